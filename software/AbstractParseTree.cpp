@@ -10,14 +10,39 @@
 
 struct tree_t
 {   
-	tree_t(const char* n_type = tt_list) : type(n_type), line(0), column(0), refcount(1) { c.parts = 0; }
-	tree_t(const Ident ident) : type(tt_ident), line(0), column(0), refcount(1) { c.ident = ident.val(); }
-	tree_t(string_t *value) : type(tt_str_value), line(0), column(0), refcount(1) { c.str_value = value; if (value != 0) value->refcount++; }
-	tree_t(long value) : type(tt_int_value), line(0), column(0), refcount(1) { c.int_value = value; }
-	tree_t(double value) : type(tt_double_value), line(0), column(0), refcount(1) { c.double_value = value; }
-	tree_t(char value) : type(tt_char_value), line(0), column(0), refcount(1) { c.char_value = value; }
+	tree_t(const char* n_type = tt_list) : type(n_type), line(0), column(0), refcount(1), in_arena(AbstractParseTreeArena::_active != 0) { c.parts = 0; }
+	tree_t(const Ident ident) : type(tt_ident), line(0), column(0), refcount(1), in_arena(AbstractParseTreeArena::_active != 0) { c.ident = ident.val(); }
+	tree_t(string_t *value) : type(tt_str_value), line(0), column(0), refcount(1), in_arena(AbstractParseTreeArena::_active != 0)
+	{	c.str_value = value;
+		if (value != 0)
+		{	if (shared_between_threads) atomicIncrement(value->refcount); else value->refcount++;
+			if (in_arena)
+				AbstractParseTreeArena::_active->hold(value);
+		}
+	}
+	tree_t(long value) : type(tt_int_value), line(0), column(0), refcount(1), in_arena(AbstractParseTreeArena::_active != 0) { c.int_value = value; }
+	tree_t(double value) : type(tt_double_value), line(0), column(0), refcount(1), in_arena(AbstractParseTreeArena::_active != 0) { c.double_value = value; }
+	tree_t(char value) : type(tt_char_value), line(0), column(0), refcount(1), in_arena(AbstractParseTreeArena::_active != 0) { c.char_value = value; }
 	
 	void release();
+	void release_str_value();
+	inline void add_ref()
+	{	if (shared_between_threads)
+			atomicIncrement(refcount);
+		else
+			refcount++;
+	}
+	inline bool release_ref()
+	{	if (shared_between_threads)
+			return atomicDecrement(refcount) == 0;
+		return --refcount == 0;
+	}
+	inline bool is_shared()
+	{	if (shared_between_threads)
+			return atomicValue(refcount) > 1;
+		return refcount > 1;
+	}
+	static bool shared_between_threads;
 	
 	bool can_have_parts();
 	static void assign(tree_t *&d, tree_t *s);
@@ -35,7 +60,8 @@ struct tree_t
         char   char_value;
     } c;
     int line, column;
-    unsigned long refcount;
+    volatile int refcount;
+    bool in_arena;
 
 
 	static const char *tt_ident;
@@ -49,23 +75,24 @@ struct tree_t
 
 	void* operator new(size_t size); 
 	void operator delete(void *data);
-	static long alloced;
+	static THREAD_LOCAL long alloced;
 private:
-	static tree_t *_old;
+	static THREAD_LOCAL tree_t *_old;
 };
 
 struct list_t
 {   
-	list_t() : first(0), next(0) {}
-	list_t(Ident n_name, tree_t *n_first) : name(n_name), first(n_first), next(0) {}
+	list_t() : first(0), next(0), in_arena(AbstractParseTreeArena::_active != 0) {}
+	list_t(Ident n_name, tree_t *n_first) : name(n_name), first(n_first), next(0), in_arena(AbstractParseTreeArena::_active != 0) {}
 	Ident name;
     tree_t *first;
 	list_t *next;
+	bool in_arena;
 
 	void* operator new(size_t size); 
 	void operator delete(void *data);
 private:
-	static list_t *_old;
+	static THREAD_LOCAL list_t *_old;
 };
 
 
@@ -80,12 +107,15 @@ const char *tree_t::tt_opencontext = "<opencontext>";
 const char *tree_t::tt_closecontext = "<closecontext>";
 
 
-tree_t *tree_t::_old = 0;
-long tree_t::alloced = 0;
+THREAD_LOCAL tree_t *tree_t::_old = 0;
+THREAD_LOCAL long tree_t::alloced = 0;
+bool tree_t::shared_between_threads = false;
 
 void* tree_t::operator new(size_t size)
 {   
 	alloced++;
+	if (AbstractParseTreeArena::_active != 0)
+		return AbstractParseTreeArena::_active->allocate(size);
 	if (_old == 0)
 		return malloc(size);
 	tree_t *new_tree = _old;
@@ -101,6 +131,8 @@ void* tree_t::operator new(size_t size)
 void tree_t::operator delete(void *data)
 {
 	tree_t *tree = (tree_t*)data;
+	if (tree->in_arena)
+		return;
     tree->type = (char*)_old;
     _old = tree;
 	alloced--;
@@ -129,9 +161,16 @@ void tree_t::release()
 
     alloced--;
 
-	if (--refcount == 0)
+	/* a node from an arena, with its parts and its string value, is
+	   freed when the arena is released */
+	if (in_arena)
+		return;
+
+	if (release_ref())
     {
-        if (can_have_parts())
+		if (type == tt_str_value)
+			release_str_value();
+        else if (can_have_parts())
         {   list_t *list = c.parts;
 
             while (list != 0)
@@ -145,9 +184,18 @@ void tree_t::release()
     }
 }
 
+void tree_t::release_str_value()
+{
+	if (c.str_value == 0)
+		return;
+	if (shared_between_threads ? atomicDecrement(c.str_value->refcount) == 0 : --c.str_value->refcount == 0)
+		delete c.str_value;
+	c.str_value = 0;
+}
+
 void tree_t::print(FILE *f, bool compact)
 {
-	static int print_tree_depth = 0;
+	static THREAD_LOCAL int print_tree_depth = 0;
     if (this == 0)
     	fprintf(f, "[EMPTY]");
     else 
@@ -208,10 +256,12 @@ void tree_t::print(FILE *f, bool compact)
     }
 }
 
-list_t *list_t::_old = 0;
+THREAD_LOCAL list_t *list_t::_old = 0;
 
 void* list_t::operator new(size_t size)
 {   
+	if (AbstractParseTreeArena::_active != 0)
+		return AbstractParseTreeArena::_active->allocate(size);
 	if (_old == 0)
 		return malloc(size);
 	list_t *new_list = _old;
@@ -222,10 +272,85 @@ void* list_t::operator new(size_t size)
 void list_t::operator delete(void *data)
 {
 	list_t *list = (list_t*)data;
+	if (list->in_arena)
+		return;
     list->next = _old;
 	_old = list;
 }
 
+
+// AbstractParseTreeArena
+
+#define ARENA_BLOCK_SIZE 65536
+
+struct AbstractParseTreeArena::block_t
+{
+	block_t* next;
+	double data[ARENA_BLOCK_SIZE/sizeof(double)];
+};
+
+struct AbstractParseTreeArena::string_ref_t
+{
+	string_t* value;
+	string_ref_t* next;
+};
+
+THREAD_LOCAL AbstractParseTreeArena* AbstractParseTreeArena::_active = 0;
+
+AbstractParseTreeArena::AbstractParseTreeArena()
+  : _blocks(0), _free(0), _nr_free(0), _nr_bytes(0), _strings(0)
+{
+}
+
+AbstractParseTreeArena::~AbstractParseTreeArena()
+{
+	release();
+}
+
+void AbstractParseTreeArena::release()
+{
+	for (string_ref_t* ref = _strings; ref != 0; ref = ref->next)
+		if (tree_t::shared_between_threads ? atomicDecrement(ref->value->refcount) == 0 : --ref->value->refcount == 0)
+			delete ref->value;
+	_strings = 0;
+	while (_blocks != 0)
+	{
+		block_t* next = _blocks->next;
+		free(_blocks);
+		_blocks = next;
+	}
+	_free = 0;
+	_nr_free = 0;
+	_nr_bytes = 0;
+}
+
+void AbstractParseTreeArena::hold(string_t* value)
+{
+	string_ref_t* ref = (string_ref_t*)allocate(sizeof(string_ref_t));
+	ref->value = value;
+	ref->next = _strings;
+	_strings = ref;
+}
+
+void* AbstractParseTreeArena::allocate(unsigned long size)
+{
+	size = (size + sizeof(double) - 1) & ~(sizeof(double) - 1);
+	if (size > _nr_free)
+	{
+		block_t* block = (block_t*)malloc(sizeof(block_t));
+		block->next = _blocks;
+		_blocks = block;
+		_free = (char*)block->data;
+		_nr_free = sizeof(block->data);
+		_nr_bytes += sizeof(block_t);
+	}
+	void* result = _free;
+	_free += size;
+	_nr_free -= size;
+	return result;
+}
+
+
 void tree_t::assign(tree_t *&d, tree_t *s)
 {
   tree_t *old_d = d;
@@ -233,7 +358,7 @@ void tree_t::assign(tree_t *&d, tree_t *s)
   d = s;
   if (d != 0)
   {
-    d->refcount++;
+    d->add_ref();
     alloced++;
 
 	//printf("%8X +B ", d);
@@ -250,7 +375,10 @@ tree_t *tree_t::clone()
 
 	tree_t *result = 0;
 	if (type == tt_ident)
-		result = new tree_t(c.ident);
+	{
+		result = new tree_t(tt_ident);
+		result->c.ident = c.ident;
+	}
 	else if (type == tt_str_value)
 		result = new tree_t(c.str_value);
 	else if (type == tt_int_value)
@@ -268,7 +396,7 @@ tree_t *tree_t::clone()
 		{
 			*ref_list = new list_t(list->name, list->first);
 			if (list->first != 0)
-				list->first->refcount++;
+				list->first->add_ref();
 			ref_list = &(*ref_list)->next;
 		}
 	}
@@ -343,13 +471,13 @@ struct tree_cursor_t
 
 	void* operator new(size_t size); 
 	void operator delete(void *data);
-	static long alloced;
+	static THREAD_LOCAL long alloced;
 private:
-	static tree_cursor_t *_old;
+	static THREAD_LOCAL tree_cursor_t *_old;
 };
 
-tree_cursor_t *tree_cursor_t::_old = 0;
-long tree_cursor_t::alloced = 0;
+THREAD_LOCAL tree_cursor_t *tree_cursor_t::_old = 0;
+THREAD_LOCAL long tree_cursor_t::alloced = 0;
 
 void* tree_cursor_t::operator new(size_t size)
 {
@@ -612,7 +740,7 @@ AbstractParseTree::AbstractParseTree(const AbstractParseTree& lhs)
 	_tree = lhs._tree;
 	if (_tree != 0)
 	{
-		_tree->refcount++;
+		_tree->add_ref();
 		tree_t::alloced++;
 
 		//printf("%8X +C ", _tree);
@@ -626,7 +754,7 @@ AbstractParseTree::AbstractParseTree(tree_t *tree)
 	_tree = tree;
 	if (_tree != 0)
 	{
-		_tree->refcount++;
+		_tree->add_ref();
 		tree_t::alloced++;
 
 		//printf("%8X +C ", _tree);
@@ -661,6 +789,11 @@ AbstractParseTree AbstractParseTree::makeTree(const Ident name)
 	return result;
 }
 
+void AbstractParseTree::setSharedBetweenThreads(bool shared)
+{
+	tree_t::shared_between_threads = shared;
+}
+
 void AbstractParseTree::clear()
 {
 	_tree->release();
@@ -695,7 +828,9 @@ void AbstractParseTree::createIdent( const Ident ident )
 void AbstractParseTree::createStringAtom( const char *str )
 {
 	release();
-	_tree = new tree_t(new string_t(str));
+	string_t *value = new string_t(str);
+	_tree = new tree_t(value);
+	value->refcount--;
 }
 
 void AbstractParseTree::createStringAtom( String &str )
@@ -783,10 +918,45 @@ void AbstractParseTree::dropLastChild()
     while ((*r_list)->next != 0)
         r_list = &(*r_list)->next;
 
+    (*r_list)->first->release();
     delete (*r_list);
     *r_list = 0;
 } 
 
+void AbstractParseTree::appendChild( const AbstractParseTree& child, iterator& last )
+/*	Appends the child after last, which is an iterator at the last part,
+	or an empty iterator when there are no parts, and makes last an
+	iterator at the child, without walking through the list.
+*/
+{
+	assert(_cursor == 0);
+
+	list_t **r_list = last._list != 0 ? &last._list->next : &_tree->c.parts;
+	assert(*r_list == 0);
+
+	*r_list = new list_t();
+	tree_t::assign((*r_list)->first, child._tree);
+	last._list = *r_list;
+}
+
+void AbstractParseTree::dropLastChild( const iterator& before_last )
+/*	Drops the last part, which comes after before_last, as before the
+	matching call of appendChild.
+*/
+{
+	assert(_cursor == 0);
+
+	list_t **r_list = before_last._list != 0 ? &before_last._list->next : &_tree->c.parts;
+
+	if (*r_list == 0)
+		return;
+	assert((*r_list)->next == 0);
+
+	(*r_list)->first->release();
+	delete (*r_list);
+	*r_list = 0;
+}
+
 void AbstractParseTree::createOpenContext()
 {
 	release();
@@ -845,6 +1015,56 @@ void AbstractParseTree::setLineColumn(int line, int column)
 	}
 }
 
+void AbstractParseTree::setOwnLineColumn(int line, int column)
+{
+	if (_tree != 0 && _tree->is_shared() && (_tree->line != line || _tree->column != column))
+	{
+		tree_t *copy = _tree->clone();
+		_tree->release();
+		_tree = copy;
+	}
+	setLineColumn(line, column);
+}
+
+/*	While shifting, the line of a shifted node is made negative, such
+	that a node that is shared by several trees is shifted only once.
+	Nodes without a position are not marked, and are always visited.
+*/
+static void shift_positions(tree_t *tree, int from_line, int line_delta, int column_delta)
+{
+	if (tree == 0 || tree->line < 0)
+		return;
+	if (tree->line > 0)
+	{	if (tree->line == from_line)
+			tree->column += column_delta;
+		tree->line = -(tree->line + line_delta);
+	}
+	if (tree->can_have_parts())
+		for (list_t *parts = tree->c.parts; parts != 0; parts = parts->next)
+			shift_positions(parts->first, from_line, line_delta, column_delta);
+}
+
+static void end_shift_positions(tree_t *tree)
+{
+	if (tree == 0 || tree->line > 0)
+		return;
+	if (tree->line < 0)
+		tree->line = -tree->line;
+	if (tree->can_have_parts())
+		for (list_t *parts = tree->c.parts; parts != 0; parts = parts->next)
+			end_shift_positions(parts->first);
+}
+
+void AbstractParseTree::shiftPositions(int from_line, int line_delta, int column_delta)
+{
+	shift_positions(_tree, from_line, line_delta, column_delta);
+}
+
+void AbstractParseTree::endShiftPositions()
+{
+	end_shift_positions(_tree);
+}
+
 
 AbstractParseTree::iterator::iterator(const AbstractParseTree& tree)
 {
@@ -974,7 +1194,7 @@ void AbstractParseTreeCursor::replaceBy(AbstractParseTree lhs)
 	_cursor->parent->make_private_copy();
 
 	if (lhs._tree != 0)
-		lhs._tree->refcount++;
+		lhs._tree->add_ref();
 
 	_cursor->assign(lhs._tree);
 }
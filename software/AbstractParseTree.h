@@ -1,8 +1,11 @@
 #ifndef INCLUDED_ABSTRACTPARSETREE_H
 #define INCLUDED_ABSTRACTPARSETREE_H
 
+#include "Threads.h"
+
 struct tree_t;
 struct list_t;
+struct string_t;
 struct tree_cursor_t;
 
 class AbstractParseTree;
@@ -17,6 +20,7 @@ public:
 	AbstractParseTreeBase() : _tree(0), _cursor(0) {}
 
 	bool isEmpty() const { return _tree == 0; }
+	bool isSameNode(const AbstractParseTreeBase& other) const { return _tree == other._tree; }
 
 	bool isIdent() const;
 	bool isIdent( const Ident ident ) const;
@@ -72,6 +76,9 @@ public:
 
 	static AbstractParseTree makeList();
 	static AbstractParseTree makeTree( const Ident name );
+	/* While trees are shared between threads, their reference counts
+	   are updated with atomic operations */
+	static void setSharedBetweenThreads(bool shared);
 
 	class iterator
 	{
@@ -109,12 +116,23 @@ public:
 	void insertChild( const AbstractParseTree& child );
 	void appendChild( const AbstractParseTree& child );
 	void dropLastChild();
+	// For building a long list: last is (or becomes) an iterator at the last part
+	void appendChild( const AbstractParseTree& child, iterator& last );
+	void dropLastChild( const iterator& before_last );
 	void createOpenContext();
 	void createCloseContext();
 	
 	AbstractParseTree part(int n) const;
 
 	void setLineColumn(int line, int column);
+	// Like setLineColumn, but when the node is shared with other trees,
+	// it is replaced by a copy first, such that they are not changed
+	void setOwnLineColumn(int line, int column);
+	// Adds line_delta to the lines of the nodes and column_delta to the
+	// columns of those on from_line. Shared nodes are only shifted once,
+	// until endShiftPositions is called on the same trees.
+	void shiftPositions(int from_line, int line_delta, int column_delta);
+	void endShiftPositions();
 
 private:
 	AbstractParseTree(tree_t *tree);
@@ -171,6 +189,50 @@ private:
 	AbstractParseTreeIteratorCursor *_next;
 };
 
+/*	AbstractParseTreeArena: a region from which the nodes of trees can be
+	allocated. While an arena is in use (see the Use class), all new nodes
+	are taken from it. Nodes from an arena are not freed when they are no
+	longer referenced, and releasing them does not visit their parts, but
+	all are freed at once when the arena is released, together with the
+	references of the arena to the string values of its nodes. Nodes
+	allocated from an arena should only refer to nodes from the same arena,
+	and the arena should only be released when none of its nodes are
+	referenced any more.
+*/
+
+class AbstractParseTreeArena
+{
+	friend struct tree_t;
+	friend struct list_t;
+public:
+	AbstractParseTreeArena();
+	~AbstractParseTreeArena();
+
+	void release();
+	unsigned long nrBytes() const { return _nr_bytes; }
+
+	class Use
+	{
+	public:
+		Use(AbstractParseTreeArena* arena) : _surr_arena(_active) { _active = arena; }
+		~Use() { _active = _surr_arena; }
+	private:
+		AbstractParseTreeArena* _surr_arena;
+	};
+
+private:
+	void* allocate(unsigned long size);
+	void hold(string_t* value);
+	struct block_t;
+	block_t* _blocks;
+	char* _free;
+	unsigned long _nr_free;
+	unsigned long _nr_bytes;
+	struct string_ref_t;
+	string_ref_t* _strings;
+	static THREAD_LOCAL AbstractParseTreeArena* _active;
+};
+
 #ifdef _DEBUG
 void AbstractParseTreeUnitTest();
 #endif
@@ -7,6 +7,7 @@
 #include "TextFilePos.h"
 #include "Scanner.h"
 #include "AbstractParser.h"
+#include "TreeStream.h"
 
 
 #define DEBUG_NL if (_debug_parse) printf("\n")
@@ -24,8 +25,128 @@ AbstractParser::AbstractParser()
 	_debug_nt = false;
 	_debug_parse = false;
 	_debug_scan = false;
+	_memo_window = false;
+	_first_sets = true;
+	_use_first_sets = false;
+	_nr_alternatives_tried = 0;
+	_nr_alternatives_pruned = 0;
+	_predictions = 0;
+	_size_predictions = 0;
+	_predictions_of = 0;
+	_nr_predicted_one = 0;
+	_nr_predicted_several = 0;
+	_nr_predicted_none = 0;
+	_tree_arena = 0;
+	_tree_stream = 0;
+	_stream_rule = 0;
+	_nr_streamed = 0;
+	_stream_broken = false;
+	_fail_pos = 0;
+	_nr_fail_pos = 0;
 }
 
+AbstractParser::~AbstractParser()
+{
+	delete[] _fail_pos;
+	delete[] _predictions;
+}
+
+void AbstractParser::init_fail_pos()
+{
+	if (_nr_fail_pos < nrRules())
+	{
+		delete[] _fail_pos;
+		_nr_fail_pos = nrRules();
+		_fail_pos = new long[_nr_fail_pos];
+	}
+	for (int i = 0; i < _nr_fail_pos; i++)
+		_fail_pos[i] = -1;
+}
+
+void AbstractParser::init_first_sets()
+/*	Determines for each character which terminals can start with it,
+	for pruning alternatives with the FIRST sets of the grammar (see
+	may_start). Pruning is only possible when the scanner matches
+	literals against the current character.
+*/
+{
+	_nr_alternatives_tried = 0;
+	_nr_alternatives_pruned = 0;
+	_use_first_sets = _first_sets && _scanner->matchesAtCurrentChar();
+	if (!_use_first_sets)
+		return;
+
+	for (int ch = 0; ch < 256; ch++)
+		_terminals_at[ch] = 0;
+	for (GrammarTerminal* term = allTerminals(); term != 0; term = term->next)
+	{
+		if (term->nr < 0 || term->nr >= FIRST_MAX_TERMINALS)
+			continue;
+		unsigned long bit = 1UL << term->nr;
+		GrammarCharSet chars;
+		bool known = _scanner->terminalFirstChars(term->name, chars);
+		for (int ch = 0; ch < 256; ch++)
+			if (!known || chars.contains_char(ch))
+				_terminals_at[ch] |= bit;
+	}
+}
+
+void AbstractParser::print_first_set_stats(FILE *f)
+{
+	fprintf(f, "alternatives: %lu tried, %lu pruned\n",
+			_nr_alternatives_tried, _nr_alternatives_pruned);
+}
+
+void AbstractParser::init_predictions()
+/*	Prepares the prediction tables of the grammar (see GrammarPrediction)
+	for the scanner, after init_first_sets. The entry for a choice and a
+	character combines the classes of the character and the terminals
+	that can start with it, and is resolved when it is first used. The
+	entries are kept for the next parse, when the grammar and the scanner
+	remain the same.
+*/
+{
+	_nr_predicted_one = 0;
+	_nr_predicted_several = 0;
+	_nr_predicted_none = 0;
+	if (!_use_first_sets)
+		return;
+
+	bool same = _predictions != 0 && _size_predictions == nrPredictions() * 256L && _predictions_of == allNonTerminals();
+	for (int ch = 0; same && ch < 256; ch++)
+		if (_predictions_terminals_at[ch] != _terminals_at[ch])
+			same = false;
+	if (same)
+		return;
+
+	if (_size_predictions != nrPredictions() * 256L)
+	{
+		delete[] _predictions;
+		_size_predictions = nrPredictions() * 256L;
+		_predictions = new short[_size_predictions];
+	}
+	for (long i = 0; i < _size_predictions; i++)
+		_predictions[i] = PREDICT_UNKNOWN;
+	_predictions_of = allNonTerminals();
+	for (int ch = 0; ch < 256; ch++)
+		_predictions_terminals_at[ch] = _terminals_at[ch];
+}
+
+short AbstractParser::resolve_prediction(GrammarPrediction* prediction, unsigned char ch)
+{
+	short entry = prediction->by_class[ch];
+	unsigned long terminals = _terminals_at[ch];
+	for (int t = 0; terminals != 0; t++, terminals >>= 1)
+		if ((terminals & 1) != 0)
+			entry = GrammarPrediction::combine(entry, prediction->by_class[256 + t]);
+	return entry;
+}
+
+void AbstractParser::print_prediction_stats(FILE *f)
+{
+	fprintf(f, "predictions: %lu of one alternative, %lu of several, %lu of none\n",
+			_nr_predicted_one, _nr_predicted_several, _nr_predicted_none);
+}
 
 void AbstractParser::expected_string(TextFilePos& pos, const char *s, bool is_keyword)
 {
@@ -95,6 +216,85 @@ void AbstractParser::printExpected(FILE *f, const char* filename, const TextFile
 
 }
 
+static bool refers_to(GrammarOrRule* or_rule, GrammarNonTerminal* non_term)
+{
+	for (; or_rule != 0; or_rule = or_rule->next)
+		for (GrammarRule* rule = or_rule->rule; rule != 0; rule = rule->next)
+			if (   ((rule->kind == RK_NT || rule->kind == RK_WS_NT) && rule->text.non_terminal == non_term)
+				|| ((rule->kind == RK_OR_RULE || rule->kind == RK_COR_RULE) && refers_to(rule->text.or_rules->first, non_term)))
+				return true;
+	return false;
+}
+
+void AbstractParser::init_stream(GrammarNonTerminal* root)
+/*	Determines whether the elements of the top-level list can be sent
+	to the tree stream while parsing. This is the case when the root has
+	a single alternative without a tree name, that starts with a
+	sequential element and has no other elements with a value, and when
+	the root is not used by any rule. The parse tree is then the list of
+	that element. When the elements cannot be streamed, endTreeStream
+	streams the parse tree as a whole.
+*/
+{
+	_stream_rule = 0;
+	_stream_seq.clear();
+	_nr_streamed = 0;
+	_stream_broken = false;
+	if (   _tree_stream == 0 || root->first == 0 || root->first->next != 0 || root->recursive != 0
+		|| !root->first->tree_name.empty() || root->first->rule == 0 || !root->first->rule->sequential)
+		return;
+	for (GrammarRule* rule = root->first->rule->next; rule != 0; rule = rule->next)
+		if (!(   rule->kind == RK_T_EOF
+			  || (   (rule->kind == RK_LIT || rule->kind == RK_WS_TERM || rule->kind == RK_WS_NT)
+				  && !rule->optional && !rule->sequential)))
+			return;
+	for (GrammarNonTerminal* non_term = allNonTerminals(); non_term != 0; non_term = non_term->next)
+		if (refers_to(non_term->first, root) || refers_to(non_term->recursive, root))
+			return;
+	_stream_rule = root->first->rule;
+}
+
+void AbstractParser::stream_elements(AbstractParseTree& seq)
+/*	Sends the elements of the top-level list that have been parsed to
+	the tree stream, and drops them from the list.
+*/
+{
+	if (_nr_streamed == 0 && _stream_seq.isEmpty())
+	{
+		_tree_stream->openList();
+		_stream_seq = seq;
+	}
+	else if (!seq.isSameNode(_stream_seq))
+		_stream_broken = true;
+	for (AbstractParseTree::iterator it(seq); it.more(); it.next())
+	{
+		_tree_stream->stream(it);
+		_nr_streamed++;
+	}
+	while (AbstractParseTree::iterator(seq).more())
+		seq.dropLastChild();
+}
+
+bool AbstractParser::endTreeStream(AbstractParseTree& result)
+/*	Completes the tree stream after a successful parse. Returns false
+	when the streamed elements do not match the parse tree, because the
+	parser back-tracked over an element that was already streamed.
+*/
+{
+	if (_stream_seq.isEmpty())
+	{
+		_tree_stream->stream(result);
+		return true;
+	}
+	bool ok = !_stream_broken && result.isSameNode(_stream_seq);
+	if (ok)
+		for (AbstractParseTree::iterator it(result); it.more(); it.next())
+			_tree_stream->stream(it);
+	_tree_stream->close();
+	_stream_seq.clear();
+	return ok;
+}
+
 /* Special strings for identifiers and context */
 const char *tt_identdef = "<identdef>";
 const char *tt_identdefadd = "<identdefadd>";
@@ -5,19 +5,29 @@
 #include "TextFileBuffer.h"
 
 class AbstractScanner;
+class AbstractTreeStream;
+
+#define PREDICT_UNKNOWN -32768
 
 class AbstractParser : public Grammar
 {
 public:
 	AbstractParser();
+	virtual ~AbstractParser();
 	
 	void setScanner(AbstractScanner* scanner) { _scanner = scanner; }
 	
 	void setDebugLevel(bool debug_nt, bool debug_parse, bool debug_scan) { _debug_nt = debug_nt; _debug_parse = debug_parse; _debug_scan = debug_scan; }
+	void setMemoWindow(bool memo_window) { _memo_window = memo_window; }
+	void setFirstSets(bool first_sets) { _first_sets = first_sets; }
+	void setTreeArena(AbstractParseTreeArena* tree_arena) { _tree_arena = tree_arena; }
+	void setTreeStream(AbstractTreeStream* tree_stream) { _tree_stream = tree_stream; }
 
 	virtual bool parse(const TextFileBuffer& textBuffer, Ident root_id, AbstractParseTree& result) = 0;
 
 	void printExpected(FILE *f, const char* filename, const TextFileBuffer& textBuffer);
+	bool endTreeStream(AbstractParseTree& result);
+	virtual void printStats(FILE *) {}
 	
 protected:
 
@@ -33,12 +43,87 @@ protected:
 	int _nr_exp_syms;
 	TextFilePos _f_file_pos;
 	void expected_string(TextFilePos& pos, const char *s, bool is_keyword);
+	void init_fail_pos();
+	void init_first_sets();
+	inline bool may_start(const GrammarFirstSet* first_set, char ch)
+	{
+		if (   !_use_first_sets || first_set == 0 || first_set->any || first_set->nullable
+			|| first_set->chars.contains_char(ch)
+			|| (first_set->terminals & _terminals_at[(unsigned char)ch]) != 0)
+		{
+			_nr_alternatives_tried++;
+			return true;
+		}
+		_nr_alternatives_pruned++;
+		return false;
+	}
+	void print_first_set_stats(FILE *f);
+	void init_predictions();
+	/* Returns the first alternative of the choice to try at character ch,
+	   and whether it is the only one (see GrammarPrediction). When there
+	   is no prediction table, all alternatives are tried, in order. */
+	inline GrammarOrRule* predict(GrammarPrediction* prediction, GrammarOrRule* first, char ch, bool& only)
+	{
+		only = false;
+		if (!_use_first_sets || prediction == 0)
+			return first;
+		short &entry = _predictions[prediction->nr * 256 + (unsigned char)ch];
+		if (entry == PREDICT_UNKNOWN)
+			entry = resolve_prediction(prediction, (unsigned char)ch);
+		if (entry == PREDICT_NONE)
+		{
+			_nr_predicted_none++;
+			return 0;
+		}
+		if (entry >= 0)
+		{
+			_nr_predicted_one++;
+			only = true;
+			return prediction->alternatives[entry];
+		}
+		_nr_predicted_several++;
+		return prediction->alternatives[PREDICT_FIRST(entry)];
+	}
+	inline GrammarOrRule* next_predicted(GrammarOrRule* or_rule, char ch, bool only)
+	{
+		if (only)
+			return 0;
+		for (or_rule = or_rule->next; or_rule != 0; or_rule = or_rule->next)
+			if (may_start(or_rule->first_set, ch))
+				return or_rule;
+		return 0;
+	}
+	void print_prediction_stats(FILE *f);
+	long *_fail_pos; // last position where a rule failed, indexed by GrammarRule::nr
+	int _nr_fail_pos;
 	Ident _current_nt;
 	GrammarRule* _current_rule;
 	
 	bool _debug_nt;
 	bool _debug_parse;
 	bool _debug_scan;
+	bool _memo_window;
+	bool _first_sets;
+	bool _use_first_sets;
+	unsigned long _terminals_at[256]; // terminals (as in GrammarFirstSet) that can start with a character
+	unsigned long _nr_alternatives_tried;
+	unsigned long _nr_alternatives_pruned;
+	short* _predictions; // for each GrammarPrediction and character, resolved on first use
+	long _size_predictions;
+	GrammarNonTerminal* _predictions_of; // the grammar of _predictions
+	unsigned long _predictions_terminals_at[256]; // and the _terminals_at they were resolved with
+	short resolve_prediction(GrammarPrediction* prediction, unsigned char ch);
+	unsigned long _nr_predicted_one;
+	unsigned long _nr_predicted_several;
+	unsigned long _nr_predicted_none;
+	AbstractParseTreeArena* _tree_arena;
+	AbstractTreeStream* _tree_stream;
+	GrammarRule* _stream_rule; // sequential element of the root of which the elements are streamed
+	AbstractParseTree _stream_seq; // the list of that element
+	unsigned long _nr_streamed;
+	bool _stream_broken; // elements were streamed from another list
+	void init_stream(GrammarNonTerminal* root);
+	void stream_elements(AbstractParseTree& seq);
 };
 
 
@@ -31,6 +31,11 @@ BTHeapParser::BTHeapParser()
 	_parse_function = 0;
 }
 
+BTHeapParser::~BTHeapParser()
+{
+	delete _solutions;
+}
+
 bool BTHeapParser::parse_term( GrammarTerminal* term, AbstractParseTree &rtree )
 {
 	TextFilePos start_pos = _text;
@@ -235,7 +240,7 @@ void ParseNTFunction::execute()
 
 	_surr_nt = _parser->_current_nt;
 	_nt = _non_term->name;
-	_sol = _parser->find_solution(_parser->_text.position(), _nt);
+	_sol = _parser->find_solution(_parser->_text.position(), _non_term);
 
 	DEBUG_ENTER_P1("parse_nt(%s)", _nt.val()); DEBUG_NL;
 
@@ -408,14 +413,14 @@ void ParseRuleFunction::execute()
 	_chain_sym = _rule->chain_symbol;
 
 	/* Did we fail the last time at this position? */
-	if (_rule->last_fail_pos == _parser->_text.position())
+	if (_parser->_fail_pos[_rule->nr] == (long)_parser->_text.position())
 	{
 		DEBUG_EXIT("parse_rule - BREAK "); DEBUG_NL;
 		_result = false;
 		_parser->exit();
 		return;
 	}
-	_last_fail_pos = &_rule->last_fail_pos;
+	_last_fail_pos = &_parser->_fail_pos[_rule->nr];
 
 	_sp = _parser->_text;
 	_parser->_current_rule = _rule;
@@ -827,48 +832,20 @@ void ParseSeqFunction::execute()
 }
 
 void BTHeapParser::init_solutions()
-{	unsigned long i;
-
-	_solutions = new ParseSolution*[_text.length()+1];
-	for (i = 0; i < _text.length()+1; i++)
-		_solutions[i] = 0;
+{
+	if (_solutions == 0)
+		_solutions = new ParseSolutions;
+	_solutions->init(_text.length(), nrNonTerminals(), false);
 }
 
 void BTHeapParser::free_solutions()
 {
-	unsigned long i;
-
-	for (i = 0; i < _text.length()+1; i++)
-	{	ParseSolution* sol = _solutions[i];
-
-		while (sol != 0)
-		{	ParseSolution* next_sol = sol->next;
-			delete sol;
-			sol = next_sol;
-		}
-  	}
-	delete _solutions;
-	_solutions = 0;
+	_solutions->clear();
 }
 
-ParseSolution* BTHeapParser::find_solution(unsigned long filepos, Ident nt)
+ParseSolution* BTHeapParser::find_solution(unsigned long filepos, GrammarNonTerminal* non_term)
 {
-	ParseSolution* sol;
-
-	if (filepos > _text.length())
-		filepos = _text.length();
-
-	for (sol = _solutions[filepos]; sol != 0; sol = sol->next)
-		if ( sol->nt == nt )
-		 	return sol;
-
-	sol = new ParseSolution;
-	sol->next = _solutions[filepos];
-	sol->nt = nt;
-	sol->success = s_unknown;
-	_solutions[filepos] = sol;
-
-	return sol;
+	return _solutions->find(filepos, non_term);
 }
 
 void BTHeapParser::expected_string(const char *s, bool is_keyword)
@@ -889,10 +866,12 @@ void BTHeapParser::exit()
 
 bool BTHeapParser::parse(const TextFileBuffer& textBuffer, Ident root_id, AbstractParseTree& rtree)
 {
+	AbstractParseTreeArena::Use use_arena(_tree_arena);
 	_depth = 0;
 	_text = textBuffer;
 	_f_file_pos = _text;
 	_nr_exp_syms = 0;
+	init_fail_pos();
 	
 	init_solutions();
 
@@ -906,6 +885,7 @@ bool BTHeapParser::parse(const TextFileBuffer& textBuffer, Ident root_id, Abstra
 	delete _root;
 
 	free_solutions();
+	_scanner->doneScanning();
 		
 	return try_it;
 }
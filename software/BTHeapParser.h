@@ -4,6 +4,7 @@
 #include "ParserGrammar.h"
 
 class ParseSolution;
+class ParseSolutions;
 class ParsedValue;
 class ParseFunction;
 
@@ -15,6 +16,7 @@ class BTHeapParser : public AbstractParser
 	friend class ParseSeqFunction;
 public:
 	BTHeapParser();
+	~BTHeapParser();
 	
 	bool parse(const TextFileBuffer& textBuffer, Ident root_id, AbstractParseTree& result);
 	
@@ -24,13 +26,13 @@ private:
 	bool parse_ident(GrammarIdent* ident, AbstractParseTree &rtree);
 	void init_solutions();
 	void free_solutions();
-	ParseSolution* find_solution(unsigned long filepos, Ident nt);
+	ParseSolution* find_solution(unsigned long filepos, GrammarNonTerminal* non_term);
 	
 	TextFileBuffer _text;	
 
 	void expected_string(const char *s, bool is_keyword);
 	
-	ParseSolution** _solutions;
+	ParseSolutions* _solutions;
 	int _depth;
 
 	void call(ParseFunction* parse_function);
@@ -9,6 +9,7 @@
 #include "AbstractParser.h"
 #include "ParseSolution.h"
 #include "BTParser.h"
+#include "LookaheadDFA.h"
 
 
 #define DEBUG_ENTER(X) if (_debug_parse) { DEBUG_TAB; printf("Enter: %s", X); _depth += 2; }
@@ -27,6 +28,57 @@
 BTParser::BTParser()
 {
 	_solutions = 0;
+	_incremental = false;
+	_solutions_kept = false;
+	_reuse_solutions = false;
+	_examined = 0;
+	_fail_examined = 0;
+	_nr_fail_examined = 0;
+	_lookahead = 0;
+}
+
+BTParser::~BTParser()
+{
+	delete _solutions;
+	delete _lookahead;
+	delete[] _fail_examined;
+}
+
+void BTParser::setAdaptive(bool adaptive)
+{
+	if (adaptive && _lookahead == 0)
+		_lookahead = new LookaheadDFAs;
+	else if (!adaptive)
+	{
+		delete _lookahead;
+		_lookahead = 0;
+	}
+}
+
+GrammarOrRule* BTParser::predict_alternatives(GrammarPrediction* prediction, GrammarOrRule* first, Alternatives& alternatives)
+/*	Narrows the alternatives that may start at the current character
+	(see AbstractParser::predict) with the lookahead DFA of the choice
+	when there are several. */
+{
+	if (!_use_first_sets || prediction == 0)
+		return may_start_from(first);
+
+	bool only;
+	GrammarOrRule* or_rule = predict(prediction, first, *_text, only);
+	alternatives.prediction = prediction;
+	alternatives.i = 0;
+	if (or_rule == 0 || only)
+	{
+		static const short none = 0;
+		alternatives.predicted = &none;
+		alternatives.nr_predicted = 1;
+		return or_rule;
+	}
+	unsigned long examined;
+	alternatives.nr_predicted = _lookahead->predict(prediction, _current_nt, _text, _scanner, alternatives.predicted, examined);
+	if (examined > _examined)
+		_examined = examined;
+	return alternatives.nr_predicted > 0 ? prediction->alternatives[alternatives.predicted[0]] : 0;
 }
 
 bool BTParser::parse_term( GrammarTerminal* term, AbstractParseTree &rtree )
@@ -111,24 +163,35 @@ bool BTParser::parse_nt( GrammarNonTerminal* non_term, AbstractParseTree& rtree)
     GrammarOrRule* or_rule;
     Ident surr_nt = _current_nt;
     Ident nt = non_term->name;
-    ParseSolution* sol = find_solution(_text.position(), nt);
+    unsigned long start_pos = _text.position();
+    ParseSolution* sol = find_solution(start_pos, non_term);
 
     DEBUG_ENTER_P1("parse_nt(%s)", nt.val()); DEBUG_NL;
 
-    if (sol->success == s_success)
+    if (sol == 0)
+        ; /* position is before the memo window */
+    else if (sol->success == s_success)
     {
         DEBUG_EXIT_P1("parse_nt(%s) SUCCESS", nt.val());  DEBUG_NL;
         rtree = sol->result;
         _text = sol->sp;
+        if (sol->examined > _examined)
+            _examined = sol->examined;
         return true;
     }
     else if (sol->success == s_fail)
     {
         DEBUG_EXIT_P1("parse_nt(%s) FAIL", nt.val());  DEBUG_NL;
+        if (sol->examined > _examined)
+            _examined = sol->examined;
         return false;
     }
 
     _current_nt = nt;
+    reached();
+    unsigned long surr_examined = _examined;
+    _examined = start_pos;
+    _text.setFurthest(start_pos);
 
     if (_debug_nt)
     {   printf("%*.*s", _depth, _depth, "");
@@ -136,7 +199,8 @@ bool BTParser::parse_nt( GrammarNonTerminal* non_term, AbstractParseTree& rtree)
         _depth += 2; 
     }
 
-    for (or_rule = non_term->first; or_rule != 0; or_rule = or_rule->next )
+    Alternatives alternatives;
+    for (or_rule = first_alternative(non_term->prediction, non_term->first, alternatives); or_rule != 0; or_rule = next_alternative(or_rule, alternatives))
         if (parse_rule(or_rule->rule, (ParsedValue*)0, or_rule->tree_name, rtree))
             break;
 
@@ -147,7 +211,7 @@ bool BTParser::parse_nt( GrammarNonTerminal* non_term, AbstractParseTree& rtree)
             val.prev = 0;
             val.last.attach(rtree);
 
-            for (or_rule = non_term->recursive; or_rule != 0; or_rule = or_rule->next )
+            for (or_rule = first_alternative(non_term->rec_prediction, non_term->recursive, alternatives); or_rule != 0; or_rule = next_alternative(or_rule, alternatives))
                 if (parse_rule(or_rule->rule, &val, or_rule->tree_name, rtree))
                     break;
 
@@ -166,9 +230,17 @@ bool BTParser::parse_nt( GrammarNonTerminal* non_term, AbstractParseTree& rtree)
 			printf("Parsed: %s %d.%d\n", nt.val(), _text.line(), _text.column());
         }
         _current_nt = surr_nt;
-        sol->result = rtree;
-        sol->success = s_success;
-        sol->sp = _text;
+        reached();
+        /* the memo window may have been cut while parsing */
+        sol = find_solution(start_pos, non_term);
+        if (sol != 0)
+        {   sol->result = rtree;
+            sol->success = s_success;
+            sol->sp = _text;
+            sol->examined = _examined;
+        }
+        if (surr_examined > _examined)
+            _examined = surr_examined;
         return true;
     }
     DEBUG_EXIT_P1("parse_nt(%s) - failed", nt.val());  DEBUG_NL;
@@ -179,16 +251,24 @@ bool BTParser::parse_nt( GrammarNonTerminal* non_term, AbstractParseTree& rtree)
 		printf("Failed: %s %d.%d\n", nt.val(), _text.line(), _text.column());
     }
     _current_nt = surr_nt;
-    sol->success = s_fail;
+    reached();
+    sol = find_solution(start_pos, non_term);
+    if (sol != 0)
+    {   sol->success = s_fail;
+        sol->examined = _examined;
+    }
+    if (surr_examined > _examined)
+        _examined = surr_examined;
     return false;
 }
 
-bool BTParser::parse_or(GrammarOrRule* or_rule, ParsedValue* prev_parts, AbstractParseTree &rtree)
+bool BTParser::parse_or(GrammarOrRules* or_rules, ParsedValue* prev_parts, AbstractParseTree &rtree)
 {
     DEBUG_ENTER("parse_or: ");
-    DEBUG_PO(or_rule); DEBUG_NL;
+    DEBUG_PO(or_rules->first); DEBUG_NL;
 
-    for ( ; or_rule != 0; or_rule = or_rule->next )
+    Alternatives alternatives;
+    for (GrammarOrRule* or_rule = first_alternative(or_rules->prediction, or_rules->first, alternatives); or_rule != 0; or_rule = next_alternative(or_rule, alternatives))
         if (parse_rule(or_rule->rule, prev_parts, or_rule->tree_name, rtree))
         {   DEBUG_EXIT("parse_or = ");
             DEBUG_PT(rtree); DEBUG_NL;
@@ -239,14 +319,17 @@ bool BTParser::parse_rule(GrammarRule* rule, ParsedValue* prev_parts, const Iden
 
     TextFilePos sp = _text;
     _current_rule = rule;
+    reached();
 
     /* Did we fail the last time at this position? */
-    if (rule->last_fail_pos == _text.position())
+    if (_fail_pos[rule->nr] == (long)_text.position())
     {
         DEBUG_EXIT("parse_rule - BREAK "); DEBUG_NL;
+        if (_fail_examined[rule->nr] > _examined)
+            _examined = _fail_examined[rule->nr];
         return false;
     }
-    long *last_fail_pos = &rule->last_fail_pos;
+    long *last_fail_pos = &_fail_pos[rule->nr];
 
     if (optional && avoid)
     {    
@@ -315,7 +398,7 @@ bool BTParser::parse_rule(GrammarRule* rule, ParsedValue* prev_parts, const Iden
                     	seq.createList();
 
                         if (parse_seq(rule, chain_sym,
-                                      seq, prev_parts, tree_name, rtree))
+                                      seq, AbstractParseTree::iterator(), prev_parts, tree_name, rtree))
                         {   DEBUG_EXIT("parse_rule = ");
                             DEBUG_PT(rtree); DEBUG_NL;
                             rtree.setLineColumn(start_pos.line(), start_pos.column());
@@ -357,10 +440,10 @@ bool BTParser::parse_rule(GrammarRule* rule, ParsedValue* prev_parts, const Iden
 				try_it = true;
 				break;
             case RK_OR_RULE:
-                try_it = parse_or(rule->text.or_rules->first, (ParsedValue*)0, t);
+                try_it = parse_or(rule->text.or_rules, (ParsedValue*)0, t);
                 break;
             case RK_COR_RULE:
-            	if (parse_or(rule->text.or_rules->first, prev_parts, rtree))
+            	if (parse_or(rule->text.or_rules, prev_parts, rtree))
                 {   DEBUG_EXIT("parse_rule = ");
                     DEBUG_PT(rtree); DEBUG_NL;
 					return true;            		
@@ -369,6 +452,8 @@ bool BTParser::parse_rule(GrammarRule* rule, ParsedValue* prev_parts, const Iden
             	{
 	    			_text = sp;
 					*last_fail_pos = _text.position();
+					reached();
+					_fail_examined[rule->nr] = _examined;
 					DEBUG_EXIT_P1("parse_rule - failed at %ld", _text.position()); DEBUG_NL;
 					return false;
 				}
@@ -387,10 +472,11 @@ bool BTParser::parse_rule(GrammarRule* rule, ParsedValue* prev_parts, const Iden
             if (sequential)
             {   AbstractParseTree seq;
             	seq.createList();
-                seq.appendChild(t);
+            	AbstractParseTree::iterator last;
+                seq.appendChild(t, last);
 
                 if (parse_seq(rule, chain_sym,
-                              seq, prev_parts, tree_name, rtree))
+                              seq, last, prev_parts, tree_name, rtree))
                 {   DEBUG_EXIT("parse_rule = ");
                     DEBUG_PT(rtree); DEBUG_NL;
                     if (is_terminal)
@@ -432,22 +518,27 @@ bool BTParser::parse_rule(GrammarRule* rule, ParsedValue* prev_parts, const Iden
     }
 
     *last_fail_pos = _text.position();
+    reached();
+    _fail_examined[rule->nr] = _examined;
     DEBUG_EXIT_P1("parse_rule - failed at %ld", _text.position()); DEBUG_NL;
     return false;
 }
 
 bool BTParser::parse_seq(GrammarRule* rule, const char *chain_sym,
-               AbstractParseTree seq, ParsedValue* prev_parts, const Ident tree_name,
+               AbstractParseTree seq, AbstractParseTree::iterator last, ParsedValue* prev_parts, const Ident tree_name,
                AbstractParseTree &rtree)
 {       
     DEBUG_ENTER("parse_seq: ");
     DEBUG_PR(rule); DEBUG_P1(" at |%s|", _text.start()); DEBUG_NL;
 	
+	if (rule == _stream_rule)
+		return parse_stream_seq(rule, chain_sym, seq, prev_parts, tree_name, rtree);
 
 	bool avoid = rule->avoid;
 
     TextFilePos sp = _text;
     _current_rule = rule;
+    reached();
 
 	if (avoid)
 	{
@@ -468,77 +559,29 @@ bool BTParser::parse_seq(GrammarRule* rule, const char *chain_sym,
     if (chain_sym == 0 || *chain_sym == '\0' || _scanner->acceptLiteral(_text, chain_sym))
     {   AbstractParseTree t;
     	TextFilePos start_pos = _text;
-	    bool try_it = false;
-
-        switch( rule->kind )
-        {   case RK_T_EOF:
-                try_it = _scanner->acceptEOF(_text);
-                if (try_it)
-                   t = Ident("EOF").val();
-                break;
-            case RK_TERM:
-            	try_it = parse_term(rule->text.terminal, t);
-            	break;
-            case RK_WS_TERM:
-            	try_it = parse_ws_term(rule->text.terminal);
-            	break;
-            case RK_IDENT:
-            	try_it = parse_ident(rule->text.ident, t);
-            	break;
-            case RK_NT:
-                try_it = parse_nt(rule->text.non_terminal, t);
-                break;
-			case RK_WS_NT:
-                try_it = parse_nt(rule->text.non_terminal, t);
-				t.clear();
-                break;
-            case RK_LIT:
-            	try_it = _scanner->acceptLiteral(_text, rule->str_value);
-            	if (!try_it)
-            		expected_string(rule->str_value, true);
-                break;
-			case RK_CHARSET:
-				try_it = rule->text.char_set->contains_char(*_text);
-				if (!try_it)
-					expected_string("<charset>", false);
-				else
-				{	t.createCharAtom(*_text);
-					_text.next();
-					_scanner->skipSpace(_text);
-				}
-				break;
-			case RK_AVOID:
-				try_it = !rule->text.char_set->contains_char(*_text);
-				break;
-			case RK_COLOURCODING:
-				try_it = true;
-				break;
-            case RK_OR_RULE:
-                try_it = parse_or(rule->text.or_rules->first, (ParsedValue*)0, t);
-                break;
-            case RK_COR_RULE:
-            	// should not happen
-            	break;
-            default:
-                try_it = false;
-        } 
         
-        if (try_it)
+        if (parse_seq_element(rule, t))
         {   /* We succeded in parsing the first element */
             
             if (!t.isEmpty() && t.line() == 0)
 	        	t.setLineColumn(start_pos.line(), start_pos.column());
    
-        	seq.appendChild(t);
+        	AbstractParseTree::iterator before_last = last;
+        	seq.appendChild(t, last);
+
+            /* an element of the top-level list is complete: the memo
+               entries before this position are not likely to be used */
+            if (_memo_window && _current_nt == _root_nt)
+                _solutions->cut(_text.position());
 
             if (parse_seq(rule, chain_sym,
-                          seq, prev_parts, tree_name, rtree))
+                          seq, last, prev_parts, tree_name, rtree))
             {
                 DEBUG_EXIT("parse_seq = ");
                 DEBUG_PT(rtree); DEBUG_NL;
                 return true;
             }
-            seq.dropLastChild();
+            seq.dropLastChild(before_last);
         }
         else if (chain_sym != 0)
         	expected_string(chain_sym, true);
@@ -564,49 +607,158 @@ bool BTParser::parse_seq(GrammarRule* rule, const char *chain_sym,
     return false;
 }
 
-void BTParser::init_solutions()
-{	unsigned long i;
+bool BTParser::parse_stream_seq(GrammarRule* rule, const char *chain_sym,
+			   AbstractParseTree seq, ParsedValue* prev_parts, const Ident tree_name,
+			   AbstractParseTree &rtree)
+/*	Parses the remaining elements of the top-level list, of which the
+	elements are streamed (see init_stream). A streamed element cannot be
+	taken back, hence the elements are parsed in a loop instead of with
+	a recursive call for each element, such that neither the stack nor
+	the parse tree grows with the input. When the rest of the rule fails
+	after the last element, the parse fails without back-tracking over
+	the elements, and parse tries again without streaming.
+*/
+{
+	bool avoid = rule->avoid;
 
-	_solutions = new ParseSolution*[_text.length()+1];
-	for (i = 0; i < _text.length()+1; i++)
-		_solutions[i] = 0;
-}
+	for (;;)
+	{
+		stream_elements(seq);
 
-void BTParser::free_solutions()
-{
-	unsigned long i;
+		TextFilePos sp = _text;
+		_current_rule = rule;
+		reached();
 
-	for (i = 0; i < _text.length()+1; i++)
-	{	ParseSolution* sol = _solutions[i];
+		if (avoid)
+		{
+			/* should be avoided */
+			ParsedValue val;
+			val.last = seq;
+			val.prev = prev_parts;
+			if (parse_rule(rule->next, &val, tree_name, rtree))
+			{
+				DEBUG_EXIT("parse_seq = ");
+				DEBUG_PT(rtree); DEBUG_NL;
+				return true;
+			}
+			_text = sp;
+		}
 
-		while (sol != 0)
-		{	ParseSolution* next_sol = sol->next;
-			delete sol;
-			sol = next_sol;
+		if (chain_sym == 0 || *chain_sym == '\0' || _scanner->acceptLiteral(_text, chain_sym))
+		{   AbstractParseTree t;
+			TextFilePos start_pos = _text;
+
+			if (parse_seq_element(rule, t))
+			{
+				if (!t.isEmpty() && t.line() == 0)
+					t.setLineColumn(start_pos.line(), start_pos.column());
+				seq.appendChild(t);
+
+				if (_memo_window)
+					_solutions->cut(_text.position());
+				continue;
+			}
+			else if (chain_sym != 0)
+				expected_string(chain_sym, true);
+			_text = sp;
 		}
-  	}
-	delete _solutions;
-	_solutions = 0;
+
+		if (!avoid)
+		{
+			/* should not be avoided */
+			ParsedValue val;
+			val.last = seq;
+			val.prev = prev_parts;
+			if (parse_rule(rule->next, &val, tree_name, rtree))
+			{
+				DEBUG_EXIT("parse_seq = ");
+				DEBUG_PT(rtree); DEBUG_NL;
+				return true;
+			}
+			_text = sp;
+		}
+
+		DEBUG_EXIT_P1("parse_seq - failed at %ld", _text.position()); DEBUG_NL;
+		return false;
+	}
 }
 
-ParseSolution* BTParser::find_solution(unsigned long filepos, Ident nt)
+bool BTParser::parse_seq_element(GrammarRule* rule, AbstractParseTree& t)
 {
-	ParseSolution* sol;
+	bool try_it = false;
+	reached();
+
+	switch( rule->kind )
+	{   case RK_T_EOF:
+			try_it = _scanner->acceptEOF(_text);
+			if (try_it)
+			   t = Ident("EOF").val();
+			break;
+		case RK_TERM:
+			try_it = parse_term(rule->text.terminal, t);
+			break;
+		case RK_WS_TERM:
+			try_it = parse_ws_term(rule->text.terminal);
+			break;
+		case RK_IDENT:
+			try_it = parse_ident(rule->text.ident, t);
+			break;
+		case RK_NT:
+			try_it = parse_nt(rule->text.non_terminal, t);
+			break;
+		case RK_WS_NT:
+			try_it = parse_nt(rule->text.non_terminal, t);
+			t.clear();
+			break;
+		case RK_LIT:
+			try_it = _scanner->acceptLiteral(_text, rule->str_value);
+			if (!try_it)
+				expected_string(rule->str_value, true);
+			break;
+		case RK_CHARSET:
+			try_it = rule->text.char_set->contains_char(*_text);
+			if (!try_it)
+				expected_string("<charset>", false);
+			else
+			{	t.createCharAtom(*_text);
+				_text.next();
+				_scanner->skipSpace(_text);
+			}
+			break;
+		case RK_AVOID:
+			try_it = !rule->text.char_set->contains_char(*_text);
+			break;
+		case RK_COLOURCODING:
+			try_it = true;
+			break;
+		case RK_OR_RULE:
+			try_it = parse_or(rule->text.or_rules, (ParsedValue*)0, t);
+			break;
+		case RK_COR_RULE:
+			// should not happen
+			break;
+		default:
+			try_it = false;
+	}
 
-	if (filepos > _text.length())
-		filepos = _text.length();
+	return try_it;
+}
 
-	for (sol = _solutions[filepos]; sol != 0; sol = sol->next)
-		if ( sol->nt == nt )
-		 	return sol;
+void BTParser::init_solutions()
+{
+	if (_solutions == 0)
+		_solutions = new ParseSolutions;
+	_solutions->init(_text.length(), nrNonTerminals(), _memo_window);
+}
 
-	sol = new ParseSolution;
-	sol->next = _solutions[filepos];
-	sol->nt = nt;
-	sol->success = s_unknown;
-	_solutions[filepos] = sol;
+void BTParser::free_solutions()
+{
+	_solutions->clear();
+}
 
-	return sol;
+ParseSolution* BTParser::find_solution(unsigned long filepos, GrammarNonTerminal* non_term)
+{
+	return _solutions->find(filepos, non_term);
 }
 
 void BTParser::expected_string(const char *s, bool is_keyword)
@@ -616,25 +768,141 @@ void BTParser::expected_string(const char *s, bool is_keyword)
 
 bool BTParser::parse(const TextFileBuffer& textBuffer, Ident root_id, AbstractParseTree& result)
 {
+	AbstractParseTreeArena::Use use_arena(_tree_arena);
 	_depth = 0;
 	_text = textBuffer;
-	_f_file_pos = _text;
-	_nr_exp_syms = 0;
-	
-	init_solutions();
+	TextFilePos file_start = _text;
 
 	_scanner->initScanning(this);
 	_scanner->skipSpace(_text);
 	GrammarNonTerminal* root = findNonTerminal(root_id);
 	if (root == 0)
 	    return false;
-	bool try_it = parse_nt(root, result);
+	_root_nt = root_id;
+	init_stream(root);
 
-	free_solutions();
+	init_first_sets();
+	if (_lookahead != 0)
+	{
+		init_predictions();
+		_lookahead->init(this, _terminals_at);
+	}
+	TextFilePos start_pos = _text;
+	_f_file_pos = file_start;
+	bool reused = _reuse_solutions;
+	bool try_it = parse_root(root, result);
+	if (!try_it && (_use_first_sets || _stream_rule != 0 || reused))
+	{
+		/* Pruned alternatives are missing from the expected symbols,
+		   and the streamed top-level list was not back-tracked over,
+		   and neither were the reused memo entries, hence parse again
+		   without them for the error message. */
+		_use_first_sets = false;
+		_stream_rule = 0;
+		_text = start_pos;
+		_f_file_pos = file_start;
+		try_it = parse_root(root, result);
+	}
+	if (!try_it)
+		_stream_seq.clear();
+	_scanner->doneScanning();
 		
 	return try_it;
 }
 
+bool BTParser::parse_root(GrammarNonTerminal* root, AbstractParseTree& result)
+{
+	_nr_exp_syms = 0;
+	init_fail_pos();
+	if (_nr_fail_examined < _nr_fail_pos)
+	{
+		delete[] _fail_examined;
+		_nr_fail_examined = _nr_fail_pos;
+		_fail_examined = new unsigned long[_nr_fail_examined];
+	}
+	if (!_reuse_solutions)
+		init_solutions();
+	_reuse_solutions = false;
+	_examined = 0;
+
+	bool try_it = parse_nt(root, result);
+
+	_solutions_kept = try_it && _incremental && !_memo_window;
+	if (!_solutions_kept)
+		free_solutions();
+
+	return try_it;
+}
+
+bool BTParser::reparse(const TextFileBuffer& textBuffer, unsigned long edit_start, unsigned long edit_old_end,
+					   unsigned long edit_new_end, AbstractParseTree& result)
+/*	Parses the text again after the text from edit_start up to
+	edit_old_end in the text of the last parse was replaced by the text
+	up to edit_new_end, reusing the memo entries of the last parse that
+	are not affected by the edit. The text of the last parse should
+	still be present. Each memo entry records the furthest position at
+	which the text was examined while parsing it, including the text
+	that the scanner looked at ahead (see TextFileBuffer::furthest),
+	hence the entries before the edit are kept when the furthest
+	position is before the start of the edit. The entries after the edit
+	are kept and moved along with the text, together with the positions
+	in their trees. When the rest of the line after the edit contains a
+	tab, the columns after it are not simply shifted, and the entries on
+	that line are discarded as well. Without a kept memo table, the text
+	is parsed completely. The result is the same as that of parse, but
+	the trees of the last parse are changed.
+*/
+{
+	if (!_solutions_kept)
+		return parse(textBuffer, _root_nt, result);
+
+	TextFileBuffer new_text;
+	new_text = textBuffer;
+	const char* s = new_text;
+	unsigned long length = new_text.length();
+
+	/* determine the line and column of the end of the edit in both texts */
+	new_text.skip(edit_start);
+	TextFileBuffer old_text;
+	old_text = _text;
+	old_text = (TextFilePos&)new_text;
+	old_text.skip(edit_old_end - edit_start);
+	new_text.skip(edit_new_end - edit_start);
+
+	MemoEdit edit;
+	edit.start = edit_start;
+	edit.keep_from = edit_old_end;
+	edit.delta = (long)edit_new_end - (long)edit_old_end;
+	edit.new_length = length;
+	edit.from_line = old_text.line();
+	edit.line_delta = new_text.line() - old_text.line();
+	edit.column_delta = new_text.column() - old_text.column();
+	unsigned long i = edit_new_end;
+	bool tab = false;
+	for (; i < length && s[i] != '\n'; i++)
+		if (s[i] == '\t')
+			tab = true;
+	edit.from_line_end = i - edit.delta;
+	if (tab)
+		edit.keep_from = edit.from_line_end + 1;
+
+	_solutions->edit(edit);
+	_reuse_solutions = true;
+	return parse(textBuffer, _root_nt, result);
+}
+
+void BTParser::printStats(FILE *f)
+{
+	if (_solutions != 0)
+		_solutions->printStats(f);
+	print_first_set_stats(f);
+	if (_lookahead != 0)
+	{
+		print_prediction_stats(f);
+		_lookahead->printStats(f);
+	}
+}
+
 #undef DEBUG_ENTER
 #undef DEBUG_ENTER_P1
 #undef DEBUG_EXIT
@@ -4,36 +4,99 @@
 #include "ParserGrammar.h"
 
 class ParseSolution;
+class ParseSolutions;
 class ParsedValue;
+class LookaheadDFAs;
 
 class BTParser : public AbstractParser
 {
 public:
 	BTParser();
+	~BTParser();
 	
 	bool parse(const TextFileBuffer& textBuffer, Ident root_id, AbstractParseTree& result);
+	void printStats(FILE *f);
+
+	// Keeps the memo table after a successful parse, for reparse
+	void setIncremental(bool incremental) { _incremental = incremental; }
+	bool reparse(const TextFileBuffer& textBuffer, unsigned long edit_start, unsigned long edit_old_end,
+				 unsigned long edit_new_end, AbstractParseTree& result);
+	/* Tries only the alternatives of a choice that the lookahead DFAs
+	   predict (see LookaheadDFAs), where the FIRST sets are used */
+	void setAdaptive(bool adaptive);
 	
 private:
 	bool parse_term(GrammarTerminal*, AbstractParseTree &rtree);
 	bool parse_ws_term(GrammarTerminal*);
 	bool parse_ident(GrammarIdent* ident, AbstractParseTree &rtree);
 	bool parse_nt(GrammarNonTerminal* non_term, AbstractParseTree &rtree);
-	bool parse_or(GrammarOrRule* or_rule, ParsedValue* prev_parts, AbstractParseTree &rtree);
+	bool parse_or(GrammarOrRules* or_rules, ParsedValue* prev_parts, AbstractParseTree &rtree);
 	bool parse_rule(GrammarRule* rule, ParsedValue* prev_parts, Ident tree_name, AbstractParseTree &rtree);
 	bool parse_seq(GrammarRule* rule, const char *chain_sym,
+				   AbstractParseTree seq, AbstractParseTree::iterator last, ParsedValue* prev_parts, const Ident tree_name,
+	               AbstractParseTree &rtree) ;
+	bool parse_stream_seq(GrammarRule* rule, const char *chain_sym,
 				   AbstractParseTree seq, ParsedValue* prev_parts, const Ident tree_name,
 	               AbstractParseTree &rtree) ;
+	bool parse_seq_element(GrammarRule* rule, AbstractParseTree& t);
 	
+	bool parse_root(GrammarNonTerminal* root, AbstractParseTree& result);
+
 	void init_solutions();
 	void free_solutions();
-	ParseSolution* find_solution(unsigned long filepos, Ident nt);
+	ParseSolution* find_solution(unsigned long filepos, GrammarNonTerminal* non_term);
 	
 	TextFileBuffer _text;	
 
 	void expected_string(const char *s, bool is_keyword);
 	
-	ParseSolution** _solutions;
+	ParseSolutions* _solutions;
+	Ident _root_nt;
 	int _depth;
+
+	bool _incremental;
+	bool _solutions_kept; // the memo table of the last parse was kept
+	bool _reuse_solutions; // the next parse starts with the kept memo table
+	unsigned long _examined; // furthest position examined in the current non-terminal
+	unsigned long *_fail_examined; // _examined when a rule failed, indexed like _fail_pos
+	int _nr_fail_examined;
+	/* including the text read by the scanner (see TextFileBuffer::furthest) */
+	inline void reached()
+	{
+		if (_text.furthest() > _examined)
+			_examined = _text.furthest();
+	}
+
+	/* The alternatives of a choice to try, in order: those that may start
+	   at the current character, or with the lookahead DFAs, those they
+	   predict */
+	LookaheadDFAs* _lookahead;
+	struct Alternatives
+	{
+		GrammarPrediction* prediction;
+		const short* predicted; // 0 without prediction
+		int nr_predicted;
+		int i;
+	};
+	inline GrammarOrRule* may_start_from(GrammarOrRule* or_rule)
+	{
+		while (or_rule != 0 && !may_start(or_rule->first_set, *_text))
+			or_rule = or_rule->next;
+		return or_rule;
+	}
+	inline GrammarOrRule* first_alternative(GrammarPrediction* prediction, GrammarOrRule* first, Alternatives& alternatives)
+	{
+		alternatives.predicted = 0;
+		return _lookahead == 0 ? may_start_from(first) : predict_alternatives(prediction, first, alternatives);
+	}
+	inline GrammarOrRule* next_alternative(GrammarOrRule* or_rule, Alternatives& alternatives)
+	{
+		if (alternatives.predicted == 0)
+			return may_start_from(or_rule->next);
+		return   ++alternatives.i < alternatives.nr_predicted
+			   ? alternatives.prediction->alternatives[alternatives.predicted[alternatives.i]] : 0;
+	}
+	GrammarOrRule* predict_alternatives(GrammarPrediction* prediction, GrammarOrRule* first, Alternatives& alternatives);
 };
 
 #endif // _INCLUDED_BTPARSER_H
@@ -0,0 +1,771 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "Ident.h"
+#include "String.h"
+#include "AbstractParseTree.h"
+#include "TextFileBuffer.h"
+#include "Scanner.h"
+#include "AbstractParser.h"
+#include "ParseSolution.h"
+#include "BTVMParser.h"
+
+
+template <class T>
+static int vm_reserve(T*& table, int& nr, int& size, int n)
+/*	Reserves n consecutive entries at the end of the table, and returns
+	the index of the first. The table may be moved in memory.
+*/
+{
+	if (nr + n > size)
+	{
+		int new_size = size == 0 ? 64 : size;
+		while (nr + n > new_size)
+			new_size *= 2;
+		T* new_table = new T[new_size];
+		for (int i = 0; i < nr; i++)
+			new_table[i] = table[i];
+		delete[] table;
+		table = new_table;
+		size = new_size;
+	}
+	int first = nr;
+	nr += n;
+	return first;
+}
+
+GrammarProgram::GrammarProgram()
+  : _instructions(0), _nr_instructions(0), _size_instructions(0),
+	_alternatives(0), _nr_alternatives(0), _size_alternatives(0),
+	_non_terminals(0), _nr_non_terminals(0),
+	_char_sets(0), _nr_char_sets(0), _size_char_sets(0),
+	_terminals(0), _nr_terminals(0), _size_terminals(0),
+	_idents(0), _nr_idents(0), _size_idents(0)
+{
+}
+
+GrammarProgram::~GrammarProgram()
+{
+	clear();
+}
+
+void GrammarProgram::clear()
+{
+	delete[] _instructions;
+	_instructions = 0;
+	_nr_instructions = _size_instructions = 0;
+	delete[] _alternatives;
+	_alternatives = 0;
+	_nr_alternatives = _size_alternatives = 0;
+	delete[] _non_terminals;
+	_non_terminals = 0;
+	_nr_non_terminals = 0;
+	delete[] _char_sets;
+	_char_sets = 0;
+	_nr_char_sets = _size_char_sets = 0;
+	delete[] _terminals;
+	_terminals = 0;
+	_nr_terminals = _size_terminals = 0;
+	delete[] _idents;
+	_idents = 0;
+	_nr_idents = _size_idents = 0;
+}
+
+void GrammarProgram::compile(Grammar& grammar)
+{
+	clear();
+
+	_nr_non_terminals = grammar.nrNonTerminals();
+	_non_terminals = new VMNonTerminal[_nr_non_terminals];
+	for (GrammarNonTerminal* nt = grammar.allNonTerminals(); nt != 0; nt = nt->next)
+	{
+		int first = compile_alternatives(nt->first);
+		int recursive = compile_alternatives(nt->recursive);
+		VMNonTerminal& vm_nt = _non_terminals[nt->nr];
+		vm_nt.non_term = nt;
+		vm_nt.first = first;
+		vm_nt.recursive = recursive;
+	}
+}
+
+int GrammarProgram::compile_alternatives(GrammarOrRule* or_rule)
+/*	Compiles the alternatives starting with or_rule into consecutive
+	entries, and returns the index of the first.
+*/
+{
+	int n = 0;
+	for (GrammarOrRule* o_r = or_rule; o_r != 0; o_r = o_r->next)
+		n++;
+	int first = vm_reserve(_alternatives, _nr_alternatives, _size_alternatives, n + 1);
+
+	int i = first;
+	for (GrammarOrRule* o_r = or_rule; o_r != 0; o_r = o_r->next, i++)
+	{
+		_alternatives[i].tree_name = o_r->tree_name;
+		_alternatives[i].first_set = o_r->first_set;
+		/* compiling the rule may move the table */
+		int start = compile_rule(o_r->rule);
+		_alternatives[i].start = start;
+	}
+	_alternatives[i].start = -1;
+	_alternatives[i].first_set = 0;
+
+	return first;
+}
+
+int GrammarProgram::compile_rule(GrammarRule* rule)
+/*	Compiles the elements of rule into consecutive instructions,
+	followed by VM_END, and returns the index of the first.
+*/
+{
+	int n = 0;
+	for (GrammarRule* r = rule; r != 0; r = r->next)
+		n++;
+	int first = vm_reserve(_instructions, _nr_instructions, _size_instructions, n + 1);
+
+	int i = first;
+	for (GrammarRule* r = rule; r != 0; r = r->next, i++)
+	{
+		int arg = 0;
+		switch (r->kind)
+		{	case RK_NT:
+			case RK_WS_NT:
+				arg = r->text.non_terminal->nr;
+				break;
+			case RK_TERM:
+			case RK_WS_TERM:
+				arg = vm_reserve(_terminals, _nr_terminals, _size_terminals, 1);
+				_terminals[arg] = r->text.terminal->name;
+				break;
+			case RK_IDENT:
+				arg = vm_reserve(_idents, _nr_idents, _size_idents, 1);
+				_idents[arg] = r->text.ident;
+				break;
+			case RK_CHARSET:
+			case RK_AVOID:
+				arg = vm_reserve(_char_sets, _nr_char_sets, _size_char_sets, 1);
+				_char_sets[arg] = *r->text.char_set;
+				break;
+			case RK_OR_RULE:
+			case RK_COR_RULE:
+				arg = compile_alternatives(r->text.or_rules->first);
+				break;
+		}
+
+		VMInstruction& instr = _instructions[i];
+		instr.kind = r->kind;
+		instr.flags =   (r->optional ? VM_OPTIONAL : 0)
+					  | (r->sequential ? VM_SEQUENTIAL : 0)
+					  | (r->avoid ? VM_AVOID : 0);
+		instr.arg = arg;
+		instr.nr = r->nr;
+		instr.str_value = r->str_value;
+		instr.chain_symbol = r->chain_symbol;
+		instr.rule = r;
+	}
+	VMInstruction& end = _instructions[i];
+	end.kind = VM_END;
+	end.flags = 0;
+	end.arg = 0;
+	end.nr = -1;
+	end.str_value = 0;
+	end.chain_symbol = 0;
+	end.rule = 0;
+
+	return first;
+}
+
+void GrammarProgram::printStats(FILE *f)
+{
+	fprintf(f, "program: %d instructions, %d alternatives, %d char sets\n",
+			_nr_instructions, _nr_alternatives, _nr_char_sets);
+}
+
+
+BTVMParser::BTVMParser()
+{
+	_program = 0;
+	_program_nt = 0;
+	_solutions = 0;
+}
+
+BTVMParser::~BTVMParser()
+{
+	delete _program;
+	delete _solutions;
+}
+
+bool BTVMParser::parse_term( Ident name, AbstractParseTree &rtree )
+{
+	bool try_it = _scanner->acceptTerminal(_text, name, rtree);
+	if (!try_it)
+		expected_string(name.val(), false);
+	return try_it;
+}
+
+bool BTVMParser::parse_ws_term( Ident name )
+{
+	bool try_it = _scanner->acceptWhiteSpace(_text, name);
+	if (!try_it)
+		expected_string(name.val(), false);
+	return try_it;
+}
+
+bool BTVMParser::parse_ident(GrammarIdent* ident, AbstractParseTree &rtree)
+{
+	AbstractParseTree tree;
+	bool try_it = _scanner->acceptTerminal(_text, ident->terminal->name, tree);
+	if (!try_it)
+		expected_string(ident->terminal->name.val(), false);
+
+	if (try_it)
+	{   switch(ident->kind)
+		{   case IK_IDENTDEF:
+				rtree.createTree(tt_identdef);
+				break;
+			case IK_IDENTDEFADD:
+				rtree.createTree(tt_identdefadd);
+				break;
+			case IK_IDENTUSE:
+				rtree.createTree(tt_identuse);
+				break;
+			case IK_IDENTFIELD:
+				rtree.createTree(tt_identfield);
+				break;
+		}
+		rtree.appendChild(tree);
+		rtree.appendChild(AbstractParseTree(Ident(ident->ident_class)));
+	}
+
+	return try_it;
+}
+
+bool BTVMParser::parse_nt( int nt, AbstractParseTree& rtree)
+{
+	const VMNonTerminal* vm_nt = _program->nonTerminal(nt);
+	const VMAlternative* alt;
+	Ident surr_nt = _current_nt;
+	unsigned long start_pos = _text.position();
+	ParseSolution* sol = _solutions->find(start_pos, vm_nt->non_term);
+
+	if (sol == 0)
+		; /* position is before the memo window */
+	else if (sol->success == s_success)
+	{
+		rtree = sol->result;
+		_text = sol->sp;
+		return true;
+	}
+	else if (sol->success == s_fail)
+		return false;
+
+	_current_nt = vm_nt->non_term->name;
+
+	for (alt = _program->alternatives(vm_nt->first); alt->start >= 0; alt++)
+		if (may_start(alt->first_set, *_text) && parse_rule(_program->instruction(alt->start), (ParsedValue*)0, alt->tree_name, rtree))
+			break;
+
+	if (alt->start >= 0)
+	{
+		for(;;)
+		{   ParsedValue val;
+			val.prev = 0;
+			val.last.attach(rtree);
+
+			for (alt = _program->alternatives(vm_nt->recursive); alt->start >= 0; alt++)
+				if (may_start(alt->first_set, *_text) && parse_rule(_program->instruction(alt->start), &val, alt->tree_name, rtree))
+					break;
+
+			if (alt->start < 0)
+			{   rtree = val.last;
+				break;
+			}
+		}
+
+		_current_nt = surr_nt;
+		/* the memo window may have been cut while parsing */
+		sol = _solutions->find(start_pos, vm_nt->non_term);
+		if (sol != 0)
+		{   sol->result = rtree;
+			sol->success = s_success;
+			sol->sp = _text;
+		}
+		return true;
+	}
+	_current_nt = surr_nt;
+	sol = _solutions->find(start_pos, vm_nt->non_term);
+	if (sol != 0)
+		sol->success = s_fail;
+	return false;
+}
+
+bool BTVMParser::parse_or(int alternatives, ParsedValue* prev_parts, AbstractParseTree &rtree)
+{
+	for (const VMAlternative* alt = _program->alternatives(alternatives); alt->start >= 0; alt++)
+		if (may_start(alt->first_set, *_text) && parse_rule(_program->instruction(alt->start), prev_parts, alt->tree_name, rtree))
+			return true;
+	return false;
+}
+
+bool BTVMParser::parse_rule(const VMInstruction* ip, ParsedValue* prev_parts, const Ident tree_name, AbstractParseTree &rtree)
+{
+	/* At the end of the rule: */
+	if (ip->kind == VM_END)
+	{   if (!tree_name.empty())
+		{   /* make tree of previous elements: */
+			rtree.createTree(tree_name);
+			while (prev_parts)
+			{   rtree.insertChild(prev_parts->last);
+				prev_parts = prev_parts->prev;
+			}
+		}
+		else
+		{   /* group previous elements into a list, if more than one: */
+			if (prev_parts == 0)
+				;
+			else if (prev_parts->prev == 0)
+				rtree = prev_parts->last;
+			else
+			{   rtree.createList();
+				while (prev_parts != 0)
+				{   rtree.insertChild(prev_parts->last);
+					prev_parts = prev_parts->prev;
+				}
+			}
+		}
+		return true;
+	}
+
+	bool optional = (ip->flags & VM_OPTIONAL) != 0;
+	bool avoid = (ip->flags & VM_AVOID) != 0;
+	bool sequential = (ip->flags & VM_SEQUENTIAL) != 0;
+	const VMInstruction* next = ip + 1;
+
+	TextFilePos sp = _text;
+	_current_rule = ip->rule;
+
+	/* Did we fail the last time at this position? */
+	if (_fail_pos[ip->nr] == (long)_text.position())
+		return false;
+	long *last_fail_pos = &_fail_pos[ip->nr];
+
+	if (optional && avoid)
+	{
+		/* First element was optional (and should be avoided): */
+		ParsedValue val;
+		val.prev = prev_parts;
+
+		if (parse_rule(next, &val, tree_name, rtree))
+			return true;
+		_text = sp;
+	}
+
+	/* Try to accept first symbol */
+	{   AbstractParseTree t;
+		TextFilePos start_pos = _text;
+		bool is_terminal = false;
+		bool try_it = false;
+
+		switch( ip->kind )
+		{   case RK_T_EOF:
+				try_it = _scanner->acceptEOF(_text);
+				if (!try_it)
+					expected_string("eof", false);
+				if (try_it && parse_rule(next, prev_parts, tree_name, rtree))
+					return true;
+				break;
+			case RK_TERM:
+				try_it = parse_term(_program->terminal(ip->arg), t);
+				is_terminal = true;
+				break;
+			case RK_IDENT:
+				try_it = parse_ident(_program->ident(ip->arg), t);
+				break;
+			case RK_T_OPENCONTEXT:
+				try_it = true;
+				t.createOpenContext();
+				break;
+			case RK_T_CLOSECONTEXT:
+				try_it = true;
+				t.createCloseContext();
+				break;
+			case RK_NT:
+				try_it = parse_nt(ip->arg, t);
+				break;
+			case RK_WS_TERM:
+			case RK_WS_NT:
+			case RK_LIT:
+			{   if (  ip->kind == RK_LIT
+					? _scanner->acceptLiteral(_text, ip->str_value)
+					: ip->kind == RK_WS_TERM
+					? parse_ws_term(_program->terminal(ip->arg))
+					: parse_nt(ip->arg, t))
+				{   if (sequential)
+					{   AbstractParseTree seq;
+						seq.createList();
+
+						if (parse_seq(ip, ip->chain_symbol,
+									  seq, AbstractParseTree::iterator(), prev_parts, tree_name, rtree))
+						{   rtree.setLineColumn(start_pos.line(), start_pos.column());
+							return true;
+						}
+					}
+					else if (parse_rule(next, prev_parts, tree_name, rtree))
+					{   rtree.setLineColumn(start_pos.line(), start_pos.column());
+						return true;
+					}
+				}
+				else if (optional && parse_rule(next, prev_parts, tree_name, rtree))
+				{   rtree.setLineColumn(start_pos.line(), start_pos.column());
+					return true;
+				}
+				else
+					expected_string(ip->str_value, true);
+				break;
+			}
+			case RK_CHARSET:
+				try_it = _program->charSet(ip->arg).contains_char(*_text);
+				if (!try_it)
+					expected_string("<charset>", false);
+				else
+				{	t.createCharAtom(*_text);
+					_text.next();
+					_scanner->skipSpace(_text);
+				}
+				break;
+			case RK_AVOID:
+				try_it = !_program->charSet(ip->arg).contains_char(*_text);
+				break;
+			case RK_COLOURCODING:
+				try_it = true;
+				break;
+			case RK_OR_RULE:
+				try_it = parse_or(ip->arg, (ParsedValue*)0, t);
+				break;
+			case RK_COR_RULE:
+				if (parse_or(ip->arg, prev_parts, rtree))
+					return true;
+				_text = sp;
+				*last_fail_pos = _text.position();
+				return false;
+			default:
+				try_it = false;
+		}
+
+		if (try_it)
+		{   /* We succeded in parsing the first element */
+
+			if (!t.isEmpty() && t.line() == 0)
+				t.setLineColumn(start_pos.line(), start_pos.column());
+
+			if (sequential)
+			{   AbstractParseTree seq;
+				seq.createList();
+				AbstractParseTree::iterator last;
+				seq.appendChild(t, last);
+
+				if (parse_seq(ip, ip->chain_symbol,
+							  seq, last, prev_parts, tree_name, rtree))
+				{   if (is_terminal)
+						rtree.setLineColumn(start_pos.line(), start_pos.column());
+					return true;
+				}
+			}
+			else
+			{
+				ParsedValue val;
+				val.last = t;
+				val.prev = prev_parts;
+
+				if (parse_rule(next, &val, tree_name, rtree))
+				{   if (is_terminal)
+						rtree.setLineColumn(start_pos.line(), start_pos.column());
+					return true;
+				}
+			}
+		}
+		_text = sp;
+	}
+
+	if (optional && !avoid)
+	{
+		/* First element was optional (and not to be avoided): */
+		ParsedValue val;
+		val.prev = prev_parts;
+
+		if (parse_rule(next, &val, tree_name, rtree))
+			return true;
+		_text = sp;
+	}
+
+	*last_fail_pos = _text.position();
+	return false;
+}
+
+bool BTVMParser::parse_seq(const VMInstruction* ip, const char *chain_sym,
+			   AbstractParseTree seq, AbstractParseTree::iterator last, ParsedValue* prev_parts, const Ident tree_name,
+			   AbstractParseTree &rtree)
+{
+	if (ip->rule == _stream_rule)
+		return parse_stream_seq(ip, chain_sym, seq, prev_parts, tree_name, rtree);
+
+	bool avoid = (ip->flags & VM_AVOID) != 0;
+	const VMInstruction* next = ip + 1;
+
+	TextFilePos sp = _text;
+	_current_rule = ip->rule;
+
+	if (avoid)
+	{
+		/* should be avoided */
+		ParsedValue val;
+		val.last = seq;
+		val.prev = prev_parts;
+		if (parse_rule(next, &val, tree_name, rtree))
+			return true;
+		_text = sp;
+	}
+
+	/* Try to accept first symbol */
+	if (chain_sym == 0 || *chain_sym == '\0' || _scanner->acceptLiteral(_text, chain_sym))
+	{   AbstractParseTree t;
+		TextFilePos start_pos = _text;
+
+		if (parse_seq_element(ip, t))
+		{   /* We succeded in parsing the first element */
+
+			if (!t.isEmpty() && t.line() == 0)
+				t.setLineColumn(start_pos.line(), start_pos.column());
+
+			AbstractParseTree::iterator before_last = last;
+			seq.appendChild(t, last);
+
+			/* an element of the top-level list is complete: the memo
+			   entries before this position are not likely to be used */
+			if (_memo_window && _current_nt == _root_nt)
+				_solutions->cut(_text.position());
+
+			if (parse_seq(ip, chain_sym,
+						  seq, last, prev_parts, tree_name, rtree))
+				return true;
+			seq.dropLastChild(before_last);
+		}
+		else if (chain_sym != 0)
+			expected_string(chain_sym, true);
+		_text = sp;
+	}
+
+	if (!avoid)
+	{
+		/* should not be avoided */
+		ParsedValue val;
+		val.last = seq;
+		val.prev = prev_parts;
+		if (parse_rule(next, &val, tree_name, rtree))
+			return true;
+		_text = sp;
+	}
+
+	return false;
+}
+
+bool BTVMParser::parse_stream_seq(const VMInstruction* ip, const char *chain_sym,
+			   AbstractParseTree seq, ParsedValue* prev_parts, const Ident tree_name,
+			   AbstractParseTree &rtree)
+/*	Like BTParser::parse_stream_seq: parses the streamed top-level list
+	in a loop.
+*/
+{
+	bool avoid = (ip->flags & VM_AVOID) != 0;
+	const VMInstruction* next = ip + 1;
+
+	for (;;)
+	{
+		stream_elements(seq);
+
+		TextFilePos sp = _text;
+		_current_rule = ip->rule;
+
+		if (avoid)
+		{
+			/* should be avoided */
+			ParsedValue val;
+			val.last = seq;
+			val.prev = prev_parts;
+			if (parse_rule(next, &val, tree_name, rtree))
+				return true;
+			_text = sp;
+		}
+
+		if (chain_sym == 0 || *chain_sym == '\0' || _scanner->acceptLiteral(_text, chain_sym))
+		{   AbstractParseTree t;
+			TextFilePos start_pos = _text;
+
+			if (parse_seq_element(ip, t))
+			{
+				if (!t.isEmpty() && t.line() == 0)
+					t.setLineColumn(start_pos.line(), start_pos.column());
+				seq.appendChild(t);
+
+				if (_memo_window)
+					_solutions->cut(_text.position());
+				continue;
+			}
+			else if (chain_sym != 0)
+				expected_string(chain_sym, true);
+			_text = sp;
+		}
+
+		if (!avoid)
+		{
+			/* should not be avoided */
+			ParsedValue val;
+			val.last = seq;
+			val.prev = prev_parts;
+			if (parse_rule(next, &val, tree_name, rtree))
+				return true;
+			_text = sp;
+		}
+
+		return false;
+	}
+}
+
+bool BTVMParser::parse_seq_element(const VMInstruction* ip, AbstractParseTree& t)
+{
+	bool try_it = false;
+
+	switch( ip->kind )
+	{   case RK_T_EOF:
+			try_it = _scanner->acceptEOF(_text);
+			if (try_it)
+			   t = Ident("EOF").val();
+			break;
+		case RK_TERM:
+			try_it = parse_term(_program->terminal(ip->arg), t);
+			break;
+		case RK_WS_TERM:
+			try_it = parse_ws_term(_program->terminal(ip->arg));
+			break;
+		case RK_IDENT:
+			try_it = parse_ident(_program->ident(ip->arg), t);
+			break;
+		case RK_NT:
+			try_it = parse_nt(ip->arg, t);
+			break;
+		case RK_WS_NT:
+			try_it = parse_nt(ip->arg, t);
+			t.clear();
+			break;
+		case RK_LIT:
+			try_it = _scanner->acceptLiteral(_text, ip->str_value);
+			if (!try_it)
+				expected_string(ip->str_value, true);
+			break;
+		case RK_CHARSET:
+			try_it = _program->charSet(ip->arg).contains_char(*_text);
+			if (!try_it)
+				expected_string("<charset>", false);
+			else
+			{	t.createCharAtom(*_text);
+				_text.next();
+				_scanner->skipSpace(_text);
+			}
+			break;
+		case RK_AVOID:
+			try_it = !_program->charSet(ip->arg).contains_char(*_text);
+			break;
+		case RK_COLOURCODING:
+			try_it = true;
+			break;
+		case RK_OR_RULE:
+			try_it = parse_or(ip->arg, (ParsedValue*)0, t);
+			break;
+		case RK_COR_RULE:
+			// should not happen
+			break;
+		default:
+			try_it = false;
+	}
+
+	return try_it;
+}
+
+void BTVMParser::expected_string(const char *s, bool is_keyword)
+{
+	AbstractParser::expected_string(_text, s, is_keyword);
+}
+
+void BTVMParser::compile_program()
+/*	Compiles the grammar, unless it was already compiled. The parser
+	can be given another grammar between two parses.
+*/
+{
+	if (_program != 0 && _program_nt == allNonTerminals())
+		return;
+	if (_program == 0)
+		_program = new GrammarProgram;
+	_program->compile(*this);
+	_program_nt = allNonTerminals();
+}
+
+bool BTVMParser::parse(const TextFileBuffer& textBuffer, Ident root_id, AbstractParseTree& result)
+{
+	AbstractParseTreeArena::Use use_arena(_tree_arena);
+	_text = textBuffer;
+	TextFilePos file_start = _text;
+
+	_scanner->initScanning(this);
+	_scanner->skipSpace(_text);
+	GrammarNonTerminal* root = findNonTerminal(root_id);
+	if (root == 0)
+	    return false;
+	_root_nt = root_id;
+	compile_program();
+	init_stream(root);
+
+	init_first_sets();
+	TextFilePos start_pos = _text;
+	_f_file_pos = file_start;
+	bool try_it = parse_root(root->nr, result);
+	if (!try_it && (_use_first_sets || _stream_rule != 0))
+	{
+		/* Pruned alternatives are missing from the expected symbols,
+		   and the streamed top-level list was not back-tracked over,
+		   hence parse again without both for the error message. */
+		_use_first_sets = false;
+		_stream_rule = 0;
+		_text = start_pos;
+		_f_file_pos = file_start;
+		try_it = parse_root(root->nr, result);
+	}
+	if (!try_it)
+		_stream_seq.clear();
+	_scanner->doneScanning();
+
+	return try_it;
+}
+
+bool BTVMParser::parse_root(int root, AbstractParseTree& result)
+{
+	_nr_exp_syms = 0;
+	init_fail_pos();
+	if (_solutions == 0)
+		_solutions = new ParseSolutions;
+	_solutions->init(_text.length(), nrNonTerminals(), _memo_window);
+
+	bool try_it = parse_nt(root, result);
+
+	_solutions->clear();
+
+	return try_it;
+}
+
+void BTVMParser::printStats(FILE *f)
+{
+	if (_program != 0)
+		_program->printStats(f);
+	if (_solutions != 0)
+		_solutions->printStats(f);
+	print_first_set_stats(f);
+}
@@ -0,0 +1,132 @@
+#ifndef _INCLUDED_BTVMPARSER_H
+#define _INCLUDED_BTVMPARSER_H
+
+#include "ParserGrammar.h"
+
+class ParseSolutions;
+class ParsedValue;
+
+/*	GrammarProgram is a grammar compiled to flat tables. The elements of
+	a rule are stored as consecutive instructions, followed by an
+	instruction with the opcode VM_END, such that the next element of a
+	rule is found at the next index. The alternatives of a non-terminal
+	or an or-rule are stored as consecutive entries, followed by an entry
+	with start -1. The argument of an instruction is an index in the table
+	that belongs to its kind: the non-terminals, the alternatives, the
+	character sets, the terminals or the identifiers.
+*/
+
+#define VM_END			255
+
+#define VM_OPTIONAL		1
+#define VM_SEQUENTIAL	2
+#define VM_AVOID		4
+
+struct VMInstruction
+{
+	unsigned char kind; // one of the RK_ constants or VM_END
+	unsigned char flags;
+	int arg;
+	int nr; // see GrammarRule::nr
+	const char* str_value;
+	const char* chain_symbol;
+	GrammarRule* rule;
+};
+
+struct VMAlternative
+{
+	int start; // index of the first instruction, or -1 at the end
+	Ident tree_name;
+	GrammarFirstSet* first_set;
+};
+
+struct VMNonTerminal
+{
+	GrammarNonTerminal* non_term;
+	int first; // index of the alternatives
+	int recursive;
+};
+
+class GrammarProgram
+{
+public:
+	GrammarProgram();
+	~GrammarProgram();
+
+	void compile(Grammar& grammar);
+
+	inline const VMInstruction* instruction(int i) const { return &_instructions[i]; }
+	inline const VMAlternative* alternatives(int i) const { return &_alternatives[i]; }
+	inline const VMNonTerminal* nonTerminal(int i) const { return &_non_terminals[i]; }
+	inline const GrammarCharSet& charSet(int i) const { return _char_sets[i]; }
+	inline Ident terminal(int i) const { return _terminals[i]; }
+	inline GrammarIdent* ident(int i) const { return _idents[i]; }
+	void printStats(FILE *f);
+
+private:
+	int compile_alternatives(GrammarOrRule* or_rule);
+	int compile_rule(GrammarRule* rule);
+	void clear();
+
+	VMInstruction* _instructions;
+	int _nr_instructions;
+	int _size_instructions;
+	VMAlternative* _alternatives;
+	int _nr_alternatives;
+	int _size_alternatives;
+	VMNonTerminal* _non_terminals;
+	int _nr_non_terminals;
+	GrammarCharSet* _char_sets;
+	int _nr_char_sets;
+	int _size_char_sets;
+	Ident* _terminals;
+	int _nr_terminals;
+	int _size_terminals;
+	GrammarIdent** _idents;
+	int _nr_idents;
+	int _size_idents;
+};
+
+/*	BTVMParser is a back-tracking parser that executes a GrammarProgram.
+	It follows the same algorithm as BTParser, including the memoization
+	of the non-terminals, and produces the same parse trees and error
+	messages. It does not support the debug output of BTParser.
+*/
+
+class BTVMParser : public AbstractParser
+{
+public:
+	BTVMParser();
+	~BTVMParser();
+
+	bool parse(const TextFileBuffer& textBuffer, Ident root_id, AbstractParseTree& result);
+	void printStats(FILE *f);
+
+private:
+	bool parse_root(int root, AbstractParseTree& result);
+	void compile_program();
+	bool parse_term(Ident name, AbstractParseTree &rtree);
+	bool parse_ws_term(Ident name);
+	bool parse_ident(GrammarIdent* ident, AbstractParseTree &rtree);
+	bool parse_nt(int nt, AbstractParseTree &rtree);
+	bool parse_or(int alternatives, ParsedValue* prev_parts, AbstractParseTree &rtree);
+	bool parse_rule(const VMInstruction* ip, ParsedValue* prev_parts, Ident tree_name, AbstractParseTree &rtree);
+	bool parse_seq(const VMInstruction* ip, const char *chain_sym,
+				   AbstractParseTree seq, AbstractParseTree::iterator last, ParsedValue* prev_parts, const Ident tree_name,
+	               AbstractParseTree &rtree) ;
+	bool parse_stream_seq(const VMInstruction* ip, const char *chain_sym,
+				   AbstractParseTree seq, ParsedValue* prev_parts, const Ident tree_name,
+	               AbstractParseTree &rtree) ;
+	bool parse_seq_element(const VMInstruction* ip, AbstractParseTree& t);
+
+	TextFileBuffer _text;
+
+	void expected_string(const char *s, bool is_keyword);
+
+	GrammarProgram* _program;
+	GrammarNonTerminal* _program_nt; // non-terminals for which _program was compiled
+	ParseSolutions* _solutions;
+	Ident _root_nt;
+};
+
+#endif // _INCLUDED_BTVMPARSER_H
@@ -1,6 +1,10 @@
 #include "CodePages.h"
 
-AbstractCodePage::AbstractCodePage(const UnicodeChar *map) : _map(map) {}
+AbstractCodePage::AbstractCodePage(const UnicodeChar *map) : _map(map)
+{
+	for (_uniform = 0; _uniform < 256 && _map[_uniform] == (UnicodeChar)_uniform; _uniform++)
+		;
+}
 
 bool AbstractCodePage::from(char c, UnicodeChar &codepoint)
 {
@@ -9,6 +9,8 @@ public:
 	AbstractCodePage(const UnicodeChar *map);
 	bool from(char c, UnicodeChar &codepoint);
 	bool to(UnicodeChar codepoint, char &c);
+	// The characters below uniform() are mapped on themselves
+	int uniform() { return _uniform; }
 protected:
 	const UnicodeChar *_map;
 	int _uniform;
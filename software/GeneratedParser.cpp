@@ -0,0 +1,209 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "Ident.h"
+#include "String.h"
+#include "AbstractParseTree.h"
+#include "TextFileBuffer.h"
+#include "Scanner.h"
+#include "AbstractParser.h"
+#include "ParseSolution.h"
+#include "GeneratedParser.h"
+
+
+GeneratedParser::GeneratedParser(const unsigned char* rule_kinds, int nr_rules, int nr_non_terminals)
+  : _rule_kinds(rule_kinds), _nr_rules(nr_rules), _nr_non_terminals(nr_non_terminals)
+{
+	_rules = new GrammarRule*[nr_rules];
+	_non_terminals = new GrammarNonTerminal*[nr_non_terminals];
+	_solutions = 0;
+	_bound_nt = 0;
+}
+
+GeneratedParser::~GeneratedParser()
+{
+	delete[] _rules;
+	delete[] _non_terminals;
+	delete _solutions;
+}
+
+bool GeneratedParser::bind()
+/*	Looks up the rules and the non-terminals of the loaded grammar by
+	their numbers, and checks that the grammar is the one from which
+	the parser was generated.
+*/
+{
+	if (_bound_nt != 0 && _bound_nt == allNonTerminals())
+		return true;
+	_bound_nt = 0;
+	if (nrRules() != _nr_rules || nrNonTerminals() != _nr_non_terminals)
+		return false;
+
+	for (GrammarNonTerminal* nt = allNonTerminals(); nt != 0; nt = nt->next)
+	{
+		_non_terminals[nt->nr] = nt;
+		if (!bind_or_rules(nt->first) || !bind_or_rules(nt->recursive))
+			return false;
+	}
+	_bound_nt = allNonTerminals();
+	return true;
+}
+
+bool GeneratedParser::bind_or_rules(GrammarOrRule* or_rule)
+{
+	for (; or_rule != 0; or_rule = or_rule->next)
+		if (!bind_rule(or_rule->rule))
+			return false;
+	return true;
+}
+
+bool GeneratedParser::bind_rule(GrammarRule* rule)
+{
+	for (; rule != 0; rule = rule->next)
+	{
+		if (rule->nr < 0 || rule->nr >= _nr_rules || rule->kind != _rule_kinds[rule->nr])
+			return false;
+		_rules[rule->nr] = rule;
+		if (   (rule->kind == RK_OR_RULE || rule->kind == RK_COR_RULE)
+			&& !bind_or_rules(rule->text.or_rules->first))
+			return false;
+	}
+	return true;
+}
+
+bool GeneratedParser::parse_term( Ident name, AbstractParseTree &rtree )
+{
+	bool try_it = _scanner->acceptTerminal(_text, name, rtree);
+	if (!try_it)
+		expected_string(name.val(), false);
+	return try_it;
+}
+
+bool GeneratedParser::parse_ws_term( Ident name )
+{
+	bool try_it = _scanner->acceptWhiteSpace(_text, name);
+	if (!try_it)
+		expected_string(name.val(), false);
+	return try_it;
+}
+
+bool GeneratedParser::parse_ident(GrammarIdent* ident, AbstractParseTree &rtree)
+{
+	AbstractParseTree tree;
+	bool try_it = _scanner->acceptTerminal(_text, ident->terminal->name, tree);
+	if (!try_it)
+		expected_string(ident->terminal->name.val(), false);
+
+	if (try_it)
+	{   switch(ident->kind)
+		{   case IK_IDENTDEF:
+				rtree.createTree(tt_identdef);
+				break;
+			case IK_IDENTDEFADD:
+				rtree.createTree(tt_identdefadd);
+				break;
+			case IK_IDENTUSE:
+				rtree.createTree(tt_identuse);
+				break;
+			case IK_IDENTFIELD:
+				rtree.createTree(tt_identfield);
+				break;
+		}
+		rtree.appendChild(tree);
+		rtree.appendChild(AbstractParseTree(Ident(ident->ident_class)));
+	}
+
+	return try_it;
+}
+
+bool GeneratedParser::make_tree(const Ident tree_name, ParsedValue* prev_parts, AbstractParseTree &rtree)
+/*	At the end of a rule with a tree name: makes a tree of the
+	previous elements. */
+{
+	rtree.createTree(tree_name);
+	while (prev_parts)
+	{   rtree.insertChild(prev_parts->last);
+		prev_parts = prev_parts->prev;
+	}
+	return true;
+}
+
+bool GeneratedParser::make_list(ParsedValue* prev_parts, AbstractParseTree &rtree)
+/*	At the end of a rule without a tree name: groups the previous
+	elements into a list, if more than one. */
+{
+	if (prev_parts == 0)
+		;
+	else if (prev_parts->prev == 0)
+		rtree = prev_parts->last;
+	else
+	{   rtree.createList();
+		while (prev_parts != 0)
+		{   rtree.insertChild(prev_parts->last);
+			prev_parts = prev_parts->prev;
+		}
+	}
+	return true;
+}
+
+void GeneratedParser::expected_string(const char *s, bool is_keyword)
+{
+	AbstractParser::expected_string(_text, s, is_keyword);
+}
+
+bool GeneratedParser::parse(const TextFileBuffer& textBuffer, Ident root_id, AbstractParseTree& result)
+{
+	AbstractParseTreeArena::Use use_arena(_tree_arena);
+	_text = textBuffer;
+	TextFilePos file_start = _text;
+
+	if (!bind())
+	{
+		fprintf(stderr, "Grammar differs from the grammar of the generated parser\n");
+		return false;
+	}
+	_scanner->initScanning(this);
+	_scanner->skipSpace(_text);
+	GrammarNonTerminal* root = findNonTerminal(root_id);
+	if (root == 0)
+		return false;
+	_root_nt = root_id;
+
+	init_first_sets();
+	TextFilePos start_pos = _text;
+	_f_file_pos = file_start;
+	bool try_it = parse_root(root->nr, result);
+	if (!try_it && _use_first_sets)
+	{
+		/* Pruned alternatives are missing from the expected symbols,
+		   hence parse again without pruning for the error message. */
+		_use_first_sets = false;
+		_text = start_pos;
+		_f_file_pos = file_start;
+		try_it = parse_root(root->nr, result);
+	}
+	_scanner->doneScanning();
+
+	return try_it;
+}
+
+bool GeneratedParser::parse_root(int root, AbstractParseTree& result)
+{
+	_nr_exp_syms = 0;
+	init_fail_pos();
+	if (_solutions == 0)
+		_solutions = new ParseSolutions;
+	_solutions->init(_text.length(), nrNonTerminals(), _memo_window);
+
+	bool try_it = parse_nt(root, result);
+
+	_solutions->clear();
+
+	return try_it;
+}
+
+void GeneratedParser::printStats(FILE *f)
+{
+	if (_solutions != 0)
+		_solutions->printStats(f);
+}
@@ -0,0 +1,64 @@
+#ifndef _INCLUDED_GENERATEDPARSER_H
+#define _INCLUDED_GENERATEDPARSER_H
+
+#include "ParserGrammar.h"
+
+class ParseSolutions;
+class ParsedValue;
+
+/*	GeneratedParser is the base class of the parsers that are generated
+	with ParserGenerator (option -ogp). A generated parser has a function
+	for each non-terminal and for each element of a rule, and produces the
+	same parse trees as BTParser. It is used with the grammar from which
+	it was generated: the grammar is still loaded into the parser, because
+	the scanner takes the literals from it and the error messages refer to
+	its rules. The parse fails when another grammar is loaded.
+*/
+
+class GeneratedParser : public AbstractParser
+{
+public:
+	GeneratedParser(const unsigned char* rule_kinds, int nr_rules, int nr_non_terminals);
+	~GeneratedParser();
+
+	bool parse(const TextFileBuffer& textBuffer, Ident root_id, AbstractParseTree& result);
+	void printStats(FILE *f);
+
+protected:
+	virtual bool parse_nt(int nr, AbstractParseTree& rtree) = 0;
+
+	bool parse_term(Ident name, AbstractParseTree &rtree);
+	bool parse_ws_term(Ident name);
+	bool parse_ident(GrammarIdent* ident, AbstractParseTree &rtree);
+	bool make_tree(const Ident tree_name, ParsedValue* prev_parts, AbstractParseTree &rtree);
+	bool make_list(ParsedValue* prev_parts, AbstractParseTree &rtree);
+	inline bool in_set(const unsigned int* set, unsigned char ch)
+	{
+		return (set[ch >> 5] & (1U << (ch & 0x01f))) != 0;
+	}
+	inline bool may_start_with(const unsigned int* chars, unsigned long terminals)
+	{
+		unsigned char ch = *_text;
+		return !_use_first_sets || in_set(chars, ch) || (terminals & _terminals_at[ch]) != 0;
+	}
+	void expected_string(const char *s, bool is_keyword);
+
+	TextFileBuffer _text;
+	GrammarRule** _rules; // indexed by GrammarRule::nr
+	GrammarNonTerminal** _non_terminals; // indexed by GrammarNonTerminal::nr
+	ParseSolutions* _solutions;
+	Ident _root_nt;
+
+private:
+	bool bind();
+	bool bind_rule(GrammarRule* rule);
+	bool bind_or_rules(GrammarOrRule* or_rule);
+	bool parse_root(int root, AbstractParseTree& result);
+
+	const unsigned char* _rule_kinds;
+	int _nr_rules;
+	int _nr_non_terminals;
+	GrammarNonTerminal* _bound_nt; // non-terminals to which the parser is bound
+};
+
+#endif // _INCLUDED_GENERATEDPARSER_H
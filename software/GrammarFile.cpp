@@ -0,0 +1,574 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#ifdef WIN32
+#include <direct.h>
+#define getcwd _getcwd
+#else
+#include <unistd.h>
+#endif
+#include "Ident.h"
+#include "String.h"
+#include "AbstractParseTree.h"
+#include "ParserGrammar.h"
+#include "GrammarFile.h"
+
+#define GRAMMAR_FILE_MAGIC "IParseGr"
+#define GRAMMAR_FILE_VERSION 3
+#define GRAMMAR_FILE_BYTE_ORDER 0x01020304
+#define GRAMMAR_FILE_HEADER_LEN 24
+
+static unsigned int grammar_file_hash(const char* data, unsigned long len)
+/*	The FNV-1a hash of the data */
+{
+	unsigned int hash = 2166136261U;
+	for (unsigned long i = 0; i < len; i++)
+	{
+		hash ^= (unsigned char)data[i];
+		hash *= 16777619U;
+	}
+	return hash;
+}
+
+static bool grammar_source_hash(const char* source_name, unsigned int& hash)
+/*	The hash of the contents of the grammar text, if it can be read */
+{
+	FILE* f = fopen(source_name, "rb");
+	if (f == 0)
+		return false;
+	fseek(f, 0L, SEEK_END);
+	long len = ftell(f);
+	fseek(f, 0L, SEEK_SET);
+	char* data = new char[len > 0 ? len : 1];
+	bool read = len >= 0 && fread(data, 1, len, f) == (size_t)len;
+	fclose(f);
+	if (read)
+		hash = grammar_file_hash(data, len);
+	delete[] data;
+	return read;
+}
+
+static bool absolute_path(const char* path)
+/*	Whether the path does not depend on the current directory */
+{
+#ifdef WIN32
+	return path[0] == '/' || path[0] == '\\' || (path[0] != '\0' && path[1] == ':');
+#else
+	return path[0] == '/';
+#endif
+}
+
+static unsigned long directory_length(const char* path)
+/*	The length of the directory part of the path, including the last
+	separator, or 0 when the path has no directory part */
+{
+	unsigned long len = 0;
+	for (unsigned long i = 0; path[i] != '\0'; i++)
+#ifdef WIN32
+		if (path[i] == '/' || path[i] == '\\' || path[i] == ':')
+#else
+		if (path[i] == '/')
+#endif
+			len = i + 1;
+	return len;
+}
+
+static char* join_path(const char* dir, unsigned long dir_len, const char* path)
+{
+	char* result = new char[dir_len + strlen(path) + 1];
+	memcpy(result, dir, dir_len);
+	strcpy(result + dir_len, path);
+	return result;
+}
+
+static char* full_path(const char* path)
+/*	The path prefixed with the current directory when it is relative */
+{
+	char cwd[4096];
+	if (absolute_path(path) || getcwd(cwd, sizeof(cwd) - 1) == 0)
+		return join_path("", 0, path);
+	unsigned long cwd_len = strlen(cwd);
+	if (cwd_len == 0 || cwd[cwd_len-1] != '/')
+		cwd[cwd_len++] = '/';
+	return join_path(cwd, cwd_len, path);
+}
+
+static char* stored_source_name(const char* source_name, const char* file_name)
+/*	The name of the grammar text as stored in the grammar file: relative
+	to the directory of the grammar file when the text is in (a
+	subdirectory of) that directory, such that the files can be moved
+	together, and otherwise the full path.
+*/
+{
+	char* full_source_name = full_path(source_name);
+	char* full_file_name = full_path(file_name);
+	unsigned long dir_len = directory_length(full_file_name);
+	char* result = strncmp(full_source_name, full_file_name, dir_len) == 0
+				   ? join_path("", 0, full_source_name + dir_len)
+				   : join_path("", 0, full_source_name);
+	delete[] full_source_name;
+	delete[] full_file_name;
+	return result;
+}
+
+bool GrammarFileWriter::write(FILE* f)
+{
+	long nr_terminals = 0;
+	for (GrammarTerminal* terminal = _grammar.allTerminals(); terminal != 0; terminal = terminal->next)
+		nr_terminals++;
+	long nr_literals = 0;
+	for (GrammarLiteral* literal = _grammar.allLiterals(); literal != 0; literal = literal->next)
+		nr_literals++;
+
+	unsigned int source_hash = 0;
+	if (_source_name != 0 && !grammar_source_hash(_source_name, source_hash))
+		return false;
+	char* source_name = _source_name != 0 ? stored_source_name(_source_name, _file_name) : 0;
+	put_string(source_name);
+	delete[] source_name;
+	put_int((int)source_hash);
+
+	put_int(_grammar.nrNonTerminals());
+	for (GrammarNonTerminal* nt = _grammar.allNonTerminals(); nt != 0; nt = nt->next)
+		put_string(nt->name.val());
+	put_int(nr_terminals);
+	for (GrammarTerminal* terminal = _grammar.allTerminals(); terminal != 0; terminal = terminal->next)
+		put_string(terminal->name.val());
+	put_int(_grammar.nrRules());
+	put_int(nr_literals);
+	for (GrammarLiteral* literal = _grammar.allLiterals(); literal != 0; literal = literal->next)
+		put_string(literal->value.val());
+
+	for (GrammarNonTerminal* nt = _grammar.allNonTerminals(); nt != 0; nt = nt->next)
+	{
+		or_rules(nt->first);
+		or_rules(nt->recursive);
+		first_set(nt->first_set);
+	}
+
+	char header[GRAMMAR_FILE_HEADER_LEN];
+	unsigned int fields[4] = { GRAMMAR_FILE_VERSION, GRAMMAR_FILE_BYTE_ORDER, (unsigned int)_len, grammar_file_hash(_data, _len) };
+	memcpy(header, GRAMMAR_FILE_MAGIC, 8);
+	memcpy(header + 8, fields, 16);
+
+	return    fwrite(header, 1, GRAMMAR_FILE_HEADER_LEN, f) == GRAMMAR_FILE_HEADER_LEN
+		   && fwrite(_data, 1, _len, f) == _len;
+}
+
+void GrammarFileWriter::or_rules(GrammarOrRule* or_rule)
+{
+	long nr = 0;
+	for (GrammarOrRule* alt = or_rule; alt != 0; alt = alt->next)
+		nr++;
+	put_int(nr);
+	for (; or_rule != 0; or_rule = or_rule->next)
+	{
+		put_string(or_rule->tree_name.empty() ? 0 : or_rule->tree_name.val());
+		put_int(or_rule->nr_active);
+		put_int(or_rule->single_element != 0 ? or_rule->single_element->nr : -1);
+		first_set(or_rule->first_set);
+		rules(or_rule->rule);
+	}
+}
+
+void GrammarFileWriter::rules(GrammarRule* rule)
+{
+	long nr = 0;
+	for (GrammarRule* elem = rule; elem != 0; elem = elem->next)
+		nr++;
+	put_int(nr);
+	for (; rule != 0; rule = rule->next)
+	{
+		put_int(rule->nr);
+		put_int(  (rule->optional ? 1 : 0) | (rule->sequential ? 2 : 0)
+				| (rule->avoid ? 4 : 0) | (rule->nongreedy ? 8 : 0));
+		put_string(rule->chain_symbol.val());
+		put_string(rule->str_value.val());
+		put_int(rule->line);
+		put_int(rule->column);
+		put_int(rule->kind);
+		switch (rule->kind)
+		{
+			case RK_NT:
+			case RK_WS_NT:
+				put_int(rule->text.non_terminal->nr);
+				break;
+			case RK_TERM:
+				put_int(rule->text.terminal->nr);
+				break;
+			case RK_WS_TERM:
+				put_string(rule->text.terminal->name.val());
+				break;
+			case RK_IDENT:
+				put_int(rule->text.ident->kind);
+				put_string(rule->text.ident->ident_class.val());
+				put_int(rule->text.ident->terminal->nr);
+				break;
+			case RK_CHARSET:
+			case RK_AVOID:
+				char_set(*rule->text.char_set);
+				break;
+			case RK_OR_RULE:
+			case RK_COR_RULE:
+				or_rules(rule->text.or_rules->first);
+				break;
+			case RK_COLOURCODING:
+				put_int(rule->text.colour_coding->type());
+				put_int(rule->text.colour_coding->fg());
+				put_int(rule->text.colour_coding->bg());
+				break;
+		}
+	}
+}
+
+void GrammarFileWriter::first_set(GrammarFirstSet* first_set)
+{
+	if (first_set == 0)
+	{
+		put_int(0);
+		return;
+	}
+	put_int(1 | (first_set->any ? 2 : 0) | (first_set->nullable ? 4 : 0));
+	put_int(first_set->terminals);
+	char_set(first_set->chars);
+}
+
+void GrammarFileWriter::char_set(const GrammarCharSet& char_set)
+{
+	for (int i = 0; i < 8; i++)
+	{
+		unsigned long bits = 0;
+		for (int j = 0; j < 32; j++)
+			if (char_set.contains_char(i * 32 + j))
+				bits |= 1UL << j;
+		put_int(bits);
+	}
+}
+
+void GrammarFileWriter::put_int(long value)
+{
+	int int_value = (int)value;
+	put_bytes(&int_value, 4);
+}
+
+void GrammarFileWriter::put_string(const char* str)
+/*	A string is stored with its length (-1 for none) and the
+	terminating '\0'. */
+{
+	if (str == 0)
+	{
+		put_int(-1);
+		return;
+	}
+	unsigned long len = strlen(str);
+	put_int(len);
+	put_bytes(str, len + 1);
+}
+
+void GrammarFileWriter::put_bytes(const void* bytes, unsigned long len)
+{
+	if (_len + len > _size)
+	{
+		_size = 2 * _size + len + 4096;
+		char* new_data = new char[_size];
+		if (_data != 0)
+			memcpy(new_data, _data, _len);
+		delete[] _data;
+		_data = new_data;
+	}
+	memcpy(_data + _len, bytes, len);
+	_len += len;
+}
+
+
+GrammarFileReader::~GrammarFileReader()
+{
+	delete[] _source_name;
+	delete[] _non_terminals;
+	delete[] _terminals;
+	delete[] _rules;
+}
+
+bool GrammarFileReader::read(const char* data, unsigned long len)
+/*	Loads the grammar from the contents of a grammar file. Returns
+	false when the header does not match, the data is not valid or
+	the file is stale, in which case the grammar is not usable.
+*/
+{
+	unsigned int fields[4];
+	if (len < GRAMMAR_FILE_HEADER_LEN || memcmp(data, GRAMMAR_FILE_MAGIC, 8) != 0)
+		return false;
+	memcpy(fields, data + 8, 16);
+	if (   fields[0] != GRAMMAR_FILE_VERSION || fields[1] != GRAMMAR_FILE_BYTE_ORDER
+		|| fields[2] != len - GRAMMAR_FILE_HEADER_LEN
+		|| fields[3] != grammar_file_hash(data + GRAMMAR_FILE_HEADER_LEN, fields[2]))
+		return false;
+	_data = data + GRAMMAR_FILE_HEADER_LEN;
+	_len = fields[2];
+	_pos = 0;
+
+	/* A grammar file is stale when the grammar text it was made from
+	   has changed. A relative name of the text is relative to the
+	   directory of the grammar file. */
+	const char* source_name;
+	long source_hash;
+	unsigned int current_hash;
+	if (!get_string(source_name) || !get_int(source_hash))
+		return false;
+	if (source_name != 0)
+	{
+		_source_name = absolute_path(source_name)
+					   ? join_path("", 0, source_name)
+					   : join_path(_file_name, directory_length(_file_name), source_name);
+		_source_found = grammar_source_hash(_source_name, current_hash);
+		if (_source_found && current_hash != (unsigned int)source_hash)
+		{
+			_stale = true;
+			return false;
+		}
+	}
+
+	if (!get_nr(_nr_non_terminals, 100000))
+		return false;
+	_non_terminals = new GrammarNonTerminal*[_nr_non_terminals];
+	for (long i = 0; i < _nr_non_terminals; i++)
+	{
+		const char* name;
+		if (!get_string(name) || name == 0)
+			return false;
+		_non_terminals[i] = _grammar.addNonTerminal(name);
+		if (_non_terminals[i]->nr != i)
+			return false;
+	}
+	if (!get_nr(_nr_terminals, 100000))
+		return false;
+	_terminals = new GrammarTerminal*[_nr_terminals];
+	for (long i = 0; i < _nr_terminals; i++)
+	{
+		const char* name;
+		if (!get_string(name) || name == 0)
+			return false;
+		_terminals[i] = _grammar.findTerminal(name);
+		if (_terminals[i]->nr != i)
+			return false;
+	}
+	if (!get_nr(_nr_rules, 10000000))
+		return false;
+	_rules = new GrammarRule*[_nr_rules];
+	for (long i = 0; i < _nr_rules; i++)
+		_rules[i] = _grammar.newRule();
+	long nr_literals;
+	if (!get_nr(nr_literals, 10000000))
+		return false;
+	for (long i = 0; i < nr_literals; i++)
+	{
+		const char* literal;
+		if (!get_string(literal) || literal == 0)
+			return false;
+		_grammar.addLiteral(literal);
+	}
+
+	for (long i = 0; i < _nr_non_terminals; i++)
+	{
+		GrammarNonTerminal* nt = _non_terminals[i];
+		if (   !or_rules(&nt->first) || !or_rules(&nt->recursive)
+			|| !first_set(&nt->first_set))
+			return false;
+	}
+	if (_pos != _len)
+		return false;
+	_grammar.computePredictions();
+	return true;
+}
+
+bool GrammarFileReader::or_rules(GrammarOrRule** ref_or_rule)
+{
+	long nr;
+	if (!get_nr(nr, 10000000))
+		return false;
+	for (long i = 0; i < nr; i++)
+	{
+		GrammarOrRule* or_rule = new GrammarOrRule;
+		*ref_or_rule = or_rule;
+		ref_or_rule = &or_rule->next;
+
+		const char* tree_name;
+		long nr_active;
+		long single_element;
+		if (   !get_string(tree_name) || !get_int(nr_active) || !get_int(single_element)
+			|| !first_set(&or_rule->first_set) || !rules(&or_rule->rule))
+			return false;
+		if (tree_name != 0)
+			or_rule->tree_name = tree_name;
+		or_rule->nr_active = nr_active;
+		if (single_element >= 0)
+		{
+			if (single_element >= _nr_rules)
+				return false;
+			or_rule->single_element = _rules[single_element];
+		}
+	}
+	return true;
+}
+
+bool GrammarFileReader::rules(GrammarRule** ref_rule)
+{
+	long nr;
+	if (!get_nr(nr, 10000000))
+		return false;
+	for (long i = 0; i < nr; i++)
+	{
+		long rule_nr;
+		long flags;
+		const char* chain_symbol;
+		const char* str_value;
+		long line;
+		long column;
+		long kind;
+		if (   !get_nr(rule_nr, _nr_rules) || !get_int(flags) || !get_string(chain_symbol)
+			|| !get_string(str_value) || !get_int(line) || !get_int(column) || !get_int(kind))
+			return false;
+
+		GrammarRule* rule = _rules[rule_nr];
+		*ref_rule = rule;
+		ref_rule = &rule->next;
+		rule->optional = (flags & 1) != 0;
+		rule->sequential = (flags & 2) != 0;
+		rule->avoid = (flags & 4) != 0;
+		rule->nongreedy = (flags & 8) != 0;
+		if (chain_symbol != 0)
+			rule->chain_symbol = chain_symbol;
+		if (str_value != 0)
+			rule->str_value = str_value;
+		rule->line = line;
+		rule->column = column;
+		rule->kind = kind;
+
+		long value;
+		const char* str;
+		switch (kind)
+		{
+			case RK_NT:
+			case RK_WS_NT:
+				if (!get_nr(value, _nr_non_terminals))
+					return false;
+				rule->text.non_terminal = _non_terminals[value];
+				break;
+			case RK_TERM:
+				if (!get_nr(value, _nr_terminals))
+					return false;
+				rule->text.terminal = _terminals[value];
+				break;
+			case RK_WS_TERM:
+				if (!get_string(str) || str == 0)
+					return false;
+				rule->text.terminal = new GrammarTerminal(str);
+				break;
+			case RK_IDENT:
+			{
+				long terminal;
+				if (!get_int(value) || !get_string(str) || !get_nr(terminal, _nr_terminals))
+					return false;
+				rule->text.ident = new GrammarIdent(value, str, _terminals[terminal]);
+				break;
+			}
+			case RK_CHARSET:
+			case RK_AVOID:
+				rule->text.char_set = new GrammarCharSet;
+				if (!char_set(*rule->text.char_set))
+					return false;
+				break;
+			case RK_OR_RULE:
+			case RK_COR_RULE:
+				rule->text.or_rules = new GrammarOrRules;
+				if (!or_rules(&rule->text.or_rules->first))
+					return false;
+				break;
+			case RK_COLOURCODING:
+			{
+				long fg;
+				long bg;
+				if (!get_int(value) || !get_int(fg) || !get_int(bg))
+					return false;
+				rule->text.colour_coding = new GrammarColourCoding((char)value, fg, bg);
+				break;
+			}
+			case RK_LIT:
+			case RK_AVOIDLIT:
+			case RK_T_EOF:
+			case RK_T_OPENCONTEXT:
+			case RK_T_CLOSECONTEXT:
+				break;
+			default:
+				return false;
+		}
+	}
+	return true;
+}
+
+bool GrammarFileReader::first_set(GrammarFirstSet** ref_first_set)
+{
+	long flags;
+	if (!get_int(flags))
+		return false;
+	if (flags == 0)
+		return true;
+
+	long terminals;
+	GrammarFirstSet* first_set = new GrammarFirstSet;
+	*ref_first_set = first_set;
+	first_set->any = (flags & 2) != 0;
+	first_set->nullable = (flags & 4) != 0;
+	if (!get_int(terminals))
+		return false;
+	first_set->terminals = (unsigned int)terminals;
+	return char_set(first_set->chars);
+}
+
+bool GrammarFileReader::char_set(GrammarCharSet& char_set)
+{
+	for (int i = 0; i < 8; i++)
+	{
+		long bits;
+		if (!get_int(bits))
+			return false;
+		for (unsigned int rest = (unsigned int)bits, ch = i * 32; rest != 0; ch++, rest >>= 1)
+			if (rest & 1)
+				char_set.add_char(ch);
+	}
+	return true;
+}
+
+bool GrammarFileReader::get_int(long& value)
+{
+	if (_pos + 4 > _len)
+		return false;
+	int int_value;
+	memcpy(&int_value, _data + _pos, 4);
+	_pos += 4;
+	value = int_value;
+	return true;
+}
+
+bool GrammarFileReader::get_nr(long& value, long nr_values)
+/*	Reads a number in the range [0, nr_values) */
+{
+	return get_int(value) && value >= 0 && value < nr_values;
+}
+
+bool GrammarFileReader::get_string(const char*& str)
+{
+	long len;
+	if (!get_int(len) || len < -1)
+		return false;
+	if (len == -1)
+	{
+		str = 0;
+		return true;
+	}
+	if (_pos + len + 1 > _len || _data[_pos + len] != '\0')
+		return false;
+	str = _data + _pos;
+	_pos += len + 1;
+	return true;
+}
@@ -0,0 +1,96 @@
+#ifndef _INCLUDED_GRAMMARFILE_H
+#define _INCLUDED_GRAMMARFILE_H
+
+#include "ParserGrammar.h"
+
+/*	A grammar file is a binary form of a loaded grammar (options
+	-savegrammar and -loadgrammar), such that a grammar can be used
+	without parsing its text and loading it from the parse tree.
+	The file starts with a header holding the magic, the version,
+	the byte order, the length of the data and a hash of the data.
+	The data starts with the name of the grammar text the grammar
+	was loaded from and a hash of that text, such that a grammar file
+	is not used after the text has changed. The name is relative to
+	the directory of the grammar file, unless the text is outside
+	that directory. It then lists the names of the non-terminals and
+	the terminals, the number of rules and the literals, followed by
+	the rules of each non-terminal in pre-order, with the first sets
+	included.
+	Non-terminals, terminals and rules are referred to by their
+	numbers. Numbers are stored in the byte order of the machine and
+	strings are stored with their terminating '\0', such that the
+	reader can work directly on the mapped file.
+*/
+
+class GrammarFileWriter
+{
+public:
+	// source_name is the grammar text the grammar was loaded from (or 0)
+	// and file_name the grammar file that is written
+	GrammarFileWriter(Grammar& grammar, const char* source_name, const char* file_name)
+	  : _grammar(grammar), _source_name(source_name), _file_name(file_name), _data(0), _len(0), _size(0) {}
+	~GrammarFileWriter() { delete[] _data; }
+
+	bool write(FILE* f);
+
+private:
+	void or_rules(GrammarOrRule* or_rule);
+	void rules(GrammarRule* rule);
+	void first_set(GrammarFirstSet* first_set);
+	void char_set(const GrammarCharSet& char_set);
+	void put_int(long value);
+	void put_string(const char* str);
+	void put_bytes(const void* bytes, unsigned long len);
+
+	Grammar& _grammar;
+	const char* _source_name;
+	const char* _file_name;
+	char* _data;
+	unsigned long _len;
+	unsigned long _size;
+};
+
+class GrammarFileReader
+{
+public:
+	// file_name is the grammar file that is read
+	GrammarFileReader(Grammar& grammar, const char* file_name)
+	  : _grammar(grammar), _file_name(file_name), _data(0), _len(0), _pos(0), _source_name(0), _source_found(false), _stale(false),
+	    _non_terminals(0), _terminals(0), _rules(0) {}
+	~GrammarFileReader();
+
+	bool read(const char* data, unsigned long len);
+	// Whether read failed because the grammar text has changed
+	bool isStale() const { return _stale; }
+	// The grammar text, relative to the current directory (or 0)
+	const char* sourceName() const { return _source_name; }
+	// Whether the grammar text was found, such that it was checked
+	// that it did not change
+	bool sourceFound() const { return _source_found; }
+
+private:
+	bool or_rules(GrammarOrRule** ref_or_rule);
+	bool rules(GrammarRule** ref_rule);
+	bool first_set(GrammarFirstSet** ref_first_set);
+	bool char_set(GrammarCharSet& char_set);
+	bool get_int(long& value);
+	bool get_nr(long& value, long nr_values);
+	bool get_string(const char*& str);
+
+	Grammar& _grammar;
+	const char* _file_name;
+	const char* _data;
+	unsigned long _len;
+	unsigned long _pos;
+	char* _source_name;
+	bool _source_found;
+	bool _stale;
+	long _nr_non_terminals;
+	long _nr_terminals;
+	long _nr_rules;
+	GrammarNonTerminal** _non_terminals;
+	GrammarTerminal** _terminals;
+	GrammarRule** _rules;
+};
+
+#endif // _INCLUDED_GRAMMARFILE_H
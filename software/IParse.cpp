@@ -12,6 +12,7 @@
 //#include <unistd.h>
 #include <ctype.h>
 #include <assert.h>
+#include <time.h>
 
 #include "Ident.h"
 #include "String.h"
@@ -24,12 +25,19 @@
 #include "AbstractParser.h"
 #include "BTParser.h"
 #include "BTHeapParser.h"
+#include "BTVMParser.h"
 #include "LL1Parser.h"
 #include "LL1HeapParser.h"
+#include "LL1HeapColourParser.h"
 #include "ParParser.h"
+#include "ParserGenerator.h"
+#include "GrammarFile.h"
+#include "TreeFile.h"
+#include "TreeStream.h"
 #include "TextReader.h"
 #include "XMLParser.h"
 #include "Unparser.h"
+#include "Threads.h"
 
 #define ASSERT assert
 
@@ -88,7 +96,7 @@ SContext* SContext::_top = 0;
 	the input grammar of IParse.
 */
 
-int print_tree_depth = 0;
+THREAD_LOCAL int print_tree_depth = 0;
 static void print_tree_rec( FILE *f, const AbstractParseTree& tree );
  
 void print_tree_to_c( FILE *f, const AbstractParseTree& tree, char *name )
@@ -153,76 +161,6 @@ static void print_tree_rec( FILE *f, const AbstractParseTree& tree )
 };
 
 
-static void print_string_to_xml( FILE *f, const char *s)
-{
-	for (; *s != '\0'; s++)
-		if (*s == '<')
-			fprintf(f, "&lt;");
-		else if (*s == '>')
-			fprintf(f, "&gt;");
-		else if (*s == '&')
-			fprintf(f, "&amp;");
-		else
-			fprintf(f, "%c", *s);
-}
-
-static void print_tree_to_xml( FILE *f, const AbstractParseTree& tree )
-{
-	fprintf(f, "\n%*.*s", print_tree_depth, print_tree_depth, "");
-    if (tree.isEmpty())
-         fprintf(f, "<EMPTY/>");
-    else if (tree.isIdent())
-    {   fprintf(f, "<ID>");
-    	print_string_to_xml(f, tree.identName().val());
-    	fprintf(f, "</ID>");
-    }
-    else if (tree.isString())
-    {   fprintf(f, "<STRING>");
-    	print_string_to_xml(f, tree.identName().val());
-    	fprintf(f, "</STRING>");
-    }
-    else if (tree.isInt())
-    	fprintf(f, "<INT>%ld</INT>", tree.intValue());
-    else if (tree.isDouble())
-		fprintf(f, "<DOUBLE>%f</DOUBLE>", tree.doubleValue());
-    else if (tree.isChar())
-	{
-		fprintf(f, "<CHAR>");
-		char str[2];
-		str[0] = tree.charValue();
-		str[1] = '\0';
-    	print_string_to_xml(f, str);
-    	fprintf(f, "</CHAR>");
-    }
-    else
-    {   
-        if (tree.nrParts() > 0)
-	    {
-	        if (tree.isList())
-	            fprintf(f, "<LIST>");
-	        else
-	            fprintf(f, "<TREE TYPE=\"%s\">", tree.type());
-
-		    print_tree_depth++;
-            for (AbstractParseTree::iterator child_it(tree); child_it.more(); child_it.next())
-            	print_tree_to_xml(f, child_it);
-            print_tree_depth--;
-	        if (tree.isList())
-	            fprintf(f, "</LIST>");
-	        else
-	            fprintf(f, "</TREE>");
-	    }
-	    else
-	    {
-	        if (tree.isList())
-	            fprintf(f, "<LIST/>");
-	        else
-	            fprintf(f, "<TREE TYPE=\"%s\"/>", tree.type());
-	    }
-    }
-};
-
-
 
 
 /*
@@ -406,27 +344,799 @@ struct context_entry_t
 };
 
 
+/*
+	Parsers, scanners and file readers
+	~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+	The parser, scanner and file reader are selected with
+	command line options, which set one of the following
+	constants.
+*/
+
+static const char* constBTStack = "BTStack";
+static const char* constBTHeap = "BTHeap";
+static const char* constBTVM = "BTVM";
+static const char* constLL1Stack = "LL1Stack";
+static const char* constLL1Heap = "LL1Heap";
+static const char* constPar = "Par";
+static const char* constAdaptive = "Adaptive";
+static const char* constBasic = "Basic";
+static const char* constWhiteSpace = "WhiteSpace";
+static const char* constProtos = "Protos";
+static const char* constResource = "Resource";
+static const char* constPascal = "Pascal";
+static const char* constColourCoding = "ColourCoding";
+static const char* constRaw = "Raw";
+static const char* constBare = "Bare";
+static const char* constPlain = "plain";
+static const char* constCP1252 = "cp1252";
+static const char* constUTF16 = "utf16";
+
+static AbstractParser* new_parser(const char* selected_parser)
+{
+	if (selected_parser == constAdaptive)
+	{
+		BTParser* parser = new BTParser();
+		parser->setAdaptive(true);
+		return parser;
+	}
+	return   selected_parser == constBTHeap 
+		   ? (AbstractParser*)new BTHeapParser()
+		   : selected_parser == constBTVM
+		   ? (AbstractParser*)new BTVMParser()
+		   : selected_parser == constBTStack
+		   ? (AbstractParser*)new BTParser()
+		   : selected_parser == constLL1Heap 
+		   ? (AbstractParser*)new LL1HeapParser()
+		   : selected_parser == constLL1Stack 
+		   ? (AbstractParser*)new LL1Parser()
+		   : (AbstractParser*)new ParParser();
+}
+
+static AbstractScanner* new_scanner(const char* use_scanner)
+{
+	return   use_scanner == constWhiteSpace
+		   ? (AbstractScanner*)new WhiteSpaceScanner()
+		   : use_scanner == constProtos
+		   ? (AbstractScanner*)new ProtosScanner()
+		   : use_scanner == constResource
+		   ? (AbstractScanner*)new ResourceScanner()
+		   : use_scanner == constPascal
+		   ? (AbstractScanner*)new PascalScanner()
+		   : use_scanner == constColourCoding
+		   ? (AbstractScanner*)new ColourCodingScanner()
+		   : use_scanner == constRaw
+		   ? (AbstractScanner*)new RawScanner()
+		   : use_scanner == constBare
+		   ? (AbstractScanner*)new BareScanner()
+		   : (AbstractScanner*)new BasicScanner();
+}
+
+class FileReaders
+{
+public:
+	FileReaders(bool use_mmap = false)
+	  : _use_mmap(use_mmap),
+	    codePage1252ToUF8ConverterStream(codePage1252),
+	    codePage1252FileReader(codePage1252ToUF8ConverterStream),
+	    utf16FileReader(utf16ToUTF8ConverterStream) {}
+	AbstractFileReader* reader(const char* encoding)
+	{
+		return   encoding == constCP1252
+			   ? (AbstractFileReader*)&codePage1252FileReader
+			   : encoding == constUTF16
+			   ? (AbstractFileReader*)&utf16FileReader
+			   : _use_mmap
+			   ? (AbstractFileReader*)&mmapFileReader
+			   : (AbstractFileReader*)&plainFileReader;
+	}
+	void setMmap(bool use_mmap) { _use_mmap = use_mmap; }
+private:
+	bool _use_mmap;
+	PlainFileReader plainFileReader;
+	MmapFileReader mmapFileReader;
+	CodePage1252 codePage1252;
+	CodePageToUF8ConverterStream codePage1252ToUF8ConverterStream;
+	ConverterFileReader codePage1252FileReader;
+	UTF16ToUTF8ConverterStream utf16ToUTF8ConverterStream;
+	ConverterFileReader utf16FileReader;
+};
+
+
+/*
+	Batch parsing
+	~~~~~~~~~~~~~
+	With the -batch option all the files listed in a file are
+	parsed with the current grammar, using a number of threads.
+	The grammar is loaded once and shared by the parsers of all
+	threads. Each thread has its own scanner and file readers.
+	The threads take the next file from the list with an atomic
+	counter.
+*/
+
+class BatchParser
+{
+public:
+	BatchParser(const char* output, bool memo_window, bool first_sets, bool use_arena, bool use_mmap)
+	  : _output(output), _memo_window(memo_window), _first_sets(first_sets), _use_arena(use_arena), _use_mmap(use_mmap),
+	    _files(0), _nr_files(0), _next_file(0), _nr_failed(0) {}
+	~BatchParser()
+	{
+		for (long i = 0; i < _nr_files; i++)
+			delete[] _files[i];
+		delete[] _files;
+	}
+
+	void addFile(const char* filename)
+	{
+		if (_nr_files % 100 == 0)
+		{
+			const char** new_files = new const char*[_nr_files + 100];
+			for (long i = 0; i < _nr_files; i++)
+				new_files[i] = _files[i];
+			delete[] _files;
+			_files = new_files;
+		}
+		char* copy = new char[strlen(filename)+1];
+		strcpy(copy, filename);
+		_files[_nr_files++] = copy;
+	}
+	long nrFiles() { return _nr_files; }
+	long nrFailed() { return _nr_failed; }
+
+	void run(int nr_threads, const AbstractParseTree& grammar, Grammar* loaded_grammar, const char* selected_parser, const char* use_scanner, const char* encoding)
+	{
+		Worker* workers = new Worker[nr_threads];
+		for (int i = 0; i < nr_threads; i++)
+		{
+			workers[i].batch = this;
+			workers[i].encoding = encoding;
+			workers[i].parser = new_parser(selected_parser);
+			workers[i].scanner = new_scanner(use_scanner);
+			workers[i].parser->setScanner(workers[i].scanner);
+			workers[i].parser->setMemoWindow(_memo_window);
+			workers[i].parser->setFirstSets(_first_sets);
+			if (i == 0 && loaded_grammar != 0)
+				workers[i].parser->shareGrammar(*loaded_grammar);
+			else if (i == 0)
+				workers[i].parser->loadGrammar(grammar);
+			else
+				workers[i].parser->shareGrammar(*workers[0].parser);
+		}
+		for (int i = 1; i < nr_threads; i++)
+			if (!workers[i].thread.start(work, &workers[i]))
+				fprintf(stderr, "Error: cannot start thread %d\n", i);
+		work(&workers[0]);
+		for (int i = 1; i < nr_threads; i++)
+			workers[i].thread.join();
+		for (int i = 0; i < nr_threads; i++)
+		{
+			delete workers[i].parser;
+			delete workers[i].scanner;
+		}
+		delete[] workers;
+	}
+
+private:
+	struct Worker
+	{
+		BatchParser* batch;
+		const char* encoding;
+		AbstractParser* parser;
+		AbstractScanner* scanner;
+		Thread thread;
+	};
+
+	static void work(void* data)
+	{
+		Worker* worker = (Worker*)data;
+		BatchParser* batch = worker->batch;
+		FileReaders fileReaders(batch->_use_mmap);
+		AbstractFileReader* fileReader = fileReaders.reader(worker->encoding);
+		for (;;)
+		{
+			long i = atomicIncrement(batch->_next_file) - 1;
+			if (i >= batch->_nr_files)
+				break;
+			if (!batch->parse_file(batch->_files[i], worker->parser, fileReader))
+				atomicIncrement(batch->_nr_failed);
+		}
+	}
+
+	bool parse_file(const char* filename, AbstractParser* parser, AbstractFileReader* fileReader)
+	{
+		FILE *fin = fopen(filename, "rt");
+		if (fin == 0)
+		{
+			printf("Cannot open: %s\n", filename);
+			return false;
+		}
+		TextFileBuffer textBuffer;
+		fileReader->read(fin, textBuffer);
+		fclose(fin);
+
+		AbstractParseTreeArena *arena = _use_arena ? new AbstractParseTreeArena() : 0;
+		parser->setTreeArena(arena);
+		bool parsed;
+		{
+			AbstractParseTree tree;
+			parsed = parser->parse(textBuffer, "root", tree);
+			if (!parsed)
+				parser->printExpected(stdout, filename, textBuffer);
+			else if (strcmp(_output, "none") != 0)
+			{
+				char *out_name = new char[strlen(filename) + 5];
+				strcpy(out_name, filename);
+				strcat(out_name, strcmp(_output, "xml") == 0 ? ".xml" : strcmp(_output, "bin") == 0 ? ".bin" : ".p");
+				FILE *fout = fopen(out_name, strcmp(_output, "bin") == 0 ? "wb" : "wt");
+				if (fout == 0)
+				{
+					printf("Cannot open: %s\n", out_name);
+					parsed = false;
+				}
+				else
+				{
+					if (strcmp(_output, "xml") == 0)
+					{
+						XMLTreeStream xmlTreeStream(fout);
+						xmlTreeStream.stream(tree);
+					}
+					else if (strcmp(_output, "bin") == 0)
+					{
+						TreeFileWriter treeFileWriter;
+						if (!treeFileWriter.write(fout, tree))
+						{
+							printf("Cannot write: %s\n", out_name);
+							parsed = false;
+						}
+					}
+					else
+						tree.print(fout, false);
+					fclose(fout);
+				}
+				delete[] out_name;
+			}
+		}
+		delete arena;
+		textBuffer.release();
+		return parsed;
+	}
+
+	const char* _output;
+	bool _memo_window;
+	bool _first_sets;
+	bool _use_arena;
+	bool _use_mmap;
+	const char** _files;
+	long _nr_files;
+	volatile long _next_file;
+	volatile long _nr_failed;
+};
+
+static bool equal_trees(const AbstractParseTree& tree1, const AbstractParseTree& tree2)
+{
+	if (tree1.isEmpty() || tree2.isEmpty())
+		return tree1.isEmpty() && tree2.isEmpty();
+	if (tree1.line() != tree2.line() || tree1.column() != tree2.column())
+		return false;
+	if (tree1.isIdent())
+		return tree2.isIdent() && tree1.identName() == tree2.identName();
+	if (tree1.isString())
+		return tree2.isString() && strcmp(tree1.stringValue(), tree2.stringValue()) == 0;
+	if (tree1.isInt())
+		return tree2.isInt() && tree1.intValue() == tree2.intValue();
+	if (tree1.isDouble())
+		return tree2.isDouble() && tree1.doubleValue() == tree2.doubleValue();
+	if (tree1.isChar())
+		return tree2.isChar() && tree1.charValue() == tree2.charValue();
+	if (   tree1.isList() != tree2.isList() || strcmp(tree1.type(), tree2.type()) != 0
+		|| tree1.nrParts() != tree2.nrParts())
+		return false;
+	AbstractParseTree::iterator it1(tree1);
+	AbstractParseTree::iterator it2(tree2);
+	for (; it1.more(); it1.next(), it2.next())
+		if (!equal_trees(it1, it2))
+			return false;
+	return true;
+}
+
+class RandomEdits
+/*	Makes a series of single character edits in a text, for benchmarking
+	parsing the text again after each edit: inserting a space or a newline
+	between two tokens and removing it again, and replacing a letter in a
+	word and restoring it. The edited texts are kept in two buffers that
+	are used in turn, such that the text before the edit remains.
+*/
+{
+public:
+	RandomEdits(TextFileBuffer& textBuffer, int nr_edits)
+	  : _len(textBuffer.length()), _k(0), _insert_pos(0), _replace_pos(0), _replaced_ch('\0')
+	{
+		_texts[0] = new char[_len + nr_edits + 1];
+		_texts[1] = new char[_len + nr_edits + 1];
+		memcpy(_texts[0], (const char*)textBuffer, _len);
+		_texts[0][_len] = '\0';
+		srand(1);
+	}
+	~RandomEdits()
+	{
+		delete[] _texts[0];
+		delete[] _texts[1];
+	}
+	const char* text() const { return _texts[_k % 2]; }
+	unsigned long length() const { return _len; }
+	void next(unsigned long& edit_start, unsigned long& edit_old_end, unsigned long& edit_new_end)
+	{
+		const char* old_text = _texts[_k % 2];
+		char* new_text = _texts[(_k + 1) % 2];
+		edit_start = _len;
+		edit_old_end = _len;
+		char new_ch = '\0';
+		unsigned long pos = ((unsigned long)rand() * ((unsigned long)RAND_MAX + 1) + rand()) % (_len + 1);
+		switch (_k % 4)
+		{	case 0:
+				while (pos < _len && !(pos > 0 && (old_text[pos-1] == ' ' || old_text[pos-1] == '\n')))
+					pos++;
+				edit_start = edit_old_end = _insert_pos = pos;
+				new_ch = (_k / 4) % 2 == 0 ? ' ' : '\n';
+				break;
+			case 1:
+				edit_start = _insert_pos;
+				edit_old_end = _insert_pos + 1;
+				break;
+			case 2:
+				while (pos < _len && !(pos > 0 && islower(old_text[pos-1]) && islower(old_text[pos])))
+					pos++;
+				_replace_pos = pos;
+				if (pos < _len)
+				{	edit_start = pos;
+					edit_old_end = pos + 1;
+					_replaced_ch = old_text[pos];
+					new_ch = _replaced_ch == 'x' ? 'y' : 'x';
+				}
+				break;
+			case 3:
+				if (_replace_pos < _len)
+				{	edit_start = _replace_pos;
+					edit_old_end = _replace_pos + 1;
+					new_ch = _replaced_ch;
+				}
+				break;
+		}
+		edit_new_end = edit_start + (new_ch != '\0' ? 1 : 0);
+		memcpy(new_text, old_text, edit_start);
+		if (new_ch != '\0')
+			new_text[edit_start] = new_ch;
+		memcpy(new_text + edit_new_end, old_text + edit_old_end, _len - edit_old_end);
+		_len = _len - edit_old_end + edit_new_end;
+		new_text[_len] = '\0';
+		_k++;
+	}
+private:
+	char* _texts[2];
+	unsigned long _len;
+	int _k;
+	unsigned long _insert_pos;
+	unsigned long _replace_pos;
+	char _replaced_ch;
+};
+
+static void reparse_edits(Grammar& grammar, const char* use_scanner, bool first_sets, TextFileBuffer& textBuffer, int nr_edits)
+/*	Benchmark for BTParser::reparse (option -reparse). After each of a
+	series of random edits, the text is parsed again with reparse and,
+	for comparison, completely with another parser.
+*/
+{
+	RandomEdits edits(textBuffer, nr_edits);
+
+	AbstractScanner* incrementalScanner = new_scanner(use_scanner);
+	AbstractScanner* scanner = new_scanner(use_scanner);
+
+	BTParser incrementalParser;
+	incrementalParser.setScanner(incrementalScanner);
+	incrementalParser.setFirstSets(first_sets);
+	incrementalParser.shareGrammar(grammar);
+	incrementalParser.setIncremental(true);
+	BTParser parser;
+	parser.setScanner(scanner);
+	parser.setFirstSets(first_sets);
+	parser.shareGrammar(grammar);
+
+	TextFileBuffer text;
+	text.assign(edits.text(), edits.length());
+	AbstractParseTree tree;
+	incrementalParser.parse(text, "root", tree);
+
+	clock_t reparse_time = 0;
+	clock_t parse_time = 0;
+	int nr_failed = 0;
+	int nr_different = 0;
+	for (int k = 0; k < nr_edits; k++)
+	{
+		unsigned long edit_start, edit_old_end, edit_new_end;
+		edits.next(edit_start, edit_old_end, edit_new_end);
+		text.assign(edits.text(), edits.length());
+
+		clock_t start_time = clock();
+		bool parsed = incrementalParser.reparse(text, edit_start, edit_old_end, edit_new_end, tree);
+		reparse_time += clock() - start_time;
+
+		AbstractParseTree full_tree;
+		start_time = clock();
+		bool full_parsed = parser.parse(text, "root", full_tree);
+		parse_time += clock() - start_time;
+
+		if (!parsed)
+			nr_failed++;
+		if (parsed != full_parsed || (parsed && !equal_trees(tree, full_tree)))
+			nr_different++;
+	}
+	if (nr_edits > 0)
+		printf("reparse: %d edits, %.2f ms per edit, parse: %.2f ms per edit, %d failed, %d different\n",
+			   nr_edits, 1000.0 * reparse_time / CLOCKS_PER_SEC / nr_edits, 1000.0 * parse_time / CLOCKS_PER_SEC / nr_edits,
+			   nr_failed, nr_different);
+
+	tree.clear();
+	delete incrementalScanner;
+	delete scanner;
+}
+
+static void par_scale(Grammar& grammar, const char* use_scanner, const TextFileBuffer& textBuffer, int max_threads)
+/*	Benchmark for ParParser with threads (option -parscale). The text is
+	parsed with 1, 2, 4, ... threads up to max_threads, and the tree of
+	each is compared with the tree parsed with one thread.
+*/
+{
+	AbstractParseTree first_tree;
+	double first_time = 0.0;
+	for (int nr_threads = 1; nr_threads <= max_threads; nr_threads = nr_threads < max_threads && 2 * nr_threads > max_threads ? max_threads : 2 * nr_threads)
+	{
+		AbstractScanner* scanner = new_scanner(use_scanner);
+		ParParser parser;
+		parser.setScanner(scanner);
+		for (int i = 1; i < nr_threads; i++)
+			parser.addScanner(new_scanner(use_scanner));
+		parser.shareGrammar(grammar);
+
+		AbstractParseTree tree;
+		double start_time = wallClockTime();
+		bool parsed = parser.parse(textBuffer, "root", tree);
+		double time = wallClockTime() - start_time;
+		if (nr_threads == 1)
+		{
+			first_tree = tree;
+			first_time = time;
+		}
+		printf("parscale: %d threads, %.3f sec, speed-up %.2f, %s\n",
+			   nr_threads, time, time > 0.0 ? first_time / time : 1.0,
+			   !parsed ? "failed" : equal_trees(tree, first_tree) ? "same tree" : "different tree");
+		delete scanner;
+	}
+}
+
+static void arena_bench(Grammar& grammar, const char* selected_parser, const char* use_scanner, bool first_sets, const TextFileBuffer& textBuffer, int nr_parses)
+/*	Benchmark for allocating parse trees from an arena (option -arenabench).
+	The text is parsed nr_parses times with reference counted trees and
+	nr_parses times with trees from an arena, each time including the
+	release of the tree, and the trees are compared.
+*/
+{
+	AbstractParseTree first_tree;
+	for (int arena_mode = 0; arena_mode < 2; arena_mode++)
+	{
+		AbstractParser* parser = new_parser(selected_parser);
+		AbstractScanner* scanner = new_scanner(use_scanner);
+		parser->setScanner(scanner);
+		parser->setFirstSets(first_sets);
+		parser->shareGrammar(grammar);
+
+		clock_t time = 0;
+		unsigned long nr_bytes = 0;
+		int nr_failed = 0;
+		int nr_different = 0;
+		for (int k = 0; k < nr_parses; k++)
+		{
+			AbstractParseTreeArena *arena = arena_mode ? new AbstractParseTreeArena() : 0;
+			parser->setTreeArena(arena);
+			clock_t start_time = clock();
+			bool parsed;
+			{
+				AbstractParseTree tree;
+				parsed = parser->parse(textBuffer, "root", tree);
+				if (arena != 0)
+					nr_bytes = arena->nrBytes();
+				time += clock() - start_time;
+				if (!parsed)
+					nr_failed++;
+				else if (first_tree.isEmpty() && arena == 0)
+					first_tree = tree;
+				else if (!equal_trees(tree, first_tree))
+					nr_different++;
+				start_time = clock();
+			}
+			delete arena;
+			time += clock() - start_time;
+		}
+		parser->setTreeArena(0);
+		if (nr_parses > 0)
+			printf("arenabench: %s, %d parses, %.2f ms per parse, %lu bytes, %d failed, %d different\n",
+				   arena_mode ? "arena" : "refcounted", nr_parses, 1000.0 * time / CLOCKS_PER_SEC / nr_parses,
+				   nr_bytes, nr_failed, nr_different);
+		delete parser;
+		delete scanner;
+	}
+}
+
+class BTStress
+/*	Stress test for sharing a grammar between back-tracking parsers in
+	several threads (option -btstress). Each thread parses the text a
+	number of times with a BTParser of its own that shares the grammar,
+	and compares each tree with the tree of a sequential parse.
+*/
+{
+public:
+	BTStress(Grammar& grammar, const char* use_scanner, bool first_sets, const TextFileBuffer& textBuffer, int nr_threads, int nr_parses)
+	  : _text(textBuffer), _nr_threads(nr_threads), _nr_parses(nr_parses), _nr_failed(0), _nr_different(0)
+	{
+		_workers = new Worker[_nr_threads];
+		for (int i = 0; i < _nr_threads; i++)
+		{
+			_workers[i].stress = this;
+			_workers[i].scanner = new_scanner(use_scanner);
+			_workers[i].parser.setScanner(_workers[i].scanner);
+			_workers[i].parser.setFirstSets(first_sets);
+			_workers[i].parser.shareGrammar(grammar);
+		}
+	}
+	~BTStress()
+	{
+		for (int i = 0; i < _nr_threads; i++)
+			delete _workers[i].scanner;
+		delete[] _workers;
+	}
+
+	void run()
+	{
+		if (!_workers[0].parser.parse(_text, "root", _tree))
+		{
+			printf("btstress: sequential parse failed\n");
+			return;
+		}
+
+		/* The threads compare their trees with the same tree */
+		AbstractParseTree::setSharedBetweenThreads(true);
+		double start_time = wallClockTime();
+		for (int i = 1; i < _nr_threads; i++)
+			if (!_workers[i].thread.start(work, &_workers[i]))
+				fprintf(stderr, "Error: cannot start thread %d\n", i);
+		work(&_workers[0]);
+		for (int i = 1; i < _nr_threads; i++)
+			_workers[i].thread.join();
+		double time = wallClockTime() - start_time;
+		AbstractParseTree::setSharedBetweenThreads(false);
+
+		printf("btstress: %d threads, %d parses each, %.3f sec, %ld failed, %ld different\n",
+			   _nr_threads, _nr_parses, time, _nr_failed, _nr_different);
+	}
+
+private:
+	struct Worker
+	{
+		BTStress* stress;
+		BTParser parser;
+		AbstractScanner* scanner;
+		Thread thread;
+	};
+
+	static void work(void* data)
+	{
+		Worker* worker = (Worker*)data;
+		BTStress* stress = worker->stress;
+		for (int k = 0; k < stress->_nr_parses; k++)
+		{
+			AbstractParseTree tree;
+			if (!worker->parser.parse(stress->_text, "root", tree))
+				atomicIncrement(stress->_nr_failed);
+			else if (!equal_trees(tree, stress->_tree))
+				atomicIncrement(stress->_nr_different);
+		}
+	}
+
+	const TextFileBuffer& _text;
+	AbstractParseTree _tree;
+	int _nr_threads;
+	int _nr_parses;
+	volatile long _nr_failed;
+	volatile long _nr_different;
+	Worker* _workers;
+};
+
+class IdentBench
+/*	Benchmark for creating Idents from several threads (option -identbench).
+	All threads create the same Idents, each starting at another one, such
+	that new Idents are added to the store by several threads at the same
+	time. The threads should get the same addresses for the same names.
+*/
+{
+public:
+	IdentBench(int nr_threads, long nr_idents)
+	  : _nr_threads(nr_threads), _nr_idents(nr_idents)
+	{
+		_workers = new Worker[_nr_threads];
+		for (int i = 0; i < _nr_threads; i++)
+		{
+			_workers[i].bench = this;
+			_workers[i].nr = i;
+			_workers[i].ids = new const char*[_nr_idents];
+		}
+	}
+	~IdentBench()
+	{
+		for (int i = 0; i < _nr_threads; i++)
+			delete[] _workers[i].ids;
+		delete[] _workers;
+	}
+
+	void run()
+	{
+		double start_time = wallClockTime();
+		for (int i = 1; i < _nr_threads; i++)
+			if (!_workers[i].thread.start(work, &_workers[i]))
+				fprintf(stderr, "Error: cannot start thread %d\n", i);
+		work(&_workers[0]);
+		for (int i = 1; i < _nr_threads; i++)
+			_workers[i].thread.join();
+		double time = wallClockTime() - start_time;
+
+		bool same = true;
+		for (int i = 1; i < _nr_threads && same; i++)
+			for (long k = 0; k < _nr_idents && same; k++)
+				same = _workers[i].ids[k] == _workers[0].ids[k];
+		printf("identbench: %d threads, %ld idents, %.3f sec, %.2f M per sec, %s\n",
+			   _nr_threads, _nr_idents, time, time > 0.0 ? _nr_threads * _nr_idents / time / 1000000.0 : 0.0,
+			   same ? "same addresses" : "different addresses");
+	}
+
+private:
+	struct Worker
+	{
+		IdentBench* bench;
+		int nr;
+		const char** ids;
+		Thread thread;
+	};
+
+	static void work(void* data)
+	{
+		Worker* worker = (Worker*)data;
+		IdentBench* bench = worker->bench;
+		long start = worker->nr * (bench->_nr_idents / bench->_nr_threads);
+		char name[40];
+		for (long i = 0; i < bench->_nr_idents; i++)
+		{
+			long k = (start + i) % bench->_nr_idents;
+			sprintf(name, "identbench%d_%ld", bench->_nr_threads, k);
+			worker->ids[k] = Ident(name).val();
+		}
+	}
+
+	int _nr_threads;
+	long _nr_idents;
+	Worker* _workers;
+};
+
+class ColourCommandWriter : public AbstractColourAssigner
+/*	Writes the colour commands (option -colour), one per line, with the
+	position where they were reached.
+*/
+{
+public:
+	ColourCommandWriter(FILE* f) : _f(f) {}
+	virtual void operator ()(const TextFilePos& command_pos, GrammarColourCoding* colour_coding)
+	{
+		TextFilePos pos = command_pos;
+		fprintf(_f, "%d.%d $", pos.line(), pos.column());
+		if (colour_coding->type() != ' ')
+			fprintf(_f, "%c", colour_coding->type());
+		if (colour_coding->fg() != -1)
+		{	fprintf(_f, "%06lx", colour_coding->fg());
+			if (colour_coding->bg() != 0)
+				fprintf(_f, ",%06lx", colour_coding->bg());
+		}
+		fprintf(_f, "\n");
+	}
+private:
+	FILE* _f;
+};
+
+static bool equal_colour_commands(const LL1HeapColourParser& parser1, const LL1HeapColourParser& parser2)
+{
+	if (parser1.nrColourCommands() != parser2.nrColourCommands())
+		return false;
+	for (long i = 0; i < parser1.nrColourCommands(); i++)
+	{
+		const LL1HeapColourParser::ColourCommand& command1 = parser1.colourCommand(i);
+		const LL1HeapColourParser::ColourCommand& command2 = parser2.colourCommand(i);
+		TextFilePos pos1 = command1.pos;
+		TextFilePos pos2 = command2.pos;
+		if (   pos1.position() != pos2.position() || pos1.line() != pos2.line() || pos1.column() != pos2.column()
+			|| command1.colour_coding != command2.colour_coding)
+			return false;
+	}
+	return true;
+}
+
+static void recolour_edits(Grammar& grammar, const char* use_scanner, TextFileBuffer& textBuffer, int nr_edits)
+/*	Benchmark for LL1HeapColourParser::recolour (option -recolour). After
+	each of a series of random edits, the text is coloured again with
+	recolour and, for comparison, completely with another parser.
+*/
+{
+	RandomEdits edits(textBuffer, nr_edits);
+
+	AbstractScanner* incrementalScanner = new_scanner(use_scanner);
+	AbstractScanner* scanner = new_scanner(use_scanner);
+
+	LL1HeapColourParser incrementalParser;
+	incrementalParser.setScanner(incrementalScanner);
+	incrementalParser.shareGrammar(grammar);
+	LL1HeapColourParser parser;
+	parser.setScanner(scanner);
+	parser.shareGrammar(grammar);
+
+	TextFileBuffer text;
+	text.assign(edits.text(), edits.length());
+	incrementalParser.parse(text, "root", (AbstractColourAssigner*)0);
+
+	clock_t recolour_time = 0;
+	clock_t max_recolour_time = 0;
+	clock_t colour_time = 0;
+	int nr_different = 0;
+	for (int k = 0; k < nr_edits; k++)
+	{
+		unsigned long edit_start, edit_old_end, edit_new_end;
+		edits.next(edit_start, edit_old_end, edit_new_end);
+		text.assign(edits.text(), edits.length());
+
+		clock_t start_time = clock();
+		bool parsed = incrementalParser.recolour(text, edit_start, edit_old_end, edit_new_end);
+		clock_t time = clock() - start_time;
+		recolour_time += time;
+		if (time > max_recolour_time)
+			max_recolour_time = time;
+
+		start_time = clock();
+		bool full_parsed = parser.parse(text, "root", (AbstractColourAssigner*)0);
+		colour_time += clock() - start_time;
+
+		if (parsed != full_parsed || !equal_colour_commands(incrementalParser, parser))
+			nr_different++;
+	}
+	if (nr_edits > 0)
+	{	printf("recolour: %d edits, %.2f ms per edit (max %.2f ms), colour: %.2f ms per edit, %d different\n",
+			   nr_edits, 1000.0 * recolour_time / CLOCKS_PER_SEC / nr_edits, 1000.0 * max_recolour_time / CLOCKS_PER_SEC,
+			   1000.0 * colour_time / CLOCKS_PER_SEC / nr_edits, nr_different);
+		incrementalParser.printStats(stdout);
+	}
+
+	delete incrementalScanner;
+	delete scanner;
+}
+
 int main(int argc, char *argv[])
 {
 	bool debug_nt = false;
 	bool debug_parse = false;
 	bool debug_scan = false;
 	bool silent = false;
-	const char* constBTStack = "BTStack";
-	const char* constBTHeap = "BTHeap";
-	const char* constLL1Stack = "LL1Stack";
-	const char* constLL1Heap = "LL1Heap";
-	const char* constPar = "Par";
-	const char* constBasic = "Basic";
-	const char* constWhiteSpace = "WhiteSpace";
-	const char* constProtos = "Protos";
-	const char* constResource = "Resource";
-	const char* constPascal = "Pascal";
-	const char* constColourCoding = "ColourCoding";
-	const char* constRaw = "Raw";
-	const char* constBare = "Bare";
+	bool memo_window = false;
+	bool first_sets = true;
+	bool print_stats = false;
+	bool use_arena = false;
+	bool use_mmap = false;
+	int nr_threads = 1;
 	const char *selected_parser = constBTStack;
 	const char* use_scanner = constBasic;
+	const char* selected_encoding = constPlain;
 
     if (argc == 1)
     {   printf("Usage: %s <grammar-file> <input-file>\n"
@@ -435,10 +1145,14 @@ int main(int argc, char *argv[])
 			   "   -plain      read input file verbatim (default)\n"
 			   "   -cp1252     read input file as code page 1252\n"
 			   "   -utf16      read input file as UTF-16\n"
+			   "   -mmap       map plain input files in memory instead of reading them\n"
 			   "   -BTStack    use back-tracking stack parser\n"
 			   "   -BTHeap     use back-tracking heap parser\n"
+			   "   -BTVM       use back-tracking parser on compiled grammar\n"
 			   "   -LL1Stack   use LL1 stack parser\n"
 			   "   -Par        use parallel parser\n"
+			   "   -Adaptive   use back-tracking stack parser that predicts the\n"
+			   "               alternatives with lookahead DFAs\n"
 			   "   -WhiteSpace use white space scanner\n"
 			   "   -Protos     use Protos scanner\n"
 			   "   -Resource   use Resource scanner\n"
@@ -446,11 +1160,47 @@ int main(int argc, char *argv[])
 			   "   -ColourCoding use colour coding scanner\n"
 			   "   -Raw        use raw scanner\n"
 			   "   -Bare       use bare scanner\n"
+			   "   -memowindow discard memo entries behind each completed top-level element\n"
+			   "   -nofirst    do not skip alternatives with the FIRST sets\n"
+			   "   -arena      allocate parse trees from an arena\n"
+			   "   -stats      print parser statistics\n"
+			   "   -j <n>      use n threads for -batch and -Par\n"
+			   "   -batch <out> <fn>  parse all files listed in <fn> (- for stdin),\n"
+			   "               where <out> is p, xml, bin or none, for writing the\n"
+			   "               parse tree of each file to <file>.p, <file>.xml or <file>.bin\n"
 			   "   -p <fn>     print parse tree\n"
 			   "   -pc <fn>    print parse tree (compact)\n"
                "   -xml <fn>   output parse tree as XML\n"
+               "   -streamxml <fn> output parse tree of next input file as XML while\n"
+               "               parsing it (with -memowindow), without keeping the tree;\n"
+               "               <fn> is only written when the input file is parsed\n"
+               "   -bin <fn>   output parse tree as binary file\n"
+               "   -reparse <n> make n single character edits in next input file, and\n"
+               "               parse it again after each, reusing the memo table (BTStack)\n"
+               "   -identbench <n> create n Idents from 1, 4 and 16 threads at the same\n"
+               "               time, comparing times and addresses\n"
+               "   -arenabench <n> parse next input file n times with reference counted\n"
+               "               trees and n times with trees from an arena, comparing times\n"
+               "   -btstress <t> <n> parse next input file n times in each of t threads\n"
+               "               with back-tracking parsers sharing the grammar, comparing\n"
+               "               the trees with that of a sequential parse\n"
+               "   -parscale <n> parse next input file with the parallel parser with\n"
+               "               1, 2, 4, ... up to n threads, comparing times and trees\n"
+               "   -colour <fn> write the colour commands reached in next input file\n"
+               "               (with a grammar parsed with syntax_colour.gr), scanned\n"
+               "               with the raw scanner unless -Bare is given\n"
+               "   -recolour <n> make n single character edits in next input file, and\n"
+               "               colour it again after each, from the last checkpoint\n"
+               "   -pbin <fn> <out> print parse tree from binary file\n"
                "   -o <fn>     output tree to C file\n"
 			   "   -oac <fn>   output grammar to C file\n"
+			   "   -ogp <fn>   output parser for grammar to C++ file\n"
+			   "   -savegrammar <fn> save grammar to binary file\n"
+			   "   -loadgrammar <fn> use grammar from binary file for next input file\n"
+			   "   -checkll1   print the LL(1) conflicts of the grammar: the alternatives,\n"
+			   "               optional elements and sequences that can start with\n"
+			   "               the same character or terminal as another alternative\n"
+			   "               or as what can follow them\n"
 			   "   -unparse <fn> unparses the parse tree\n"
                "   +ds         debug scanning (full)\n"
                //"   +dss      debug scanning (normal)\n"
@@ -462,14 +1212,8 @@ int main(int argc, char *argv[])
         return 0;
     }
 
-	PlainFileReader plainFileReader;
+	FileReaders fileReaders;
 	CodePage1252 codePage1252;
-	CodePageToUF8ConverterStream codePage1252ToUF8ConverterStream(codePage1252);
-	ConverterFileReader codePage1252FileReader(codePage1252ToUF8ConverterStream);
-	UTF16ToUTF8ConverterStream utf16ToUTF8ConverterStream;
-	ConverterFileReader utf16FileReader(utf16ToUTF8ConverterStream);
-	AbstractFileReader *selected_file_reader = &plainFileReader;
-
 	UTF8ToCodePageConverterStream utf8ToCodePageConverterStream(codePage1252);
 	UTF8ToUTF16ConverterStream utf8ToUTF16ConverterStream;
 	ConverterStream<char, char> *selected_output_converter = 0;
@@ -477,6 +1221,19 @@ int main(int argc, char *argv[])
 	AbstractParseTree grammarTree;
 	AbstractParseTree tree;
 	init_IParse_grammar(tree);
+	AbstractParseTreeArena *grammarTreeArena = 0;
+	AbstractParseTreeArena *treeArena = 0;
+	Grammar *loaded_grammar = 0;
+	const char *loaded_grammar_source = 0; // the grammar text of loaded_grammar
+	const char *tree_source = 0; // the file of which tree is the parse tree
+	const char *stream_xml_name = 0;
+	int nr_reparse_edits = 0;
+	int max_par_scale_threads = 0;
+	int nr_arena_bench_parses = 0;
+	int nr_bt_stress_threads = 0;
+	int nr_bt_stress_parses = 0;
+	const char *colour_name = 0;
+	int nr_recolour_edits = 0;
 
     for (int i = 1; i < argc; i++)
     {   char *arg = argv[i];
@@ -497,29 +1254,33 @@ int main(int argc, char *argv[])
 			;
 		else if (!strcmp(arg, "-plain"))
 		{
-			selected_file_reader = &plainFileReader;
+			selected_encoding = constPlain;
 			selected_output_converter = 0;
 		}
 		else if (!strcmp(arg, "-cp1252"))
 		{
-			selected_file_reader = &codePage1252FileReader;
+			selected_encoding = constCP1252;
 			selected_output_converter = &utf8ToCodePageConverterStream;
 		}
 		else if (!strcmp(arg, "-utf16"))
 		{
-			selected_file_reader = &utf16FileReader;
+			selected_encoding = constUTF16;
 			selected_output_converter = &utf8ToUTF16ConverterStream;
 		}
 		else if (!strcmp(arg, "-BTStack"))
 			selected_parser = constBTStack;
         else if (!strcmp(arg, "-BTHeap"))
 			selected_parser = constBTHeap;
+		else if (!strcmp(arg, "-BTVM"))
+			selected_parser = constBTVM;
 		else if (!strcmp(arg, "-LL1Stack"))
 			selected_parser = constLL1Stack;
 		else if (!strcmp(arg, "-LL1Heap"))
 			selected_parser = constLL1Heap;
 		else if (!strcmp(arg, "-Par"))
 			selected_parser = constPar;
+		else if (!strcmp(arg, "-Adaptive"))
+			selected_parser = constAdaptive;
         else if (!strcmp(arg, "-WhiteSpace"))
 		{
 			use_scanner = constWhiteSpace;
@@ -548,6 +1309,53 @@ int main(int argc, char *argv[])
 		{
 			use_scanner = constBare;
 		}
+        else if (!strcmp(arg, "-memowindow"))
+			memo_window = true;
+        else if (!strcmp(arg, "-nofirst"))
+			first_sets = false;
+        else if (!strcmp(arg, "-arena"))
+			use_arena = true;
+		else if (!strcmp(arg, "-mmap"))
+		{
+			use_mmap = true;
+			fileReaders.setMmap(true);
+		}
+        else if (!strcmp(arg, "-stats"))
+			print_stats = true;
+		else if (!strcmp(arg, "-j") && i + 1 < argc)
+		{
+			nr_threads = atoi(argv[++i]);
+			if (nr_threads < 1)
+				nr_threads = 1;
+		}
+		else if (!strcmp(arg, "-batch") && i + 2 < argc)
+		{
+			const char* output = argv[++i];
+			const char* list_name = argv[++i];
+			FILE *flist = !strcmp(list_name, "-") ? stdin : fopen(list_name, "rt");
+			if (flist == 0)
+			{	printf("Cannot open: %s\n", list_name);
+				return 0;
+			}
+			BatchParser batchParser(output, memo_window, first_sets, use_arena, use_mmap);
+			char line[1000];
+			while (fgets(line, 1000, flist) != 0)
+			{
+				int len = strlen(line);
+				while (len > 0 && (line[len-1] == '\n' || line[len-1] == '\r'))
+					line[--len] = '\0';
+				if (len > 0)
+					batchParser.addFile(line);
+			}
+			if (flist != stdin)
+				fclose(flist);
+
+			/* The parallel parser uses global data */
+			batchParser.run(selected_parser == constPar ? 1 : nr_threads, tree, loaded_grammar, selected_parser, use_scanner, selected_encoding);
+			loaded_grammar = 0;
+			if (!silent)
+				printf("Parsed %ld files, %ld failed\n", batchParser.nrFiles(), batchParser.nrFailed());
+		}
         else if (!strcmp(arg, "-p"))
         {   
             char *file_name = argv[++i];
@@ -615,6 +1423,169 @@ int main(int argc, char *argv[])
                 return 0;
             }
         }
+        else if (!strcmp(arg, "-ogp") && i + 1 < argc)
+        {   
+            char *file_name = argv[++i];
+            FILE *fout = !strcmp(file_name, "-") 
+                         ? stdout : fopen(file_name, "wt");
+
+            if (fout != 0)
+            {   char *class_name = file_name;
+                for (char *s = file_name; *s != '\0'; s++)
+                    if (*s == '/' || *s == '\\')
+                        class_name = s + 1;
+                char *dot = strstr(class_name, ".");
+                if (dot)
+                    *dot = '\0';
+
+				Grammar grammar;
+				grammar.loadGrammar(tree);
+				ParserGenerator parserGenerator(grammar, fout);
+				parserGenerator.generate(class_name);
+                fclose(fout);
+            }
+            else
+            {   printf("Cannot open: %s\n", file_name);
+                return 0;
+            }
+        }
+        else if (!strcmp(arg, "-savegrammar") && i + 1 < argc)
+        {
+            char *file_name = argv[++i];
+            FILE *fout = fopen(file_name, "wb");
+
+            if (fout != 0)
+            {
+				Grammar grammar;
+				if (loaded_grammar != 0)
+					grammar.shareGrammar(*loaded_grammar);
+				else
+					grammar.loadGrammar(tree);
+				GrammarFileWriter grammarFileWriter(grammar, loaded_grammar != 0 ? loaded_grammar_source : tree_source, file_name);
+				if (!grammarFileWriter.write(fout))
+					printf("Cannot write: %s\n", file_name);
+                fclose(fout);
+            }
+            else
+            {   printf("Cannot open: %s\n", file_name);
+                return 0;
+            }
+        }
+        else if (!strcmp(arg, "-checkll1"))
+        {
+			Grammar grammar;
+			if (loaded_grammar != 0)
+				grammar.shareGrammar(*loaded_grammar);
+			else
+				grammar.loadGrammar(tree);
+			grammar.printConflicts(stdout);
+        }
+        else if (!strcmp(arg, "-streamxml") && i + 1 < argc)
+			stream_xml_name = argv[++i];
+        else if (!strcmp(arg, "-reparse") && i + 1 < argc)
+			nr_reparse_edits = atoi(argv[++i]);
+        else if (!strcmp(arg, "-identbench") && i + 1 < argc)
+		{
+			long nr_idents = atol(argv[++i]);
+			for (int nr_bench_threads = 1; nr_bench_threads <= 16; nr_bench_threads *= 4)
+			{
+				IdentBench identBench(nr_bench_threads, nr_idents);
+				identBench.run();
+			}
+		}
+        else if (!strcmp(arg, "-btstress") && i + 2 < argc)
+		{
+			nr_bt_stress_threads = atoi(argv[++i]);
+			nr_bt_stress_parses = atoi(argv[++i]);
+		}
+        else if (!strcmp(arg, "-arenabench") && i + 1 < argc)
+			nr_arena_bench_parses = atoi(argv[++i]);
+        else if (!strcmp(arg, "-parscale") && i + 1 < argc)
+			max_par_scale_threads = atoi(argv[++i]);
+        else if (!strcmp(arg, "-colour") && i + 1 < argc)
+			colour_name = argv[++i];
+        else if (!strcmp(arg, "-recolour") && i + 1 < argc)
+			nr_recolour_edits = atoi(argv[++i]);
+        else if (!strcmp(arg, "-loadgrammar") && i + 1 < argc)
+        {
+            char *file_name = argv[++i];
+            FILE *fin = fopen(file_name, "rb");
+
+            if (fin != 0)
+            {
+				/* The grammar is never freed, like the grammars of the parsers */
+				TextFileBuffer grammarBuffer;
+				MmapFileReader mmapFileReader;
+				mmapFileReader.read(fin, grammarBuffer);
+                fclose(fin);
+				loaded_grammar = new Grammar;
+				GrammarFileReader grammarFileReader(*loaded_grammar, file_name);
+				bool valid = grammarFileReader.read(grammarBuffer, grammarBuffer.length());
+				if (grammarFileReader.isStale())
+				{   printf("Grammar file is older than %s: %s\n", grammarFileReader.sourceName(), file_name);
+					return 0;
+				}
+				if (valid && grammarFileReader.sourceName() != 0 && !grammarFileReader.sourceFound())
+					printf("Warning: cannot find %s, not checked whether grammar file is up to date: %s\n",
+						   grammarFileReader.sourceName(), file_name);
+				loaded_grammar_source = grammarFileReader.sourceName() != 0 ? Ident(grammarFileReader.sourceName()).val() : 0;
+				grammarBuffer.release();
+				if (!valid)
+				{   printf("Not a valid grammar file: %s\n", file_name);
+					return 0;
+				}
+            }
+            else
+            {   printf("Cannot open: %s\n", file_name);
+                return 0;
+            }
+        }
+        else if (!strcmp(arg, "-bin") && i + 1 < argc)
+        {
+            char *file_name = argv[++i];
+            FILE *fout = fopen(file_name, "wb");
+
+            if (fout != 0)
+            {
+				TreeFileWriter treeFileWriter;
+				if (!treeFileWriter.write(fout, tree))
+					printf("Cannot write: %s\n", file_name);
+                fclose(fout);
+            }
+            else
+            {   printf("Cannot open: %s\n", file_name);
+                return 0;
+            }
+        }
+        else if (!strcmp(arg, "-pbin") && i + 2 < argc)
+        {
+            char *file_name = argv[++i];
+            char *out_name = argv[++i];
+            FILE *fin = fopen(file_name, "rb");
+
+            if (fin != 0)
+            {
+				TreeFile treeFile;
+				bool valid = treeFile.open(fin);
+                fclose(fin);
+				if (!valid)
+				{   printf("Not a valid tree file: %s\n", file_name);
+					return 0;
+				}
+				FILE *fout = !strcmp(out_name, "-") ? stdout : fopen(out_name, "wt");
+				if (fout == 0)
+				{   printf("Cannot open: %s\n", out_name);
+					return 0;
+				}
+				treeFile.root().print(fout, false);
+				if (fout != stdout)
+					fclose(fout);
+            }
+            else
+            {   printf("Cannot open: %s\n", file_name);
+                return 0;
+            }
+        }
         else if (!strcmp(arg, "-xml") && i + 1 < argc)
         {
             char *file_name = argv[++i];
@@ -626,7 +1597,8 @@ int main(int argc, char *argv[])
                 if (dot)
                     *dot = '\0';
 
-                print_tree_to_xml(fout, tree);
+                XMLTreeStream xmlTreeStream(fout);
+                xmlTreeStream.stream(tree);
                 fclose(fout);
             }
             else
@@ -724,46 +1696,184 @@ int main(int argc, char *argv[])
             if (fin != 0)
             {
 				TextFileBuffer textBuffer;
-				selected_file_reader->read(fin, textBuffer);
-
-				AbstractParser* parser =   selected_parser == constBTHeap 
-					                     ? (AbstractParser*)new BTHeapParser()
-										 : selected_parser == constBTStack
-										 ? (AbstractParser*)new BTParser()
-										 : selected_parser == constLL1Heap 
-					                     ? (AbstractParser*)new LL1HeapParser()
-										 : selected_parser == constLL1Stack 
-					                     ? (AbstractParser*)new LL1Parser()
-										 : (AbstractParser*)new ParParser();
-				AbstractScanner* scanner = use_scanner == constWhiteSpace
-										 ? (AbstractScanner*)new WhiteSpaceScanner()
-										 : use_scanner == constProtos
-										 ? (AbstractScanner*)new ProtosScanner()
-										 : use_scanner == constResource
-										 ? (AbstractScanner*)new ResourceScanner()
-										 : use_scanner == constPascal
-										 ? (AbstractScanner*)new PascalScanner()
-										 : use_scanner == constColourCoding
-										 ? (AbstractScanner*)new ColourCodingScanner()
-										 : use_scanner == constRaw
-										 ? (AbstractScanner*)new RawScanner()
-										 : use_scanner == constBare
-										 ? (AbstractScanner*)new BareScanner()
-										 : (AbstractScanner*)new BasicScanner();
+				fileReaders.reader(selected_encoding)->read(fin, textBuffer);
+
+				if (colour_name != 0 || nr_recolour_edits > 0)
+				{
+					/* The grammar remains the current tree, for colouring other files.
+					   A colour grammar describes the text character by character,
+					   hence the text is scanned with the raw scanner, unless the
+					   bare scanner is selected. */
+					const char* colour_scanner = use_scanner == constBare ? constBare : constRaw;
+					LL1HeapColourParser colourParser;
+					AbstractScanner* scanner = new_scanner(colour_scanner);
+					colourParser.setScanner(scanner);
+					colourParser.setDebugLevel(debug_nt, debug_parse, debug_scan);
+					if (loaded_grammar != 0)
+						colourParser.shareGrammar(*loaded_grammar);
+					else
+						colourParser.loadGrammar(tree);
+					loaded_grammar = 0;
+					FILE *fout = 0;
+					if (colour_name != 0)
+					{
+						fout = !strcmp(colour_name, "-") ? stdout : fopen(colour_name, "w");
+						if (fout == 0)
+						{   printf("Cannot open: %s\n", colour_name);
+							return 0;
+						}
+					}
+					ColourCommandWriter colourCommandWriter(fout);
+					clock_t start_time = clock();
+					bool parsed = colourParser.parse(textBuffer, "root", fout != 0 ? &colourCommandWriter : 0);
+					if (fout != 0 && fout != stdout)
+						fclose(fout);
+					colour_name = 0;
+					if (!parsed)
+						colourParser.printExpected(stdout, filename, textBuffer);
+					if (print_stats)
+					{
+						printf("colour time: %.3f sec\n", (double)(clock() - start_time) / CLOCKS_PER_SEC);
+						colourParser.printStats(stdout);
+						scanner->printStats(stdout);
+					}
+					if (nr_recolour_edits > 0)
+					{
+						recolour_edits(colourParser, colour_scanner, textBuffer, nr_recolour_edits);
+						nr_recolour_edits = 0;
+					}
+					delete scanner;
+					textBuffer.release();
+					fclose(fin);
+					continue;
+				}
+
+				AbstractParser* parser = new_parser(selected_parser);
+				AbstractScanner* scanner = new_scanner(use_scanner);
 				parser->setScanner(scanner);
+				if (selected_parser == constPar)
+					for (int j = 1; j < nr_threads; j++)
+						((ParParser*)parser)->addScanner(new_scanner(use_scanner));
 				parser->setDebugLevel(debug_nt, debug_parse, debug_scan);
-				parser->loadGrammar(tree);
+				parser->setMemoWindow(memo_window || stream_xml_name != 0);
+				parser->setFirstSets(first_sets);
+				/* The tree is streamed to a temporary file, which replaces the
+				   output file when the streamed tree is complete */
+				FILE *fstream = 0;
+				char *stream_tmp_name = 0;
+				if (stream_xml_name != 0)
+				{
+					if (!strcmp(stream_xml_name, "-"))
+						fstream = stdout;
+					else
+					{
+						stream_tmp_name = new char[strlen(stream_xml_name) + 5];
+						strcpy(stream_tmp_name, stream_xml_name);
+						strcat(stream_tmp_name, ".tmp");
+						fstream = fopen(stream_tmp_name, "w");
+					}
+					if (fstream == 0)
+					{   printf("Cannot open: %s\n", stream_tmp_name);
+						return 0;
+					}
+				}
+				XMLTreeStream xmlTreeStream(fstream);
+				if (fstream != 0)
+					parser->setTreeStream(&xmlTreeStream);
+				if (loaded_grammar != 0)
+					parser->shareGrammar(*loaded_grammar);
+				else
+					parser->loadGrammar(tree);
+				loaded_grammar = 0;
 				grammarTree = tree;
+				if (grammarTreeArena != treeArena)
+					delete grammarTreeArena;
+				grammarTreeArena = treeArena;
+
+				AbstractParseTreeArena *newTreeArena = use_arena ? new AbstractParseTreeArena() : 0;
+				parser->setTreeArena(newTreeArena);
 
+				clock_t start_time = clock();
 				AbstractParseTree new_tree;
-				if (!parser->parse(textBuffer, "root", new_tree))
+				bool parsed = parser->parse(textBuffer, "root", new_tree);
+				if (fstream != 0)
+				{
+					bool streamed = parsed && parser->endTreeStream(new_tree);
+					if (parsed && !streamed && fstream != stdout)
+					{
+						/* The parser back-tracked over elements that were
+						   streamed already: write the whole tree instead */
+						parser->setTreeStream(0);
+						parser->setMemoWindow(memo_window);
+						parsed = parser->parse(textBuffer, "root", new_tree);
+						fclose(fstream);
+						fstream = parsed ? fopen(stream_tmp_name, "w") : 0;
+						if (fstream != 0)
+						{
+							XMLTreeStream wholeTreeStream(fstream);
+							wholeTreeStream.stream(new_tree);
+							streamed = true;
+						}
+					}
+					else if (parsed && !streamed)
+						printf("Streamed parse tree is not valid: %s\n", stream_xml_name);
+					if (stream_tmp_name != 0)
+					{
+						if (fstream != 0)
+							fclose(fstream);
+						if (streamed)
+						{
+							remove(stream_xml_name);
+							if (rename(stream_tmp_name, stream_xml_name) != 0)
+								printf("Cannot write: %s\n", stream_xml_name);
+						}
+						else
+							remove(stream_tmp_name);
+						delete[] stream_tmp_name;
+					}
+					stream_xml_name = 0;
+				}
+				if (!parsed)
 				{
 					parser->printExpected(stdout, filename, textBuffer);
 					return 0;
 				}
+				if (print_stats)
+				{
+					printf("parse time: %.3f sec\n", (double)(clock() - start_time) / CLOCKS_PER_SEC);
+					parser->printStats(stdout);
+					scanner->printStats(stdout);
+					if (newTreeArena != 0)
+						printf("arena: %lu bytes\n", newTreeArena->nrBytes());
+				}
+				if (nr_reparse_edits > 0)
+				{
+					reparse_edits(*parser, use_scanner, first_sets, textBuffer, nr_reparse_edits);
+					nr_reparse_edits = 0;
+				}
+				if (nr_arena_bench_parses > 0)
+				{
+					arena_bench(*parser, selected_parser, use_scanner, first_sets, textBuffer, nr_arena_bench_parses);
+					nr_arena_bench_parses = 0;
+				}
+				if (nr_bt_stress_threads > 0)
+				{
+					BTStress btStress(*parser, use_scanner, first_sets, textBuffer, nr_bt_stress_threads, nr_bt_stress_parses);
+					btStress.run();
+					nr_bt_stress_threads = 0;
+				}
+				if (max_par_scale_threads > 0)
+				{
+					par_scale(*parser, use_scanner, textBuffer, max_par_scale_threads);
+					max_par_scale_threads = 0;
+				}
+				delete parser;
+				delete scanner;
 				textBuffer.release();
 
                	tree.attach(new_tree);
+				treeArena = newTreeArena;
+				tree_source = filename;
 
                 fclose(fin);
             }
@@ -775,6 +1885,10 @@ int main(int argc, char *argv[])
     }
 
 	tree.clear();
+	grammarTree.clear();
+	if (grammarTreeArena != treeArena)
+		delete grammarTreeArena;
+	delete treeArena;
 
     return 0;
 }
@@ -254,12 +254,12 @@ bool IParser::parse_rule(GrammarRule* rule, ParsedValue* prev_parts, const Ident
     chain_sym = rule->chain_symbol;
 
     /* Did we fail the last time at this position? */
-    if (rule->last_fail_pos == _text.position())
+    if (_fail_pos[rule->nr] == (long)_text.position())
     {
         DEBUG_EXIT("parse_rule - BREAK "); DEBUG_NL;
         return false;
     }
-    last_fail_pos = &rule->last_fail_pos;
+    last_fail_pos = &_fail_pos[rule->nr];
 
     sp = _text;
     _current_rule = rule;
@@ -546,6 +546,7 @@ bool IParser::parse(const TextFileBuffer& textBuffer, Ident root_id, AbstractPar
 	_text = textBuffer;
 	_f_file_pos = _text;
 	_nr_exp_syms = 0;
+	init_fail_pos();
 	
 	init_solutions();
 
@@ -554,6 +555,7 @@ bool IParser::parse(const TextFileBuffer& textBuffer, Ident root_id, AbstractPar
 	bool try_it = parse_nt(find_nt(root_id), result);
 
 	free_solutions();
+	_scanner->doneScanning();
 		
 	return try_it;
 }
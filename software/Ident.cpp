@@ -18,29 +18,50 @@ const char* strcopy(const char *s)
 	return result;
 }
 
+/*	New nodes are added to the hash tree with an atomic compare-and-swap,
+	such that Idents can be created from several threads at the same time.
+*/
+#ifdef WIN32
+#include <windows.h>
+#define CAS_NODE(R,O,N) (InterlockedCompareExchangePointer((PVOID volatile*)(R), (N), (O)) == (O))
+#define LOAD_NODE(R) (*(R))
+#else
+#define CAS_NODE(R,O,N) __sync_bool_compare_and_swap((R), (O), (N))
+#define LOAD_NODE(R) __atomic_load_n((R), __ATOMIC_ACQUIRE)
+#endif
+
 const char* Ident::ident_unify(const char* id) const
 /*	Returns a unique address representing the string. If
 	the string does not occure in the store, it is added.
+	Nodes are never removed from the store, and a node is
+	only replaced by a node with children (containing it)
+	using a compare-and-swap. Hence searching the store
+	does not need any locking. When the compare-and-swap
+	fails, because another thread changed the same place,
+	the step is simply repeated.
 */
 {
-	static hexa_hash_tree_p hash_tree = 0;
-	hexa_hash_tree_p *r_node = &hash_tree;
+	static hexa_hash_tree_p volatile hash_tree = 0;
+	hexa_hash_tree_p volatile *r_node = &hash_tree;
 	const char *vs = id;
-	int depth;
+	int depth = 0;
 	int mode = 0;
 	
 	if (*id == '\0')
 		return _empty;
 
-	for (depth = 0; ; depth++)
-	{	hexa_hash_tree_p node = *r_node;
+	for (;;)
+	{	hexa_hash_tree_p node = LOAD_NODE(r_node);
 
 		if (node == 0)
 		{	node = new hexa_hash_tree_t();
 			node->has_children = false;
 			node->data.string = strcopy(id);
-			*r_node = node;
-			return node->data.string;
+			if (CAS_NODE(r_node, (hexa_hash_tree_p)0, node))
+				return node->data.string;
+			delete[] node->data.string;
+			delete node;
+			continue;
 		}
 
 		if (!node->has_children)
@@ -63,10 +84,15 @@ const char* Ident::ident_unify(const char* id) const
 
 			children[v] = node;
 
-			node = new hexa_hash_tree_t;
-			node->has_children = true;
-			node->data.children = children;
-			*r_node = node;
+			hexa_hash_tree_p new_node = new hexa_hash_tree_t;
+			new_node->has_children = true;
+			new_node->data.children = children;
+			if (!CAS_NODE(r_node, node, new_node))
+			{	delete[] children;
+				delete new_node;
+				continue;
+			}
+			node = new_node;
 		}
 		{	unsigned short v;
 			if (*vs == '\0')
@@ -77,13 +103,17 @@ const char* Ident::ident_unify(const char* id) const
 				}
 			}
 			else if (mode == 0)
-				v = ((unsigned short)*vs++) & 15;
+				v = ((unsigned char)*vs++) & 15;
 			else
-				v = ((unsigned short)*vs++) >> 4;
+				v = ((unsigned char)*vs++) >> 4;
 
 			r_node = &node->data.children[v];
+			depth++;
 		}
 	}
 }
 
+#undef CAS_NODE
+#undef LOAD_NODE
+
 const char* Ident::_empty = "";
@@ -7,21 +7,14 @@
 #include "TextFileBuffer.h"
 #include "Scanner.h"
 #include "AbstractParser.h"
-#include "ParseSolution.h"
 #include "LL1HeapColourParser.h"
 
 
 #define DEBUG_ENTER(X) if (_parser->_debug_parse) { DEBUG_TAB; printf("Enter: %s", X); _parser->_depth += 2; }
-#define DEBUG_ENTER_P1(X,A) if (_parser->_debug_parse) { DEBUG_TAB; printf("Enter: "); printf(X,A); _parser->_depth += 2; }
 #define DEBUG_EXIT(X) if (_parser->_debug_parse) { _parser->_depth -=2; DEBUG_TAB; printf("Leave: %s", X); }
-#define DEBUG_EXIT_P1(X,A) if (_parser->_debug_parse) { _parser->_depth -=2; DEBUG_TAB; printf("Leave: "); printf(X,A); }
 #define DEBUG_TAB if (_parser->_debug_parse) printf("%*.*s", _parser->_depth, _parser->_depth, "")
 #define DEBUG_NL if (_parser->_debug_parse) printf("\n")
-#define DEBUG_PT(X) if (_parser->_debug_parse) X.print(stdout, true)
-#define DEBUG_PO(X) if (_parser->_debug_parse) X->print(stdout)
 #define DEBUG_PR(X) if (_parser->_debug_parse) X->print(stdout)
-#define DEBUG_(X)  if (_parser->_debug_parse) printf(X)
-#define DEBUG_P1(X,A) if (_parser->_debug_parse) printf(X,A)
 
 
 
@@ -31,7 +24,7 @@ bool LL1HeapColourParser::parse_term( GrammarTerminal* term )
 
 	if (_debug_scan)
 		printf("%d.%d: acceptTerminal(%s)\n", start_pos.line(), start_pos.column(), term->name.val());
-	
+
 	AbstractParseTree tree;
 	bool try_it = _scanner->acceptTerminal(_text, term->name, tree);
 	if (!try_it)
@@ -46,7 +39,7 @@ bool LL1HeapColourParser::parse_term( GrammarTerminal* term )
 	    else
 	    	printf("%d.%d: acceptTerminal(%s) failed at '%s'\n", start_pos.line(), start_pos.column(), term->name.val(), _text.start());
 	}
-	
+
 	return try_it;
 }
 
@@ -56,7 +49,7 @@ bool LL1HeapColourParser::parse_ws_term( GrammarTerminal* term )
 
 	if (_debug_scan)
 		printf("%d.%d: acceptWhiteSpace(%s)\n", start_pos.line(), start_pos.column(), term->name.val());
-	
+
 	bool try_it = _scanner->acceptWhiteSpace(_text, term->name);
 	if (!try_it)
 		expected_string(term->name.val(), false);
@@ -64,33 +57,68 @@ bool LL1HeapColourParser::parse_ws_term( GrammarTerminal* term )
 	if (_debug_scan)
 	{
 		if (try_it)
-			printf("%d.%d: acceptWhiteSpacel(%s)\n", start_pos.line(), start_pos.column(), term->name.val());
+			printf("%d.%d: acceptWhiteSpace(%s)\n", start_pos.line(), start_pos.column(), term->name.val());
 	    else
-	    	printf("%d.%d: acceptWhiteSpacel(%s) failed at '%s'\n", start_pos.line(), start_pos.column(), term->name.val(), _text.start());
+	    	printf("%d.%d: acceptWhiteSpace(%s) failed at '%s'\n", start_pos.line(), start_pos.column(), term->name.val(), _text.start());
 	}
-	
+
 	return try_it;
 }
-       
+
 bool LL1HeapColourParser::parse_ident(GrammarIdent* ident)
-{	
+{
 	AbstractParseTree tree;
 	bool try_it = _scanner->acceptTerminal(_text, ident->terminal->name, tree);
 	if (!try_it)
 		expected_string(ident->terminal->name.val(), false);
-	
+
 	return try_it;
 }
 
+#define PK_NT		1
+#define PK_OR_RULE	2
+#define PK_RULE		3
+
+/*	A process parses a non-terminal, a group of alternatives or a rule.
+	It calls a sub process and returns, after which it is executed again
+	when the sub process has exited, with the result in _parser->_result.
+	Apart from the sub process on the stack, a process holds no pointers
+	to data of the parse, such that a copy of the stack can continue the
+	parse from the same state (see LL1HeapColourParser::add_checkpoint).
+*/
+
 class LL1HeapColourParseProcess
 {
 	friend class LL1HeapColourParser;
+	friend class LL1HeapColourParseNTProcess;
+	friend class LL1HeapColourParseOrRuleProcess;
+	friend class LL1HeapColourParseRuleProcess;
 public:
-	LL1HeapColourParseProcess(LL1HeapColourParser* parser) : _parser(parser), _state(0), _parent_process(0) {}
+	LL1HeapColourParseProcess(LL1HeapColourParser* parser, int kind)
+	  : _kind(kind), _state(0), _parser(parser), _sub_process(0), _start_mark(0), _parent_process(0) {}
+	virtual ~LL1HeapColourParseProcess() {}
 	virtual void execute() = 0;
+	virtual LL1HeapColourParseProcess* copy() = 0;
+	// Whether the process is in the same state as the given process:
+	virtual bool same(LL1HeapColourParseProcess* process) = 0;
+	/* When the sub process fails and the process does not fail as well,
+	   but continues parsing, returns the position the text is set back
+	   to and the number of colour commands that are kept. */
+	virtual bool continuation(LL1HeapColourParseProcess* sub_process, TextFilePos*& pos, long*& mark) = 0;
+	virtual void move(LL1HeapColourParser* parser, long old_nr_commands)
+	{
+		parser->move_position(_start_pos);
+		_start_mark = parser->move_mark(_start_mark, old_nr_commands);
+	}
 protected:
+	int _kind;
 	int _state;
 	LL1HeapColourParser* _parser;
+	LL1HeapColourParseProcess* _sub_process;
+	// where the process started, to which it sets back the text and the
+	// colour commands when it fails:
+	TextFilePos _start_pos;
+	long _start_mark;
 private:
 	LL1HeapColourParseProcess* _parent_process;
 };
@@ -98,85 +126,104 @@ private:
 class LL1HeapColourParseNTProcess : public LL1HeapColourParseProcess
 {
 public:
-	LL1HeapColourParseNTProcess(LL1HeapColourParser* parser, GrammarNonTerminal* non_term, bool &result)
-		: LL1HeapColourParseProcess(parser), _non_term(non_term), _result(result) {}
+	LL1HeapColourParseNTProcess(LL1HeapColourParser* parser, GrammarNonTerminal* non_term)
+		: LL1HeapColourParseProcess(parser, PK_NT), _non_term(non_term), _or_rule(0), _recursive(false) {}
 
 	virtual void execute();
+	virtual LL1HeapColourParseProcess* copy() { return new LL1HeapColourParseNTProcess(*this); }
+	virtual bool same(LL1HeapColourParseProcess* process)
+	{
+		if (process->_kind != _kind || process->_state != _state)
+			return false;
+		LL1HeapColourParseNTProcess* nt_process = (LL1HeapColourParseNTProcess*)process;
+		return    nt_process->_non_term == _non_term && nt_process->_or_rule == _or_rule
+			   && nt_process->_recursive == _recursive;
+	}
+	virtual bool continuation(LL1HeapColourParseProcess* sub_process, TextFilePos*& pos, long*& mark)
+	{
+		if (sub_process == 0 || !(_recursive || _or_rule->next != 0))
+			return false;
+		pos = &sub_process->_start_pos;
+		mark = &sub_process->_start_mark;
+		return true;
+	}
 
 private:
-	// parametes:
+	// parameters:
 	GrammarNonTerminal* _non_term;
-	bool &_result;
 	// locals:
 	GrammarOrRule* _or_rule;
+	bool _recursive;
 	Ident _surr_nt;
-	Ident _nt;
-	//ParseSolution* _sol;
-	LL1HeapColourParseProcess* _sub_process;
-	bool _sub_result;
 };
 
 class LL1HeapColourParseOrRuleProcess : public LL1HeapColourParseProcess
 {
 public:
-	LL1HeapColourParseOrRuleProcess(LL1HeapColourParser* parser, GrammarOrRule* or_rule, bool &result)
-		: LL1HeapColourParseProcess(parser), _or_rule(or_rule), _result(result) {}
+	LL1HeapColourParseOrRuleProcess(LL1HeapColourParser* parser, GrammarOrRule* or_rule)
+		: LL1HeapColourParseProcess(parser, PK_OR_RULE), _or_rule(or_rule) {}
 
 	virtual void execute();
+	virtual LL1HeapColourParseProcess* copy() { return new LL1HeapColourParseOrRuleProcess(*this); }
+	virtual bool same(LL1HeapColourParseProcess* process)
+	{
+		return    process->_kind == _kind && process->_state == _state
+			   && ((LL1HeapColourParseOrRuleProcess*)process)->_or_rule == _or_rule;
+	}
+	virtual bool continuation(LL1HeapColourParseProcess* sub_process, TextFilePos*& pos, long*& mark)
+	{
+		if (sub_process == 0 || _or_rule->next == 0)
+			return false;
+		pos = &sub_process->_start_pos;
+		mark = &sub_process->_start_mark;
+		return true;
+	}
 
 private:
-	// parameters:
+	// parameters (and local):
 	GrammarOrRule* _or_rule;
-	bool &_result;
-	// locals:
-	bool _sub_result;
-	LL1HeapColourParseProcess* _sub_process;
 };
 
 
 class LL1HeapColourParseRuleProcess : public LL1HeapColourParseProcess
 {
 public:
-	LL1HeapColourParseRuleProcess(LL1HeapColourParser* parser, GrammarRule* rule, bool &result)
-		: LL1HeapColourParseProcess(parser), _rule(rule), _result(result) {}
-
-	virtual void execute();
-
-private:
-	// parameters:
-	GrammarRule* _rule;
-	bool &_result;
-	// locals
-	bool _optional;
-	bool _sequential;
-    const char *_chain_sym;
-    //long *_last_fail_pos;
-    //TextFilePos _sp;
-    bool _try_it;
-    TextFilePos _start_pos;
-	LL1HeapColourParseProcess* _sub_process;
-	bool _sub_result;
-};
-
-class LL1HeapColourParseSeqProcess : public LL1HeapColourParseProcess
-{
-public:
-	LL1HeapColourParseSeqProcess(LL1HeapColourParser* parser, GrammarRule* rule, const char *chain_sym, bool &result)
-		: LL1HeapColourParseProcess(parser), _rule(rule), _chain_sym(chain_sym), _result(result) {}
+	LL1HeapColourParseRuleProcess(LL1HeapColourParser* parser, GrammarRule* rule)
+		: LL1HeapColourParseProcess(parser, PK_RULE), _rule(rule), _elem(0), _nr_parsed(0), _elem_mark(0) {}
 
 	virtual void execute();
+	virtual LL1HeapColourParseProcess* copy() { return new LL1HeapColourParseRuleProcess(*this); }
+	virtual bool same(LL1HeapColourParseProcess* process)
+	{
+		if (process->_kind != _kind || process->_state != _state)
+			return false;
+		LL1HeapColourParseRuleProcess* rule_process = (LL1HeapColourParseRuleProcess*)process;
+		return    rule_process->_rule == _rule && rule_process->_elem == _elem
+			   && rule_process->_nr_parsed == _nr_parsed;
+	}
+	virtual bool continuation(LL1HeapColourParseProcess*, TextFilePos*& pos, long*& mark)
+	{
+		if (!(_elem->optional || _nr_parsed > 0))
+			return false;
+		pos = &_elem_pos;
+		mark = &_elem_mark;
+		return true;
+	}
+	virtual void move(LL1HeapColourParser* parser, long old_nr_commands)
+	{
+		LL1HeapColourParseProcess::move(parser, old_nr_commands);
+		parser->move_position(_elem_pos);
+		_elem_mark = parser->move_mark(_elem_mark, old_nr_commands);
+	}
 
 private:
 	// parameters:
 	GrammarRule* _rule;
-	const char *_chain_sym;
-	bool &_result;
 	// locals:
-	//TextFilePos _sp;
-	bool _try_it;
-    TextFilePos _start_pos;
-	LL1HeapColourParseProcess* _sub_process;
-	bool _sub_result;
+	GrammarRule* _elem;
+	long _nr_parsed; // of the sequential element
+	TextFilePos _elem_pos;
+	long _elem_mark;
 };
 
 void LL1HeapColourParseNTProcess::execute()
@@ -186,64 +233,67 @@ void LL1HeapColourParseNTProcess::execute()
 		case 2: goto state2;
 	}
 
+	_start_pos = _parser->_text;
+	_start_mark = _parser->_nr_commands;
 	_surr_nt = _parser->_current_nt;
-	_nt = _non_term->name;
-
-	_parser->_current_nt = _nt;
+	_parser->_current_nt = _non_term->name;
 
 	if (_parser->_debug_nt)
 	{   printf("%*.*s", _parser->_depth, _parser->_depth, "");
-		printf("Enter: %s\n", _nt.val());
-		_parser->_depth += 2; 
+		printf("Enter: %s\n", _non_term->name.val());
+		_parser->_depth += 2;
 	}
 
 	for (_or_rule = _non_term->first; _or_rule != 0; _or_rule = _or_rule->next )
-	{
-		_sub_process = new LL1HeapColourParseRuleProcess(_parser, _or_rule->rule, _sub_result);
-		_parser->call(_sub_process);
-		_state = 1; return; state1:
-		delete _sub_process;
-		if (_sub_result)
-			break;
-	}
-
-	if (_or_rule != 0)
-	{
-		for(;;)
-		{   for (_or_rule = _non_term->recursive; _or_rule != 0; _or_rule = _or_rule->next )
-			{
-				_sub_process = new LL1HeapColourParseRuleProcess(_parser, _or_rule->rule, _sub_result);
-				_parser->call(_sub_process);
-				_state = 2; return; state2:
-				delete _sub_process;
-				if (_sub_result)
-					break;
-			}
-
-			if (_or_rule == 0)
+		if (_parser->may_start(_or_rule->first_set, *_parser->_text))
+		{
+			_sub_process = new LL1HeapColourParseRuleProcess(_parser, _or_rule->rule);
+			_parser->call(_sub_process);
+			_state = 1; return; state1:
+			delete _sub_process;
+			_sub_process = 0;
+			if (_parser->_result)
 				break;
 		}
 
-		DEBUG_EXIT_P1("parse_nt(%s)", _nt.val()); DEBUG_NL;
+	if (_or_rule == 0)
+	{
 		if (_parser->_debug_nt)
 		{   _parser->_depth -= 2;
 			printf("%*.*s", _parser->_depth, _parser->_depth, "");
-			printf("Parsed: %s\n", _nt.val());
+			printf("Failed: %s\n", _non_term->name.val());
 		}
 		_parser->_current_nt = _surr_nt;
-		_result = true;
+		_parser->_result = false;
 		_parser->exit();
 		return;
 	}
-	DEBUG_EXIT_P1("parse_nt(%s) - failed", _nt.val());  DEBUG_NL;
+
+	_recursive = true;
+	for(;;)
+	{   for (_or_rule = _non_term->recursive; _or_rule != 0; _or_rule = _or_rule->next )
+			if (_parser->may_start(_or_rule->first_set, *_parser->_text))
+			{
+				_sub_process = new LL1HeapColourParseRuleProcess(_parser, _or_rule->rule);
+				_parser->call(_sub_process);
+				_state = 2; return; state2:
+				delete _sub_process;
+				_sub_process = 0;
+				if (_parser->_result)
+					break;
+			}
+
+		if (_or_rule == 0)
+			break;
+	}
+
 	if (_parser->_debug_nt)
 	{   _parser->_depth -= 2;
 		printf("%*.*s", _parser->_depth, _parser->_depth, "");
-		printf("Failed: %s\n", _nt.val());
+		printf("Parsed: %s\n", _non_term->name.val());
 	}
 	_parser->_current_nt = _surr_nt;
-	//_sol->success = s_fail;
-	_result = false;
+	_parser->_result = true;
 	_parser->exit();
 }
 
@@ -253,476 +303,676 @@ void LL1HeapColourParseOrRuleProcess::execute()
 		case 1: goto state1;
 	}
 
-	DEBUG_ENTER("parse_or: ");
-	DEBUG_PO(_or_rule); DEBUG_NL;
+	_start_pos = _parser->_text;
+	_start_mark = _parser->_nr_commands;
 
 	for ( ; _or_rule != 0; _or_rule = _or_rule->next )
-	{
-		_sub_process = new LL1HeapColourParseRuleProcess(_parser, _or_rule->rule, _sub_result);
-		_parser->call(_sub_process);
-		_state = 1; return; state1:
-		delete _sub_process;
-		if (_sub_result)
-		{   DEBUG_EXIT("parse_or"); DEBUG_NL;
-			_result = true;
-			_parser->exit();
-			return;
+		if (_parser->may_start(_or_rule->first_set, *_parser->_text))
+		{
+			_sub_process = new LL1HeapColourParseRuleProcess(_parser, _or_rule->rule);
+			_parser->call(_sub_process);
+			_state = 1; return; state1:
+			delete _sub_process;
+			_sub_process = 0;
+			if (_parser->_result)
+			{	_parser->exit();
+				return;
+			}
 		}
-	}
-	DEBUG_EXIT("parse_or: failed"); DEBUG_NL;
-	_result = false;
+
+	_parser->_result = false;
 	_parser->exit();
 }
 
 void LL1HeapColourParseRuleProcess::execute()
-{   
+/*	Parses the elements of the rule one after the other. An optional
+	element that does not match is skipped, and a sequential element
+	takes as many elements as match. When an element does not match, the
+	text and the colour commands are set back to where the element (or
+	the last element of the sequence) started, and when it was not
+	optional, to where the rule started.
+*/
+{
 	switch(_state) {
-		case 2: goto state2;
-		case 3: goto state3;
-		case 4: goto state4;
-		case 5: goto state5;
-		case 6: goto state6;
-		case 7: goto state7;
-		case 8: goto state8;
-		case 9: goto state9;
-		case 10: goto state10;
+		case 1: goto state1;
 	}
 
-	_try_it = false;
-
 	DEBUG_ENTER("parse_rule: ");
 	DEBUG_PR(_rule); DEBUG_NL;
 
-	/* At the end of the rule: */
-	if (_rule == 0)
-	{   DEBUG_EXIT("parse_rule = "); DEBUG_NL;
-		_result = true;
-		_parser->exit();
-		return;
-	}
+	_start_pos = _parser->_text;
+	_start_mark = _parser->_nr_commands;
 
-	_optional = _rule->optional,
-	_sequential = _rule->sequential;
-	_chain_sym = _rule->chain_symbol;
-
-	/* Did we fail the last time at this position? 
-	if (_rule->last_fail_pos == _parser->_text.position())
+	for (_elem = _rule; _elem != 0; _elem = _elem->next)
 	{
-		DEBUG_EXIT("parse_rule - BREAK "); DEBUG_NL;
-		_result = false;
-		_parser->exit();
-		return;
-	}
-	_last_fail_pos = &_rule->last_fail_pos;
-	*/
-
-	//_sp = _parser->_text;
-	_parser->_current_rule = _rule;
-
-	/* Try to accept first symbol */
-	{   _start_pos = _parser->_text;
-
-		switch( _rule->kind )
-		{   case RK_T_EOF:
-        		_try_it = _parser->_scanner->acceptEOF(_parser->_text);
-				if (!_try_it)
-					_parser->expected_string("eof", false);
-        		if (_try_it)
-        		{
-					if (_rule->next == 0)
-					{   DEBUG_EXIT("parse_rule"); DEBUG_NL;
-						_result = true;
-						_parser->exit();
-						return;
-					}
-				}
-				break;
-			case RK_TERM:
-            	_try_it = _parser->parse_term(_rule->text.terminal);
-            	break;
-			case RK_IDENT:
-            	_try_it = _parser->parse_ident(_rule->text.ident);
-            	break;
-			case RK_T_OPENCONTEXT:
-            	_try_it = true;
-            	break;
-			case RK_T_CLOSECONTEXT:
-            	_try_it = true;
-            	break;
-			case RK_NT:
-			case RK_WS_NT:
-				_sub_process = new LL1HeapColourParseNTProcess(_parser, _rule->text.non_terminal, _try_it);
-				_parser->call(_sub_process);
-				_state = 2; return; state2:
-				delete _sub_process;
-				break;
-            case RK_WS_TERM:
-            case RK_LIT:
-			{   if (_rule->kind == RK_LIT ? _parser->_scanner->acceptLiteral(_parser->_text, _rule->str_value) : _parser->parse_ws_term(_rule->text.terminal))
-				{   if (_sequential)
-					{   _sub_process = new LL1HeapColourParseSeqProcess(_parser, _rule, _chain_sym, _sub_result);
-						_parser->call(_sub_process);
-						_state = 3; return; state3:
-						delete _sub_process;
-						if (_sub_result)
-						{   DEBUG_EXIT("parse_rule"); DEBUG_NL;
-							_result = true;
-							_parser->exit();
-							return;
-						}
-					}
-					else
-					{
-						_sub_process = new LL1HeapColourParseRuleProcess(_parser, _rule->next, _sub_result);
-						_parser->call(_sub_process);
-						_state = 4; return; state4:
-						delete _sub_process;
-						if (_sub_result)
-						{   DEBUG_EXIT("parse_rule");DEBUG_NL;
-							_result = true;
-							_parser->exit();
-							return;
-						}
-					}
-				}
-				else if (_optional)
-				{
-					_sub_process = new LL1HeapColourParseRuleProcess(_parser, _rule->next, _sub_result);
-					_parser->call(_sub_process);
-					_state = 5; return; state5:
-					delete _sub_process;
-					if (_sub_result)
-					{   DEBUG_EXIT("parse_rule"); DEBUG_NL;
-						_result = true;
-						_parser->exit();
-						return;
-					}
-					else
-						_parser->expected_string(_rule->str_value.val(), true);
+		_parser->_current_rule = _elem;
+		_nr_parsed = 0;
+		for (;;)
+		{
+			_elem_pos = _parser->_text;
+			_elem_mark = _parser->_nr_commands;
+			if (_nr_parsed > 0)
+			{	const char* chain_sym = _elem->chain_symbol;
+				if (*chain_sym != '\0' && !_parser->_scanner->acceptLiteral(_parser->_text, chain_sym))
+				{	_parser->expected_string(chain_sym, true);
+					break;
 				}
-				else
-					_parser->expected_string(_rule->str_value, true);
-				break;
 			}
-			case RK_CHARSET:
-				_try_it = _rule->text.char_set->contains_char(*_parser->_text);
-				if (!_try_it)
-					_parser->expected_string("<charset>", false);
-				else
-				{
-					_parser->_text.next();
-					_parser->_scanner->skipSpace(_parser->_text);
-				}				
-				break;
-			case RK_AVOID:
-				_try_it = !_rule->text.char_set->contains_char(*_parser->_text);
-				break;
-			case RK_COLOURCODING:
-				_try_it = true;
-				break;
-			case RK_OR_RULE:
-				_sub_process = new LL1HeapColourParseOrRuleProcess(_parser, _rule->text.or_rules->first, _try_it);
-				_parser->call(_sub_process);
-				_state = 6; return; state6:
-				delete _sub_process;
-				break;
-			case RK_COR_RULE:
-				_sub_process = new LL1HeapColourParseOrRuleProcess(_parser, _rule->text.or_rules->first, _result);
-				_parser->call(_sub_process);
-				_state = 7; return; state7:
-				delete _sub_process;
-				if (_result)
-				{   DEBUG_EXIT("parse_rule"); DEBUG_NL;
-				}
-				else
-				{
-					DEBUG_EXIT_P1("parse_rule - failed at %ld", _parser->_text.position()); DEBUG_NL;
-				}
-				_parser->exit();
-				return;
-				break;
-			default:
-				_try_it = false;
-		}
-    
-
-		if (_try_it)
-		{   /* We succeded in parsing the first element */
 
-			if (_sequential)
-			{   _sub_process = new LL1HeapColourParseSeqProcess(_parser, _rule, _chain_sym, _sub_result);
+			_sub_process = _parser->parse_element(_elem);
+			if (_sub_process != 0)
+			{
 				_parser->call(_sub_process);
-				_state = 8; return; state8:
+				_state = 1; return; state1:
 				delete _sub_process;
-				if (_sub_result)
-				{   DEBUG_EXIT("parse_rule"); DEBUG_NL;
-					_result = true;
-					_parser->exit();
-					return;
-				}
+				_sub_process = 0;
 			}
-			else
+			if (!_parser->_result)
 			{
-				_sub_process = new LL1HeapColourParseRuleProcess(_parser, _rule->next, _sub_result);
-				_parser->call(_sub_process);
-				_state = 9; return; state9:
-				delete _sub_process;
-				if (_sub_result)
-				{   DEBUG_EXIT("parse_rule = "); DEBUG_NL;
-					_result = true;
-					_parser->exit();
-					return;
-				}
-				_parser->_failed = true;
+				_parser->_text = _elem_pos;
+				_parser->drop_commands(_elem_mark);
+				break;
 			}
-			DEBUG_EXIT_P1("parse_rule - failed at %ld", _parser->_text.position()); DEBUG_NL;
-			_result = false;
-			return;
+			_nr_parsed++;
+			if (!_elem->sequential || _parser->_text == _elem_pos)
+				break;
 		}
-	}
 
-	if (_optional)
-	{    
-		//_parser->_text = _sp;
-
-		/* First element was optional: */
-		_sub_process = new LL1HeapColourParseRuleProcess(_parser, _rule->next, _sub_result);
-		_parser->call(_sub_process);
-		_state = 10; return; state10:
-		delete _sub_process;
-		if (_sub_result)
+		if (_nr_parsed == 0 && !_elem->optional)
 		{
-			DEBUG_EXIT("parse_rule"); DEBUG_NL;
-			_result = true;
+			_parser->_text = _start_pos;
+			_parser->drop_commands(_start_mark);
+			DEBUG_EXIT("parse_rule - failed"); DEBUG_NL;
+			_parser->_result = false;
 			_parser->exit();
 			return;
 		}
-		_parser->_failed = true;
 	}
 
-	//_parser->_text = _sp;
-
-	//*_last_fail_pos = _parser->_text.position();
-	DEBUG_EXIT_P1("parse_rule - failed at %ld", _parser->_text.position()); DEBUG_NL;
-	_result = false;
+	DEBUG_EXIT("parse_rule"); DEBUG_NL;
+	_parser->_result = true;
 	_parser->exit();
 }
 
-void LL1HeapColourParseSeqProcess::execute()
-{   
-	switch(_state) {
-		case 1: goto state1;
-		case 2: goto state2;
-		case 3: goto state3;
-		case 4: goto state4;
+LL1HeapColourParseProcess* LL1HeapColourParser::parse_element(GrammarRule* rule)
+/*	Parses an element of a rule. For a (group of alternatives of) a
+	non-terminal, returns the process that parses it, otherwise _result
+	tells whether the element was accepted.
+*/
+{
+	switch( rule->kind )
+	{   case RK_T_EOF:
+			_result = _scanner->acceptEOF(_text);
+			if (!_result)
+				expected_string("eof", false);
+			break;
+		case RK_TERM:
+			_result = parse_term(rule->text.terminal);
+			break;
+		case RK_WS_TERM:
+			_result = parse_ws_term(rule->text.terminal);
+			break;
+		case RK_IDENT:
+			_result = parse_ident(rule->text.ident);
+			break;
+		case RK_NT:
+		case RK_WS_NT:
+			return new LL1HeapColourParseNTProcess(this, rule->text.non_terminal);
+		case RK_LIT:
+			_result = _scanner->acceptLiteral(_text, rule->str_value);
+			if (!_result)
+				expected_string(rule->str_value, true);
+			break;
+		case RK_CHARSET:
+			_result = rule->text.char_set->contains_char(*_text);
+			if (!_result)
+				expected_string("<charset>", false);
+			else
+			{
+				_text.next();
+				_scanner->skipSpace(_text);
+			}
+			break;
+		case RK_AVOID:
+			_result = !rule->text.char_set->contains_char(*_text);
+			break;
+		case RK_AVOIDLIT:
+		{	TextFileBuffer text(_text);
+			_result = !_scanner->acceptLiteral(text, rule->str_value);
+			break;
+		}
+		case RK_COLOURCODING:
+			add_command(rule->text.colour_coding);
+			_result = true;
+			break;
+		case RK_T_OPENCONTEXT:
+		case RK_T_CLOSECONTEXT:
+			_result = true;
+			break;
+		case RK_OR_RULE:
+		case RK_COR_RULE:
+			/* the alternatives of RK_COR_RULE include the rest of the rule */
+			return new LL1HeapColourParseOrRuleProcess(this, rule->text.or_rules->first);
+		default:
+			_result = false;
 	}
-	
-	_try_it = false;
+	return 0;
+}
 
-	DEBUG_ENTER("parse_seq: ");
-	DEBUG_PR(_rule); DEBUG_NL;
+LL1HeapColourParser::LL1HeapColourParser()
+  : _colour_assigner(0), _root(0), _parsed(false), _depth(0), _parse_process(0), _root_process(0), _result(false),
+	_commands(0), _nr_commands(0), _size_commands(0), _min_commands(0),
+	_checkpoints(0), _nr_checkpoints(0), _size_checkpoints(0),
+	_checkpoint_lines(COLOUR_CHECKPOINT_LINES), _next_checkpoint_line(0),
+	_old_checkpoints(0), _nr_old_checkpoints(0), _old_min_commands(0), _converge_nr(0), _converge_pos((unsigned long)-1),
+	_old_commands(0), _nr_old_commands(0), _old_first_command(0),
+	_edit_start(0), _edit_old_end(0), _after_edit(0), _pos_delta(0), _from_line(0), _line_delta(0), _column_delta(0),
+	_old_marks(0), _new_marks(0), _nr_marks(0), _size_marks(0),
+	_nr_recolours(0), _nr_recoloured(0), _nr_converged(0)
+{
+}
 
-	//_sp = _parser->_text;
-	_parser->_current_rule = _rule;
+LL1HeapColourParser::~LL1HeapColourParser()
+{
+	free_checkpoints(_checkpoints, _nr_checkpoints);
+	delete[] _checkpoints;
+	delete[] _commands;
+	delete[] _old_marks;
+	delete[] _new_marks;
+}
 
-	/* Try to accept first symbol */
-	if (_chain_sym == 0 || *_chain_sym != '\0' || _parser->_scanner->acceptLiteral(_parser->_text, _chain_sym))
-	{   _start_pos = _parser->_text;
+void LL1HeapColourParser::expected_string(const char *s, bool is_keyword)
+{
+	AbstractParser::expected_string(_text, s, is_keyword);
+}
 
-		switch( _rule->kind )
-		{   case RK_T_EOF:
-				_try_it = _parser->_scanner->acceptEOF(_parser->_text);
-				break;
-			case RK_TERM:
-            	_try_it = _parser->parse_term(_rule->text.terminal);
-            	break;
-			case RK_WS_TERM:
-            	_try_it = _parser->parse_ws_term(_rule->text.terminal);
-            	break;
-			case RK_IDENT:
-            	_try_it = _parser->parse_ident(_rule->text.ident);
-            	break;
-			case RK_NT:
-			case RK_WS_NT:
-				_sub_process = new LL1HeapColourParseNTProcess(_parser, _rule->text.non_terminal, _try_it);
-				_parser->call(_sub_process);
-				_state = 1; return; state1:
-				delete _sub_process;
-				break;
-			case RK_LIT:
-            	_try_it = _parser->_scanner->acceptLiteral(_parser->_text, _rule->str_value);
-            	if (!_try_it)
-            		_parser->expected_string(_rule->str_value, true);
-				break;
-			case RK_CHARSET:
-				_try_it = _rule->text.char_set->contains_char(*_parser->_text);
-				if (!_try_it)
-					_parser->expected_string("<charset>", false);
-				else
-				{
-					_parser->_text.next();
-					_parser->_scanner->skipSpace(_parser->_text);
-				}
-				break;
-			case RK_AVOID:
-				_try_it = !_rule->text.char_set->contains_char(*_parser->_text);
-				break;
-			case RK_COLOURCODING:
-				_try_it = true;
-				break;
-			case RK_OR_RULE:
-				_sub_process = new LL1HeapColourParseOrRuleProcess(_parser, _rule->text.or_rules->first, _try_it);
-				_parser->call(_sub_process);
-				_state = 2; return; state2:
-				delete _sub_process;
-				break;
-			default:
-				_try_it = false;
-		} 
-    
-		if (_try_it)
-		{   /* We succeded in parsing the first element */
-			_sub_process = new LL1HeapColourParseSeqProcess(_parser, _rule, _chain_sym, _sub_result);
-			_parser->call(_sub_process);
-			_state = 3; return; state3:
-			delete _sub_process;
-			if (_sub_result)
-			{
-				DEBUG_EXIT("parse_seq"); DEBUG_NL;
-				_result = true;
-				_parser->exit();
-				return;
-			}
-			DEBUG_EXIT_P1("parse_seq - failed at %ld", _parser->_text.position()); DEBUG_NL;
-			_result = false;
-			return;
-		}
-		if (_chain_sym != 0)
-        	_parser->expected_string(_chain_sym, true);
+void LL1HeapColourParser::call(LL1HeapColourParseProcess *parse_process)
+{
+	parse_process->_parent_process = _parse_process;
+	_parse_process = parse_process;
+}
+
+void LL1HeapColourParser::exit()
+{
+	_parse_process = _parse_process->_parent_process;
+}
+
+void LL1HeapColourParser::add_command(GrammarColourCoding* colour_coding)
+{
+	if (_nr_commands == _size_commands)
+	{
+		long new_size = _size_commands == 0 ? 1024 : 2 * _size_commands;
+		ColourCommand* new_commands = new ColourCommand[new_size];
+		for (long i = 0; i < _nr_commands; i++)
+			new_commands[i] = _commands[i];
+		delete[] _commands;
+		_commands = new_commands;
+		_size_commands = new_size;
 	}
+	_commands[_nr_commands].pos = _text;
+	_commands[_nr_commands].colour_coding = colour_coding;
+	_nr_commands++;
+}
 
-	//_parser->_text = _sp;
+void LL1HeapColourParser::pass_commands(long first)
+{
+	if (_colour_assigner != 0)
+		for (long i = first; i < _nr_commands; i++)
+			(*_colour_assigner)(_commands[i].pos, _commands[i].colour_coding);
+}
 
-	_sub_process = new LL1HeapColourParseRuleProcess(_parser, _rule->next, _sub_result);
-	_parser->call(_sub_process);
-	_state = 4; return; state4:
-	delete _sub_process;
-	if (_sub_result)
+LL1HeapColourParseProcess* LL1HeapColourParser::copy_processes(LL1HeapColourParseProcess* process)
+/*	Copies the stack of processes from the given (current) process down
+	to the root process, and returns the copy of the given process. */
+{
+	LL1HeapColourParseProcess* top_copy = 0;
+	LL1HeapColourParseProcess* sub_copy = 0;
+	for (; process != 0; process = process->_parent_process)
 	{
-		DEBUG_EXIT("parse_seq"); DEBUG_NL;
-		_result = true;
-		_parser->exit();
+		LL1HeapColourParseProcess* process_copy = process->copy();
+		process_copy->_sub_process = sub_copy;
+		process_copy->_parent_process = 0;
+		if (sub_copy != 0)
+			sub_copy->_parent_process = process_copy;
+		else
+			top_copy = process_copy;
+		sub_copy = process_copy;
+	}
+	return top_copy;
+}
+
+void LL1HeapColourParser::free_processes(LL1HeapColourParseProcess* process)
+{
+	if (process == 0)
 		return;
+	/* the sub process of the current process may have exited already */
+	delete process->_sub_process;
+	while (process != 0)
+	{
+		LL1HeapColourParseProcess* parent_process = process->_parent_process;
+		delete process;
+		process = parent_process;
 	}
+}
 
-	//_parser->_text = _sp;
+void LL1HeapColourParser::add_checkpoint()
+{
+	if (_nr_checkpoints == _size_checkpoints)
+	{
+		long new_size = _size_checkpoints == 0 ? 64 : 2 * _size_checkpoints;
+		Checkpoint* new_checkpoints = new Checkpoint[new_size];
+		for (long i = 0; i < _nr_checkpoints; i++)
+			new_checkpoints[i] = _checkpoints[i];
+		delete[] _checkpoints;
+		_checkpoints = new_checkpoints;
+		_size_checkpoints = new_size;
+	}
+	if (_nr_checkpoints > 0)
+		_checkpoints[_nr_checkpoints - 1].min_commands = _min_commands;
+	Checkpoint& checkpoint = _checkpoints[_nr_checkpoints++];
+	checkpoint.pos = _text;
+	checkpoint.nr_commands = _nr_commands;
+	checkpoint.min_commands = _nr_commands;
+	checkpoint.result = _result;
+	checkpoint.process = copy_processes(_parse_process);
+	_min_commands = _nr_commands;
+	_next_checkpoint_line = _text.line() - _text.line() % _checkpoint_lines + _checkpoint_lines;
+}
 
-	DEBUG_EXIT_P1("parse_seq - failed at %ld", _parser->_text.position()); DEBUG_NL;
-	_result = false;
-	_parser->exit();
+void LL1HeapColourParser::free_checkpoints(Checkpoint* checkpoints, long nr_checkpoints)
+{
+	for (long i = 0; i < nr_checkpoints; i++)
+	{	free_processes(checkpoints[i].process);
+		checkpoints[i].process = 0;
+	}
 }
 
-/*void LL1HeapColourParser::init_solutions()
-{	unsigned long i;
+void LL1HeapColourParser::start()
+/*	Starts parsing at the start of the text. */
+{
+	_f_file_pos = _text;
+	_nr_exp_syms = 0;
+	_depth = 0;
+	_scanner->skipSpace(_text);
+	_nr_commands = 0;
+	_min_commands = 0;
+	_nr_checkpoints = 0;
+	_next_checkpoint_line = 0;
+	_parse_process = 0;
+	_root_process = new LL1HeapColourParseNTProcess(this, _root);
+	call(_root_process);
+}
 
-	_solutions = new ParseSolution*[_text.length()+1];
-	for (i = 0; i < _text.length()+1; i++)
-		_solutions[i] = 0;
+bool LL1HeapColourParser::run()
+/*	Executes the processes until the root process exits, or, while
+	recolouring, until the state is the same as at an old checkpoint,
+	in which case it returns true.
+*/
+{
+	while (_parse_process != 0)
+	{
+		if (_text.position() >= _converge_pos && converge())
+			return true;
+		if (_text.line() >= _next_checkpoint_line)
+			add_checkpoint();
+		_parse_process->execute();
+	}
+	delete _root_process;
+	_root_process = 0;
+	_parsed = _result;
+	if (_nr_checkpoints > 0)
+		_checkpoints[_nr_checkpoints - 1].min_commands = _min_commands;
+	return false;
 }
 
-void LL1HeapColourParser::free_solutions()
+bool LL1HeapColourParser::parse(const TextFileBuffer& textBuffer, Ident root_id, AbstractColourAssigner* colour_assigner)
 {
-	unsigned long i;
+	_colour_assigner = colour_assigner;
+	free_checkpoints(_checkpoints, _nr_checkpoints);
+	_nr_checkpoints = 0;
+	_nr_commands = 0;
+	_root = findNonTerminal(root_id);
+	if (_root == 0)
+		return _parsed = false;
 
-	for (i = 0; i < _text.length()+1; i++)
-	{	ParseSolution* sol = _solutions[i];
+	_text = textBuffer;
+	_scanner->initScanning(this);
+	init_first_sets();
+	_converge_pos = (unsigned long)-1;
+	start();
+	run();
+	_scanner->doneScanning();
+	pass_commands(0);
+
+	return _parsed;
+}
 
-		while (sol != 0)
-		{	ParseSolution* next_sol = sol->next;
-			delete sol;
-			sol = next_sol;
-		}
-  	}
-	delete _solutions;
-	_solutions = 0;
+bool LL1HeapColourParser::parse(const TextFileBuffer& textBuffer, Ident root_id, AbstractParseTree& result)
+{
+	result.clear();
+	return parse(textBuffer, root_id, (AbstractColourAssigner*)0);
 }
 
-ParseSolution* LL1HeapColourParser::find_solution(unsigned long filepos, Ident nt)
+bool LL1HeapColourParser::recolour(const TextFileBuffer& textBuffer, unsigned long edit_start, unsigned long edit_old_end,
+								   unsigned long edit_new_end)
+/*	Parses the text again after the text from edit_start up to
+	edit_old_end in the text of the last parse was replaced by the text
+	up to edit_new_end. The text of the last parse should still be
+	present. The parse continues from the last checkpoint before the
+	line of the edit, after which the commands up to the checkpoint have
+	not been dropped. This assumes that a scanner does not look beyond
+	the end of the line. It stops at the first checkpoint after the line
+	of the edit where the state of the parser is the same as before.
+	That is, the same processes in the same states, where the positions
+	to which they can set back the text and then continue parsing, are
+	after the line of the edit and have moved along with the text, and
+	the colour commands they can drop back to, correspond. Also the old
+	parse should not have dropped commands from before the checkpoint.
+	The colour assigner of the last parse receives the changed commands.
+*/
 {
-	ParseSolution* sol;
+	if (_root == 0)
+		return false;
+	if (_nr_checkpoints == 0)
+	{
+		if (_colour_assigner != 0)
+			_colour_assigner->replace(0, _nr_commands);
+		return parse(textBuffer, _root->name, _colour_assigner);
+	}
 
-	if (filepos > _text.length())
-		filepos = _text.length();
+	TextFileBuffer old_text;
+	old_text = _text;
+	_text = textBuffer;
+	const char* s = _text;
+	unsigned long line_start = edit_start;
+	while (line_start > 0 && s[line_start - 1] != '\n')
+		line_start--;
+
+	/* find the checkpoint to continue from */
+	_old_checkpoints = _checkpoints;
+	_nr_old_checkpoints = _nr_checkpoints;
+	_old_min_commands = new long[_nr_old_checkpoints];
+	long min_commands = _nr_commands;
+	for (long i = _nr_old_checkpoints - 1; i >= 0; i--)
+	{	if (_old_checkpoints[i].min_commands < min_commands)
+			min_commands = _old_checkpoints[i].min_commands;
+		_old_min_commands[i] = min_commands;
+	}
+	long from_nr = _nr_old_checkpoints - 1;
+	while (   from_nr >= 0
+		   && (   _old_checkpoints[from_nr].pos.position() >= line_start
+			   || _old_min_commands[from_nr] < _old_checkpoints[from_nr].nr_commands))
+		from_nr--;
+
+	/* determine the line and column of the edit in both texts */
+	TextFileBuffer new_text(_text);
+	if (from_nr >= 0)
+		new_text = _old_checkpoints[from_nr].pos;
+	new_text.skip(edit_start - new_text.position());
+	_edit_pos = new_text;
+	old_text = (TextFilePos&)new_text;
+	old_text.skip(edit_old_end - edit_start);
+	new_text.skip(edit_new_end - edit_start);
+	_edit_start = edit_start;
+	_edit_old_end = edit_old_end;
+	_pos_delta = (long)edit_new_end - (long)edit_old_end;
+	_from_line = old_text.line();
+	_line_delta = new_text.line() - old_text.line();
+	_column_delta = new_text.column() - old_text.column();
+	const char* os = old_text;
+	unsigned long old_length = old_text.length();
+	_after_edit = edit_old_end;
+	while (_after_edit < old_length && *os != '\n')
+	{	_after_edit++;
+		os++;
+	}
+	_after_edit++;
+	for (_converge_nr = from_nr + 1; _converge_nr < _nr_old_checkpoints; _converge_nr++)
+		if (_old_checkpoints[_converge_nr].pos.position() >= _after_edit)
+			break;
+	_converge_pos =   _converge_nr < _nr_old_checkpoints
+					? _old_checkpoints[_converge_nr].pos.position() + _pos_delta : (unsigned long)-1;
+
+	/* keep the checkpoints and the commands before it */
+	_size_checkpoints = _nr_old_checkpoints < 64 ? 64 : _nr_old_checkpoints;
+	_checkpoints = new Checkpoint[_size_checkpoints];
+	for (_nr_checkpoints = 0; _nr_checkpoints <= from_nr; _nr_checkpoints++)
+	{	_checkpoints[_nr_checkpoints] = _old_checkpoints[_nr_checkpoints];
+		_old_checkpoints[_nr_checkpoints].process = 0;
+	}
+	_old_first_command = from_nr >= 0 ? _old_checkpoints[from_nr].nr_commands : 0;
+	_nr_old_commands = _nr_commands - _old_first_command;
+	_old_commands = new ColourCommand[_nr_old_commands];
+	for (long i = 0; i < _nr_old_commands; i++)
+		_old_commands[i] = _commands[_old_first_command + i];
 
-	for (sol = _solutions[filepos]; sol != 0; sol = sol->next)
-		if ( sol->nt == nt )
-		 	return sol;
+	_scanner->initScanning(this);
+	init_first_sets();
+	unsigned long from_pos = 0;
+	if (from_nr >= 0)
+	{
+		Checkpoint& checkpoint = _checkpoints[from_nr];
+		_text = checkpoint.pos;
+		from_pos = _text.position();
+		_f_file_pos = _text;
+		_nr_exp_syms = 0;
+		_nr_commands = _old_first_command;
+		_min_commands = _nr_commands;
+		_result = checkpoint.result;
+		_parse_process = copy_processes(checkpoint.process);
+		for (_root_process = _parse_process; _root_process->_parent_process != 0; _root_process = _root_process->_parent_process)
+			;
+		_next_checkpoint_line = _text.line() - _text.line() % _checkpoint_lines + _checkpoint_lines;
+	}
+	else
+		start();
 
-	sol = new ParseSolution;
-	sol->next = _solutions[filepos];
-	sol->nt = nt;
-	sol->success = s_unknown;
-	_solutions[filepos] = sol;
+	bool converged = run();
+	_scanner->doneScanning();
+	_nr_recolours++;
+	_nr_recoloured += (converged ? _converge_pos : _text.length()) - from_pos;
 
-	return sol;
+	if (!converged && _colour_assigner != 0)
+	{
+		_colour_assigner->replace(_old_first_command, _nr_old_commands);
+		pass_commands(_old_first_command);
+	}
+	free_checkpoints(_old_checkpoints, _nr_old_checkpoints);
+	delete[] _old_checkpoints;
+	_old_checkpoints = 0;
+	_nr_old_checkpoints = 0;
+	delete[] _old_min_commands;
+	_old_min_commands = 0;
+	delete[] _old_commands;
+	_old_commands = 0;
+	_converge_pos = (unsigned long)-1;
+
+	return _parsed;
 }
+
+bool LL1HeapColourParser::converge()
+/*	Called while recolouring when the text reached the position of the
+	next old checkpoint after the edit. When the state is the same as at
+	that checkpoint, the old commands and checkpoints after it are taken
+	over, and it returns true.
 */
+{
+	unsigned long pos = _text.position();
+	for (; _converge_nr < _nr_old_checkpoints; _converge_nr++)
+	{
+		Checkpoint& old_checkpoint = _old_checkpoints[_converge_nr];
+		unsigned long old_pos = old_checkpoint.pos.position() + _pos_delta;
+		if (old_pos > pos)
+		{	_converge_pos = old_pos;
+			return false;
+		}
+		if (   old_pos == pos
+			&& _old_min_commands[_converge_nr] >= old_checkpoint.nr_commands
+			&& (_parse_process->_state == 0 || _result == old_checkpoint.result)
+			&& same_state(_parse_process, old_checkpoint.process, old_checkpoint.nr_commands))
+		{
+			splice(_converge_nr);
+			return true;
+		}
+	}
+	_converge_pos = (unsigned long)-1;
+	return false;
+}
 
-void LL1HeapColourParser::expected_string(const char *s, bool is_keyword)
+bool LL1HeapColourParser::same_state(LL1HeapColourParseProcess* process, LL1HeapColourParseProcess* old_process, long old_nr_commands)
 {
-	AbstractParser::expected_string(_text, s, is_keyword);
+	_nr_marks = 0;
+	add_mark(old_nr_commands, _nr_commands);
+	LL1HeapColourParseProcess* sub_process = 0;
+	LL1HeapColourParseProcess* old_sub_process = 0;
+	for (; process != 0 && old_process != 0; process = process->_parent_process, old_process = old_process->_parent_process)
+	{
+		if (!process->same(old_process))
+			return false;
+		TextFilePos* pos;
+		long* mark;
+		TextFilePos* old_pos;
+		long* old_mark;
+		if (   process->_state != 0 && process->continuation(sub_process, pos, mark)
+			&& old_process->continuation(old_sub_process, old_pos, old_mark))
+		{
+			if (   old_pos->position() < _after_edit || old_pos->position() + _pos_delta != pos->position()
+				|| !add_mark(*old_mark, *mark))
+				return false;
+		}
+		sub_process = process;
+		old_sub_process = old_process;
+	}
+	return process == 0 && old_process == 0;
 }
 
-void LL1HeapColourParser::call(LL1HeapColourParseProcess *parse_process)
+bool LL1HeapColourParser::add_mark(long old_mark, long mark)
+/*	Records that the number of colour commands old_mark of the old
+	parse corresponds with mark, returns false if it corresponds with
+	another number already. */
 {
-	parse_process->_parent_process = _parse_process;
-	_parse_process = parse_process;
+	for (int i = 0; i < _nr_marks; i++)
+		if (_old_marks[i] == old_mark)
+			return _new_marks[i] == mark;
+	if (_nr_marks == _size_marks)
+	{
+		int new_size = _size_marks == 0 ? 32 : 2 * _size_marks;
+		long* new_old_marks = new long[new_size];
+		long* new_new_marks = new long[new_size];
+		for (int i = 0; i < _nr_marks; i++)
+		{	new_old_marks[i] = _old_marks[i];
+			new_new_marks[i] = _new_marks[i];
+		}
+		delete[] _old_marks;
+		delete[] _new_marks;
+		_old_marks = new_old_marks;
+		_new_marks = new_new_marks;
+		_size_marks = new_size;
+	}
+	_old_marks[_nr_marks] = old_mark;
+	_new_marks[_nr_marks] = mark;
+	_nr_marks++;
+	return true;
 }
 
-void LL1HeapColourParser::exit()
+void LL1HeapColourParser::move_position(TextFilePos& pos)
 {
-	_parse_process = _parse_process->_parent_process;
+	if (pos.position() >= _edit_old_end)
+		pos.shift(_pos_delta, _from_line, _line_delta, _column_delta);
+	else if (pos.position() >= _edit_start)
+		pos = _edit_pos; // not a position the parse continues from
 }
 
-bool LL1HeapColourParser::parse(const TextFileBuffer& textBuffer, Ident root_id, AbstractColourAssigner* colour_assigner)
+long LL1HeapColourParser::move_mark(long mark, long old_nr_commands)
+/*	Returns the number of commands that corresponds with the number of
+	commands mark of the old parse after the checkpoint with
+	old_nr_commands commands, with which the parse converged. Of the
+	numbers before it, only those that the parse can drop back to and
+	then continue, correspond exactly, hence for the other ones, the
+	next lower of those is taken. */
 {
-	_depth = 0;
-	_text = textBuffer;
-	_colour_assigner = colour_assigner;
-	_f_file_pos = _text;
-	_nr_exp_syms = 0;
-	
-	//init_solutions();
-	_failed = false;
+	if (mark >= old_nr_commands)
+		return mark - old_nr_commands + _new_marks[0];
+	long old_below = -1;
+	long below = 0;
+	for (int i = 0; i < _nr_marks; i++)
+		if (_old_marks[i] <= mark && _old_marks[i] > old_below)
+		{	old_below = _old_marks[i];
+			below = _new_marks[i];
+		}
+	return below;
+}
 
-	_scanner->initScanning(this);
-	_scanner->skipSpace(_text);
-	bool try_it = false;
-	LL1HeapColourParseProcess* _root = new LL1HeapColourParseNTProcess(this, findNonTerminal(root_id), try_it);
-	call(_root);
-	while (_parse_process != 0 && _failed)
-		_parse_process->execute();
-	while (_parse_process != 0)
+void LL1HeapColourParser::splice(long old_nr)
+/*	Takes over the commands and the checkpoints of the old parse from the
+	old checkpoint old_nr on, which has the same state as the current one,
+	moved along with the text. */
+{
+	long old_nr_commands = _old_checkpoints[old_nr].nr_commands;
+	_nr_converged++;
+
+	if (_colour_assigner != 0)
 	{
-		LL1HeapColourParseProcess* process = _parse_process;
-		_parse_process = process->_parent_process;
-		delete process;
+		_colour_assigner->replace(_old_first_command, old_nr_commands - _old_first_command);
+		pass_commands(_old_first_command);
 	}
-	delete _root;
 
-	//free_solutions();
-		
-	return try_it;
+	long nr_commands = _nr_commands + _nr_old_commands - (old_nr_commands - _old_first_command);
+	if (nr_commands > _size_commands)
+	{
+		ColourCommand* new_commands = new ColourCommand[nr_commands];
+		for (long i = 0; i < _nr_commands; i++)
+			new_commands[i] = _commands[i];
+		delete[] _commands;
+		_commands = new_commands;
+		_size_commands = nr_commands;
+	}
+	for (long i = old_nr_commands - _old_first_command; i < _nr_old_commands; i++)
+	{
+		_commands[_nr_commands] = _old_commands[i];
+		move_position(_commands[_nr_commands].pos);
+		_nr_commands++;
+	}
+
+	if (_nr_checkpoints > 0)
+		_checkpoints[_nr_checkpoints - 1].min_commands = _min_commands;
+	long nr_checkpoints = _nr_checkpoints + _nr_old_checkpoints - old_nr;
+	if (nr_checkpoints > _size_checkpoints)
+	{
+		Checkpoint* new_checkpoints = new Checkpoint[nr_checkpoints];
+		for (long i = 0; i < _nr_checkpoints; i++)
+			new_checkpoints[i] = _checkpoints[i];
+		delete[] _checkpoints;
+		_checkpoints = new_checkpoints;
+		_size_checkpoints = nr_checkpoints;
+	}
+	for (long i = old_nr; i < _nr_old_checkpoints; i++)
+	{
+		Checkpoint& checkpoint = _checkpoints[_nr_checkpoints++];
+		checkpoint = _old_checkpoints[i];
+		_old_checkpoints[i].process = 0;
+		move_position(checkpoint.pos);
+		checkpoint.nr_commands = move_mark(checkpoint.nr_commands, old_nr_commands);
+		checkpoint.min_commands = move_mark(checkpoint.min_commands, old_nr_commands);
+		for (LL1HeapColourParseProcess* process = checkpoint.process; process != 0; process = process->_parent_process)
+			process->move(this, old_nr_commands);
+	}
+
+	free_processes(_parse_process);
+	_parse_process = 0;
+	_root_process = 0;
+}
+
+void LL1HeapColourParser::printStats(FILE *f)
+{
+	fprintf(f, "colour: %ld commands, %ld checkpoints\n", _nr_commands, _nr_checkpoints);
+	if (_nr_recolours > 0)
+		fprintf(f, "recolour: %lu edits, %lu characters parsed per edit, %lu converged\n",
+				_nr_recolours, _nr_recoloured / _nr_recolours, _nr_converged);
 }
 
 #undef DEBUG_ENTER
-#undef DEBUG_ENTER_P1
 #undef DEBUG_EXIT
-#undef DEBUG_EXIT_P1
 #undef DEBUG_TAB
 #undef DEBUG_NL
-#undef DEBUG_PT
-#undef DEBUG_PO
 #undef DEBUG_PR
-#undef DEBUG_
-#undef DEBUG_P1
@@ -1,68 +1,159 @@
-#ifndef _INCLUDED_LL1HEAPPARSER_H
-#define _INCLUDED_LL1HEAPPARSER_H
+#ifndef _INCLUDED_LL1HEAPCOLOURPARSER_H
+#define _INCLUDED_LL1HEAPCOLOURPARSER_H
 
 #include "ParserGrammar.h"
+#include "AbstractParser.h"
+
+/*	AbstractColourAssigner receives the colour commands (the $ elements
+	of a grammar, see ColourCodingScanner) that LL1HeapColourParser
+	reached while parsing a text, in the order of the text. What a
+	command means, is up to the assigner.
+*/
 
 class AbstractColourAssigner
 {
 public:
+	virtual ~AbstractColourAssigner() {}
 	virtual void operator ()(const TextFilePos& pos, GrammarColourCoding* colour_coding) = 0;
+	/* Called by LL1HeapColourParser::recolour before it passes the
+	   commands of the part of the text that was parsed again: these
+	   replace the nr_removed commands from the command with index first
+	   on. The commands after them are kept, moved along with the text. */
+	virtual void replace(long, long) {}
 };
 
+#define COLOUR_CHECKPOINT_LINES 20
+
 class LL1HeapColourParseProcess;
 
+/*	LL1HeapColourParser parses a text for syntax colouring. The parser
+	is a stack of processes on the heap, such that its state can be
+	copied. The alternatives of a non-terminal are tried in order and
+	the first that matches is taken, and sequences and options take as
+	many elements as match, without back-tracking into them. Each time
+	the parser reaches a new block of lines, it keeps a copy of its
+	state as a checkpoint. After an edit, recolour continues from the
+	last checkpoint before the line of the edit, and stops as soon as it
+	reaches a checkpoint after the edit in the same state, because from
+	there on the parse is the same as before.
+*/
+
 class LL1HeapColourParser : public AbstractParser
 {
+	friend class LL1HeapColourParseProcess;
 	friend class LL1HeapColourParseNTProcess;
 	friend class LL1HeapColourParseRuleProcess;
 	friend class LL1HeapColourParseOrRuleProcess;
-	friend class LL1HeapColourParseSeqProcess;
 public:
+	struct ColourCommand
+	{
+		TextFilePos pos;
+		GrammarColourCoding* colour_coding;
+	};
+
+	LL1HeapColourParser();
+	~LL1HeapColourParser();
+
 	bool parse(const TextFileBuffer& textBuffer, Ident root_id, AbstractColourAssigner* colour_assigner);
-	
+	// Only tells whether the text can be parsed, the result remains empty:
+	virtual bool parse(const TextFileBuffer& textBuffer, Ident root_id, AbstractParseTree& result);
+	bool recolour(const TextFileBuffer& textBuffer, unsigned long edit_start, unsigned long edit_old_end, unsigned long edit_new_end);
+	void setCheckpointLines(int nr_lines) { _checkpoint_lines = nr_lines > 0 ? nr_lines : 1; }
+	long nrColourCommands() const { return _nr_commands; }
+	const ColourCommand& colourCommand(long i) const { return _commands[i]; }
+	virtual void printStats(FILE *f);
+
 private:
 	bool parse_term(GrammarTerminal*);
 	bool parse_ws_term(GrammarTerminal*);
 	bool parse_ident(GrammarIdent* ident);
-	
-	//void init_solutions();
-	//void free_solutions();
-	//ParseSolution* find_solution(unsigned long filepos, Ident nt);
-	
+	LL1HeapColourParseProcess* parse_element(GrammarRule* rule);
+
 	TextFileBuffer _text;
 	AbstractColourAssigner* _colour_assigner;
-
-	void enterRule();
-	void advanced();
-	void leaveLeave();
-	void setColourCoding(GrammarColourCoding* colour_coding);
-
-	/*
-	struct ColourCodingStack
-	{
-		ColourCodingStack(rammarColourCoding* n_coding, int n_depth, const TextFilePos& n_pos)
-		  : n_coding(coding), n_depth(depth), n_pos(pos), processed(false) {}
-		GrammarColourCoding* coding;
-		int depth;
-		TextFilePos pos;
-		bool processed;
-		ColourCodingStack *parent;
-	};
-	ColourCodingStack *_colour_coding_stack;
-	int _rule_depth;
-	*/
+	GrammarNonTerminal* _root;
+	bool _parsed; // the result of the last parse
 
 	void expected_string(const char *s, bool is_keyword);
-	
-	//ParseSolution** _solutions;
+
 	int _depth;
 
 	void call(LL1HeapColourParseProcess* parse_process);
 	void exit();
 	LL1HeapColourParseProcess* _parse_process;
-	bool _failed;
-};
+	LL1HeapColourParseProcess* _root_process;
+	bool _result; // of the last process that exited
+	bool run();
+	void start();
+
+	// The colour commands reached, of which the last ones are dropped
+	// when back-tracking:
+	ColourCommand* _commands;
+	long _nr_commands;
+	long _size_commands;
+	long _min_commands; // since the last checkpoint
+	void add_command(GrammarColourCoding* colour_coding);
+	inline void drop_commands(long nr_commands)
+	{
+		if (nr_commands < _nr_commands)
+		{	_nr_commands = nr_commands;
+			if (nr_commands < _min_commands)
+				_min_commands = nr_commands;
+		}
+	}
+	void pass_commands(long first);
 
+	struct Checkpoint
+	{
+		TextFilePos pos;
+		long nr_commands;
+		long min_commands; // up to the next checkpoint
+		bool result;
+		LL1HeapColourParseProcess* process; // copy of the stack of processes
+	};
+	Checkpoint* _checkpoints;
+	long _nr_checkpoints;
+	long _size_checkpoints;
+	int _checkpoint_lines;
+	int _next_checkpoint_line;
+	void add_checkpoint();
+	void free_checkpoints(Checkpoint* checkpoints, long nr_checkpoints);
+	LL1HeapColourParseProcess* copy_processes(LL1HeapColourParseProcess* process);
+	void free_processes(LL1HeapColourParseProcess* process);
+
+	/* While recolouring: the old checkpoints after the edit, with which
+	   the state is compared, and how positions and commands move */
+	Checkpoint* _old_checkpoints;
+	long _nr_old_checkpoints;
+	long* _old_min_commands; // the least number of commands after each old checkpoint
+	long _converge_nr; // the old checkpoint to compare with next
+	unsigned long _converge_pos; // its position in the new text
+	ColourCommand* _old_commands; // from the checkpoint recolour started from
+	long _nr_old_commands;
+	long _old_first_command;
+	unsigned long _edit_start;
+	unsigned long _edit_old_end;
+	unsigned long _after_edit; // start of the line after the edit in the old text
+	TextFilePos _edit_pos; // of the edit in the new text
+	long _pos_delta;
+	int _from_line;
+	int _line_delta;
+	int _column_delta;
+	long* _old_marks; // commands the state before the old checkpoint drops back to
+	long* _new_marks; // and those of the state now
+	int _nr_marks;
+	int _size_marks;
+	bool converge();
+	bool add_mark(long old_mark, long mark);
+	bool same_state(LL1HeapColourParseProcess* process, LL1HeapColourParseProcess* old_process, long old_nr_commands);
+	void move_position(TextFilePos& pos);
+	long move_mark(long mark, long old_nr_commands);
+	void splice(long old_nr);
+
+	unsigned long _nr_recolours;
+	unsigned long _nr_recoloured; // characters parsed again by recolour
+	unsigned long _nr_converged;
+};
 
-#endif // _INCLUDED_LL1HEAPPARSER_H
 
+#endif // _INCLUDED_LL1HEAPCOLOURPARSER_H
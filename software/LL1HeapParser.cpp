@@ -130,6 +130,8 @@ private:
 	bool &_result;
 	// locals:
 	GrammarOrRule* _or_rule;
+	char _ch;
+	bool _only;
 	Ident _surr_nt;
 	Ident _nt;
 	//ParseSolution* _sol;
@@ -141,18 +143,21 @@ private:
 class LL1HeapParseOrRuleProcess : public LL1HeapParseProcess
 {
 public:
-	LL1HeapParseOrRuleProcess(LL1HeapParser* parser, GrammarOrRule* or_rule, ParsedValue* prev_parts, AbstractParseTree &rtree, bool &result)
-		: LL1HeapParseProcess(parser), _or_rule(or_rule), _prev_parts(prev_parts), _rtree(rtree), _result(result) {}
+	LL1HeapParseOrRuleProcess(LL1HeapParser* parser, GrammarOrRules* or_rules, ParsedValue* prev_parts, AbstractParseTree &rtree, bool &result)
+		: LL1HeapParseProcess(parser), _or_rules(or_rules), _prev_parts(prev_parts), _rtree(rtree), _result(result) {}
 
 	virtual void execute();
 
 private:
 	// parameters:
-	GrammarOrRule* _or_rule;
+	GrammarOrRules* _or_rules;
 	ParsedValue* _prev_parts;
 	AbstractParseTree &_rtree;
 	bool &_result;
 	// locals:
+	GrammarOrRule* _or_rule;
+	char _ch;
+	bool _only;
 	bool _sub_result;
 	LL1HeapParseProcess* _sub_process;
 };
@@ -257,7 +262,8 @@ void LL1HeapParseNTProcess::execute()
 		_parser->_depth += 2; 
 	}
 
-	for (_or_rule = _non_term->first; _or_rule != 0; _or_rule = _or_rule->next )
+	_ch = *_parser->_text;
+	for (_or_rule = _parser->predict(_non_term->prediction, _non_term->first, _ch, _only); _or_rule != 0; _or_rule = _parser->next_predicted(_or_rule, _ch, _only))
 	{
 		_sub_process = new LL1HeapParseRuleProcess(_parser, _or_rule->rule, (ParsedValue*)0, _or_rule->tree_name, _rtree, _sub_result);
 		_parser->call(_sub_process);
@@ -273,7 +279,8 @@ void LL1HeapParseNTProcess::execute()
 		{   _val.prev = 0;
 			_val.last.attach(_rtree);
 
-			for (_or_rule = _non_term->recursive; _or_rule != 0; _or_rule = _or_rule->next )
+			_ch = *_parser->_text;
+			for (_or_rule = _parser->predict(_non_term->rec_prediction, _non_term->recursive, _ch, _only); _or_rule != 0; _or_rule = _parser->next_predicted(_or_rule, _ch, _only))
 			{
 				_sub_process = new LL1HeapParseRuleProcess(_parser, _or_rule->rule, &_val, _or_rule->tree_name, _rtree, _sub_result);
 				_parser->call(_sub_process);
@@ -323,9 +330,10 @@ void LL1HeapParseOrRuleProcess::execute()
 	}
 
 	DEBUG_ENTER("parse_or: ");
-	DEBUG_PO(_or_rule); DEBUG_NL;
+	DEBUG_PO(_or_rules->first); DEBUG_NL;
 
-	for ( ; _or_rule != 0; _or_rule = _or_rule->next )
+	_ch = *_parser->_text;
+	for (_or_rule = _parser->predict(_or_rules->prediction, _or_rules->first, _ch, _only); _or_rule != 0; _or_rule = _parser->next_predicted(_or_rule, _ch, _only))
 	{
 		_sub_process = new LL1HeapParseRuleProcess(_parser, _or_rule->rule, _prev_parts, _or_rule->tree_name, _rtree, _sub_result);
 		_parser->call(_sub_process);
@@ -401,14 +409,14 @@ void LL1HeapParseRuleProcess::execute()
 	_chain_sym = _rule->chain_symbol;
 
 	/* Did we fail the last time at this position? 
-	if (_rule->last_fail_pos == _parser->_text.position())
+	if (_parser->_fail_pos[_rule->nr] == (long)_parser->_text.position())
 	{
 		DEBUG_EXIT("parse_rule - BREAK "); DEBUG_NL;
 		_result = false;
 		_parser->exit();
 		return;
 	}
-	_last_fail_pos = &_rule->last_fail_pos;
+	_last_fail_pos = &_parser->_fail_pos[_rule->nr];
 	*/
 
 	//_sp = _parser->_text;
@@ -545,13 +553,13 @@ void LL1HeapParseRuleProcess::execute()
 				_try_it = true;
 				break;
 			case RK_OR_RULE:
-				_sub_process = new LL1HeapParseOrRuleProcess(_parser, _rule->text.or_rules->first, (ParsedValue*)0, _t, _try_it);
+				_sub_process = new LL1HeapParseOrRuleProcess(_parser, _rule->text.or_rules, (ParsedValue*)0, _t, _try_it);
 				_parser->call(_sub_process);
 				_state = 7; return; state7:
 				delete _sub_process;
 				break;
 			case RK_COR_RULE:
-				_sub_process = new LL1HeapParseOrRuleProcess(_parser, _rule->text.or_rules->first, _prev_parts, _rtree, _result);
+				_sub_process = new LL1HeapParseOrRuleProcess(_parser, _rule->text.or_rules, _prev_parts, _rtree, _result);
 				_parser->call(_sub_process);
 				_state = 8; return; state8:
 				delete _sub_process;
@@ -618,6 +626,7 @@ void LL1HeapParseRuleProcess::execute()
 			}
 			DEBUG_EXIT_P1("parse_rule - failed at %ld", _parser->_text.position()); DEBUG_NL;
 			_result = false;
+			_parser->exit();
 			return;
 		}
 	}
@@ -670,7 +679,7 @@ void LL1HeapParseSeqProcess::execute()
 	_parser->_current_rule = _rule;
 
 	/* Try to accept first symbol */
-	if (_chain_sym == 0 || *_chain_sym != '\0' || _parser->_scanner->acceptLiteral(_parser->_text, _chain_sym))
+	if (_chain_sym == 0 || *_chain_sym == '\0' || _parser->_scanner->acceptLiteral(_parser->_text, _chain_sym))
 	{   _start_pos = _parser->_text;
 
 		switch( _rule->kind )
@@ -719,7 +728,7 @@ void LL1HeapParseSeqProcess::execute()
 				_try_it = true;
 				break;
 			case RK_OR_RULE:
-				_sub_process = new LL1HeapParseOrRuleProcess(_parser, _rule->text.or_rules->first, (ParsedValue*)0, _t, _try_it);
+				_sub_process = new LL1HeapParseOrRuleProcess(_parser, _rule->text.or_rules, (ParsedValue*)0, _t, _try_it);
 				_parser->call(_sub_process);
 				_state = 2; return; state2:
 				delete _sub_process;
@@ -845,6 +854,7 @@ void LL1HeapParser::exit()
 
 bool LL1HeapParser::parse(const TextFileBuffer& textBuffer, Ident root_id, AbstractParseTree& rtree)
 {
+	AbstractParseTreeArena::Use use_arena(_tree_arena);
 	_depth = 0;
 	_text = textBuffer;
 	_f_file_pos = _text;
@@ -855,8 +865,37 @@ bool LL1HeapParser::parse(const TextFileBuffer& textBuffer, Ident root_id, Abstr
 
 	_scanner->initScanning(this);
 	_scanner->skipSpace(_text);
+	GrammarNonTerminal* root = findNonTerminal(root_id);
+	TextFilePos start_pos = _text;
+	Ident surr_nt = _current_nt;
+	init_first_sets();
+	init_predictions();
+	bool try_it = run(root, rtree);
+	if (!try_it && _use_first_sets)
+	{
+		/* The alternatives that were not predicted are missing from
+		   the expected symbols, hence parse again without the
+		   prediction tables for the error message. */
+		_use_first_sets = false;
+		_text = start_pos;
+		_f_file_pos = textBuffer;
+		_nr_exp_syms = 0;
+		_failed = false;
+		_current_nt = surr_nt;
+		rtree.clear();
+		try_it = run(root, rtree);
+	}
+
+	//free_solutions();
+	_scanner->doneScanning();
+		
+	return try_it;
+}
+
+bool LL1HeapParser::run(GrammarNonTerminal* root, AbstractParseTree& rtree)
+{
 	bool try_it = false;
-	LL1HeapParseProcess* _root = new LL1HeapParseNTProcess(this, findNonTerminal(root_id), rtree, try_it);
+	LL1HeapParseProcess* _root = new LL1HeapParseNTProcess(this, root, rtree, try_it);
 	call(_root);
 	while (_parse_process != 0 && !_failed)
 		_parse_process->execute();
@@ -864,15 +903,19 @@ bool LL1HeapParser::parse(const TextFileBuffer& textBuffer, Ident root_id, Abstr
 	{
 		LL1HeapParseProcess* process = _parse_process;
 		_parse_process = process->_parent_process;
-		delete process;
+		if (process != _root)
+			delete process;
 	}
 	delete _root;
-
-	//free_solutions();
-		
 	return try_it;
 }
 
+void LL1HeapParser::printStats(FILE *f)
+{
+	print_prediction_stats(f);
+	print_first_set_stats(f);
+}
+
 #undef DEBUG_ENTER
 #undef DEBUG_ENTER_P1
 #undef DEBUG_EXIT
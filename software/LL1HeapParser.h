@@ -13,6 +13,7 @@ class LL1HeapParser : public AbstractParser
 	friend class LL1HeapParseSeqProcess;
 public:
 	bool parse(const TextFileBuffer& textBuffer, Ident root_id, AbstractParseTree& result);
+	virtual void printStats(FILE *f);
 	
 private:
 	bool parse_term(GrammarTerminal*, AbstractParseTree &rtree);
@@ -34,6 +35,7 @@ private:
 	void exit();
 	LL1HeapParseProcess* _parse_process;
 	bool _failed;
+	bool run(GrammarNonTerminal* root, AbstractParseTree& rtree);
 };
 
 
@@ -117,8 +117,10 @@ bool LL1Parser::parse_nt( GrammarNonTerminal* non_term, AbstractParseTree& rtree
     }
 
 	TextFilePos start_pos = _text;
+	char ch = *_text;
+	bool only;
 
-    for (or_rule = non_term->first; or_rule != 0; or_rule = or_rule->next )
+    for (or_rule = predict(non_term->prediction, non_term->first, ch, only); or_rule != 0; or_rule = next_predicted(or_rule, ch, only))
         if (parse_rule(or_rule->rule, (ParsedValue*)0, or_rule->tree_name, rtree))
             break;
 		else if (_failed)
@@ -131,7 +133,8 @@ bool LL1Parser::parse_nt( GrammarNonTerminal* non_term, AbstractParseTree& rtree
             val.prev = 0;
             val.last.attach(rtree);
 
-            for (or_rule = non_term->recursive; or_rule != 0; or_rule = or_rule->next )
+			ch = *_text;
+            for (or_rule = predict(non_term->rec_prediction, non_term->recursive, ch, only); or_rule != 0; or_rule = next_predicted(or_rule, ch, only))
                 if (parse_rule(or_rule->rule, &val, or_rule->tree_name, rtree))
                     break;
 				else if (_failed)
@@ -163,12 +166,14 @@ bool LL1Parser::parse_nt( GrammarNonTerminal* non_term, AbstractParseTree& rtree
     return false;
 }
 
-bool LL1Parser::parse_or(GrammarOrRule* or_rule, ParsedValue* prev_parts, AbstractParseTree &rtree)
+bool LL1Parser::parse_or(GrammarOrRules* or_rules, ParsedValue* prev_parts, AbstractParseTree &rtree)
 {
     DEBUG_ENTER("parse_or: ");
-    DEBUG_PO(or_rule); DEBUG_NL;
+    DEBUG_PO(or_rules->first); DEBUG_NL;
 
-    for ( ; or_rule != 0; or_rule = or_rule->next )
+	char ch = *_text;
+	bool only;
+    for (GrammarOrRule* or_rule = predict(or_rules->prediction, or_rules->first, ch, only); or_rule != 0; or_rule = next_predicted(or_rule, ch, only))
         if (parse_rule(or_rule->rule, prev_parts, or_rule->tree_name, rtree))
         {   DEBUG_EXIT("parse_or = ");
             DEBUG_PT(rtree); DEBUG_NL;
@@ -319,10 +324,10 @@ bool LL1Parser::parse_rule(GrammarRule* rule, ParsedValue* prev_parts, const Ide
 				try_it = true;
 				break;
             case RK_OR_RULE:
-                try_it = parse_or(rule->text.or_rules->first, (ParsedValue*)0, t);
+                try_it = parse_or(rule->text.or_rules, (ParsedValue*)0, t);
                 break;
             case RK_COR_RULE:
-            	if (parse_or(rule->text.or_rules->first, prev_parts, rtree))
+            	if (parse_or(rule->text.or_rules, prev_parts, rtree))
                 {   DEBUG_EXIT("parse_rule = ");
                     DEBUG_PT(rtree); DEBUG_NL;
 					return true;            		
@@ -457,7 +462,7 @@ bool LL1Parser::parse_seq(GrammarRule* rule, const char *chain_sym,
 				try_it = true;
 				break;
             case RK_OR_RULE:
-                try_it = parse_or(rule->text.or_rules->first, (ParsedValue*)0, t);
+                try_it = parse_or(rule->text.or_rules, (ParsedValue*)0, t);
                 break;
             default:
                 try_it = false;
@@ -507,6 +512,7 @@ void LL1Parser::expected_string(const char *s, bool is_keyword)
 
 bool LL1Parser::parse(const TextFileBuffer& textBuffer, Ident root_id, AbstractParseTree& result)
 {
+	AbstractParseTreeArena::Use use_arena(_tree_arena);
 	_depth = 0;
 	_text = textBuffer;
 	_f_file_pos = _text;
@@ -515,7 +521,35 @@ bool LL1Parser::parse(const TextFileBuffer& textBuffer, Ident root_id, AbstractP
 	
 	_scanner->initScanning(this);
 	_scanner->skipSpace(_text);
-	return parse_nt(findNonTerminal(root_id), result);
+	GrammarNonTerminal* root = findNonTerminal(root_id);
+	TextFilePos start_pos = _text;
+	Ident surr_nt = _current_nt;
+	init_first_sets();
+	init_predictions();
+	bool try_it = parse_nt(root, result);
+	if (!try_it && _use_first_sets)
+	{
+		/* The alternatives that were not predicted are missing from
+		   the expected symbols, hence parse again without the
+		   prediction tables for the error message. */
+		_use_first_sets = false;
+		_text = start_pos;
+		_f_file_pos = textBuffer;
+		_nr_exp_syms = 0;
+		_failed = false;
+		_current_nt = surr_nt;
+		result.clear();
+		try_it = parse_nt(root, result);
+	}
+	_scanner->doneScanning();
+
+	return try_it;
+}
+
+void LL1Parser::printStats(FILE *f)
+{
+	print_prediction_stats(f);
+	print_first_set_stats(f);
 }
 
 #undef DEBUG_ENTER
@@ -536,6 +536,9 @@ bool LL1SSParser::parse(const TextFileBuffer& textBuffer, Ident root_id, Abstrac
 	
 	_scanner->initScanning(this);
 	_scanner->skipSpace(_text);
-	return parse_nt(find_nt(root_id), result);
+	bool try_it = parse_nt(find_nt(root_id), result);
+	_scanner->doneScanning();
+
+	return try_it;
 }
 
@@ -0,0 +1,779 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "Ident.h"
+#include "String.h"
+#include "AbstractParseTree.h"
+#include "TextFileBuffer.h"
+#include "Scanner.h"
+#include "LookaheadDFA.h"
+
+/* The kinds of nodes, with what they stand for: */
+#define LN_RULE  0 // the elements of a rule from rule on, followed by parent
+#define LN_ELEM  1 // the element of rule, followed by what comes after it
+#define LN_SEQ   2 // after an element of sequence rule: the next element or what comes after the sequence
+#define LN_CHAIN 3 // the chain symbol of sequence rule, followed by its next element
+#define LN_REC   4 // after non_term: its left-recursive alternatives, followed by parent
+
+class LookaheadNode
+/*	A way in which an alternative continues: what is to be matched next,
+	followed by what its parent stands for. Nodes are made only once,
+	hence equal ways are the same node. A node without parent is the end
+	of the alternative.
+*/
+{
+public:
+	int kind;
+	GrammarRule* rule;
+	GrammarNonTerminal* non_term;
+	LookaheadNode* parent;
+	int depth; // of parents
+	LookaheadNode* next; // in the hash table
+};
+
+class LookaheadConfig
+{
+public:
+	short alt;
+	LookaheadNode* node; // expects a token
+};
+
+class LookaheadTest
+/*	A token expected in a state */
+{
+public:
+	int kind; // RK_LIT, RK_TERM, RK_WS_TERM, RK_T_EOF or RK_CHARSET
+	const char* literal;
+	Ident terminal;
+	int terminal_nr; // see GrammarTerminal
+	GrammarCharSet* char_set;
+};
+
+class LookaheadEdge
+{
+public:
+	unsigned long matched; // the tests of the state that matched
+	LookaheadState* to;
+	LookaheadEdge* next;
+};
+
+class LookaheadState
+/*	A state of the DFA of a choice: the configurations, each an
+	alternative with a way in which it continues that expects a token,
+	and the alternatives that can have been matched completely. A final
+	state ends the prediction with the alternatives that are left.
+*/
+{
+public:
+	LookaheadState() : configs(0), config_tests(0), nr_configs(0), completed(0), nr_completed(0),
+		left(0), nr_left(0), tests(0), nr_tests(0), tests_at(0), final(false), edges(0), next(0) {}
+	~LookaheadState()
+	{
+		delete[] configs;
+		delete[] config_tests;
+		delete[] completed;
+		delete[] left;
+		delete[] tests;
+		delete[] tests_at;
+		while (edges != 0)
+		{
+			LookaheadEdge* edge = edges;
+			edges = edge->next;
+			delete edge;
+		}
+	}
+	LookaheadConfig* configs; // sorted
+	short* config_tests; // the index of the test of each configuration
+	long nr_configs;
+	short* completed; // sorted
+	int nr_completed;
+	short* left; // the alternatives of both, in order
+	int nr_left;
+	LookaheadTest* tests;
+	int nr_tests;
+	unsigned long* tests_at; // for each character, the tests that can match text starting with it
+	bool final;
+	unsigned long hash;
+	LookaheadEdge* edges;
+	LookaheadState* next; // in the hash table of the decision
+};
+
+#define LOOKAHEAD_STATE_BUCKETS 256
+
+class LookaheadDecision
+/*	The DFA of a choice, with the statistics of its predictions */
+{
+public:
+	LookaheadDecision(GrammarPrediction* n_prediction, Ident n_nt)
+	  : prediction(n_prediction), nt(n_nt), nr_states(0),
+		nr_predictions(0), nr_one(0), nr_several(0), nr_none(0), nr_hits(0), nr_misses(0)
+	{
+		for (int ch = 0; ch < 256; ch++)
+			starts[ch] = 0;
+		for (int i = 0; i < LOOKAHEAD_STATE_BUCKETS; i++)
+			states[i] = 0;
+	}
+	~LookaheadDecision()
+	{
+		for (int i = 0; i < LOOKAHEAD_STATE_BUCKETS; i++)
+			while (states[i] != 0)
+			{
+				LookaheadState* state = states[i];
+				states[i] = state->next;
+				delete state;
+			}
+	}
+	GrammarPrediction* prediction;
+	Ident nt;
+	LookaheadState* starts[256]; // for each character
+	LookaheadState* states[LOOKAHEAD_STATE_BUCKETS];
+	int nr_states;
+	unsigned long nr_predictions;
+	unsigned long nr_one;
+	unsigned long nr_several;
+	unsigned long nr_none;
+	unsigned long nr_hits; // transitions that were made before
+	unsigned long nr_misses;
+};
+
+
+LookaheadDFAs::LookaheadDFAs()
+{
+	_grammar = 0;
+	_decisions = 0;
+	_nr_decisions = 0;
+	_size_nodes = 1024;
+	_nodes = new LookaheadNode*[_size_nodes];
+	for (long i = 0; i < _size_nodes; i++)
+		_nodes[i] = 0;
+	_nr_nodes = 0;
+	_size_configs = 64;
+	_configs = new LookaheadConfig[_size_configs];
+	_nr_configs = 0;
+	_size_completed = 16;
+	_completed = new short[_size_completed];
+	_nr_completed = 0;
+	_nr_steps = 0;
+	_size_visits = 1024;
+	_visits = new Visit[_size_visits];
+	for (long i = 0; i < _size_visits; i++)
+		_visits[i].stamp = 0;
+	_nr_visits = 0;
+	_stamp = 0;
+}
+
+LookaheadDFAs::~LookaheadDFAs()
+{
+	clear();
+	delete[] _nodes;
+	delete[] _configs;
+	delete[] _completed;
+	delete[] _visits;
+}
+
+void LookaheadDFAs::clear()
+{
+	for (int i = 0; i < _nr_decisions; i++)
+		delete _decisions[i];
+	delete[] _decisions;
+	_decisions = 0;
+	_nr_decisions = 0;
+	for (long i = 0; i < _size_nodes; i++)
+		while (_nodes[i] != 0)
+		{
+			LookaheadNode* node = _nodes[i];
+			_nodes[i] = node->next;
+			delete node;
+		}
+	_nr_nodes = 0;
+}
+
+void LookaheadDFAs::init(Grammar* grammar, const unsigned long* terminals_at)
+{
+	bool same = _decisions != 0 && _grammar == grammar->allNonTerminals() && _nr_decisions == grammar->nrPredictions();
+	for (int ch = 0; same && ch < 256; ch++)
+		if (_terminals_at[ch] != terminals_at[ch])
+			same = false;
+	if (same)
+		return;
+
+	clear();
+	for (int ch = 0; ch < 256; ch++)
+		_terminals_at[ch] = terminals_at[ch];
+	_grammar = grammar->allNonTerminals();
+	_nr_decisions = grammar->nrPredictions();
+	_decisions = new LookaheadDecision*[_nr_decisions];
+	for (int i = 0; i < _nr_decisions; i++)
+		_decisions[i] = 0;
+}
+
+static unsigned long hash_pointer(const void* p)
+{
+	size_t v = (size_t)p;
+	return (unsigned long)(v ^ (v >> 17));
+}
+
+static unsigned long hash_node(int kind, GrammarRule* rule, GrammarNonTerminal* non_term, LookaheadNode* parent)
+{
+	return (hash_pointer(rule) * 31 + hash_pointer(non_term)) * 31 + hash_pointer(parent) * 7 + kind;
+}
+
+LookaheadNode* LookaheadDFAs::make_node(int kind, GrammarRule* rule, GrammarNonTerminal* non_term, LookaheadNode* parent)
+{
+	unsigned long hash = hash_node(kind, rule, non_term, parent);
+	LookaheadNode** ref_node = &_nodes[hash % _size_nodes];
+	for (LookaheadNode* node = *ref_node; node != 0; node = node->next)
+		if (node->kind == kind && node->rule == rule && node->non_term == non_term && node->parent == parent)
+			return node;
+
+	LookaheadNode* node = new LookaheadNode;
+	node->kind = kind;
+	node->rule = rule;
+	node->non_term = non_term;
+	node->parent = parent;
+	node->depth = parent != 0 ? parent->depth + 1 : 0;
+	node->next = *ref_node;
+	*ref_node = node;
+
+	if (++_nr_nodes > 2 * _size_nodes)
+	{
+		long size_nodes = 4 * _size_nodes;
+		LookaheadNode** nodes = new LookaheadNode*[size_nodes];
+		for (long i = 0; i < size_nodes; i++)
+			nodes[i] = 0;
+		for (long i = 0; i < _size_nodes; i++)
+			while (_nodes[i] != 0)
+			{
+				LookaheadNode* moved = _nodes[i];
+				_nodes[i] = moved->next;
+				LookaheadNode** ref_moved = &nodes[hash_node(moved->kind, moved->rule, moved->non_term, moved->parent) % size_nodes];
+				moved->next = *ref_moved;
+				*ref_moved = moved;
+			}
+		delete[] _nodes;
+		_nodes = nodes;
+		_size_nodes = size_nodes;
+	}
+	return node;
+}
+
+LookaheadNode* LookaheadDFAs::make_rest(GrammarRule* rule, LookaheadNode* parent)
+{
+	return rule != 0 ? make_node(LN_RULE, rule, 0, parent) : parent;
+}
+
+LookaheadNode* LookaheadDFAs::make_after(LookaheadNode* node)
+{
+	GrammarRule* rule = node->rule;
+	return rule->sequential ? make_node(LN_SEQ, rule, 0, node->parent) : make_rest(rule->next, node->parent);
+}
+
+bool LookaheadDFAs::visit(short alt, LookaheadNode* node)
+/*	Returns whether the configuration was not reached before while
+	making the current state */
+{
+	if (2 * (_nr_visits + 1) > _size_visits)
+	{
+		Visit* old_visits = _visits;
+		long old_size = _size_visits;
+		_size_visits *= 2;
+		_visits = new Visit[_size_visits];
+		for (long i = 0; i < _size_visits; i++)
+			_visits[i].stamp = 0;
+		_nr_visits = 0;
+		for (long i = 0; i < old_size; i++)
+			if (old_visits[i].stamp == _stamp)
+				visit(old_visits[i].alt, old_visits[i].node);
+		delete[] old_visits;
+	}
+
+	long i = (long)((hash_pointer(node) * 31 + alt) % _size_visits);
+	for (; _visits[i].stamp == _stamp; i = (i + 1) % _size_visits)
+		if (_visits[i].alt == alt && _visits[i].node == node)
+			return false;
+	_visits[i].alt = alt;
+	_visits[i].node = node;
+	_visits[i].stamp = _stamp;
+	_nr_visits++;
+	return true;
+}
+
+void LookaheadDFAs::add_config(short alt, LookaheadNode* node)
+{
+	if (_nr_configs == _size_configs)
+	{
+		LookaheadConfig* configs = new LookaheadConfig[2 * _size_configs];
+		for (long i = 0; i < _nr_configs; i++)
+			configs[i] = _configs[i];
+		delete[] _configs;
+		_configs = configs;
+		_size_configs *= 2;
+	}
+	_configs[_nr_configs].alt = alt;
+	_configs[_nr_configs].node = node;
+	_nr_configs++;
+}
+
+void LookaheadDFAs::add_completed(short alt)
+{
+	for (int i = 0; i < _nr_completed; i++)
+		if (_completed[i] == alt)
+			return;
+	if (_nr_completed == _size_completed)
+	{
+		short* completed = new short[2 * _size_completed];
+		for (int i = 0; i < _nr_completed; i++)
+			completed[i] = _completed[i];
+		delete[] _completed;
+		_completed = completed;
+		_size_completed *= 2;
+	}
+	_completed[_nr_completed++] = alt;
+}
+
+void LookaheadDFAs::close(short alt, LookaheadNode* node)
+/*	Adds the configurations that the alternative reaches from the node
+	without matching a token. Where it cannot be followed further, the
+	alternative is taken to be matched completely.
+*/
+{
+	if (node == 0 || ++_nr_steps > LOOKAHEAD_MAX_CLOSURE || node->depth > LOOKAHEAD_MAX_NESTING)
+	{
+		add_completed(alt);
+		return;
+	}
+	if (!visit(alt, node))
+		return;
+
+	GrammarRule* rule = node->rule;
+	switch (node->kind)
+	{
+		case LN_RULE:
+			if (rule->optional)
+				close(alt, make_rest(rule->next, node->parent));
+			close(alt, make_node(LN_ELEM, rule, 0, node->parent));
+			break;
+		case LN_ELEM:
+			close_element(alt, node);
+			break;
+		case LN_SEQ:
+			close(alt, make_rest(rule->next, node->parent));
+			close(alt, make_node(rule->chain_symbol.empty() ? LN_ELEM : LN_CHAIN, rule, 0, node->parent));
+			break;
+		case LN_CHAIN:
+			add_config(alt, node);
+			break;
+		case LN_REC:
+			close(alt, node->parent);
+			for (GrammarOrRule* or_rule = node->non_term->recursive; or_rule != 0; or_rule = or_rule->next)
+				close(alt, make_rest(or_rule->rule, node));
+			break;
+	}
+}
+
+void LookaheadDFAs::close_element(short alt, LookaheadNode* node)
+{
+	GrammarRule* rule = node->rule;
+	switch (rule->kind)
+	{
+		case RK_LIT:
+			if (rule->str_value.empty())
+				close(alt, make_after(node));
+			else
+				add_config(alt, node);
+			break;
+		case RK_TERM:
+		case RK_WS_TERM:
+		case RK_IDENT:
+		case RK_T_EOF:
+		case RK_CHARSET:
+			add_config(alt, node);
+			break;
+		case RK_AVOID:
+		case RK_T_OPENCONTEXT:
+		case RK_T_CLOSECONTEXT:
+		case RK_COLOURCODING:
+			/* these do not match text */
+			close(alt, make_after(node));
+			break;
+		case RK_NT:
+		case RK_WS_NT:
+		{
+			GrammarNonTerminal* non_term = rule->text.non_terminal;
+			LookaheadNode* after = make_after(node);
+			if (non_term->recursive != 0)
+				after = make_node(LN_REC, 0, non_term, after);
+			for (GrammarOrRule* or_rule = non_term->first; or_rule != 0; or_rule = or_rule->next)
+				close(alt, make_rest(or_rule->rule, after));
+			break;
+		}
+		case RK_OR_RULE:
+		{
+			LookaheadNode* after = make_after(node);
+			for (GrammarOrRule* or_rule = rule->text.or_rules->first; or_rule != 0; or_rule = or_rule->next)
+				close(alt, make_rest(or_rule->rule, after));
+			break;
+		}
+		case RK_COR_RULE:
+			/* the alternatives include the rest of the rule */
+			if (rule->sequential)
+				add_completed(alt);
+			else
+				for (GrammarOrRule* or_rule = rule->text.or_rules->first; or_rule != 0; or_rule = or_rule->next)
+					close(alt, make_rest(or_rule->rule, node->parent));
+			break;
+		default:
+			add_completed(alt);
+			break;
+	}
+}
+
+static void set_test(LookaheadTest& test, LookaheadNode* node)
+{
+	GrammarRule* rule = node->rule;
+	test.literal = 0;
+	test.terminal_nr = -1;
+	test.char_set = 0;
+	if (node->kind == LN_CHAIN)
+	{
+		test.kind = RK_LIT;
+		test.literal = rule->chain_symbol;
+		return;
+	}
+	test.kind = rule->kind;
+	switch (rule->kind)
+	{
+		case RK_LIT:
+			test.literal = rule->str_value;
+			break;
+		case RK_TERM:
+			test.terminal = rule->text.terminal->name;
+			test.terminal_nr = rule->text.terminal->nr;
+			break;
+		case RK_WS_TERM:
+			test.terminal = rule->text.terminal->name;
+			break;
+		case RK_IDENT:
+			test.kind = RK_TERM;
+			test.terminal = rule->text.ident->terminal->name;
+			test.terminal_nr = rule->text.ident->terminal->nr;
+			break;
+		case RK_CHARSET:
+			test.char_set = rule->text.char_set;
+			break;
+	}
+}
+
+static bool equal_tests(const LookaheadTest& test1, const LookaheadTest& test2)
+{
+	if (test1.kind != test2.kind)
+		return false;
+	switch (test1.kind)
+	{
+		case RK_LIT:
+			return strcmp(test1.literal, test2.literal) == 0;
+		case RK_TERM:
+		case RK_WS_TERM:
+			return test1.terminal == test2.terminal;
+		case RK_CHARSET:
+			return test1.char_set == test2.char_set;
+	}
+	return true;
+}
+
+static int compare_configs(const void* lhs, const void* rhs)
+{
+	const LookaheadConfig* config1 = (const LookaheadConfig*)lhs;
+	const LookaheadConfig* config2 = (const LookaheadConfig*)rhs;
+	if (config1->alt != config2->alt)
+		return config1->alt < config2->alt ? -1 : 1;
+	if (config1->node != config2->node)
+		return config1->node < config2->node ? -1 : 1;
+	return 0;
+}
+
+static int compare_alts(const void* lhs, const void* rhs)
+{
+	return *(const short*)lhs - *(const short*)rhs;
+}
+
+LookaheadState* LookaheadDFAs::add_state(LookaheadDecision* decision)
+/*	Returns the state of the configurations that were made, which is
+	added to the DFA when it is new
+*/
+{
+	qsort(_configs, _nr_configs, sizeof(LookaheadConfig), compare_configs);
+	qsort(_completed, _nr_completed, sizeof(short), compare_alts);
+	unsigned long hash = _nr_configs;
+	for (long i = 0; i < _nr_configs; i++)
+		hash = hash * 31 + hash_pointer(_configs[i].node) + _configs[i].alt;
+	for (int i = 0; i < _nr_completed; i++)
+		hash = hash * 7 + _completed[i];
+
+	LookaheadState** ref_state = &decision->states[hash % LOOKAHEAD_STATE_BUCKETS];
+	for (LookaheadState* state = *ref_state; state != 0; state = state->next)
+		if (state->hash == hash && state->nr_configs == _nr_configs && state->nr_completed == _nr_completed)
+		{
+			long i = 0;
+			while (i < _nr_configs && compare_configs(&state->configs[i], &_configs[i]) == 0)
+				i++;
+			int j = 0;
+			while (j < _nr_completed && state->completed[j] == _completed[j])
+				j++;
+			if (i == _nr_configs && j == _nr_completed)
+				return state;
+		}
+
+	LookaheadState* state = new LookaheadState;
+	state->hash = hash;
+	state->nr_configs = _nr_configs;
+	state->configs = new LookaheadConfig[_nr_configs];
+	state->config_tests = new short[_nr_configs];
+	for (long i = 0; i < _nr_configs; i++)
+		state->configs[i] = _configs[i];
+	state->nr_completed = _nr_completed;
+	state->completed = new short[_nr_completed];
+	for (int i = 0; i < _nr_completed; i++)
+		state->completed[i] = _completed[i];
+
+	/* the alternatives that are left, in order */
+	state->left = new short[_nr_configs + _nr_completed];
+	long i = 0;
+	int j = 0;
+	while (i < _nr_configs || j < _nr_completed)
+	{
+		short alt = j == _nr_completed || (i < _nr_configs && _configs[i].alt < _completed[j]) ? _configs[i].alt : _completed[j];
+		if (state->nr_left == 0 || state->left[state->nr_left - 1] != alt)
+			state->left[state->nr_left++] = alt;
+		while (i < _nr_configs && _configs[i].alt == alt)
+			i++;
+		if (j < _nr_completed && _completed[j] == alt)
+			j++;
+	}
+	state->final =    state->nr_left <= 1 || _nr_configs == 0
+				   || (_nr_completed > 0 && _completed[0] == state->left[0]);
+
+	if (!state->final)
+	{
+		state->tests = new LookaheadTest[LOOKAHEAD_MAX_TESTS];
+		for (long i = 0; i < _nr_configs && !state->final; i++)
+		{
+			LookaheadTest test;
+			set_test(test, _configs[i].node);
+			int t = 0;
+			while (t < state->nr_tests && !equal_tests(state->tests[t], test))
+				t++;
+			if (t == state->nr_tests)
+			{
+				if (t == LOOKAHEAD_MAX_TESTS)
+					state->final = true;
+				else
+					state->tests[state->nr_tests++] = test;
+			}
+			state->config_tests[i] = t;
+		}
+	}
+	if (!state->final)
+	{
+		state->tests_at = new unsigned long[256];
+		for (int ch = 0; ch < 256; ch++)
+		{
+			unsigned long tests_at = 0;
+			for (int t = 0; t < state->nr_tests; t++)
+				if (may_match(state->tests[t], (unsigned char)ch))
+					tests_at |= 1UL << t;
+			state->tests_at[ch] = tests_at;
+		}
+	}
+
+	state->next = *ref_state;
+	*ref_state = state;
+	decision->nr_states++;
+	return state;
+}
+
+LookaheadState* LookaheadDFAs::make_start(LookaheadDecision* decision, unsigned char ch)
+/*	Makes the state of the alternatives that can start with character ch
+	(see AbstractParser::may_start) */
+{
+	_stamp++;
+	_nr_visits = 0;
+	_nr_configs = 0;
+	_nr_completed = 0;
+	GrammarPrediction* prediction = decision->prediction;
+	for (short alt = 0; alt < prediction->nr_alternatives; alt++)
+	{
+		GrammarOrRule* or_rule = prediction->alternatives[alt];
+		GrammarFirstSet* first_set = or_rule->first_set;
+		if (   first_set == 0 || first_set->any || first_set->nullable || first_set->chars.contains_char(ch)
+			|| (first_set->terminals & _terminals_at[ch]) != 0)
+		{
+			_nr_steps = 0;
+			close(alt, make_rest(or_rule->rule, 0));
+		}
+	}
+	return add_state(decision);
+}
+
+LookaheadState* LookaheadDFAs::make_next(LookaheadDecision* decision, LookaheadState* state, unsigned long matched)
+/*	Makes the state after the tests of state that are in matched, or
+	returns 0 when the DFA has grown too large */
+{
+	if (decision->nr_states >= LOOKAHEAD_MAX_STATES)
+		return 0;
+	_stamp++;
+	_nr_visits = 0;
+	_nr_configs = 0;
+	_nr_completed = 0;
+	for (long i = 0; i < state->nr_configs; i++)
+		if ((matched & (1UL << state->config_tests[i])) != 0)
+		{
+			LookaheadNode* node = state->configs[i].node;
+			_nr_steps = 0;
+			close(state->configs[i].alt,
+				  node->kind == LN_CHAIN ? make_node(LN_ELEM, node->rule, 0, node->parent) : make_after(node));
+		}
+	for (int i = 0; i < state->nr_completed; i++)
+		add_completed(state->completed[i]);
+	return add_state(decision);
+}
+
+bool LookaheadDFAs::may_match(const LookaheadTest& test, unsigned char ch)
+/*	Returns whether the test can match text that starts with ch, like
+	the FIRST sets (see AbstractParser::init_first_sets) */
+{
+	switch (test.kind)
+	{
+		case RK_LIT:
+			return (unsigned char)test.literal[0] == ch;
+		case RK_TERM:
+			return    test.terminal_nr < 0 || test.terminal_nr >= FIRST_MAX_TERMINALS
+				   || (_terminals_at[ch] & (1UL << test.terminal_nr)) != 0;
+		case RK_CHARSET:
+			return test.char_set->contains_char(ch);
+	}
+	return true;
+}
+
+bool LookaheadDFAs::match(LookaheadState* state, int test, TextFileBuffer& text, AbstractScanner* scanner)
+{
+	LookaheadTest& t = state->tests[test];
+	switch (t.kind)
+	{
+		case RK_LIT:
+			return scanner->acceptLiteral(text, t.literal);
+		case RK_TERM:
+		{
+			AbstractParseTree tree;
+			return scanner->acceptTerminal(text, t.terminal, tree);
+		}
+		case RK_WS_TERM:
+			return scanner->acceptWhiteSpace(text, t.terminal);
+		case RK_T_EOF:
+			return scanner->acceptEOF(text);
+		case RK_CHARSET:
+			if (!t.char_set->contains_char(*text))
+				return false;
+			text.next();
+			return true;
+	}
+	return false;
+}
+
+int LookaheadDFAs::predict(GrammarPrediction* prediction, Ident nt, const TextFileBuffer& text, AbstractScanner* scanner,
+						   const short*& predicted, unsigned long& examined)
+{
+	LookaheadDecision*& decision = _decisions[prediction->nr];
+	if (decision == 0)
+		decision = new LookaheadDecision(prediction, nt);
+	decision->nr_predictions++;
+
+	TextFileBuffer pos;
+	pos = text;
+	pos = (const TextFilePos&)text;
+	TextFileBuffer end = pos;
+	TextFileBuffer at = pos;
+	examined = pos.position();
+	unsigned char ch = *pos;
+	LookaheadState*& start = decision->starts[ch];
+	if (start == 0)
+		start = make_start(decision, ch);
+	LookaheadState* state = start;
+	for (int nr_tokens = 0; !state->final && nr_tokens < LOOKAHEAD_MAX_TOKENS; nr_tokens++)
+	{
+		unsigned long matched = 0;
+		bool same_end = true;
+		unsigned long tests = state->tests_at[(unsigned char)*pos];
+		for (int t = 0; tests != 0; t++, tests >>= 1)
+		{
+			if ((tests & 1) == 0)
+				continue;
+			at = (TextFilePos&)pos;
+			if (match(state, t, at, scanner))
+			{
+				if (matched == 0)
+					end = (TextFilePos&)at;
+				else if (at != end)
+					same_end = false;
+				matched |= 1UL << t;
+				if (at.position() > examined)
+					examined = at.position();
+			}
+		}
+		if (!same_end)
+			break;
+
+		LookaheadEdge* edge = state->edges;
+		while (edge != 0 && edge->matched != matched)
+			edge = edge->next;
+		if (edge != 0)
+			decision->nr_hits++;
+		else
+		{
+			decision->nr_misses++;
+			LookaheadState* next_state = make_next(decision, state, matched);
+			if (next_state == 0)
+				break;
+			edge = new LookaheadEdge;
+			edge->matched = matched;
+			edge->to = next_state;
+			edge->next = state->edges;
+			state->edges = edge;
+		}
+		state = edge->to;
+		if (matched != 0)
+			pos = (TextFilePos&)end;
+	}
+
+	if (state->nr_left == 1)
+		decision->nr_one++;
+	else if (state->nr_left == 0)
+		decision->nr_none++;
+	else
+		decision->nr_several++;
+	predicted = state->left;
+	return state->nr_left;
+}
+
+void LookaheadDFAs::printStats(FILE* f)
+{
+	int nr_states = 0;
+	for (int i = 0; i < _nr_decisions; i++)
+		if (_decisions[i] != 0)
+			nr_states += _decisions[i]->nr_states;
+	fprintf(f, "lookahead DFAs: %d states, %ld nodes\n", nr_states, _nr_nodes);
+	for (int i = 0; i < _nr_decisions; i++)
+	{
+		LookaheadDecision* decision = _decisions[i];
+		if (decision == 0)
+			continue;
+		GrammarRule* rule = Grammar::positionedRule(decision->prediction->alternatives[0]->rule);
+		unsigned long nr_transitions = decision->nr_hits + decision->nr_misses;
+		fprintf(f, "  %s %ld.%ld: %lu predictions (%lu of one alternative, %lu of several, %lu of none), "
+				   "%lu transitions, %.1f%% hits, %d states\n",
+				decision->nt.val(), rule != 0 ? rule->line : 0L, rule != 0 ? rule->column : 0L,
+				decision->nr_predictions, decision->nr_one, decision->nr_several, decision->nr_none,
+				nr_transitions, nr_transitions > 0 ? 100.0 * decision->nr_hits / nr_transitions : 0.0,
+				decision->nr_states);
+	}
+}
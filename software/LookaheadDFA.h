@@ -0,0 +1,103 @@
+#ifndef _INCLUDED_LOOKAHEADDFA_H
+#define _INCLUDED_LOOKAHEADDFA_H
+
+#include "ParserGrammar.h"
+#include "TextFileBuffer.h"
+
+class AbstractScanner;
+class LookaheadNode;
+class LookaheadConfig;
+class LookaheadState;
+class LookaheadTest;
+class LookaheadDecision;
+
+#define LOOKAHEAD_MAX_TOKENS 16 // looked ahead by one prediction
+#define LOOKAHEAD_MAX_TESTS 32 // different tokens expected in a state
+#define LOOKAHEAD_MAX_STATES 1000 // of a choice
+#define LOOKAHEAD_MAX_NESTING 40 // of elements followed into
+#define LOOKAHEAD_MAX_CLOSURE 4000 // steps to follow an alternative up to its tokens
+
+/*	LookaheadDFAs predicts which alternatives of a choice (see
+	GrammarPrediction) can match the text ahead, in the manner of LL(*)
+	parsing. It follows all alternatives token by token, as if the
+	grammar were context-free, and drops an alternative when none of the
+	ways in which it continues matches the next token. An alternative
+	that is dropped cannot match, hence trying the others in order gives
+	the same result as trying all. Where it cannot follow an alternative
+	(because it nests too deep), the alternative is kept. The sets of
+	ways in which the alternatives continue are the states of a DFA for
+	each choice, which are made when they are first reached, and kept
+	for the next parse. The transitions are made for the combinations
+	of the tokens expected in a state that match. A prediction stops
+	when one alternative is left, when the first alternative that is
+	left can have been matched completely, or when tokens of different
+	lengths match, because the DFA moves through the text in steps that
+	are the same for all alternatives.
+*/
+
+class LookaheadDFAs
+{
+public:
+	LookaheadDFAs();
+	~LookaheadDFAs();
+
+	/* Keeps the DFAs of the last parse when the grammar is the same. The
+	   DFAs start with the alternatives that can start with the character
+	   at the text, for which terminals_at gives the terminals (as in
+	   GrammarFirstSet) that can start with each character. */
+	void init(Grammar* grammar, const unsigned long* terminals_at);
+	/* Returns the number of alternatives of the choice that are left
+	   at text, and in predicted their indexes, in order. The furthest
+	   position looked at is returned in examined. The prediction is
+	   reported for non-terminal nt. */
+	int predict(GrammarPrediction* prediction, Ident nt, const TextFileBuffer& text, AbstractScanner* scanner,
+				const short*& predicted, unsigned long& examined);
+	// Prints the predictions and the DFA hit rate of each choice
+	void printStats(FILE* f);
+
+private:
+	GrammarNonTerminal* _grammar; // of which the DFAs are
+	LookaheadDecision** _decisions; // indexed by GrammarPrediction::nr
+	int _nr_decisions;
+	unsigned long _terminals_at[256];
+	void clear();
+
+	LookaheadNode** _nodes; // hash table of all nodes
+	long _size_nodes;
+	long _nr_nodes;
+	LookaheadNode* make_node(int kind, GrammarRule* rule, GrammarNonTerminal* non_term, LookaheadNode* parent);
+
+	/* The configurations (see LookaheadState) of the state being made */
+	LookaheadState* make_start(LookaheadDecision* decision, unsigned char ch);
+	LookaheadState* make_next(LookaheadDecision* decision, LookaheadState* state, unsigned long matched);
+	LookaheadState* add_state(LookaheadDecision* decision);
+	LookaheadNode* make_rest(GrammarRule* rule, LookaheadNode* parent);
+	LookaheadNode* make_after(LookaheadNode* node);
+	void close(short alt, LookaheadNode* node);
+	void close_element(short alt, LookaheadNode* node);
+	void add_config(short alt, LookaheadNode* node);
+	void add_completed(short alt);
+	bool visit(short alt, LookaheadNode* node);
+	LookaheadConfig* _configs;
+	long _nr_configs;
+	long _size_configs;
+	short* _completed;
+	int _nr_completed;
+	int _size_completed;
+	long _nr_steps;
+	struct Visit
+	{
+		short alt;
+		LookaheadNode* node;
+		unsigned long stamp;
+	};
+	Visit* _visits;
+	long _size_visits;
+	long _nr_visits;
+	unsigned long _stamp;
+
+	bool may_match(const LookaheadTest& test, unsigned char ch);
+	bool match(LookaheadState* state, int test, TextFileBuffer& text, AbstractScanner* scanner);
+};
+
+#endif // _INCLUDED_LOOKAHEADDFA_H
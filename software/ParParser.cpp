@@ -9,6 +9,7 @@
 #include "Scanner.h"
 #include "AbstractParser.h"
 #include "ParParser.h"
+#include "Threads.h"
 
 
 
@@ -26,53 +27,98 @@
 //#define DEBUG_P1(X,A) if (parser->_debug_parse) printf(X,A)
 
 #define DEBUG
-#define DEBUG_ALLOC_ALT
+//#define DEBUG_ALLOC_ALT
 //#define TREE_CHECK
-#define CHECK  _check();
-#define CHILD_CHECK // child->_check();
+#define CHECK // _check();
 
 #ifdef DEBUG
 bool detailed_debug = false;
 #endif
 
 
+/*	While more than one worker thread runs, the alternatives and the
+	processes are shared between them. The workers change the tree of
+	alternatives with it locked, once at the end of each execution.
+*/
+static bool par_threads = false;
+static Mutex tree_lock;
+
+class TreeLock
+/*	Locks the tree of alternatives, while it is shared by threads */
+{
+public:
+	TreeLock() { if (par_threads) tree_lock.lock(); }
+	~TreeLock() { if (par_threads) tree_lock.unlock(); }
+};
+
+// The number of the worker that runs in the thread
+static THREAD_LOCAL int par_worker_nr = 0;
+
 class MyAlloc
+/*	Keeps freed objects for reuse, in a free list for each worker, such
+	that workers do not have to lock. Objects freed by another worker
+	than the one that allocated them, move to the free list of that
+	worker.
+*/
 {
 public:
-	MyAlloc(const char* name) : _name(name), _allocs(0), _allocated(0), _freed(0), _count(0), _reused(0) {}
+	MyAlloc(const char* name) : _name(name)
+	{
+		for (int i = 0; i < PAR_MAX_THREADS; i++)
+		{
+			free_list_t& list = _lists[i];
+			list.allocs = 0;
+			list.allocated = list.freed = list.count = list.reused = 0;
+		}
+	}
 	void* mynew(size_t size)
 	{
-		_allocated++;
-		if (_allocs != 0)
+		free_list_t& list = _lists[par_worker_nr];
+		list.allocated++;
+		if (list.allocs != 0)
 		{
-			_reused++;
-			void* result = _allocs;
-			_allocs = *(void**)_allocs;
+			list.reused++;
+			void* result = list.allocs;
+			list.allocs = *(void**)list.allocs;
 			return result;
 		}
 		else
 		{
-			_count++;
+			list.count++;
 			return malloc(size);
 		}
 	}
 	void mydelete(void *old)
 	{
-		_freed++;
-		*(void**)old = _allocs; _allocs = old;
+		free_list_t& list = _lists[par_worker_nr];
+		list.freed++;
+		*(void**)old = list.allocs; list.allocs = old;
 	}
-	void print()
+	void print(FILE *f)
 	{
-		printf("Allocator %s: allocated = %ld. freed = %ld, left = %ld, count = %ld, reused = %ld\n",
-			_name, _allocated, _freed, _allocated - _freed, _count, _reused);
+		long allocated = 0, freed = 0, count = 0, reused = 0;
+		for (int i = 0; i < PAR_MAX_THREADS; i++)
+		{
+			allocated += _lists[i].allocated;
+			freed += _lists[i].freed;
+			count += _lists[i].count;
+			reused += _lists[i].reused;
+		}
+		fprintf(f, "Allocator %s: allocated = %ld. freed = %ld, left = %ld, count = %ld, reused = %ld\n",
+			_name, allocated, freed, allocated - freed, count, reused);
 	}
 private:
-	void* _allocs;
 	const char* _name;
-	long _allocated;
-	long _freed;
-	long _count;
-	long _reused;
+	struct free_list_t
+	{
+		void* allocs;
+		long allocated;
+		long freed;
+		long count;
+		long reused;
+		char padding[24]; // to keep the lists of workers in different cache lines
+	};
+	free_list_t _lists[PAR_MAX_THREADS];
 };
 
 #define MYALLOC public: \
@@ -84,12 +130,15 @@ class Alternative;
 
 class ParseProcess
 {
-	// Reference counting is managed by class Alternative.
+	// Reference counting is managed by class Alternative, with atomic
+	// operations, because alternatives in different threads can share
+	// the same parent processes.
 	friend class Alternative;
 public:
-	ParseProcess(int state, ParseProcess* parent_process) : _ref_count(1), _state(state), _parent_process(parent_process) {}
+	ParseProcess(int state, ParseProcess* parent_process) : _state(state), _parent_process(parent_process), _ref_count(1) {}
+	virtual ~ParseProcess() {}
 	virtual ParseProcess* clone(int state) = 0;
-	virtual void execute(ParParser* parser, Alternative* alt) = 0;
+	virtual void execute(ParParseWorker* parser, Alternative* alt) = 0;
 	virtual void print(FILE *fout) = 0;
 	virtual bool printNT(FILE *fout) { return false; }
 	ParseProcess* parent() { return _parent_process; }
@@ -98,16 +147,32 @@ protected:
 	ParseProcess* _parent_process;
 	virtual void destruct() = 0;
 private:
-	long _ref_count;
+	volatile long _ref_count;
+	inline void add_ref()
+	{	if (par_threads)
+			atomicIncrement(_ref_count);
+		else
+			_ref_count++;
+	}
+	inline bool release_ref()
+	{	if (par_threads)
+			return atomicDecrement(_ref_count) == 0;
+		return --_ref_count == 0;
+	}
+	inline bool is_shared()
+	{	if (par_threads)
+			return atomicValue(_ref_count) > 1;
+		return _ref_count > 1;
+	}
 };
 
 class ParsePosition
 {
 	friend class Alternative;
 public:
-	ParsePosition(ParsePosition* n_next, const TextFilePos& file_pos) : alternatives(0), next(n_next), _file_pos(file_pos) { _tail_alternatives = &alternatives; }
+	ParsePosition(const TextFilePos& file_pos) : alternatives(0), next_in_bucket(0), _file_pos(file_pos) { _tail_alternatives = &alternatives; }
 	Alternative* alternatives;
-	ParsePosition* next;
+	ParsePosition* next_in_bucket;
 	void append(Alternative* alternative);
 	const TextFilePos& filePos() { return _file_pos; }
 private:
@@ -118,17 +183,231 @@ private:
 
 MyAlloc ParsePosition::allocs("ParsePosition");
 
+class ParseFrontier
+/*	The parse positions with waiting alternatives. They are kept in a
+	heap ordered on position, from which the first position is taken
+	in O(log n), and in a hash table on position, in which the position
+	for an alternative is found in O(1).
+*/
+{
+public:
+	ParseFrontier() : _heap(0), _nr_positions(0), _size_heap(0), _buckets(0), _nr_buckets(0) {}
+	~ParseFrontier()
+	{
+		for (int i = 0; i < _nr_positions; i++)
+			delete _heap[i];
+		delete[] _heap;
+		delete[] _buckets;
+	}
+	ParsePosition* find(const TextFilePos& pos); // adds the position, if not present
+	ParsePosition* first() { return _nr_positions > 0 ? _heap[0] : 0; }
+	void removeFirst();
+	int nrPositions() { return _nr_positions; }
+	ParsePosition* position(int i) { return _heap[i]; }
+private:
+	ParsePosition** _heap;
+	int _nr_positions;
+	int _size_heap;
+	ParsePosition** _buckets;
+	int _nr_buckets; // a power of two
+	inline ParsePosition** bucket(TextFilePos pos) { return &_buckets[pos.position() & (_nr_buckets - 1)]; }
+	void grow();
+};
+
+void ParseFrontier::grow()
+{
+	int new_size = _size_heap == 0 ? 64 : 2 * _size_heap;
+	ParsePosition** new_heap = new ParsePosition*[new_size];
+	for (int i = 0; i < _nr_positions; i++)
+		new_heap[i] = _heap[i];
+	delete[] _heap;
+	_heap = new_heap;
+	_size_heap = new_size;
+
+	// Positions are consecutive offsets, hence the lowest bits spread
+	// them over the buckets
+	delete[] _buckets;
+	_nr_buckets = new_size;
+	_buckets = new ParsePosition*[_nr_buckets];
+	for (int i = 0; i < _nr_buckets; i++)
+		_buckets[i] = 0;
+	for (int i = 0; i < _nr_positions; i++)
+	{
+		ParsePosition** ref_bucket = bucket(_heap[i]->filePos());
+		_heap[i]->next_in_bucket = *ref_bucket;
+		*ref_bucket = _heap[i];
+	}
+}
+
+ParsePosition* ParseFrontier::find(const TextFilePos& pos)
+{
+	if (_nr_buckets > 0)
+		for (ParsePosition* parse_position = *bucket(pos); parse_position != 0; parse_position = parse_position->next_in_bucket)
+			if (parse_position->filePos() == pos)
+				return parse_position;
+
+	if (_nr_positions == _size_heap)
+		grow();
+	ParsePosition* new_position = new ParsePosition(pos);
+	ParsePosition** ref_bucket = bucket(pos);
+	new_position->next_in_bucket = *ref_bucket;
+	*ref_bucket = new_position;
+
+	// sift up
+	int i = _nr_positions++;
+	while (i > 0)
+	{
+		int parent = (i - 1) / 2;
+		if (!(pos < _heap[parent]->filePos()))
+			break;
+		_heap[i] = _heap[parent];
+		i = parent;
+	}
+	_heap[i] = new_position;
+	return new_position;
+}
+
+void ParseFrontier::removeFirst()
+{
+	ParsePosition* first = _heap[0];
+	ParsePosition** ref_bucket = bucket(first->filePos());
+	while (*ref_bucket != first)
+		ref_bucket = &(*ref_bucket)->next_in_bucket;
+	*ref_bucket = first->next_in_bucket;
+	delete first;
+
+	// sift down the last position from the top
+	ParsePosition* last = _heap[--_nr_positions];
+	int i = 0;
+	for (;;)
+	{
+		int child = 2 * i + 1;
+		if (child >= _nr_positions)
+			break;
+		if (child + 1 < _nr_positions && _heap[child + 1]->filePos() < _heap[child]->filePos())
+			child++;
+		if (!(_heap[child]->filePos() < last->filePos()))
+			break;
+		_heap[i] = _heap[child];
+		i = child;
+	}
+	if (_nr_positions > 0)
+		_heap[i] = last;
+}
+
+
+class ParseCall
+/*	The parse of a non-terminal at a position, which is shared by all
+	alternatives that call the non-terminal at that position, as in the
+	graph-structured stack of a GLL parser. It runs in a tree of
+	alternatives of its own. Because the first alternative of a
+	non-terminal that matches is taken, a call has one result: the
+	callers wait until the alternative that returned first in order is
+	final, and then all continue with its result.
+*/
+{
+public:
+	ParseCall(GrammarNonTerminal* n_non_term, const TextFilePos& n_pos)
+		: non_term(n_non_term), pos(n_pos), next_in_bucket(0), state(call_running), root(0), waiting(0),
+		  next_returned(0), returned(false) {}
+	GrammarNonTerminal* non_term;
+	TextFilePos pos;
+	ParseCall* next_in_bucket;
+	enum { call_running, call_succeeded, call_failed } state;
+	AbstractParseTree result;
+	TextFilePos end_pos;
+	Alternative* root; // of the tree that parses the non-terminal, while it runs
+	Alternative* waiting; // the callers
+	ParseCall* next_returned;
+	bool returned; // in the list of calls of which an alternative returned
+	MYALLOC
+};
+
+MyAlloc ParseCall::allocs("ParseCall");
+
+class ParseCalls
+/*	The calls of a parse, in a hash table on position and non-terminal.
+	They are kept until the end of the parse.
+*/
+{
+public:
+	ParseCalls() : _buckets(0), _nr_buckets(0), _nr_calls(0) {}
+	~ParseCalls()
+	{
+		for (int i = 0; i < _nr_buckets; i++)
+			for (ParseCall* call = _buckets[i]; call != 0; )
+			{
+				ParseCall* next_call = call->next_in_bucket;
+				delete call;
+				call = next_call;
+			}
+		delete[] _buckets;
+	}
+	ParseCall* find(const TextFilePos& pos, GrammarNonTerminal* non_term); // adds the call, if not present
+	long nrCalls() { return _nr_calls; }
+	int nrBuckets() { return _nr_buckets; }
+	ParseCall* bucket(int i) { return _buckets[i]; }
+private:
+	ParseCall** _buckets;
+	int _nr_buckets; // a power of two
+	long _nr_calls;
+	inline int hash(TextFilePos pos, GrammarNonTerminal* non_term) { return (int)(pos.position() * 31 + non_term->nr) & (_nr_buckets - 1); }
+	void grow();
+};
+
+void ParseCalls::grow()
+{
+	int old_nr_buckets = _nr_buckets;
+	ParseCall** old_buckets = _buckets;
+	_nr_buckets = _nr_buckets == 0 ? 256 : 2 * _nr_buckets;
+	_buckets = new ParseCall*[_nr_buckets];
+	for (int i = 0; i < _nr_buckets; i++)
+		_buckets[i] = 0;
+	for (int i = 0; i < old_nr_buckets; i++)
+		for (ParseCall* call = old_buckets[i]; call != 0; )
+		{
+			ParseCall* next_call = call->next_in_bucket;
+			ParseCall** ref_bucket = &_buckets[hash(call->pos, call->non_term)];
+			call->next_in_bucket = *ref_bucket;
+			*ref_bucket = call;
+			call = next_call;
+		}
+	delete[] old_buckets;
+}
+
+ParseCall* ParseCalls::find(const TextFilePos& pos, GrammarNonTerminal* non_term)
+{
+	if (_nr_buckets > 0)
+		for (ParseCall* call = _buckets[hash(pos, non_term)]; call != 0; call = call->next_in_bucket)
+			if (call->non_term == non_term && call->pos == pos)
+				return call;
+
+	if (_nr_calls >= _nr_buckets)
+		grow();
+	ParseCall* new_call = new ParseCall(non_term, pos);
+	ParseCall** ref_bucket = &_buckets[hash(pos, non_term)];
+	new_call->next_in_bucket = *ref_bucket;
+	*ref_bucket = new_call;
+	_nr_calls++;
+	return new_call;
+}
+
 
-int next_alt_id = 0;
+volatile int next_alt_id = 0;
 
 class Alternative
 {
 	friend class ParParser;
+	friend class ParParseWorker;
 public:
-	Alternative(Alternative *parent) : _parent(parent), _children(0), _next_sibl(0), _ref_prev_sibl(0), _success(0), _next(0), _ref_prev(0), _process(0), _parse_position(0),
-			cr_text(""), cr_grammar_rule(0), _check_state(' ')
+	Alternative(Alternative *parent) : cr_text(""), cr_grammar_rule(0), _parent(parent), _children(0), _next_sibl(0), _ref_prev_sibl(0), _parse_position(0), _next(0), _ref_prev(0), _success(0), _process(0),
+			_in_worker(false), _dead(false), _root_of(0), _waits_for(0), _returned(false), _check_state(' ')
 	{
-		alt_id = next_alt_id++;
+		alt_id = par_threads ? atomicIncrement(next_alt_id) - 1 : next_alt_id++;
+		if (par_threads)
+			atomicIncrement(nr_live);
+		else
+			nr_live++;
 		_tail_children = &_children;
 		if (_parent != 0)
 		{
@@ -143,52 +422,73 @@ public:
 		CHECK
 	};
 	static bool _deleting;
+	static volatile long nr_live;
+	static long max_live; // updated when the tree is changed
 	~Alternative()
 	{
 		_deleting = true;
+		if (par_threads)
+			atomicDecrement(nr_live);
+		else
+			nr_live--;
 #ifdef DEBUG_ALLOC_ALT
 		_assign_live(_ref_prev_live, _next_live);
 #endif
+		if (_waits_for != 0)
+			stopWaiting();
+		if (_root_of != 0 && _root_of->root == this)
+			_root_of->root = 0;
 		releaseProcess();
 		remove();
 		for (Alternative* child = _children; child != 0; )
 		{
 			Alternative* next_child = child->_next_sibl;
-			delete child;
+			_kill(child);
 			child = next_child;
 		}
 		_deleting = false;
 	}
 	Alternative* addChild(int state)
+	/* The child belongs to the worker that executes this alternative,
+	   until it is inserted. It is linked to this alternative when the
+	   worker changes the tree. */
 	{
 		CHECK
-		Alternative *child = new Alternative(this);
+		ParseProcess* child_process = 0;
 		if (_process != 0)
 		{
-			ParseProcess* child_process = _process->clone(state);
+			child_process = _process->clone(state);
 			ParseProcess* parent_process = _process->_parent_process;
 			if (parent_process != 0)
 			{
 				child_process->_parent_process = parent_process;			
-				parent_process->_ref_count++;
+				parent_process->add_ref();
 			}
-			child->_process = child_process;
 		}
+		Alternative *child = new Alternative(0);
+		child->_process = child_process;
+		child->_in_worker = true;
 		CHECK
-		CHILD_CHECK
 		return child;
 	}
-	void releaseProcess()
+	void link(Alternative* parent)
+	/* Links the child made by addChild to its parent. If the parent was
+	   killed in the meantime, the child is dead as well. */
 	{
-		CHECK
-		for (ParseProcess* process = _process; process != 0;)
+		if (parent->_dead)
 		{
-			ParseProcess* parent = process->_parent_process;
-			if (--process->_ref_count != 0)
-				break;
-			process->destruct();
-			process = parent;
+			_dead = true;
+			return;
 		}
+		_parent = parent;
+		_assign_sibl(_parent->_tail_children, this);
+		_parent->_tail_children = &_next_sibl;
+		CHECK
+	}
+	void releaseProcess()
+	{
+		CHECK
+		_release(_process);
 		_process = 0;
 		CHECK
 	}
@@ -214,8 +514,39 @@ public:
 		}
 		CHECK
 	}
+	void waitFor(ParseCall* call)
+	/* Waits in the list of callers of the call */
+	{
+		_waits_for = call;
+		_assign(&_next, call->waiting);
+		_assign(&call->waiting, this);
+	}
+	void stopWaiting()
+	/* When the last caller stops waiting for a call that is still
+	   running, nobody needs its result any more, and the parse is
+	   dropped. Another caller will start it again. */
+	{
+		ParseCall* call = _waits_for;
+		remove();
+		_waits_for = 0;
+		if (call->waiting == 0 && call->root != 0)
+		{
+			Alternative* root = call->root;
+			call->root = 0;
+			_kill(root);
+		}
+	}
+	Alternative* firstLeaf()
+	{
+		Alternative* alt = this;
+		while (alt->_children != 0)
+			alt = alt->_children;
+		return alt;
+	}
 	void succeed()
 	{
+		if (_dead)
+			return;
 		CHECK
 #ifdef DEBUG
 		if (detailed_debug)
@@ -235,7 +566,6 @@ public:
 		int success = 0;
 		for(Alternative* child = this; child != 0; child = child->_parent)
 		{
-			printf("child %d\n", child->alt_id);
 			success += child->_success;
 			if (success == 0)
 				break;
@@ -248,7 +578,7 @@ public:
 				if (detailed_debug)
 					printf("  remove[%d]\n", sibl->alt_id);
 #endif
-				delete sibl;
+				_kill(sibl);
 				sibl = next_sibl;
 			}
 			child->_next_sibl = 0;
@@ -261,7 +591,7 @@ public:
 		_try_reduce();
 		CHECK
 	}
-	void fail()
+	void _fail()
 	{
 		CHECK
 #ifdef DEBUG
@@ -287,11 +617,27 @@ public:
 			_ref_prev_sibl = 0;
 			_next_sibl = 0;
 			if (_parent != 0 && _parent->_children == 0)
-				_parent->fail();
+				_parent->_fail();
 			else if (next_sibl != 0 && next_sibl->_success > 0)
 				next_sibl->_try_reduce();
+			_kill(this);
+		}
+		else if (_root_of != 0)
+		{
+			// None of the alternatives of a shared call matched
+			ParseCall* call = _root_of;
+			call->state = ParseCall::call_failed;
+			call->root = 0;
+			while (call->waiting != 0)
+			{
+				Alternative* caller = call->waiting;
+				caller->remove();
+				caller->_waits_for = 0;
+				if (!caller->_dead)
+					caller->_fail();
+			}
 			delete this;
-		}		
+		}
 	}
 	void call(ParseProcess* process)
 	{
@@ -308,16 +654,19 @@ public:
 		ParseProcess* parent = _process->_parent_process;
 		_process->destruct();
 		_process = parent;
-		if (_process != 0 && _process->_ref_count > 1)
+		if (_process != 0 && _process->is_shared())
 		{
-			_process->_ref_count--;
-			_process = _process->clone(_process->_state);
+			// Continue with a copy; the shared process is released after
+			// copying it, because another alternative might release it too
+			ParseProcess* shared_process = _process;
+			_process = shared_process->clone(shared_process->_state);
 			if (_process->_parent_process != 0)
-				_process->_parent_process->_ref_count++;
+				_process->_parent_process->add_ref();
+			_release(shared_process);
 		}
 		CHECK
 	}
-	inline void execute(ParParser* parser)
+	inline void execute(ParParseWorker* parser)
 	{
 		CHECK
 		if (_process == 0) { assert(0); return; }
@@ -374,7 +723,6 @@ private:
 	}
 	void _try_reduce()
 	{
-		printf("try_reduce\n");
 		CHECK
 		// If we are the first, take place of parent
 		while (_success > 0 && _parent != 0 && _parent->_children == this)
@@ -405,14 +753,45 @@ private:
 			if (detailed_debug)
 				printf("  reduced[%d]\n", old_parent->alt_id);
 #endif
-			delete old_parent;
+			_kill(old_parent);
 			_success--;
 			CHECK
 		}
 	}
-	void _kill()
+	static void _kill(Alternative* alt)
+	/* Deletes the alternative with its children, except for those that
+	   a worker holds: these are marked as dead and detached from the
+	   tree, and the worker deletes them when it is done with them. The
+	   caller takes care of the links of the siblings. */
 	{
-		delete this;
+		if (!alt->_in_worker)
+		{
+			delete alt;
+			return;
+		}
+		alt->_dead = true;
+		alt->_parent = 0;
+		alt->_next_sibl = 0;
+		alt->_ref_prev_sibl = 0;
+		for (Alternative* child = alt->_children; child != 0; )
+		{
+			Alternative* next_child = child->_next_sibl;
+			_kill(child);
+			child = next_child;
+		}
+		alt->_children = 0;
+		alt->_tail_children = &alt->_children;
+	}
+	static void _release(ParseProcess* process)
+	{
+		while (process != 0)
+		{
+			ParseProcess* parent = process->_parent_process;
+			if (!process->release_ref())
+				break;
+			process->destruct();
+			process = parent;
+		}
 	}
 
 #ifdef DEBUG_ALLOC_ALT
@@ -530,10 +909,17 @@ private:
 	Alternative **_ref_prev;
 	int _success;
 	ParseProcess* _process;
+	bool _in_worker; // in the queue of a worker, or held by it
+	bool _dead;
+	ParseCall* _root_of; // the shared call of which this is the root
+	ParseCall* _waits_for; // the shared call this is a caller of
+	bool _returned; // at the end of a shared call, waiting until it is final
 	char _check_state;
 	MYALLOC
 };
 bool Alternative::_deleting = false;
+volatile long Alternative::nr_live = 0;
+long Alternative::max_live = 0;
 
 #ifdef DEBUG_ALLOC_ALT
 Alternative *Alternative::all_live = 0;
@@ -546,7 +932,341 @@ void ParsePosition::append(Alternative* alternative)
 }
 
 
-bool ParParser::parse_term( GrammarTerminal* term, AbstractParseTree &rtree )
+class ParParseWorker
+/*	Executes alternatives of the current round in a thread of its own,
+	with a scanner of its own. The changes of the tree of alternatives
+	that an execution makes, and the alternatives that it inserts, are
+	kept until it is done. Then the changes are made in order, with the
+	tree locked once, and the inserted alternatives at the current
+	position are added to its queue, the others to the parse positions
+	of the parser.
+*/
+{
+	friend class ParParser;
+	friend class ParseRootProcess;
+	friend class ParseNTProcess;
+	friend class ParseRuleProcess;
+	friend class ParseOrRuleProcess;
+	friend class ParseSeqProcess;
+	friend class ParseCallProcess;
+	friend class ParseReturnProcess;
+public:
+	ParParseWorker() : _parser(0), _scanner(0), _current_rule(0), _debug_parse(false), _debug_scan(false),
+		_changes(0), _nr_changes(0), _size_changes(0),
+		_pending(0), _nr_pending(0), _size_pending(0), _queue(0), _size_queue(0), _head(0), _queue_length(0) {}
+	~ParParseWorker() { delete[] _changes; delete[] _pending; delete[] _queue; }
+	void run();
+
+private:
+	ParParser* _parser;
+	AbstractScanner* _scanner;
+	TextFileBuffer _text;
+	GrammarRule* _current_rule;
+	bool _debug_parse;
+	bool _debug_scan;
+
+	bool parse_term(GrammarTerminal*, AbstractParseTree &rtree);
+	bool parse_ws_term(GrammarTerminal*);
+	bool parse_ident(GrammarIdent* ident, AbstractParseTree &rtree);
+	void expected_string(const char *s, bool is_keyword);
+	inline GrammarNonTerminal* findNonTerminal(Ident name) { return _parser->findNonTerminal(name); }
+
+	Alternative* addChild(Alternative* alt, int state);
+	void succeed(Alternative* alt);
+	void fail(Alternative* alt);
+	void insert(Alternative* alt);
+	void add_pending(Alternative* alt, const TextFilePos& pos);
+	void execute(Alternative* alt);
+	void call(GrammarNonTerminal* non_term, Alternative* alt);
+	void returned(ParseCall* call, Alternative* alt);
+
+	// The changes of the tree of alternatives by the execution
+	enum change_kind_t { change_link, change_succeed, change_fail, change_call, change_returned, change_expected };
+	struct change_t
+	{
+		change_kind_t kind;
+		Alternative* alt;
+		Alternative* parent; // change_link
+		GrammarNonTerminal* non_term; // change_call
+		ParseCall* call; // change_returned
+		TextFilePos pos; // change_call, change_expected
+		const char* sym; // change_expected
+		GrammarRule* rule; // change_expected
+		bool is_keyword; // change_expected
+	};
+	change_t* _changes;
+	int _nr_changes;
+	int _size_changes;
+	change_t& add_change(change_kind_t kind, Alternative* alt);
+	void make_changes(Alternative* executed);
+	void make_call(GrammarNonTerminal* non_term, const TextFilePos& pos, Alternative* alt);
+	void make_returned(ParseCall* call, Alternative* alt);
+
+	struct pending_t
+	{
+		Alternative* alt;
+		TextFilePos pos;
+	};
+	pending_t* _pending;
+	int _nr_pending;
+	int _size_pending;
+
+	// The queue: the worker takes alternatives from the head, other
+	// workers steal them from the tail
+	Mutex _queue_lock;
+	Alternative** _queue;
+	int _size_queue;
+	int _head;
+	int _queue_length;
+	void push(Alternative* alt);
+	Alternative* take();
+	Alternative* steal();
+};
+
+void ParParseWorker::push(Alternative* alt)
+{
+	// Counted before it can be taken, such that the round cannot end
+	// before it is done
+	_parser->work_queued();
+	_queue_lock.lock();
+	if (_queue_length == _size_queue)
+	{
+		int new_size = _size_queue == 0 ? 64 : 2 * _size_queue;
+		Alternative** new_queue = new Alternative*[new_size];
+		for (int i = 0; i < _queue_length; i++)
+			new_queue[i] = _queue[(_head + i) % _size_queue];
+		delete[] _queue;
+		_queue = new_queue;
+		_size_queue = new_size;
+		_head = 0;
+	}
+	_queue[(_head + _queue_length) % _size_queue] = alt;
+	_queue_length++;
+	_queue_lock.unlock();
+	_parser->work_available();
+}
+
+Alternative* ParParseWorker::take()
+{
+	Alternative* alt = 0;
+	_queue_lock.lock();
+	if (_queue_length > 0)
+	{
+		alt = _queue[_head];
+		_head = (_head + 1) % _size_queue;
+		_queue_length--;
+	}
+	_queue_lock.unlock();
+	if (alt != 0)
+		_parser->work_taken();
+	return alt;
+}
+
+Alternative* ParParseWorker::steal()
+{
+	Alternative* alt = 0;
+	_queue_lock.lock();
+	if (_queue_length > 0)
+	{
+		_queue_length--;
+		alt = _queue[(_head + _queue_length) % _size_queue];
+	}
+	_queue_lock.unlock();
+	if (alt != 0)
+		_parser->work_taken();
+	return alt;
+}
+
+ParParseWorker::change_t& ParParseWorker::add_change(change_kind_t kind, Alternative* alt)
+{
+	if (_nr_changes == _size_changes)
+	{
+		_size_changes = _size_changes == 0 ? 16 : 2 * _size_changes;
+		change_t* new_changes = new change_t[_size_changes];
+		for (int i = 0; i < _nr_changes; i++)
+			new_changes[i] = _changes[i];
+		delete[] _changes;
+		_changes = new_changes;
+	}
+	change_t& change = _changes[_nr_changes++];
+	change.kind = kind;
+	change.alt = alt;
+	return change;
+}
+
+Alternative* ParParseWorker::addChild(Alternative* alt, int state)
+{
+	Alternative* child = alt->addChild(state);
+	add_change(change_link, child).parent = alt;
+	return child;
+}
+
+void ParParseWorker::succeed(Alternative* alt)
+{
+	add_change(change_succeed, alt);
+}
+
+void ParParseWorker::fail(Alternative* alt)
+{
+	add_change(change_fail, alt);
+}
+
+void ParParseWorker::make_changes(Alternative* executed)
+/*	Makes the changes of the execution in order, with the tree locked.
+	The changes of an alternative that was killed in the meantime have
+	no effect, and the symbols that it expected are dropped.
+*/
+{
+	bool executed_dead = executed->_dead;
+	long nr_live = atomicValue(Alternative::nr_live);
+	if (nr_live > Alternative::max_live)
+		Alternative::max_live = nr_live;
+	for (int i = 0; i < _nr_changes; i++)
+	{
+		change_t& change = _changes[i];
+		switch (change.kind)
+		{
+			case change_link:
+				change.alt->link(change.parent);
+				break;
+			case change_succeed:
+				change.alt->succeed();
+				break;
+			case change_fail:
+				change.alt->_fail();
+				break;
+			case change_call:
+				make_call(change.non_term, change.pos, change.alt);
+				break;
+			case change_returned:
+				make_returned(change.call, change.alt);
+				break;
+			case change_expected:
+				if (executed_dead)
+					break;
+				_parser->_current_rule = change.rule;
+				_parser->AbstractParser::expected_string(change.pos, change.sym, change.is_keyword);
+				break;
+		}
+	}
+	_nr_changes = 0;
+	nr_live = atomicValue(Alternative::nr_live);
+	if (nr_live > Alternative::max_live)
+		Alternative::max_live = nr_live;
+}
+
+void ParParseWorker::insert(Alternative *alt)
+{
+	add_pending(alt, _text);
+	if (_debug_parse)
+	{
+		TreeLock lock;
+		printf(" insert: ");
+		alt->print(stdout);
+		printf("\n");
+	}
+}
+
+void ParParseWorker::add_pending(Alternative *alt, const TextFilePos& pos)
+{
+	if (_nr_pending == _size_pending)
+	{
+		_size_pending = _size_pending == 0 ? 16 : 2 * _size_pending;
+		pending_t* new_pending = new pending_t[_size_pending];
+		for (int i = 0; i < _nr_pending; i++)
+			new_pending[i] = _pending[i];
+		delete[] _pending;
+		_pending = new_pending;
+	}
+	_pending[_nr_pending].alt = alt;
+	_pending[_nr_pending].pos = pos;
+	_nr_pending++;
+}
+
+void ParParseWorker::execute(Alternative* alt)
+{
+	// While threads run, an alternative that was killed after it was
+	// queued, is found to be dead when its changes are made
+	if (!par_threads && alt->_dead)
+	{
+		delete alt;
+		_parser->work_done();
+		return;
+	}
+	if (_debug_parse)
+	{
+		TreeLock lock;
+		_parser->_root_alt->print(stdout, 0);
+		printf("\nExecute: ");
+		alt->print(stdout);
+		printf("\n");
+	}
+
+	_text = _parser->_round_pos;
+	alt->execute(this);
+
+	{
+		TreeLock lock;
+		make_changes(alt);
+		bool alt_inserted = false;
+		for (int i = 0; i < _nr_pending; i++)
+		{
+			Alternative* pending_alt = _pending[i].alt;
+			if (pending_alt == alt)
+				alt_inserted = true;
+			if (pending_alt->_dead)
+				delete pending_alt;
+			else if (_pending[i].pos == _parser->_round_pos)
+				push(pending_alt);
+			else
+			{
+				pending_alt->_in_worker = false;
+				_parser->insert_position(pending_alt, _pending[i].pos);
+			}
+		}
+		_parser->_nr_inserts += _nr_pending;
+		_nr_pending = 0;
+		if (!alt_inserted)
+		{
+			alt->_in_worker = false;
+			if (alt->_dead)
+				delete alt;
+		}
+	}
+	_parser->work_done();
+}
+
+void ParParseWorker::run()
+{
+	par_worker_nr = this - _parser->_workers;
+	for (;;)
+	{
+		Alternative* alt = take();
+		for (int i = 1; alt == 0 && i < _parser->_nr_workers; i++)
+			alt = _parser->_workers[(this - _parser->_workers + i) % _parser->_nr_workers].steal();
+		if (alt != 0)
+			execute(alt);
+		else if (!_parser->wait_for_work())
+			break;
+	}
+}
+
+static void run_worker(void *data)
+{
+	((ParParseWorker*)data)->run();
+}
+
+void ParParseWorker::expected_string(const char *s, bool is_keyword)
+{
+	change_t& change = add_change(change_expected, 0);
+	change.pos = _text;
+	change.sym = s;
+	change.rule = _current_rule;
+	change.is_keyword = is_keyword;
+}
+
+
+bool ParParseWorker::parse_term( GrammarTerminal* term, AbstractParseTree &rtree )
 {
 	TextFilePos start_pos = _text;
 	//if (_debug_scan)
@@ -571,7 +1291,7 @@ bool ParParser::parse_term( GrammarTerminal* term, AbstractParseTree &rtree )
 	return try_it;
 }
 
-bool ParParser::parse_ws_term( GrammarTerminal* term )
+bool ParParseWorker::parse_ws_term( GrammarTerminal* term )
 {
 	TextFilePos start_pos = _text;
 
@@ -593,7 +1313,7 @@ bool ParParser::parse_ws_term( GrammarTerminal* term )
 	return try_it;
 }
 
-bool ParParser::parse_ident(GrammarIdent* ident, AbstractParseTree &rtree)
+bool ParParseWorker::parse_ident(GrammarIdent* ident, AbstractParseTree &rtree)
 {	
 	TextFilePos start_pos = _text;
 	//if (_debug_scan)
@@ -652,7 +1372,7 @@ public:
 		return new ParseRootProcess(_root_id, state);
 	}
 
-	virtual void execute(ParParser* parser, Alternative* alt);
+	virtual void execute(ParParseWorker* parser, Alternative* alt);
 	virtual void print(FILE *fout);
 
 private:
@@ -676,7 +1396,7 @@ public:
 		return new ParseNTProcess(_non_term, state, _parent_process, _nt, _val);
 	}
 
-	virtual void execute(ParParser* parser, Alternative* alt);
+	virtual void execute(ParParseWorker* parser, Alternative* alt);
 	virtual void print(FILE *fout);
 	virtual bool printNT(FILE *fout) { printf("%s", _nt.val()); return true; }
 
@@ -704,7 +1424,7 @@ public:
 		return new ParseOrRuleProcess(_or_rule, _prev_parts, state, _parent_process);
 	}
 
-	virtual void execute(ParParser* parser, Alternative* alt);
+	virtual void execute(ParParseWorker* parser, Alternative* alt);
 	virtual void print(FILE *fout);
 
 private:
@@ -734,7 +1454,7 @@ public:
 									state, _parent_process, _optional, _avoid, _nongreedy, _sequential, _chain_sym, _start_pos, _is_terminal);
 	}
 
-	virtual void execute(ParParser* parser, Alternative* alt);
+	virtual void execute(ParParseWorker* parser, Alternative* alt);
 	virtual void print(FILE *fout);
 
 private:
@@ -767,14 +1487,15 @@ class ParseSeqProcess : public ParseProcess
 public:
 	ParseSeqProcess(GrammarRule* rule, const char *chain_sym,
 					ParsedValue* prev_seq_parts, ParsedValue* prev_parts, const Ident tree_name,
-					int state = 0, ParseProcess* parent_process = 0)
-		: ParseProcess(state, parent_process), _rule(rule), _chain_sym(chain_sym), _prev_seq_parts(prev_seq_parts), _prev_parts(prev_parts), _tree_name(tree_name) {}
+					int state = 0, ParseProcess* parent_process = 0, TextFilePos start_pos = TextFilePos())
+		: ParseProcess(state, parent_process), _rule(rule), _chain_sym(chain_sym), _prev_seq_parts(prev_seq_parts), _prev_parts(prev_parts), _tree_name(tree_name),
+		  _start_pos(start_pos) {}
 	virtual ParseProcess* clone(int state)
 	{
-		return new ParseSeqProcess(_rule, _chain_sym, _prev_seq_parts, _prev_parts, _tree_name, state, _parent_process);
+		return new ParseSeqProcess(_rule, _chain_sym, _prev_seq_parts, _prev_parts, _tree_name, state, _parent_process, _start_pos);
 	}
 
-	virtual void execute(ParParser* parser, Alternative* alt);
+	virtual void execute(ParParseWorker* parser, Alternative* alt);
 	virtual void print(FILE *fout);
 
 private:
@@ -796,7 +1517,131 @@ protected:
 
 MyAlloc ParseSeqProcess::allocs("ParseSeqProcess");
 
-void ParseRootProcess::execute(ParParser* parser, Alternative* alt)
+class ParseCallProcess : public ParseProcess
+/*	Calls a non-terminal through a shared call (see ParseCall) */
+{
+public:
+	ParseCallProcess(GrammarNonTerminal* non_term, int state = 0, ParseProcess* parent_process = 0)
+		: ParseProcess(state, parent_process), _non_term(non_term) {}
+	virtual ParseProcess* clone(int state)
+	{
+		return new ParseCallProcess(_non_term, state, _parent_process);
+	}
+
+	virtual void execute(ParParseWorker* parser, Alternative* alt);
+	virtual void print(FILE *fout);
+	virtual bool printNT(FILE *) { printf("%s", _non_term->name.val()); return true; }
+
+private:
+	// parameters:
+	GrammarNonTerminal* _non_term;
+protected:
+	virtual void destruct() { delete this; }
+	MYALLOC
+};
+
+MyAlloc ParseCallProcess::allocs("ParseCallProcess");
+
+class ParseReturnProcess : public ParseProcess
+/*	The bottom process of the alternatives of a shared call */
+{
+public:
+	ParseReturnProcess(ParseCall* call, int state = 0, ParseProcess* parent_process = 0)
+		: ParseProcess(state, parent_process), _call(call) {}
+	virtual ParseProcess* clone(int state)
+	{
+		return new ParseReturnProcess(_call, state, _parent_process);
+	}
+
+	virtual void execute(ParParseWorker* parser, Alternative* alt);
+	virtual void print(FILE *fout);
+	const TextFilePos& endPos() { return _end_pos; }
+
+private:
+	// parameters:
+	ParseCall* _call;
+	// locals:
+	TextFilePos _end_pos;
+protected:
+	virtual void destruct() { delete this; }
+	MYALLOC
+};
+
+MyAlloc ParseReturnProcess::allocs("ParseReturnProcess");
+
+void ParParseWorker::call(GrammarNonTerminal* non_term, Alternative* alt)
+{
+	change_t& change = add_change(change_call, alt);
+	change.non_term = non_term;
+	change.pos = _text;
+}
+
+void ParParseWorker::make_call(GrammarNonTerminal* non_term, const TextFilePos& pos, Alternative* alt)
+/*	Lets the alternative call the non-terminal at the position. When
+	the call is done, the alternative continues with its result at
+	once, otherwise it waits for the call, which is started when no
+	other alternative has done so yet.
+*/
+{
+	if (alt->_dead)
+		return;
+	ParseCall* call = _parser->_calls->find(pos, non_term);
+	if (call->state == ParseCall::call_succeeded)
+	{
+		_parser->_nr_reused_calls++;
+		alt->result = call->result;
+		add_pending(alt, call->end_pos);
+		return;
+	}
+	if (call->state == ParseCall::call_failed)
+	{
+		_parser->_nr_reused_calls++;
+		alt->_fail();
+		return;
+	}
+	if (call->root == 0)
+	{
+		_parser->_nr_started_calls++;
+		call->root = new Alternative(0);
+		call->root->_root_of = call;
+		call->root->cr_text = "Call";
+		Alternative* nt_alt = new Alternative(call->root);
+		nt_alt->_in_worker = true;
+		nt_alt->cr_text = "Call_NT";
+		nt_alt->call(new ParseReturnProcess(call));
+		nt_alt->call(new ParseNTProcess(non_term));
+		add_pending(nt_alt, pos);
+	}
+	else
+		_parser->_nr_shared_calls++;
+	alt->waitFor(call);
+}
+
+void ParParseWorker::returned(ParseCall* call, Alternative* alt)
+{
+	add_change(change_returned, alt).call = call;
+}
+
+void ParParseWorker::make_returned(ParseCall* call, Alternative* alt)
+/*	The alternative reached the end of the shared call. If there is no
+	alternative before it, its result is final, otherwise the parser
+	checks again after each round.
+*/
+{
+	if (alt->_dead)
+		return;
+	alt->_returned = true;
+	if (call->root->firstLeaf() == alt)
+		_parser->call_final(call, alt, this);
+	else if (!call->returned)
+	{
+		call->returned = true;
+		call->next_returned = _parser->_returned_calls;
+		_parser->_returned_calls = call;
+	}
+}
+
+void ParseRootProcess::execute(ParParseWorker* parser, Alternative* alt)
 {
 	//ParseRootProcess* process = (ParseRootProcess*)alt->process();
 
@@ -805,12 +1650,12 @@ void ParseRootProcess::execute(ParParser* parser, Alternative* alt)
 	}
 	
 	DEBUG_ENTER("Root:start")
-	alt->call(new ParseNTProcess(parser->findNonTerminal(_root_id)));
+	alt->call(new ParseCallProcess(parser->findNonTerminal(_root_id)));
 	parser->insert(alt);
 	_state = 1; return; state1:
 	DEBUG_ENTER("Root:done")
-	parser->_result = true;
-	parser->_result_tree = alt->result;
+	parser->_parser->_result = true;
+	parser->_parser->_result_tree = alt->result;
 
 	alt->finishCall(); // Just to clean-up a little bit...
 
@@ -824,7 +1669,7 @@ void ParseRootProcess::print(FILE* fout)
 	fprintf(fout, " root");
 }
 
-void ParseNTProcess::execute(ParParser* parser, Alternative* alt)
+void ParseNTProcess::execute(ParParseWorker* parser, Alternative* alt)
 {
 	//ParseNTProcess* process = (ParseNTProcess*)alt->process();
 
@@ -839,7 +1684,7 @@ void ParseNTProcess::execute(ParParser* parser, Alternative* alt)
 	{
 		for (GrammarOrRule* or_rule = _non_term->first; or_rule != 0; or_rule = or_rule->next )
 		{
-			Alternative* child_alt = alt->addChild(1);
+			Alternative* child_alt = parser->addChild(alt, 1);
 			child_alt->cr_text = "NT_Or";
 			child_alt->cr_grammar_rule = or_rule->rule;
 
@@ -852,12 +1697,12 @@ void ParseNTProcess::execute(ParParser* parser, Alternative* alt)
 
 state1:
 	DEBUG_ENTER("NT:succes")
-	alt->succeed();
+	parser->succeed(alt);
 	// return from call of ParseRuleProcess
 	{
 		for (GrammarOrRule* or_rule = _non_term->recursive; or_rule != 0; or_rule = or_rule->next )
 		{
-			Alternative* child_alt = alt->addChild(1);
+			Alternative* child_alt = parser->addChild(alt, 1);
 			child_alt->cr_text = "NT_L_Or";
 			child_alt->cr_grammar_rule = or_rule->rule;
 			ParseNTProcess* child_process = (ParseNTProcess*)child_alt->process();
@@ -868,7 +1713,7 @@ state1:
 			child_alt->call(new ParseRuleProcess(or_rule->rule, &child_process->_val, or_rule->tree_name));
 			parser->insert(child_alt);
 		}
-		Alternative* child_alt = alt->addChild(2);
+		Alternative* child_alt = parser->addChild(alt, 2);
 		child_alt->cr_text = "NT_done";
 		child_alt->result.attach(alt->result);
 		parser->insert(child_alt);
@@ -878,7 +1723,7 @@ state1:
 
 state2:
 	DEBUG_ENTER("NT:done")
-	alt->succeed();
+	parser->succeed(alt);
 	alt->finishCall();
 	alt->execute(parser);
 }
@@ -890,7 +1735,43 @@ void ParseNTProcess::print(FILE* fout)
 	fprintf(fout, " NT:%s,%d", _non_term->name.val(), _state);
 }
 
-void ParseOrRuleProcess::execute(ParParser* parser, Alternative* alt)
+void ParseCallProcess::execute(ParParseWorker* parser, Alternative* alt)
+{
+	switch (_state) {
+		case 1: goto state1;
+	}
+
+	DEBUG_ENTER("Call:start")
+	_state = 1;
+	parser->call(_non_term, alt);
+	return;
+
+state1:
+	DEBUG_ENTER("Call:done")
+	alt->finishCall();
+	alt->execute(parser);
+}
+
+void ParseCallProcess::print(FILE* fout)
+{
+	if (_parent_process != 0)
+		_parent_process->print(fout);
+	fprintf(fout, " call:%s,%d", _non_term->name.val(), _state);
+}
+
+void ParseReturnProcess::execute(ParParseWorker* parser, Alternative* alt)
+{
+	DEBUG_ENTER("Return")
+	_end_pos = parser->_text;
+	parser->returned(_call, alt);
+}
+
+void ParseReturnProcess::print(FILE* fout)
+{
+	fprintf(fout, " return");
+}
+
+void ParseOrRuleProcess::execute(ParParseWorker* parser, Alternative* alt)
 {
 	//ParseOrRuleProcess* process = (ParseOrRuleProcess*)alt->process();
 
@@ -902,7 +1783,7 @@ void ParseOrRuleProcess::execute(ParParser* parser, Alternative* alt)
 	{
 		for (GrammarOrRule* or_rule = _or_rule; or_rule != 0; or_rule = or_rule->next )
 		{
-			Alternative* child_alt = alt->addChild(1);
+			Alternative* child_alt = parser->addChild(alt, 1);
 			child_alt->cr_text = "Or";
 			child_alt->cr_grammar_rule = or_rule->rule;
 
@@ -915,7 +1796,7 @@ void ParseOrRuleProcess::execute(ParParser* parser, Alternative* alt)
 
 state1:
 	DEBUG_ENTER("Or:done")
-	alt->succeed();
+	parser->succeed(alt);
 	alt->finishCall();
 	alt->execute(parser);
 }
@@ -927,7 +1808,7 @@ void ParseOrRuleProcess::print(FILE* fout)
 	fprintf(fout, " or:%d", _state);
 }
 
-void ParseRuleProcess::execute(ParParser* parser, Alternative* alt)
+void ParseRuleProcess::execute(ParParseWorker* parser, Alternative* alt)
 {
 	//ParseRuleProcess* process = (ParseRuleProcess*)alt->process();
 
@@ -975,7 +1856,7 @@ void ParseRuleProcess::execute(ParParser* parser, Alternative* alt)
 		}
 		//DEBUG_EXIT("parse_rule = ");
 		//DEBUG_PT(_rtree); DEBUG_NL;
-		//alt->succeed();
+		//parser->succeed(alt);
 		alt->finishCall();
 		alt->execute(parser);
 		return;
@@ -1005,20 +1886,20 @@ void ParseRuleProcess::execute(ParParser* parser, Alternative* alt)
 	{
 		if (_avoid)
 		{
-			Alternative* child_alt_missing = alt->addChild(11);
+			Alternative* child_alt_missing = parser->addChild(alt, 11);
 			child_alt_missing->cr_text = "Rule_miss_avoid";
 			child_alt_missing->cr_grammar_rule = _rule;
 			parser->insert(child_alt_missing);
 		}
 
-		Alternative* child_alt_present = alt->addChild(1);
+		Alternative* child_alt_present = parser->addChild(alt, 1);
 		child_alt_present->cr_text = "Rule_pres";
 		child_alt_present->cr_grammar_rule = _rule;
 		parser->insert(child_alt_present);
 
 		if (!_avoid)
 		{
-			Alternative* child_alt_missing = alt->addChild(11);
+			Alternative* child_alt_missing = parser->addChild(alt, 11);
 			child_alt_missing->cr_text = "Rule_miss";
 			child_alt_missing->cr_grammar_rule = _rule;
 			parser->insert(child_alt_missing);
@@ -1050,7 +1931,7 @@ state1:
 				_state = 2; return; state2:
 				DEBUG_ENTER("Rule:eof");
 				if (_optional)
-					alt->succeed();
+					parser->succeed(alt);
 				alt->finishCall();
 				alt->execute(parser);
 				return;
@@ -1073,7 +1954,7 @@ state1:
             _t.createCloseContext();
             break;
 		case RK_NT:
-			alt->call(new ParseNTProcess(_rule->text.non_terminal));
+			alt->call(new ParseCallProcess(_rule->text.non_terminal));
 			parser->insert(alt);
 			_state = 3; return; state3:
 			DEBUG_ENTER("Rule:done_NT");
@@ -1089,7 +1970,7 @@ state1:
 				_try_it = parser->parse_ws_term(_rule->text.terminal);
 			else
 			{
-				alt->call(new ParseNTProcess(_rule->text.non_terminal));
+				alt->call(new ParseCallProcess(_rule->text.non_terminal));
 				parser->insert(alt);
 				_state = 4; return; state4:
 				DEBUG_ENTER("Rule:done_NT (for WS_NT)");
@@ -1107,9 +1988,9 @@ state1:
 					parser->insert(alt);
 					_state = 5; return; state5:
 					DEBUG_ENTER("Rule:done_Lit_SEQ");
-					alt->result.setLineColumn(_start_pos.line(), _start_pos.column());
+					alt->result.setOwnLineColumn(_start_pos.line(), _start_pos.column());
 					if (_optional)
-						alt->succeed();
+						parser->succeed(alt);
 					alt->finishCall();
 					alt->execute(parser);
 					return;
@@ -1124,9 +2005,9 @@ state1:
 					alt->print(stdout, 0);
 					printf("|");
 					*/
-					alt->result.setLineColumn(_start_pos.line(), _start_pos.column());
+					alt->result.setOwnLineColumn(_start_pos.line(), _start_pos.column());
 					if (_optional)
-						alt->succeed();
+						parser->succeed(alt);
 					alt->finishCall();
 					alt->execute(parser);
 					return;
@@ -1136,7 +2017,7 @@ state1:
 			{
 		    	//printf("%d.%d: acceptLiteral(%s) failed at '%s'\n", _start_pos.line(), _start_pos.column(), _rule->str_value, parser->_text.start());
 			}
-			alt->fail();
+			parser->fail(alt);
 			return;
 		}
 		case RK_CHARSET:
@@ -1178,16 +2059,16 @@ state1:
 
 	if (!_try_it)
 	{
-		alt->fail();
+		parser->fail(alt);
 		return;
 	}
 
 	/* We succeded in parsing the first element */
 	if (_optional && !_nongreedy)
-		alt->succeed();
+		parser->succeed(alt);
 
 	if (!_t.isEmpty() && _t.line() == 0)
-	    _t.setLineColumn(_start_pos.line(), _start_pos.column());
+	    _t.setOwnLineColumn(_start_pos.line(), _start_pos.column());
 
 	if (_sequential)
 	{   _seq_val.last = _t;
@@ -1198,9 +2079,9 @@ state1:
 		_state = 9; return; state9:
 		DEBUG_ENTER("Rule:done_Seq");
 		if (_is_terminal)
-            alt->result.setLineColumn(_start_pos.line(), _start_pos.column());
+            alt->result.setOwnLineColumn(_start_pos.line(), _start_pos.column());
 		if (_optional && _nongreedy)
-			alt->succeed();
+			parser->succeed(alt);
 		alt->finishCall();
 		alt->execute(parser);
 		return;
@@ -1227,9 +2108,9 @@ state1:
 		}
 #endif
 		if (_is_terminal)
-            alt->result.setLineColumn(_start_pos.line(), _start_pos.column());
+            alt->result.setOwnLineColumn(_start_pos.line(), _start_pos.column());
 		if (_optional && _nongreedy)
-			alt->succeed();
+			parser->succeed(alt);
 		alt->finishCall();
 		alt->execute(parser);
 		return;
@@ -1244,7 +2125,7 @@ state11:
 	parser->insert(alt);
 	_state = 12; return; state12:
 	DEBUG_ENTER("Rule:done_Opt");
-	alt->succeed();
+	parser->succeed(alt);
 	alt->finishCall();
 	alt->execute(parser);
 }
@@ -1261,7 +2142,7 @@ void ParseRuleProcess::print(FILE* fout)
 		fprintf(fout, "![%s]", _tree_name.val());
 }
 
-void ParseSeqProcess::execute(ParParser* parser, Alternative* alt)
+void ParseSeqProcess::execute(ParParseWorker* parser, Alternative* alt)
 {   
 	switch(_state) {
 		case 1: goto state1;
@@ -1277,20 +2158,20 @@ void ParseSeqProcess::execute(ParParser* parser, Alternative* alt)
 	{
 		if (_rule->avoid)
 		{
-			Alternative* child_alt_over = alt->addChild(6);
+			Alternative* child_alt_over = parser->addChild(alt, 6);
 			child_alt_over->cr_text = "Seq_over_avoid";
 			child_alt_over->cr_grammar_rule = _rule;
 			parser->insert(child_alt_over);
 		}
 
-		Alternative* child_alt_more = alt->addChild(1);
+		Alternative* child_alt_more = parser->addChild(alt, 1);
 		child_alt_more->cr_text = "Seq_more";
 		child_alt_more->cr_grammar_rule = _rule;
 		parser->insert(child_alt_more);
 
 		if (!_rule->avoid)
 		{
-			Alternative* child_alt_over = alt->addChild(6);
+			Alternative* child_alt_over = parser->addChild(alt, 6);
 			child_alt_over->cr_text = "Seq_over_normal";
 			child_alt_over->cr_grammar_rule = _rule;
 			parser->insert(child_alt_over);
@@ -1309,7 +2190,7 @@ state1:
 	{
 		if (!parser->_scanner->acceptLiteral(parser->_text, _chain_sym))
 		{
-			alt->fail();
+			parser->fail(alt);
 			return;
 		}
 		parser->insert(alt);
@@ -1352,7 +2233,7 @@ state1:
             break;
 		case RK_NT:
 		case RK_WS_NT:
-			alt->call(new ParseNTProcess(_rule->text.non_terminal));
+			alt->call(new ParseCallProcess(_rule->text.non_terminal));
 			parser->insert(alt);
 			_state = 3; return; state3:
 			DEBUG_ENTER("Seq:done_NT");
@@ -1408,13 +2289,13 @@ state1:
 
 	if (!_try_it)
 	{
-		alt->fail();
+		parser->fail(alt);
 		return;
 	}
 
 	/* We succeded in parsing the first element */
 	if (!_t.isEmpty() && _t.line() == 0)
-	    _t.setLineColumn(_start_pos.line(), _start_pos.column());
+	    _t.setOwnLineColumn(_start_pos.line(), _start_pos.column());
 
 	_val.last.attach(_t);
     _val.prev = _prev_seq_parts;
@@ -1423,7 +2304,7 @@ state1:
 	parser->insert(alt);
 	_state = 5; return; state5:
 	DEBUG_ENTER("Seq:try_finish");
-	alt->succeed();
+	parser->succeed(alt);
 	alt->finishCall();
 	alt->execute(parser);
 	return;
@@ -1442,7 +2323,7 @@ state6:
 	parser->insert(alt);
 	_state = 7; return; state7:
 	DEBUG_ENTER("Seq:end_finish");
-	alt->succeed();
+	parser->succeed(alt);
 	alt->finishCall();
 	alt->execute(parser);
 }
@@ -1455,36 +2336,168 @@ void ParseSeqProcess::print(FILE* fout)
 }
 
 
-void ParParser::expected_string(const char *s, bool is_keyword)
+ParParser::~ParParser()
 {
-	AbstractParser::expected_string(_text, s, is_keyword);
+	for (int i = 0; i < _nr_extra_scanners; i++)
+		delete _extra_scanners[i];
 }
 
-void ParParser::insert(Alternative *alt)
+void ParParser::addScanner(AbstractScanner* scanner)
 {
-	ParsePosition **ref_parse_pos = &_parse_position;
-	while ((*ref_parse_pos) != 0 && (*ref_parse_pos)->filePos() < _text)
-		ref_parse_pos = &(*ref_parse_pos)->next;
+	if (_nr_extra_scanners < PAR_MAX_THREADS - 1)
+		_extra_scanners[_nr_extra_scanners++] = scanner;
+}
 
-	if ((*ref_parse_pos) == 0 || (*ref_parse_pos)->filePos() > _text)
-		*ref_parse_pos = new ParsePosition(*ref_parse_pos, _text);
+void ParParser::work_queued()
+{
+	atomicIncrement(_nr_queued);
+}
 
-	(*ref_parse_pos)->append(alt);
-	if (this->_debug_parse)
+void ParParser::work_available()
+/*	Wakes up one waiting worker for the alternative that was queued.
+	The counter is changed before checking for waiting workers, and a
+	worker counts itself as waiting before checking the counter, such
+	that one of them sees the change of the other.
+*/
+{
+	atomicIncrement(_nr_in_queues);
+	if (atomicValue(_nr_waiting) > 0)
 	{
-		printf(" insert: ");
-		alt->print(stdout);
-		printf("\n");
+		_work_lock.lock();
+		_work_changed.signal();
+		_work_lock.unlock();
 	}
 }
 
+void ParParser::work_taken()
+{
+	atomicDecrement(_nr_in_queues);
+}
+
+void ParParser::work_done()
+/*	The worker that is done with the last alternative of the round,
+	starts the next round */
+{
+	if (atomicDecrement(_nr_queued) == 0)
+		next_round();
+}
+
+bool ParParser::wait_for_work()
+/*	Waits until there are alternatives in the queues. Returns false when
+	the parse is done.
+*/
+{
+	_work_lock.lock();
+	atomicIncrement(_nr_waiting);
+	// An alternative is counted after it was queued and before it is
+	// taken, hence the counter can be negative for a moment
+	while (!_done && atomicValue(_nr_in_queues) <= 0)
+		_work_changed.wait(_work_lock);
+	atomicDecrement(_nr_waiting);
+	bool done = _done;
+	_work_lock.unlock();
+	return !done;
+}
+
+void ParParser::insert_position(Alternative *alt, const TextFilePos& pos)
+{
+	_frontier->find(pos)->append(alt);
+	if (_frontier->nrPositions() > _max_positions)
+		_max_positions = _frontier->nrPositions();
+}
+
+void ParParser::call_final(ParseCall* call, Alternative* returned, ParParseWorker* worker)
+/*	The returned alternative is the final result of the call: the
+	callers continue at its end position, either through the worker
+	that executes the returned alternative, or through the parse
+	positions. The tree of the call is no longer needed.
+*/
+{
+	call->state = ParseCall::call_succeeded;
+	call->result = returned->result;
+	call->end_pos = ((ParseReturnProcess*)returned->process())->endPos();
+	Alternative* root = call->root;
+	call->root = 0;
+	while (call->waiting != 0)
+	{
+		Alternative* caller = call->waiting;
+		caller->remove();
+		caller->_waits_for = 0;
+		if (caller->_dead)
+			continue;
+		caller->result = call->result;
+		if (worker != 0 && !caller->_in_worker)
+		{
+			caller->_in_worker = true;
+			worker->add_pending(caller, call->end_pos);
+		}
+		else
+			insert_position(caller, call->end_pos);
+	}
+	Alternative::_kill(root);
+}
+
+void ParParser::next_round()
+/*	Lets the callers of the shared calls that have become final
+	continue. Then divides the alternatives at the first position over
+	the queues of the workers, or ends the parse when there are none
+	left.
+*/
+{
+	TreeLock lock;
+#ifdef TREE_CHECK
+	check(_root_alt);
+#endif
+	for (ParseCall** ref_call = &_returned_calls; *ref_call != 0; )
+	{
+		ParseCall* call = *ref_call;
+		Alternative* first = call->root != 0 ? call->root->firstLeaf() : 0;
+		if (first == 0 || first->_returned)
+		{
+			*ref_call = call->next_returned;
+			call->returned = false;
+			if (first != 0)
+				call_final(call, first, 0);
+		}
+		else
+			ref_call = &call->next_returned;
+	}
+	while (_frontier->first() != 0 && _frontier->first()->alternatives == 0)
+		_frontier->removeFirst();
+	ParsePosition* parse_position = _frontier->first();
+	if (parse_position == 0)
+	{
+		_work_lock.lock();
+		_done = true;
+		_work_changed.signalAll();
+		_work_lock.unlock();
+		return;
+	}
+
+	_round_pos = parse_position->filePos();
+	_nr_rounds++;
+	long nr_alternatives = 0;
+	for (int i = 0; parse_position->alternatives != 0; i = (i + 1) % _nr_workers)
+	{
+		Alternative* alt = parse_position->alternatives;
+		alt->remove();
+		alt->_in_worker = true;
+		_workers[i].push(alt);
+		nr_alternatives++;
+	}
+	_frontier->removeFirst();
+	if (nr_alternatives > _max_round_alternatives)
+		_max_round_alternatives = nr_alternatives;
+}
+
 void ParParser::check(Alternative* root_alt)
 {
 
 	// Mark all active alternatives
 	{
-	for (ParsePosition* parse_position = _parse_position; parse_position != 0; parse_position = parse_position->next)
+	for (int i = 0; i < _frontier->nrPositions(); i++)
 	{
+		ParsePosition* parse_position = _frontier->position(i);
 		for (Alternative* alternative = parse_position->alternatives; alternative != 0; alternative = alternative->_next)
 			alternative->_check_state = 'A';
 	}
@@ -1492,8 +2505,9 @@ void ParParser::check(Alternative* root_alt)
 	root_alt->check();
 
 	// Mark all active alternatives
-	for (ParsePosition* parse_position = _parse_position; parse_position != 0; parse_position = parse_position->next)
+	for (int i = 0; i < _frontier->nrPositions(); i++)
 	{
+		ParsePosition* parse_position = _frontier->position(i);
 		for (Alternative* alternative = parse_position->alternatives; alternative != 0; alternative = alternative->_next)
 		{
 			if (alternative->_check_state != 'F')
@@ -1508,80 +2522,119 @@ void ParParser::check(Alternative* root_alt)
 
 bool ParParser::parse(const TextFileBuffer& textBuffer, Ident root_id, AbstractParseTree& rtree)
 {
-	_text = textBuffer;
-	_f_file_pos = _text;
+	_nr_workers = 1 + _nr_extra_scanners;
+	// The nodes of an arena cannot be allocated from several threads
+	AbstractParseTreeArena::Use use_arena(_nr_workers == 1 ? _tree_arena : 0);
+	_f_file_pos = textBuffer;
 	_nr_exp_syms = 0;
-	int count = 0;
 	
 	_result = false;
-	detailed_debug = true;
 
-	_scanner->initScanning(this);
-	_scanner->skipSpace(_text);
-	Alternative* root_alt = new Alternative(0);
-	Alternative* alt = new Alternative(root_alt);
-	alt->call(new ParseRootProcess(root_id));
-	_parse_position = 0;
-	insert(alt);
-	for(;;)
+	_workers = new ParParseWorker[_nr_workers];
+	for (int i = 0; i < _nr_workers; i++)
 	{
-		count++;
-		/*printf("%d ", count);
-		if (count > 25000)
-		{
-			_debug_parse = true;
-			_debug_scan = true;
-
-			detailed_debug = true;
-		}*/
-#ifdef TREE_CHECK
-		check(root_alt);
-#endif
-		if (_debug_parse)
-			root_alt->print(stdout,0);
-		while (_parse_position != 0 && _parse_position->alternatives == 0)
-		{
-			ParsePosition *next = _parse_position->next;
-			delete _parse_position;
-			_parse_position = next;
-		}
-		if (_parse_position == 0)
-			break;
-		
-		Alternative* alt = _parse_position->alternatives;
-		if (_debug_parse)
-		{
-			printf("\nExecute: ");
-			alt->print(stdout);
-			printf("\n");
-		}
-		alt->remove();
-		_text = _parse_position->filePos();
-		alt->execute(this);
+		ParParseWorker& worker = _workers[i];
+		worker._parser = this;
+		worker._scanner = i == 0 ? _scanner : _extra_scanners[i - 1];
+		worker._text = textBuffer;
+		worker._debug_parse = _debug_parse;
+		worker._debug_scan = _debug_scan;
+		worker._scanner->initScanning(this);
 	}
 
+	ParseFrontier frontier;
+	_frontier = &frontier;
+	ParseCalls calls;
+	_calls = &calls;
+	_returned_calls = 0;
+	_nr_started_calls = 0;
+	_nr_shared_calls = 0;
+	_nr_reused_calls = 0;
+	_nr_inserts = 1;
+	_nr_rounds = 0;
+	_max_positions = 0;
+	_max_round_alternatives = 0;
+	Alternative::max_live = Alternative::nr_live;
+	long nr_live_before = Alternative::nr_live;
+
+	TextFileBuffer text = textBuffer;
+	_scanner->skipSpace(text);
+	_root_alt = new Alternative(0);
+	Alternative* alt = new Alternative(_root_alt);
+	alt->call(new ParseRootProcess(root_id));
+	insert_position(alt, text);
+	_nr_queued = 0;
+	_nr_in_queues = 0;
+	_nr_waiting = 0;
+	_done = false;
+	next_round();
+
+	par_threads = _nr_workers > 1;
+	AbstractParseTree::setSharedBetweenThreads(par_threads);
+	Thread* threads = new Thread[_nr_workers];
+	for (int i = 1; i < _nr_workers; i++)
+		threads[i].start(run_worker, &_workers[i]);
+	_workers[0].run();
+	for (int i = 1; i < _nr_workers; i++)
+		threads[i].join();
+	delete[] threads;
+	par_threads = false;
+	AbstractParseTree::setSharedBetweenThreads(false);
+
+	// Drop the calls that did not end
+	for (int i = 0; i < calls.nrBuckets(); i++)
+		for (ParseCall* call = calls.bucket(i); call != 0; call = call->next_in_bucket)
+			if (call->root != 0)
+			{
+				Alternative* root = call->root;
+				call->root = 0;
+				Alternative::_kill(root);
+			}
+	_nr_calls = calls.nrCalls();
+
 	if (_result)
 		rtree.attach(_result_tree);
+	for (int i = 0; i < _nr_workers; i++)
+		_workers[i]._scanner->doneScanning();
+	delete[] _workers;
+	_workers = 0;
+	_frontier = 0;
+	_calls = 0;
+	_max_live_alternatives = Alternative::max_live - nr_live_before;
+	_nr_left_alternatives = Alternative::nr_live - nr_live_before;
 
 #ifdef DEBUG
 	if (detailed_debug)
-		alt->print(stdout, 0);
+		_root_alt->print(stdout, 0);
 
 #endif
 
 #ifdef DEBUG_ALLOC_ALT
-	ParsePosition::allocs.print();
-	Alternative::allocs.print();
 	Alternative::print_live();
-	ParseNTProcess::allocs.print();
-	ParseOrRuleProcess::allocs.print();
-	ParseRuleProcess::allocs.print();
-	ParseSeqProcess::allocs.print();
 #endif
 
 	return _result;
 }
 
+void ParParser::printStats(FILE *f)
+{
+	fprintf(f, "par: %lu inserts, %lu rounds, max %d positions waiting, max %ld alternatives in a round\n",
+			_nr_inserts, _nr_rounds, _max_positions, _max_round_alternatives);
+	fprintf(f, "par: max %ld live alternatives, %ld left after parsing\n",
+			_max_live_alternatives, _nr_left_alternatives);
+	fprintf(f, "par: %ld calls, %lu started, %lu shared while running, %lu reused when done\n",
+			_nr_calls, _nr_started_calls, _nr_shared_calls, _nr_reused_calls);
+	ParsePosition::allocs.print(f);
+	Alternative::allocs.print(f);
+	ParseNTProcess::allocs.print(f);
+	ParseOrRuleProcess::allocs.print(f);
+	ParseRuleProcess::allocs.print(f);
+	ParseSeqProcess::allocs.print(f);
+	ParseCallProcess::allocs.print(f);
+	ParseReturnProcess::allocs.print(f);
+	ParseCall::allocs.print(f);
+}
+
 #undef DEBUG_ENTER
 //#undef DEBUG_ENTER_P1
 //#undef DEBUG_EXIT
@@ -2,38 +2,94 @@
 #define _INCLUDED_PARPARSER_H
 
 #include "ParserGrammar.h"
+#include "Threads.h"
 
 class Alternative;
 class ParsePosition;
+class ParseFrontier;
+class ParseCall;
+class ParseCalls;
+class ParParseWorker;
+
+#define PAR_MAX_THREADS 64
+
+/*	ParParser parses all alternatives in parallel, position by position.
+	The alternatives at the first position are executed by a number of
+	worker threads, one for each scanner: each worker takes alternatives
+	from its own queue, and when that is empty, steals them from the
+	queues of the other workers. A worker without work waits until
+	alternatives are queued. The alternatives that move on to a
+	further position, wait in the list of parse positions until all
+	alternatives at the current position are done; the worker that
+	finishes the last of them starts the next round.
+	A worker changes the shared tree of alternatives at the end of
+	each execution, with the tree locked once for all its changes.
+	A non-terminal is parsed only once at each position: the
+	alternatives that call it there share the parse, and continue
+	with its result when it is final (see ParseCall).
+*/
 
 class ParParser : public AbstractParser
 {
+	friend class ParParseWorker;
 	friend class ParseRootProcess;
-	friend class ParseNTProcess;
-	friend class ParseRuleProcess;
-	friend class ParseOrRuleProcess;
-	friend class ParseSeqProcess;
 public:
+	ParParser() : _nr_extra_scanners(0), _frontier(0), _calls(0), _returned_calls(0), _result(false),
+		_nr_inserts(0), _nr_rounds(0), _max_positions(0), _max_round_alternatives(0), _max_live_alternatives(0), _nr_left_alternatives(0),
+		_nr_calls(0), _nr_started_calls(0), _nr_shared_calls(0), _nr_reused_calls(0) {}
+	~ParParser();
+	// Adds a scanner for an extra worker thread, which the parser deletes
+	void addScanner(AbstractScanner* scanner);
 	bool parse(const TextFileBuffer& textBuffer, Ident root_id, AbstractParseTree& result);
-	
+	virtual void printStats(FILE *f);
+
 private:
-	bool parse_term(GrammarTerminal*, AbstractParseTree &rtree);
-	bool parse_ws_term(GrammarTerminal*);
-	bool parse_ident(GrammarIdent* ident, AbstractParseTree &rtree);
-	
-	TextFileBuffer _text;	
+	AbstractScanner* _extra_scanners[PAR_MAX_THREADS - 1];
+	int _nr_extra_scanners;
 
-	void insert(Alternative* alt);
+	void insert_position(Alternative* alt, const TextFilePos& pos);
+	void next_round();
 
-	void expected_string(const char *s, bool is_keyword);
+	ParseFrontier* _frontier;
+	ParParseWorker* _workers;
+	int _nr_workers;
+	TextFilePos _round_pos; // of the alternatives being executed
 
-	ParsePosition* _parse_position;
+	// The state of the round: the counters are atomic, the waiting
+	// workers are woken with _work_lock locked
+	Mutex _work_lock;
+	Condition _work_changed;
+	volatile long _nr_queued; // alternatives in the queues of the workers, or being executed
+	volatile long _nr_in_queues; // alternatives in the queues of the workers
+	volatile long _nr_waiting; // workers that wait for work
+	bool _done;
+	void work_queued();
+	void work_available();
+	void work_taken();
+	void work_done();
+	bool wait_for_work();
+	Alternative* _root_alt;
+
+	ParseCalls* _calls;
+	ParseCall* _returned_calls; // of which an alternative returned that is not final yet
+	void call_final(ParseCall* call, Alternative* returned, ParParseWorker* worker);
 
 	bool              _result;
 	AbstractParseTree _result_tree;
 
+	// Statistics of the last parse
+	unsigned long _nr_inserts;
+	unsigned long _nr_rounds;
+	int _max_positions; // waiting at the same time
+	long _max_round_alternatives;
+	long _max_live_alternatives;
+	long _nr_left_alternatives; // still alive after the parse
+	long _nr_calls;
+	unsigned long _nr_started_calls;
+	unsigned long _nr_shared_calls;
+	unsigned long _nr_reused_calls;
+
 	void check(Alternative* root_alt);
 };
 
 #endif // _INCLUDED_PARPARSER_H
-
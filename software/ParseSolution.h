@@ -5,13 +5,324 @@
 enum EnumSuccess { s_unknown, s_fail, s_success } ;
 
 class ParseSolution
-{	
+{
 public:
+	ParseSolution() : next(0), nt_nr(-1), success(s_unknown), examined(0), dense(0) {}
 	ParseSolution* next;
 	Ident nt;
+	int nt_nr;
 	enum EnumSuccess success;
 	AbstractParseTree result;
 	TextFilePos sp;
+	unsigned long examined; // furthest position at which the text was examined
+	ParseSolution** dense; // only used in the first solution of a position
+};
+
+/*	ParseSolutions is the packrat memo table of the back-tracking parsers.
+	It is indexed by file position and by the number of the non-terminal
+	(see GrammarNonTerminal::nr). The solutions at a position are kept in a
+	list. When the list grows beyond MEMO_SPARSE_MAX entries, a dense row
+	with a slot for each non-terminal is attached to the first solution,
+	after which a lookup is a single index operation. Solutions
+	and rows are taken from blocks, which are released all at once.
+
+	In window mode, the table only covers the positions from the last cut
+	onwards. A cut discards all solutions, and find returns 0 for positions
+	before the cut. This bounds the memory used by the table to what is
+	needed for the largest part of the input between two cuts.
+
+	Outside window mode, the table can be kept after parsing, and be
+	reused for parsing the text again after an edit (see edit).
+*/
+
+/*	MemoEdit describes an edit of the text for ParseSolutions::edit,
+	where the text from start up to old_end was replaced. The positions
+	are those in the text before the edit.
+*/
+
+struct MemoEdit
+{
+	unsigned long start;
+	unsigned long keep_from; // old_end, or the start of the next line
+	long delta; // the number of characters the text after old_end moved
+	unsigned long new_length;
+	int from_line; // the line of old_end
+	unsigned long from_line_end; // the end of that line
+	int line_delta;
+	int column_delta; // for the positions on from_line
+};
+
+#define MEMO_SPARSE_MAX		 4
+#define MEMO_BLOCK_SIZE		 1024
+#define MEMO_ROWS_PER_BLOCK	 64
+#define MEMO_WINDOW_SIZE	 4096
+
+class ParseSolutions
+{
+public:
+	ParseSolutions()
+	  : _solutions(0), _length(0), _nr_nt(0), _window(false), _base(0), _size(0), _used(0),
+	    _sol_blocks(0), _nr_free_sols(0), _row_blocks(0), _nr_free_rows(0),
+	    _bytes(0), _peak_bytes(0), _nr_solutions(0), _nr_cuts(0) {}
+	~ParseSolutions() { clear(); }
+
+	void init(unsigned long length, int nr_nt, bool window)
+	{
+		clear();
+		_length = length;
+		_nr_nt = nr_nt;
+		_window = window;
+		_base = 0;
+		_size = _window && _length+1 > MEMO_WINDOW_SIZE ? MEMO_WINDOW_SIZE : _length+1;
+		_used = 0;
+		_solutions = new ParseSolution*[_size];
+		for (unsigned long i = 0; i < _size; i++)
+			_solutions[i] = 0;
+		_bytes = _size * sizeof(ParseSolution*);
+		_peak_bytes = _bytes;
+		_nr_solutions = 0;
+		_nr_cuts = 0;
+	}
+
+	void clear()
+	{
+		free_blocks();
+		delete[] _solutions;
+		_solutions = 0;
+		_size = 0;
+		_used = 0;
+		_bytes = 0;
+	}
+
+	// Discards all solutions before filepos (and those after it as well)
+	void cut(unsigned long filepos)
+	{
+		if (!_window || filepos <= _base)
+			return;
+		free_blocks();
+		for (unsigned long i = 0; i < _used; i++)
+			_solutions[i] = 0;
+		_base = filepos;
+		_used = 0;
+		_nr_cuts++;
+	}
+
+	ParseSolution* find(unsigned long filepos, GrammarNonTerminal* non_term)
+	{
+		if (filepos > _length)
+			filepos = _length;
+		if (filepos < _base)
+			return 0;
+		unsigned long i = filepos - _base;
+		if (i >= _size)
+			grow(i);
+		if (i >= _used)
+			_used = i + 1;
+
+		ParseSolution* first = _solutions[i];
+		if (first == 0)
+			return _solutions[i] = new_solution(non_term);
+
+		if (first->dense != 0)
+		{
+			ParseSolution* &sol = first->dense[non_term->nr];
+			if (sol == 0)
+			{	sol = new_solution(non_term);
+				sol->next = first->next;
+				first->next = sol;
+			}
+			return sol;
+		}
+
+		int nr = 0;
+		ParseSolution* last = 0;
+		for (ParseSolution* sol = first; sol != 0; sol = sol->next)
+		{	if (sol->nt_nr == non_term->nr)
+				return sol;
+			last = sol;
+			nr++;
+		}
+
+		ParseSolution* sol = new_solution(non_term);
+		last->next = sol;
+		if (nr >= MEMO_SPARSE_MAX)
+		{
+			first->dense = new_row();
+			for (ParseSolution* s = first; s != 0; s = s->next)
+				first->dense[s->nt_nr] = s;
+			first->dense[non_term->nr] = sol;
+		}
+		return sol;
+	}
+
+	/*	Prepares the table for parsing the text again after an edit (see
+		MemoEdit). Solutions before the edit that examined the text from
+		start onwards are reset, solutions up to keep_from are
+		discarded, and the other solutions are moved with their result
+		trees, of which the positions are shifted as with TextFilePos::shift.
+	*/
+	void edit(const MemoEdit& edit)
+	{
+		if (_window)
+		{	init(edit.new_length, _nr_nt, _window);
+			return;
+		}
+		unsigned long i = 0;
+		for (; i < edit.start && i < _used; i++)
+			for (ParseSolution* sol = _solutions[i]; sol != 0; sol = sol->next)
+				if (sol->examined >= edit.start)
+				{	sol->success = s_unknown;
+					sol->result.clear();
+				}
+		for (; i < edit.keep_from && i < _used; i++)
+			for (ParseSolution* sol = _solutions[i]; sol != 0; sol = sol->next)
+				sol->result.clear();
+
+		/* only the trees of the solutions that start on from_line can
+		   have positions on that line */
+		unsigned long shift_trees_until = edit.line_delta != 0 ? _used : edit.from_line_end;
+		unsigned long new_size = edit.new_length + 1;
+		ParseSolution** new_solutions = new ParseSolution*[new_size];
+		for (i = 0; i < new_size; i++)
+			new_solutions[i] = 0;
+		unsigned long new_used = 0;
+		for (i = 0; i < edit.start && i < _used; i++)
+			if ((new_solutions[i] = _solutions[i]) != 0)
+				new_used = i + 1;
+		for (i = edit.keep_from; i < _used; i++)
+			if (_solutions[i] != 0)
+			{	for (ParseSolution* sol = _solutions[i]; sol != 0; sol = sol->next)
+				{	sol->examined += edit.delta;
+					if (sol->success == s_success)
+					{	sol->sp.shift(edit.delta, edit.from_line, edit.line_delta, edit.column_delta);
+						if (i < shift_trees_until)
+							sol->result.shiftPositions(edit.from_line, edit.line_delta, edit.column_delta);
+					}
+				}
+				new_solutions[i + edit.delta] = _solutions[i];
+				new_used = i + edit.delta + 1;
+			}
+		for (i = edit.keep_from; i < _used && i < shift_trees_until; i++)
+			for (ParseSolution* sol = _solutions[i]; sol != 0; sol = sol->next)
+				sol->result.endShiftPositions();
+
+		delete[] _solutions;
+		_solutions = new_solutions;
+		_bytes -= _size * sizeof(ParseSolution*);
+		add_bytes(new_size * sizeof(ParseSolution*));
+		_size = new_size;
+		_used = new_used;
+		_length = edit.new_length;
+	}
+
+	void printStats(FILE *f)
+	{
+		fprintf(f, "memo: %lu solutions, %lu cuts, peak %lu bytes\n",
+				_nr_solutions, _nr_cuts, _peak_bytes);
+	}
+
+private:
+	struct SolutionBlock
+	{
+		SolutionBlock* next;
+		ParseSolution solutions[MEMO_BLOCK_SIZE];
+	};
+	struct RowBlock
+	{
+		RowBlock* next;
+		ParseSolution** rows;
+	};
+
+	void add_bytes(unsigned long bytes)
+	{
+		_bytes += bytes;
+		if (_bytes > _peak_bytes)
+			_peak_bytes = _bytes;
+	}
+
+	void grow(unsigned long i)
+	{
+		unsigned long new_size = _size;
+		while (new_size <= i)
+			new_size *= 2;
+		ParseSolution** new_solutions = new ParseSolution*[new_size];
+		unsigned long j = 0;
+		for (; j < _size; j++)
+			new_solutions[j] = _solutions[j];
+		for (; j < new_size; j++)
+			new_solutions[j] = 0;
+		delete[] _solutions;
+		_solutions = new_solutions;
+		add_bytes((new_size - _size) * sizeof(ParseSolution*));
+		_size = new_size;
+	}
+
+	void free_blocks()
+	{
+		while (_sol_blocks != 0)
+		{	SolutionBlock* next = _sol_blocks->next;
+			delete _sol_blocks;
+			_sol_blocks = next;
+			_bytes -= sizeof(SolutionBlock);
+		}
+		_nr_free_sols = 0;
+		while (_row_blocks != 0)
+		{	RowBlock* next = _row_blocks->next;
+			delete[] _row_blocks->rows;
+			delete _row_blocks;
+			_row_blocks = next;
+			_bytes -= sizeof(RowBlock) + _nr_nt * MEMO_ROWS_PER_BLOCK * sizeof(ParseSolution*);
+		}
+		_nr_free_rows = 0;
+	}
+
+	ParseSolution* new_solution(GrammarNonTerminal* non_term)
+	{
+		if (_nr_free_sols == 0)
+		{	SolutionBlock* block = new SolutionBlock;
+			block->next = _sol_blocks;
+			_sol_blocks = block;
+			_nr_free_sols = MEMO_BLOCK_SIZE;
+			add_bytes(sizeof(SolutionBlock));
+		}
+		ParseSolution* sol = &_sol_blocks->solutions[--_nr_free_sols];
+		sol->nt = non_term->name;
+		sol->nt_nr = non_term->nr;
+		_nr_solutions++;
+		return sol;
+	}
+
+	ParseSolution** new_row()
+	{
+		if (_nr_free_rows == 0)
+		{	RowBlock* block = new RowBlock;
+			block->next = _row_blocks;
+			block->rows = new ParseSolution*[_nr_nt * MEMO_ROWS_PER_BLOCK];
+			_row_blocks = block;
+			_nr_free_rows = MEMO_ROWS_PER_BLOCK;
+			add_bytes(sizeof(RowBlock) + _nr_nt * MEMO_ROWS_PER_BLOCK * sizeof(ParseSolution*));
+		}
+		ParseSolution** row = _row_blocks->rows + _nr_nt * --_nr_free_rows;
+		for (int i = 0; i < _nr_nt; i++)
+			row[i] = 0;
+		return row;
+	}
+
+	ParseSolution** _solutions;
+	unsigned long _length;
+	int _nr_nt;
+	bool _window;
+	unsigned long _base;
+	unsigned long _size;
+	unsigned long _used;
+	SolutionBlock* _sol_blocks;
+	int _nr_free_sols;
+	RowBlock* _row_blocks;
+	int _nr_free_rows;
+	unsigned long _bytes;
+	unsigned long _peak_bytes;
+	unsigned long _nr_solutions;
+	unsigned long _nr_cuts;
 };
 
 #endif // _INCLUDED_PARSESOLUTION_H
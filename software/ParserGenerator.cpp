@@ -0,0 +1,616 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "Ident.h"
+#include "String.h"
+#include "AbstractParseTree.h"
+#include "ParserGrammar.h"
+#include "ParserGenerator.h"
+
+
+ParserGenerator::ParserGenerator(Grammar& grammar, FILE* f)
+  : _grammar(grammar), _f(f), _class_name(0),
+	_idents(0), _nr_idents(0), _size_idents(0)
+{
+	_rules = new GrammarRule*[grammar.nrRules()];
+	_tree_names = new Ident[grammar.nrRules()];
+	_nr_uses = new int[grammar.nrNonTerminals()];
+	for (int i = 0; i < grammar.nrRules(); i++)
+		_rules[i] = 0;
+	for (int i = 0; i < grammar.nrNonTerminals(); i++)
+		_nr_uses[i] = 0;
+}
+
+ParserGenerator::~ParserGenerator()
+{
+	delete[] _rules;
+	delete[] _tree_names;
+	delete[] _nr_uses;
+	delete[] _idents;
+}
+
+void ParserGenerator::collect_or_rules(GrammarOrRule* or_rule)
+{
+	for (; or_rule != 0; or_rule = or_rule->next)
+	{
+		collect_rule(or_rule->rule, or_rule->tree_name);
+		count_leading(or_rule->rule);
+		if (!or_rule->tree_name.empty())
+			ident_nr(or_rule->tree_name);
+	}
+}
+
+void ParserGenerator::collect_rule(GrammarRule* rule, Ident tree_name)
+{
+	for (; rule != 0; rule = rule->next)
+	{
+		_rules[rule->nr] = rule;
+		_tree_names[rule->nr] = tree_name;
+		switch (rule->kind)
+		{
+			case RK_TERM:
+			case RK_WS_TERM:
+				ident_nr(rule->text.terminal->name);
+				break;
+			case RK_OR_RULE:
+			case RK_COR_RULE:
+				collect_or_rules(rule->text.or_rules->first);
+				break;
+		}
+	}
+}
+
+void ParserGenerator::count_leading(GrammarRule* rule)
+/*	Counts the non-terminals with which the rule can start. A non-terminal
+	that starts only one rule is not parsed again at the same position
+	when an alternative fails, and does not need to be memoized. */
+{
+	for (; rule != 0; rule = rule->next)
+	{
+		bool nullable = rule->optional;
+		switch (rule->kind)
+		{
+			case RK_NT:
+			case RK_WS_NT:
+				_nr_uses[rule->text.non_terminal->nr]++;
+				if (rule->text.non_terminal->first_set->nullable)
+					nullable = true;
+				break;
+			case RK_LIT:
+				if (rule->str_value.empty())
+					nullable = true;
+				break;
+			case RK_WS_TERM:
+			case RK_AVOID:
+			case RK_COLOURCODING:
+			case RK_T_OPENCONTEXT:
+			case RK_T_CLOSECONTEXT:
+				nullable = true;
+				break;
+			case RK_OR_RULE:
+				/* the alternatives are counted by collect_or_rules */
+				for (GrammarOrRule* or_rule = rule->text.or_rules->first; or_rule != 0; or_rule = or_rule->next)
+					if (or_rule->first_set == 0 || or_rule->first_set->nullable)
+						nullable = true;
+				break;
+			case RK_COR_RULE:
+				return;
+		}
+		if (!nullable)
+			return;
+	}
+}
+
+int ParserGenerator::ident_nr(Ident ident)
+/*	Returns the index of ident in the table of identifiers of the
+	generated parser, adding it when needed. */
+{
+	for (int i = 0; i < _nr_idents; i++)
+		if (_idents[i] == ident)
+			return i;
+	if (_nr_idents == _size_idents)
+	{
+		_size_idents = _size_idents == 0 ? 64 : 2 * _size_idents;
+		Ident* new_idents = new Ident[_size_idents];
+		for (int i = 0; i < _nr_idents; i++)
+			new_idents[i] = _idents[i];
+		delete[] _idents;
+		_idents = new_idents;
+	}
+	_idents[_nr_idents] = ident;
+	return _nr_idents++;
+}
+
+void ParserGenerator::generate(const char* class_name)
+{
+	_class_name = class_name;
+	for (GrammarNonTerminal* nt = _grammar.allNonTerminals(); nt != 0; nt = nt->next)
+	{
+		collect_or_rules(nt->first);
+		collect_or_rules(nt->recursive);
+	}
+
+	fprintf(_f, "#include <stdio.h>\n");
+	fprintf(_f, "#include <string.h>\n");
+	fprintf(_f, "#include \"Ident.h\"\n");
+	fprintf(_f, "#include \"String.h\"\n");
+	fprintf(_f, "#include \"AbstractParseTree.h\"\n");
+	fprintf(_f, "#include \"TextFileBuffer.h\"\n");
+	fprintf(_f, "#include \"Scanner.h\"\n");
+	fprintf(_f, "#include \"AbstractParser.h\"\n");
+	fprintf(_f, "#include \"ParseSolution.h\"\n");
+	fprintf(_f, "#include \"GeneratedParser.h\"\n\n");
+
+	declarations();
+	rule_kinds();
+	constructor();
+	dispatch();
+	for (GrammarNonTerminal* nt = _grammar.allNonTerminals(); nt != 0; nt = nt->next)
+		non_terminal(nt);
+	for (int nr = 0; nr < _grammar.nrRules(); nr++)
+	{
+		GrammarRule* rule = _rules[nr];
+		if (rule == 0)
+			continue;
+		if (rule->kind == RK_OR_RULE || rule->kind == RK_COR_RULE)
+			or_rule_function(rule);
+		rule_function(rule);
+		if (rule->sequential)
+			seq_function(rule);
+	}
+}
+
+void ParserGenerator::declarations()
+{
+	fprintf(_f, "class %s : public GeneratedParser\n", _class_name);
+	fprintf(_f, "{\n");
+	fprintf(_f, "public:\n");
+	fprintf(_f, "\t%s();\n\n", _class_name);
+	fprintf(_f, "protected:\n");
+	fprintf(_f, "\tbool parse_nt(int nr, AbstractParseTree& rtree);\n\n");
+	fprintf(_f, "private:\n");
+	for (GrammarNonTerminal* nt = _grammar.allNonTerminals(); nt != 0; nt = nt->next)
+		fprintf(_f, "\tbool nt_%s(AbstractParseTree& rtree);\n", nt->name.val());
+	for (int nr = 0; nr < _grammar.nrRules(); nr++)
+	{
+		GrammarRule* rule = _rules[nr];
+		if (rule == 0)
+			continue;
+		if (rule->kind == RK_OR_RULE || rule->kind == RK_COR_RULE)
+			fprintf(_f, "\tbool or_%d(ParsedValue* prev_parts, AbstractParseTree& rtree);\n", nr);
+		fprintf(_f, "\tbool r_%d(ParsedValue* prev_parts, AbstractParseTree& rtree);\n", nr);
+		if (rule->sequential)
+			fprintf(_f, "\tbool s_%d(AbstractParseTree seq, AbstractParseTree::iterator last, ParsedValue* prev_parts, AbstractParseTree& rtree);\n", nr);
+	}
+	fprintf(_f, "\n\tIdent _ids[%d];\n", _nr_idents > 0 ? _nr_idents : 1);
+	fprintf(_f, "};\n\n");
+}
+
+void ParserGenerator::rule_kinds()
+{
+	fprintf(_f, "static const unsigned char %s_rule_kinds[%d] =\n{", _class_name, _grammar.nrRules() > 0 ? _grammar.nrRules() : 1);
+	for (int nr = 0; nr < _grammar.nrRules(); nr++)
+		fprintf(_f, "%s%d,", nr % 20 == 0 ? "\n\t" : " ", _rules[nr] != 0 ? _rules[nr]->kind : 255);
+	fprintf(_f, "\n};\n\n");
+}
+
+void ParserGenerator::constructor()
+{
+	fprintf(_f, "%s::%s()\n  : GeneratedParser(%s_rule_kinds, %d, %d)\n{\n",
+			_class_name, _class_name, _class_name, _grammar.nrRules(), _grammar.nrNonTerminals());
+	for (int i = 0; i < _nr_idents; i++)
+	{
+		fprintf(_f, "\t_ids[%d] = \"", i);
+		print_string(_idents[i].val());
+		fprintf(_f, "\";\n");
+	}
+	fprintf(_f, "}\n\n");
+}
+
+void ParserGenerator::dispatch()
+{
+	fprintf(_f, "bool %s::parse_nt(int nr, AbstractParseTree& rtree)\n{\n", _class_name);
+	fprintf(_f, "\tswitch (nr)\n\t{\n");
+	for (GrammarNonTerminal* nt = _grammar.allNonTerminals(); nt != 0; nt = nt->next)
+		fprintf(_f, "\t\tcase %d: return nt_%s(rtree);\n", nt->nr, nt->name.val());
+	fprintf(_f, "\t}\n\treturn false;\n}\n\n");
+}
+
+void ParserGenerator::non_terminal(GrammarNonTerminal* nt)
+{
+	bool memo = _nr_uses[nt->nr] > 1;
+
+	fprintf(_f, "bool %s::nt_%s(AbstractParseTree& rtree)\n{\n", _class_name, nt->name.val());
+	fprintf(_f, "\tIdent surr_nt = _current_nt;\n");
+	if (memo)
+	{
+		fprintf(_f, "\tunsigned long start_pos = _text.position();\n");
+		fprintf(_f, "\tParseSolution* sol = _solutions->find(start_pos, _non_terminals[%d]);\n", nt->nr);
+		fprintf(_f, "\tif (sol == 0)\n");
+		fprintf(_f, "\t\t; /* position is before the memo window */\n");
+		fprintf(_f, "\telse if (sol->success == s_success)\n");
+		fprintf(_f, "\t{\n\t\trtree = sol->result;\n\t\t_text = sol->sp;\n\t\treturn true;\n\t}\n");
+		fprintf(_f, "\telse if (sol->success == s_fail)\n\t\treturn false;\n");
+	}
+	fprintf(_f, "\t_current_nt = _non_terminals[%d]->name;\n\n", nt->nr);
+
+	first_set_tables(nt->first, "first", "\t");
+	first_set_tables(nt->recursive, "rec", "\t");
+	fprintf(_f, "\tif (");
+	alternatives(nt->first, "first", "(ParsedValue*)0", "\t");
+	fprintf(_f, ")\n\t{\n");
+	if (nt->recursive != 0)
+	{
+		fprintf(_f, "\t\tfor (;;)\n\t\t{\n");
+		fprintf(_f, "\t\t\tParsedValue val;\n\t\t\tval.prev = 0;\n\t\t\tval.last.attach(rtree);\n");
+		fprintf(_f, "\t\t\tif (!(");
+		alternatives(nt->recursive, "rec", "&val", "\t\t\t");
+		fprintf(_f, "))\n\t\t\t{\n\t\t\t\trtree = val.last;\n\t\t\t\tbreak;\n\t\t\t}\n\t\t}\n");
+	}
+	fprintf(_f, "\t\t_current_nt = surr_nt;\n");
+	if (memo)
+	{
+		fprintf(_f, "\t\t/* the memo window may have been cut while parsing */\n");
+		fprintf(_f, "\t\tsol = _solutions->find(start_pos, _non_terminals[%d]);\n", nt->nr);
+		fprintf(_f, "\t\tif (sol != 0)\n\t\t{\n\t\t\tsol->result = rtree;\n\t\t\tsol->success = s_success;\n\t\t\tsol->sp = _text;\n\t\t}\n");
+	}
+	fprintf(_f, "\t\treturn true;\n\t}\n");
+	fprintf(_f, "\t_current_nt = surr_nt;\n");
+	if (memo)
+	{
+		fprintf(_f, "\tsol = _solutions->find(start_pos, _non_terminals[%d]);\n", nt->nr);
+		fprintf(_f, "\tif (sol != 0)\n\t\tsol->success = s_fail;\n");
+	}
+	fprintf(_f, "\treturn false;\n}\n\n");
+}
+
+void ParserGenerator::first_set_tables(GrammarOrRule* or_rule, const char* name, const char* indent)
+/*	Writes the tables with the first characters of the alternatives
+	that are checked by alternatives(). */
+{
+	for (int i = 0; or_rule != 0; or_rule = or_rule->next, i++)
+	{
+		GrammarFirstSet* first_set = or_rule->first_set;
+		if (first_set != 0 && !first_set->any && !first_set->nullable)
+		{
+			fprintf(_f, "%sstatic const unsigned int %s_%d[8] = ", indent, name, i);
+			set_table(first_set->chars);
+			fprintf(_f, ";\n");
+		}
+	}
+}
+
+void ParserGenerator::alternatives(GrammarOrRule* or_rule, const char* name, const char* prev_parts, const char* indent)
+/*	Writes the condition that one of the alternatives can be parsed,
+	in the order of the grammar. */
+{
+	if (or_rule == 0)
+	{
+		fprintf(_f, "false");
+		return;
+	}
+	for (int i = 0; or_rule != 0; or_rule = or_rule->next, i++)
+	{
+		if (i > 0)
+			fprintf(_f, "\n%s    || ", indent);
+		GrammarFirstSet* first_set = or_rule->first_set;
+		bool check = first_set != 0 && !first_set->any && !first_set->nullable;
+		if (check)
+			fprintf(_f, "(may_start_with(%s_%d, 0x%lxUL) && ", name, i, first_set->terminals);
+		if (or_rule->rule != 0)
+			fprintf(_f, "r_%d(%s, rtree)", or_rule->rule->nr, prev_parts);
+		else
+			end_call(or_rule->tree_name, prev_parts);
+		if (check)
+			fprintf(_f, ")");
+	}
+}
+
+void ParserGenerator::or_rule_function(GrammarRule* rule)
+{
+	fprintf(_f, "bool %s::or_%d(ParsedValue* prev_parts, AbstractParseTree& rtree)\n{\n", _class_name, rule->nr);
+	first_set_tables(rule->text.or_rules->first, "first", "\t");
+	fprintf(_f, "\treturn ");
+	alternatives(rule->text.or_rules->first, "first", "prev_parts", "\t");
+	fprintf(_f, ";\n}\n\n");
+}
+
+void ParserGenerator::next_call(GrammarRule* rule, const char* prev_parts)
+{
+	if (rule->next != 0)
+		fprintf(_f, "r_%d(%s, rtree)", rule->next->nr, prev_parts);
+	else
+		end_call(_tree_names[rule->nr], prev_parts);
+}
+
+void ParserGenerator::end_call(Ident tree_name, const char* prev_parts)
+{
+	if (!tree_name.empty())
+		fprintf(_f, "make_tree(_ids[%d], %s, rtree)", ident_nr(tree_name), prev_parts);
+	else
+		fprintf(_f, "make_list(%s, rtree)", prev_parts);
+}
+
+void ParserGenerator::accept_literal(const char* sym)
+{
+	if (sym != 0 && *sym != '\0')
+		fprintf(_f, "(!_use_first_sets || (unsigned char)*_text == %d) && ", (unsigned char)*sym);
+	fprintf(_f, "_scanner->acceptLiteral(_text, \"");
+	print_string(sym);
+	fprintf(_f, "\")");
+}
+
+void ParserGenerator::char_set_table(const GrammarCharSet& char_set)
+{
+	fprintf(_f, "\t\tstatic const unsigned int chars[8] = ");
+	set_table(char_set);
+	fprintf(_f, ";\n");
+}
+
+void ParserGenerator::set_table(const GrammarCharSet& char_set)
+{
+	fprintf(_f, "{");
+	for (int i = 0; i < 8; i++)
+	{
+		unsigned int bits = 0;
+		for (int j = 0; j < 32; j++)
+			if (char_set.contains_char(i * 32 + j))
+				bits |= 1U << j;
+		fprintf(_f, "%s0x%x", i > 0 ? "," : "", bits);
+	}
+	fprintf(_f, "}");
+}
+
+void ParserGenerator::element_done(GrammarRule* rule, bool is_terminal)
+/*	Writes what follows after the element has been parsed into t. */
+{
+	fprintf(_f, "\t\tif (try_it)\n\t\t{\n");
+	fprintf(_f, "\t\t\tif (!t.isEmpty() && t.line() == 0)\n");
+	fprintf(_f, "\t\t\t\tt.setLineColumn(start_pos.line(), start_pos.column());\n");
+	if (rule->sequential)
+	{
+		fprintf(_f, "\t\t\tAbstractParseTree seq;\n\t\t\tseq.createList();\n");
+		fprintf(_f, "\t\t\tAbstractParseTree::iterator last;\n\t\t\tseq.appendChild(t, last);\n");
+		fprintf(_f, "\t\t\tif (s_%d(seq, last, prev_parts, rtree))\n", rule->nr);
+	}
+	else
+	{
+		fprintf(_f, "\t\t\tParsedValue val;\n\t\t\tval.last = t;\n\t\t\tval.prev = prev_parts;\n");
+		fprintf(_f, "\t\t\tif (");
+		next_call(rule, "&val");
+		fprintf(_f, ")\n");
+	}
+	fprintf(_f, "\t\t\t{\n");
+	if (is_terminal)
+		fprintf(_f, "\t\t\t\trtree.setLineColumn(start_pos.line(), start_pos.column());\n");
+	fprintf(_f, "\t\t\t\treturn true;\n\t\t\t}\n\t\t}\n");
+}
+
+void ParserGenerator::rule_function(GrammarRule* rule)
+{
+	int nr = rule->nr;
+	fprintf(_f, "bool %s::r_%d(ParsedValue* prev_parts, AbstractParseTree& rtree)\n{\n", _class_name, nr);
+	fprintf(_f, "\tTextFilePos sp = _text;\n");
+	fprintf(_f, "\t_current_rule = _rules[%d];\n", nr);
+	fprintf(_f, "\tif (_fail_pos[%d] == _text.position())\n\t\treturn false;\n\n", nr);
+
+	if (rule->optional && rule->avoid)
+	{
+		fprintf(_f, "\t{\n\t\tParsedValue val;\n\t\tval.prev = prev_parts;\n\t\tif (");
+		next_call(rule, "&val");
+		fprintf(_f, ")\n\t\t\treturn true;\n\t\t_text = sp;\n\t}\n\n");
+	}
+
+	fprintf(_f, "\t{\n\t\tAbstractParseTree t;\n\t\tTextFilePos start_pos = _text;\n");
+	switch (rule->kind)
+	{
+		case RK_T_EOF:
+			fprintf(_f, "\t\tbool try_it = _scanner->acceptEOF(_text);\n");
+			fprintf(_f, "\t\tif (!try_it)\n\t\t\texpected_string(\"eof\", false);\n");
+			fprintf(_f, "\t\tif (try_it && ");
+			next_call(rule, "prev_parts");
+			fprintf(_f, ")\n\t\t\treturn true;\n");
+			element_done(rule, false);
+			break;
+		case RK_TERM:
+			fprintf(_f, "\t\tbool try_it = parse_term(_ids[%d], t);\n", ident_nr(rule->text.terminal->name));
+			element_done(rule, true);
+			break;
+		case RK_IDENT:
+			fprintf(_f, "\t\tbool try_it = parse_ident(_rules[%d]->text.ident, t);\n", nr);
+			element_done(rule, false);
+			break;
+		case RK_T_OPENCONTEXT:
+		case RK_T_CLOSECONTEXT:
+			fprintf(_f, "\t\tbool try_it = true;\n");
+			fprintf(_f, "\t\tt.%s();\n", rule->kind == RK_T_OPENCONTEXT ? "createOpenContext" : "createCloseContext");
+			element_done(rule, false);
+			break;
+		case RK_NT:
+			fprintf(_f, "\t\tbool try_it = nt_%s(t);\n", rule->text.non_terminal->name.val());
+			element_done(rule, false);
+			break;
+		case RK_WS_TERM:
+		case RK_WS_NT:
+		case RK_LIT:
+			fprintf(_f, "\t\tif (");
+			if (rule->kind == RK_LIT)
+				accept_literal(rule->str_value);
+			else if (rule->kind == RK_WS_TERM)
+				fprintf(_f, "parse_ws_term(_ids[%d])", ident_nr(rule->text.terminal->name));
+			else
+				fprintf(_f, "nt_%s(t)", rule->text.non_terminal->name.val());
+			fprintf(_f, ")\n\t\t{\n");
+			if (rule->sequential)
+			{
+				fprintf(_f, "\t\t\tAbstractParseTree seq;\n\t\t\tseq.createList();\n");
+				fprintf(_f, "\t\t\tif (s_%d(seq, AbstractParseTree::iterator(), prev_parts, rtree))\n", nr);
+			}
+			else
+			{
+				fprintf(_f, "\t\t\tif (");
+				next_call(rule, "prev_parts");
+				fprintf(_f, ")\n");
+			}
+			fprintf(_f, "\t\t\t{\n\t\t\t\trtree.setLineColumn(start_pos.line(), start_pos.column());\n\t\t\t\treturn true;\n\t\t\t}\n\t\t}\n");
+			if (rule->optional)
+			{
+				fprintf(_f, "\t\telse if (");
+				next_call(rule, "prev_parts");
+				fprintf(_f, ")\n\t\t{\n\t\t\trtree.setLineColumn(start_pos.line(), start_pos.column());\n\t\t\treturn true;\n\t\t}\n");
+			}
+			fprintf(_f, "\t\telse\n\t\t\texpected_string(\"");
+			print_string(rule->str_value);
+			fprintf(_f, "\", true);\n");
+			break;
+		case RK_CHARSET:
+			char_set_table(*rule->text.char_set);
+			fprintf(_f, "\t\tbool try_it = in_set(chars, *_text);\n");
+			fprintf(_f, "\t\tif (!try_it)\n\t\t\texpected_string(\"<charset>\", false);\n");
+			fprintf(_f, "\t\telse\n\t\t{\n\t\t\tt.createCharAtom(*_text);\n\t\t\t_text.next();\n\t\t\t_scanner->skipSpace(_text);\n\t\t}\n");
+			element_done(rule, false);
+			break;
+		case RK_AVOID:
+			char_set_table(*rule->text.char_set);
+			fprintf(_f, "\t\tbool try_it = !in_set(chars, *_text);\n");
+			element_done(rule, false);
+			break;
+		case RK_COLOURCODING:
+			fprintf(_f, "\t\tbool try_it = true;\n");
+			element_done(rule, false);
+			break;
+		case RK_OR_RULE:
+			fprintf(_f, "\t\tbool try_it = or_%d((ParsedValue*)0, t);\n", nr);
+			element_done(rule, false);
+			break;
+		case RK_COR_RULE:
+			fprintf(_f, "\t\tif (or_%d(prev_parts, rtree))\n\t\t\treturn true;\n", nr);
+			fprintf(_f, "\t\t_text = sp;\n\t\t_fail_pos[%d] = _text.position();\n\t\treturn false;\n\t}\n}\n\n", nr);
+			return;
+		default:
+			break;
+	}
+	fprintf(_f, "\t\t_text = sp;\n\t}\n\n");
+
+	if (rule->optional && !rule->avoid)
+	{
+		fprintf(_f, "\t{\n\t\tParsedValue val;\n\t\tval.prev = prev_parts;\n\t\tif (");
+		next_call(rule, "&val");
+		fprintf(_f, ")\n\t\t\treturn true;\n\t\t_text = sp;\n\t}\n\n");
+	}
+
+	fprintf(_f, "\t_fail_pos[%d] = _text.position();\n\treturn false;\n}\n\n", nr);
+}
+
+void ParserGenerator::seq_function(GrammarRule* rule)
+{
+	int nr = rule->nr;
+	const char* chain_sym = rule->chain_symbol;
+
+	fprintf(_f, "bool %s::s_%d(AbstractParseTree seq, AbstractParseTree::iterator last, ParsedValue* prev_parts, AbstractParseTree& rtree)\n{\n", _class_name, nr);
+	fprintf(_f, "\tTextFilePos sp = _text;\n");
+	fprintf(_f, "\t_current_rule = _rules[%d];\n\n", nr);
+
+	if (rule->avoid)
+	{
+		fprintf(_f, "\t{\n\t\tParsedValue val;\n\t\tval.last = seq;\n\t\tval.prev = prev_parts;\n\t\tif (");
+		next_call(rule, "&val");
+		fprintf(_f, ")\n\t\t\treturn true;\n\t\t_text = sp;\n\t}\n\n");
+	}
+
+	if (*chain_sym != '\0')
+	{
+		fprintf(_f, "\tif (_scanner->acceptLiteral(_text, \"");
+		print_string(chain_sym);
+		fprintf(_f, "\"))\n");
+	}
+	fprintf(_f, "\t{\n\t\tAbstractParseTree t;\n\t\tTextFilePos start_pos = _text;\n");
+	switch (rule->kind)
+	{
+		case RK_T_EOF:
+			fprintf(_f, "\t\tbool try_it = _scanner->acceptEOF(_text);\n");
+			fprintf(_f, "\t\tif (try_it)\n\t\t\tt = Ident(\"EOF\").val();\n");
+			break;
+		case RK_TERM:
+			fprintf(_f, "\t\tbool try_it = parse_term(_ids[%d], t);\n", ident_nr(rule->text.terminal->name));
+			break;
+		case RK_WS_TERM:
+			fprintf(_f, "\t\tbool try_it = parse_ws_term(_ids[%d]);\n", ident_nr(rule->text.terminal->name));
+			break;
+		case RK_IDENT:
+			fprintf(_f, "\t\tbool try_it = parse_ident(_rules[%d]->text.ident, t);\n", nr);
+			break;
+		case RK_NT:
+			fprintf(_f, "\t\tbool try_it = nt_%s(t);\n", rule->text.non_terminal->name.val());
+			break;
+		case RK_WS_NT:
+			fprintf(_f, "\t\tbool try_it = nt_%s(t);\n\t\tt.clear();\n", rule->text.non_terminal->name.val());
+			break;
+		case RK_LIT:
+			fprintf(_f, "\t\tbool try_it = ");
+			accept_literal(rule->str_value);
+			fprintf(_f, ";\n\t\tif (!try_it)\n\t\t\texpected_string(\"");
+			print_string(rule->str_value);
+			fprintf(_f, "\", true);\n");
+			break;
+		case RK_CHARSET:
+			char_set_table(*rule->text.char_set);
+			fprintf(_f, "\t\tbool try_it = in_set(chars, *_text);\n");
+			fprintf(_f, "\t\tif (!try_it)\n\t\t\texpected_string(\"<charset>\", false);\n");
+			fprintf(_f, "\t\telse\n\t\t{\n\t\t\tt.createCharAtom(*_text);\n\t\t\t_text.next();\n\t\t\t_scanner->skipSpace(_text);\n\t\t}\n");
+			break;
+		case RK_AVOID:
+			char_set_table(*rule->text.char_set);
+			fprintf(_f, "\t\tbool try_it = !in_set(chars, *_text);\n");
+			break;
+		case RK_COLOURCODING:
+			fprintf(_f, "\t\tbool try_it = true;\n");
+			break;
+		case RK_OR_RULE:
+			fprintf(_f, "\t\tbool try_it = or_%d((ParsedValue*)0, t);\n", nr);
+			break;
+		default:
+			fprintf(_f, "\t\tbool try_it = false;\n");
+			break;
+	}
+	fprintf(_f, "\t\tif (try_it)\n\t\t{\n");
+	fprintf(_f, "\t\t\tif (!t.isEmpty() && t.line() == 0)\n");
+	fprintf(_f, "\t\t\t\tt.setLineColumn(start_pos.line(), start_pos.column());\n");
+	fprintf(_f, "\t\t\tAbstractParseTree::iterator before_last = last;\n");
+	fprintf(_f, "\t\t\tseq.appendChild(t, last);\n");
+	fprintf(_f, "\t\t\t/* an element of the top-level list is complete: the memo\n");
+	fprintf(_f, "\t\t\t   entries before this position are not likely to be used */\n");
+	fprintf(_f, "\t\t\tif (_memo_window && _current_nt == _root_nt)\n");
+	fprintf(_f, "\t\t\t\t_solutions->cut(_text.position());\n");
+	fprintf(_f, "\t\t\tif (s_%d(seq, last, prev_parts, rtree))\n\t\t\t\treturn true;\n", nr);
+	fprintf(_f, "\t\t\tseq.dropLastChild(before_last);\n\t\t}\n");
+	fprintf(_f, "\t\telse\n\t\t\texpected_string(\"");
+	print_string(chain_sym);
+	fprintf(_f, "\", true);\n");
+	fprintf(_f, "\t\t_text = sp;\n\t}\n\n");
+
+	if (!rule->avoid)
+	{
+		fprintf(_f, "\t{\n\t\tParsedValue val;\n\t\tval.last = seq;\n\t\tval.prev = prev_parts;\n\t\tif (");
+		next_call(rule, "&val");
+		fprintf(_f, ")\n\t\t\treturn true;\n\t\t_text = sp;\n\t}\n\n");
+	}
+	fprintf(_f, "\treturn false;\n}\n\n");
+}
+
+void ParserGenerator::print_string(const char* str)
+{
+	for (const unsigned char *s = (const unsigned char*)str; *s != '\0'; s++)
+		if (*s == '\n')
+			fprintf(_f, "\\n");
+		else if (*s == '\t')
+			fprintf(_f, "\\t");
+		else if (*s == '\\')
+			fprintf(_f, "\\\\");
+		else if (*s == '"')
+			fprintf(_f, "\\\"");
+		else if (*s < ' ' || *s >= 127)
+			fprintf(_f, "\\%03o", *s);
+		else
+			fprintf(_f, "%c", *s);
+}
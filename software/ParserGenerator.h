@@ -0,0 +1,60 @@
+#ifndef _INCLUDED_PARSERGENERATOR_H
+#define _INCLUDED_PARSERGENERATOR_H
+
+#include "ParserGrammar.h"
+
+/*	ParserGenerator writes a C++ parser class for a grammar (option -ogp).
+	The class is derived from GeneratedParser and has a function for each
+	non-terminal (nt_), for each element of a rule (r_), for each sequence
+	(s_) and for each group of alternatives (or_). These follow BTParser,
+	with the kind of each element, its flags and the tree names resolved
+	when generating. Before an alternative is tried, the current character
+	is looked up in its FIRST set, and literals are only passed to the
+	scanner when they start with the current character. Only non-terminals
+	with which more than one rule can start are memoized.
+*/
+
+class ParserGenerator
+{
+public:
+	ParserGenerator(Grammar& grammar, FILE* f);
+	~ParserGenerator();
+
+	void generate(const char* class_name);
+
+private:
+	void collect_or_rules(GrammarOrRule* or_rule);
+	void collect_rule(GrammarRule* rule, Ident tree_name);
+	void count_leading(GrammarRule* rule);
+	int ident_nr(Ident ident);
+
+	void declarations();
+	void rule_kinds();
+	void constructor();
+	void dispatch();
+	void non_terminal(GrammarNonTerminal* nt);
+	void or_rule_function(GrammarRule* rule);
+	void rule_function(GrammarRule* rule);
+	void seq_function(GrammarRule* rule);
+	void first_set_tables(GrammarOrRule* or_rule, const char* name, const char* indent);
+	void alternatives(GrammarOrRule* or_rule, const char* name, const char* prev_parts, const char* indent);
+	void next_call(GrammarRule* rule, const char* prev_parts);
+	void end_call(Ident tree_name, const char* prev_parts);
+	void accept_literal(const char* sym);
+	void char_set_table(const GrammarCharSet& char_set);
+	void set_table(const GrammarCharSet& char_set);
+	void element_done(GrammarRule* rule, bool is_terminal);
+	void print_string(const char* str);
+
+	Grammar& _grammar;
+	FILE* _f;
+	const char* _class_name;
+	GrammarRule** _rules; // indexed by GrammarRule::nr
+	Ident* _tree_names; // tree name at the end of the rule, indexed by GrammarRule::nr
+	int* _nr_uses; // number of rules that can start with it, indexed by GrammarNonTerminal::nr
+	Ident* _idents;
+	int _nr_idents;
+	int _size_idents;
+};
+
+#endif // _INCLUDED_PARSERGENERATOR_H
@@ -19,6 +19,20 @@ void GrammarCharSet::add_range(unsigned char from, unsigned char to)
 	add_char(to); // just in case to equals 255
 }
 
+void GrammarCharSet::add_set(const GrammarCharSet& char_set)
+{
+	for (int i = 0; i < 8; i++)
+		_range[i] |= char_set._range[i];
+}
+
+bool GrammarCharSet::equal(const GrammarCharSet& char_set) const
+{
+	for (int i = 0; i < 8; i++)
+		if (_range[i] != char_set._range[i])
+			return false;
+	return true;
+}
+
 void GrammarCharSet::RangeIterator::next()
 {
 	_more = false;
@@ -159,7 +173,7 @@ GrammarRule* Grammar::make_rule(AbstractParseTree::iterator rule, GrammarOrRule*
     if (!rule.more())
         return 0;
 
-    result = new GrammarRule;
+    result = newRule();
 
     AbstractParseTree elem = rule;
 
@@ -215,7 +229,7 @@ GrammarRule* Grammar::make_rule(AbstractParseTree::iterator rule, GrammarOrRule*
 			else
         	{
         		result->kind = RK_TERM;
-        		result->text.terminal = new GrammarTerminal(name);
+        		result->text.terminal = findTerminal(name);
         	}
         }
     }
@@ -237,7 +251,7 @@ GrammarRule* Grammar::make_rule(AbstractParseTree::iterator rule, GrammarOrRule*
     else if (elem.isTree(id_identalone))
     {
         result->kind = RK_TERM;
-        result->text.terminal = new GrammarTerminal(id_ident);
+        result->text.terminal = findTerminal(id_ident);
     }
     else if (elem.isTree(id_identdef))
     {
@@ -347,7 +361,7 @@ GrammarRule* Grammar::make_rule(CombinedRule* rules)
 		if (!rule->rule.more() || !equivalent(rules->rule, rule->rule))
 			all_equivalent = false;
 
-    result = new GrammarRule;
+    result = newRule();
 	if (all_equivalent)
 	{
 		AbstractParseTree elem = rules->rule;
@@ -368,7 +382,7 @@ GrammarRule* Grammar::make_rule(CombinedRule* rules)
 				else
         		{
         			result->kind = RK_TERM;
-        			result->text.terminal = new GrammarTerminal(name);
+        			result->text.terminal = findTerminal(name);
         		}
 			}
 		}
@@ -380,7 +394,7 @@ GrammarRule* Grammar::make_rule(CombinedRule* rules)
 		else if (elem.isTree(id_identalone))
 		{
 			result->kind = RK_TERM;
-			result->text.terminal = new GrammarTerminal(id_ident);
+			result->text.terminal = findTerminal(id_ident);
 		}
 
 		for (CombinedRule* rule = rules; rule != 0; rule = rule->next)
@@ -454,6 +468,12 @@ GrammarOrRule* Grammar::make_or_rule(AbstractParseTree::iterator or_rule)
 void Grammar::loadGrammar(const AbstractParseTree& root)
 {
 	_all_nt = 0;
+	_nr_nt = 0;
+	_nr_rules = 0;
+	_nr_t = 0;
+	_nr_predictions = 0;
+	_all_t = 0;
+	_all_l = 0;
 	GrammarNonTerminal **ref_nt = &_all_nt;
 
     for (AbstractParseTree::iterator rules1(root); rules1.more(); rules1.next())
@@ -464,7 +484,7 @@ void Grammar::loadGrammar(const AbstractParseTree& root)
 			
 			if (findNonTerminal(nt_name) == 0)
 			{
-				*ref_nt = new GrammarNonTerminal(nt_name);
+				*ref_nt = new GrammarNonTerminal(nt_name, _nr_nt++);
 				ref_nt = &(*ref_nt)->next;
 			}
 		}
@@ -560,6 +580,9 @@ void Grammar::loadGrammar(const AbstractParseTree& root)
             }
         }
     }
+	computeFirstSets();
+	computePredictions();
+
 	if(false)
     {	GrammarNonTerminal* nt;
     
@@ -586,6 +609,23 @@ void Grammar::loadGrammar(const AbstractParseTree& root)
     }		    
 }
 
+void Grammar::shareGrammar(const Grammar& grammar)
+/*	Makes this grammar use the (already loaded) rules of the given
+	grammar. The rules are not modified while parsing, hence they
+	can be used by several parsers at the same time. The rules are
+	never freed.
+*/
+{
+	_all_nt = grammar._all_nt;
+	_nr_nt = grammar._nr_nt;
+	_nr_rules = grammar._nr_rules;
+	_nr_t = grammar._nr_t;
+	_nr_predictions = grammar._nr_predictions;
+	_all_t = grammar._all_t;
+	_all_l = grammar._all_l;
+	_for_unparse = grammar._for_unparse;
+}
+
 GrammarNonTerminal* Grammar::findNonTerminal(Ident name)
 {
 	for (GrammarNonTerminal* nt = _all_nt; nt != 0; nt = nt->next)
@@ -602,7 +642,7 @@ GrammarNonTerminal* Grammar::addNonTerminal(Ident name)
 		if ((*ref_nt)->name == name)
 			return (*ref_nt);
 
-	*ref_nt = new GrammarNonTerminal(name);
+	*ref_nt = new GrammarNonTerminal(name, _nr_nt++);
 	return *ref_nt;
 }
 
@@ -613,18 +653,508 @@ GrammarTerminal* Grammar::findTerminal(Ident name)
 		if ((*ref_t)->name == name)
 			return (*ref_t);
 	
-	*ref_t = new GrammarTerminal(name);
+	*ref_t = new GrammarTerminal(name, _nr_t++);
 
 	return *ref_t;
 }
 
-class GrammarLiteral
+void Grammar::computeFirstSets()
+/*	Computes the FIRST sets of all non-terminals and of all alternatives,
+	such that a parser can skip the alternatives that cannot match the
+	current character. The sets of the non-terminals are computed by
+	iterating until nothing changes. The left-recursive alternatives only
+	add to the set of a non-terminal when its other alternatives can be
+	empty.
+*/
 {
-public:
-	GrammarLiteral(Ident n_value) : value(n_value), next(0) {}
-	Ident value;
-	GrammarLiteral* next;
-};
+	GrammarNonTerminal* nt;
+	for (nt = _all_nt; nt != 0; nt = nt->next)
+		if (nt->first_set == 0)
+			nt->first_set = new GrammarFirstSet;
+
+	for (bool changed = true; changed; )
+	{
+		changed = false;
+		for (nt = _all_nt; nt != 0; nt = nt->next)
+		{
+			GrammarFirstSet first_set;
+			first_set.nullable = add_first_of_or_rules(nt->first, first_set);
+			if (first_set.nullable)
+				add_first_of_or_rules(nt->recursive, first_set);
+			if (!first_set.equal(*nt->first_set))
+			{
+				*nt->first_set = first_set;
+				changed = true;
+			}
+		}
+	}
+
+	for (nt = _all_nt; nt != 0; nt = nt->next)
+	{
+		set_first_of_or_rules(nt->first);
+		set_first_of_or_rules(nt->recursive);
+	}
+}
+
+bool Grammar::add_first_of_rule(GrammarRule* rule, GrammarFirstSet& first_set)
+/*	Adds the characters with which the given rule can start to first_set,
+	and returns whether the rule can match the empty string.
+*/
+{
+	for (; rule != 0; rule = rule->next)
+	{
+		bool nullable = add_first_of_element(rule, first_set);
+		/* the alternatives of a combined rule include the rest of the rule */
+		if (!nullable || rule->kind == RK_COR_RULE)
+			return nullable;
+	}
+	return true;
+}
+
+bool Grammar::add_first_of_element(GrammarRule* rule, GrammarFirstSet& first_set)
+/*	Adds the characters with which the element rule can start to
+	first_set, and returns whether it can match the empty string.
+*/
+{
+	bool nullable = rule->optional;
+	switch (rule->kind)
+	{
+		case RK_LIT:
+		{	const char* sym = rule->str_value;
+			if (sym == 0 || *sym == '\0')
+				nullable = true;
+			else
+				first_set.chars.add_char(*sym);
+			break;
+		}
+		case RK_TERM:
+			add_first_of_terminal(rule->text.terminal, first_set);
+			break;
+		case RK_IDENT:
+			add_first_of_terminal(rule->text.ident->terminal, first_set);
+			break;
+		case RK_T_EOF:
+			first_set.chars.add_char('\0');
+			break;
+		case RK_CHARSET:
+			first_set.chars.add_set(*rule->text.char_set);
+			break;
+		case RK_NT:
+		case RK_WS_NT:
+			first_set.add(*rule->text.non_terminal->first_set);
+			if (rule->text.non_terminal->first_set->nullable)
+				nullable = true;
+			break;
+		case RK_WS_TERM:
+		case RK_AVOID:
+		case RK_COLOURCODING:
+		case RK_T_OPENCONTEXT:
+		case RK_T_CLOSECONTEXT:
+			nullable = true;
+			break;
+		case RK_OR_RULE:
+		case RK_COR_RULE:
+			if (add_first_of_or_rules(rule->text.or_rules->first, first_set))
+				nullable = true;
+			break;
+		default:
+			first_set.any = true;
+			nullable = true;
+			break;
+	}
+	return nullable;
+}
+
+bool Grammar::add_first_of_or_rules(GrammarOrRule* or_rule, GrammarFirstSet& first_set)
+{
+	bool nullable = false;
+	for (; or_rule != 0; or_rule = or_rule->next)
+		if (add_first_of_rule(or_rule->rule, first_set))
+			nullable = true;
+	return nullable;
+}
+
+void Grammar::add_first_of_terminal(GrammarTerminal* terminal, GrammarFirstSet& first_set)
+{
+	if (terminal->nr < 0 || terminal->nr >= FIRST_MAX_TERMINALS)
+		first_set.any = true;
+	else
+		first_set.terminals |= 1UL << terminal->nr;
+}
+
+void Grammar::set_first_of_or_rules(GrammarOrRule* or_rule)
+{
+	for (; or_rule != 0; or_rule = or_rule->next)
+	{
+		if (or_rule->first_set == 0)
+			or_rule->first_set = new GrammarFirstSet;
+		GrammarFirstSet& first_set = *or_rule->first_set;
+		first_set = GrammarFirstSet();
+		first_set.nullable = add_first_of_rule(or_rule->rule, first_set);
+
+		for (GrammarRule* rule = or_rule->rule; rule != 0; rule = rule->next)
+			if (rule->kind == RK_OR_RULE || rule->kind == RK_COR_RULE)
+				set_first_of_or_rules(rule->text.or_rules->first);
+	}
+}
+
+static bool starts_with_class(GrammarFirstSet* first_set, int c)
+{
+	return    first_set->any
+		   || (c < 256 ? first_set->chars.contains_char(c) : (first_set->terminals & (1UL << (c - 256))) != 0);
+}
+
+void Grammar::computePredictions()
+/*	Builds the LL(1) prediction tables of all choices from the FIRST
+	sets of their alternatives, hence after computeFirstSets().
+*/
+{
+	for (GrammarNonTerminal* nt = _all_nt; nt != 0; nt = nt->next)
+	{
+		if (nt->first != 0 && nt->prediction == 0)
+			nt->prediction = make_prediction(nt->first);
+		if (nt->recursive != 0 && nt->rec_prediction == 0)
+			nt->rec_prediction = make_prediction(nt->recursive);
+		make_predictions_in(nt->first);
+		make_predictions_in(nt->recursive);
+	}
+}
+
+GrammarPrediction* Grammar::make_prediction(GrammarOrRule* first)
+{
+	GrammarPrediction* prediction = new GrammarPrediction(_nr_predictions++);
+	GrammarOrRule* or_rule;
+	for (or_rule = first; or_rule != 0; or_rule = or_rule->next)
+		prediction->nr_alternatives++;
+	prediction->alternatives = new GrammarOrRule*[prediction->nr_alternatives];
+	int c;
+	for (c = 0; c < PREDICT_CLASSES; c++)
+		prediction->by_class[c] = PREDICT_NONE;
+
+	short i = 0;
+	for (or_rule = first; or_rule != 0; or_rule = or_rule->next, i++)
+	{
+		prediction->alternatives[i] = or_rule;
+		GrammarFirstSet* first_set = or_rule->first_set;
+		bool always = first_set == 0 || first_set->nullable;
+		for (c = 0; c < PREDICT_CLASSES; c++)
+			if (always || starts_with_class(first_set, c))
+				prediction->by_class[c] = GrammarPrediction::combine(prediction->by_class[c], i);
+	}
+	return prediction;
+}
+
+void Grammar::make_predictions_in(GrammarOrRule* or_rule)
+{
+	for (; or_rule != 0; or_rule = or_rule->next)
+		for (GrammarRule* rule = or_rule->rule; rule != 0; rule = rule->next)
+			if (rule->kind == RK_OR_RULE || rule->kind == RK_COR_RULE)
+			{
+				GrammarOrRules* or_rules = rule->text.or_rules;
+				if (or_rules->first != 0 && or_rules->prediction == 0)
+				{
+					or_rules->prediction = make_prediction(or_rules->first);
+					make_predictions_in(or_rules->first);
+				}
+			}
+}
+
+static void print_char(FILE* f, int ch)
+{
+	if (ch == '\0')
+		fprintf(f, "'\\0'");
+	else if (ch == '\n')
+		fprintf(f, "'\\n'");
+	else if (ch == '\t')
+		fprintf(f, "'\\t'");
+	else if (ch == '\\' || ch == '\'')
+		fprintf(f, "'\\%c'", ch);
+	else if (ch >= ' ' && ch < 127)
+		fprintf(f, "'%c'", ch);
+	else
+		fprintf(f, "'\\x%02x'", ch);
+}
+
+GrammarRule* Grammar::positionedRule(GrammarRule* rule)
+/*	Returns the first element of the rule with a position in the grammar,
+	because the rules that combine alternatives have none of their own.
+*/
+{
+	for (; rule != 0; rule = rule->next)
+	{
+		if (rule->line > 0)
+			return rule;
+		if (rule->kind == RK_OR_RULE || rule->kind == RK_COR_RULE)
+			for (GrammarOrRule* or_rule = rule->text.or_rules->first; or_rule != 0; or_rule = or_rule->next)
+			{
+				GrammarRule* positioned = positionedRule(or_rule->rule);
+				if (positioned != 0)
+					return positioned;
+			}
+	}
+	return 0;
+}
+
+void Grammar::add_follow_of_element(GrammarRule* rule, const GrammarFirstSet& end_follow, GrammarFirstSet& follow_set)
+/*	Adds what can follow an occurrence of the element rule to follow_set:
+	the next occurrence of a sequence, the rest of the rule, and when the
+	rest can be empty, end_follow, which is what follows the rule.
+*/
+{
+	if (rule->sequential)
+		add_first_of_repeat(rule, follow_set);
+	if (rule->kind == RK_COR_RULE || add_first_of_rule(rule->next, follow_set))
+		follow_set.add(end_follow);
+}
+
+void Grammar::add_first_of_repeat(GrammarRule* rule, GrammarFirstSet& first_set)
+/*	Adds with what the next occurrence of the sequence rule starts. */
+{
+	const char* chain_sym = rule->chain_symbol;
+	if (chain_sym != 0 && *chain_sym != '\0')
+		first_set.chars.add_char(*chain_sym);
+	else
+		add_first_of_element(rule, first_set);
+}
+
+void Grammar::add_follow_of_rule(GrammarRule* rule, const GrammarFirstSet& end_follow, GrammarFirstSet* follow)
+/*	Adds what can follow the non-terminals in rule to their FOLLOW sets
+	(indexed by GrammarNonTerminal::nr), given what follows the rule.
+*/
+{
+	for (; rule != 0; rule = rule->next)
+	{
+		GrammarFirstSet elem_follow;
+		add_follow_of_element(rule, end_follow, elem_follow);
+		switch (rule->kind)
+		{
+			case RK_NT:
+			case RK_WS_NT:
+				follow[rule->text.non_terminal->nr].add(elem_follow);
+				break;
+			case RK_OR_RULE:
+				for (GrammarOrRule* or_rule = rule->text.or_rules->first; or_rule != 0; or_rule = or_rule->next)
+					add_follow_of_rule(or_rule->rule, elem_follow, follow);
+				break;
+			case RK_COR_RULE:
+				for (GrammarOrRule* or_rule = rule->text.or_rules->first; or_rule != 0; or_rule = or_rule->next)
+					add_follow_of_rule(or_rule->rule, end_follow, follow);
+				return;
+		}
+	}
+}
+
+void Grammar::end_follow_of(GrammarNonTerminal* nt, GrammarFirstSet* follow, GrammarFirstSet& end_follow)
+/*	Sets end_follow to what can follow the alternatives of nt: what
+	follows nt, and the left-recursive alternatives that can come next.
+*/
+{
+	end_follow = follow[nt->nr];
+	add_first_of_or_rules(nt->recursive, end_follow);
+}
+
+void Grammar::compute_follow_sets(GrammarFirstSet* follow)
+/*	Computes the FOLLOW sets of all non-terminals (indexed by
+	GrammarNonTerminal::nr) from the FIRST sets, by iterating until
+	nothing changes.
+*/
+{
+	GrammarFirstSet* old_follow = new GrammarFirstSet[_nr_nt];
+	for (bool changed = true; changed; )
+	{
+		for (int i = 0; i < _nr_nt; i++)
+			old_follow[i] = follow[i];
+		for (GrammarNonTerminal* nt = _all_nt; nt != 0; nt = nt->next)
+		{
+			GrammarFirstSet end_follow;
+			end_follow_of(nt, follow, end_follow);
+			GrammarOrRule* or_rule;
+			for (or_rule = nt->first; or_rule != 0; or_rule = or_rule->next)
+				add_follow_of_rule(or_rule->rule, end_follow, follow);
+			for (or_rule = nt->recursive; or_rule != 0; or_rule = or_rule->next)
+				add_follow_of_rule(or_rule->rule, end_follow, follow);
+		}
+		changed = false;
+		for (int i = 0; i < _nr_nt; i++)
+			if (!old_follow[i].equal(follow[i]))
+				changed = true;
+	}
+	delete[] old_follow;
+}
+
+static bool overlap(const GrammarFirstSet& first_set1, const GrammarFirstSet& first_set2, GrammarCharSet& chars, unsigned long& terminals)
+/*	Collects the characters and terminals both sets can start with, and
+	returns whether there are any. */
+{
+	bool conflict = false;
+	for (int c = 0; c < PREDICT_CLASSES; c++)
+		if (   starts_with_class((GrammarFirstSet*)&first_set1, c)
+			&& starts_with_class((GrammarFirstSet*)&first_set2, c))
+		{
+			conflict = true;
+			if (c < 256)
+				chars.add_char(c);
+			else
+				terminals |= 1UL << (c - 256);
+		}
+	return conflict;
+}
+
+void Grammar::print_overlap(FILE* f, GrammarCharSet& chars, unsigned long terminals)
+{
+	for (GrammarCharSet::RangeIterator it(chars); it.more(); it.next())
+	{
+		fprintf(f, " ");
+		print_char(f, it.from());
+		if (it.from() < it.to())
+		{
+			fprintf(f, "..");
+			print_char(f, it.to());
+		}
+	}
+	for (GrammarTerminal* terminal = _all_t; terminal != 0; terminal = terminal->next)
+		if (   terminal->nr >= 0 && terminal->nr < FIRST_MAX_TERMINALS
+			&& (terminals & (1UL << terminal->nr)) != 0)
+			fprintf(f, " <%s>", terminal->name.val());
+	fprintf(f, "\n");
+}
+
+int Grammar::printConflicts(FILE* f)
+/*	Prints the LL(1) conflicts of the grammar, with their positions in
+	the grammar: the pairs of alternatives of a choice that can start
+	with the same character or terminal, where a nullable alternative
+	also starts with what can follow the choice, the left-recursive
+	alternatives that can start with what follows the non-terminal, and
+	the optional elements and sequences that can start (again) with what
+	can follow them. Returns the number of conflicts.
+*/
+{
+	GrammarFirstSet* follow = new GrammarFirstSet[_nr_nt];
+	compute_follow_sets(follow);
+
+	int nr_choices = 0;
+	int nr_conflicts = 0;
+	for (GrammarNonTerminal* nt = _all_nt; nt != 0; nt = nt->next)
+	{
+		GrammarFirstSet end_follow;
+		end_follow_of(nt, follow, end_follow);
+		if (nt->prediction != 0)
+		{
+			nr_choices++;
+			nr_conflicts += print_conflicts(f, nt, nt->prediction, end_follow, false);
+		}
+		if (nt->rec_prediction != 0)
+		{
+			/* after each left-recursive alternative, the parser chooses
+			   between another one and what follows the non-terminal */
+			nr_choices++;
+			nr_conflicts += print_conflicts(f, nt, nt->rec_prediction, follow[nt->nr], true);
+		}
+		print_conflicts_in(f, nt, nt->first, end_follow, nr_choices, nr_conflicts);
+		print_conflicts_in(f, nt, nt->recursive, end_follow, nr_choices, nr_conflicts);
+	}
+	fprintf(f, "%d LL(1) conflicts in %d choices\n", nr_conflicts, nr_choices);
+
+	delete[] follow;
+	return nr_conflicts;
+}
+
+void Grammar::print_conflicts_in(FILE* f, GrammarNonTerminal* nt, GrammarOrRule* or_rule, const GrammarFirstSet& end_follow, int& nr_choices, int& nr_conflicts)
+/*	Prints the conflicts of the optional elements, sequences and groups
+	in the alternatives or_rule, given what can follow them. */
+{
+	for (; or_rule != 0; or_rule = or_rule->next)
+		for (GrammarRule* rule = or_rule->rule; rule != 0; rule = rule->next)
+		{
+			GrammarFirstSet rest_follow;
+			if (rule->kind == RK_COR_RULE || add_first_of_rule(rule->next, rest_follow))
+				rest_follow.add(end_follow);
+
+			if (rule->optional || rule->sequential)
+			{
+				/* the parser chooses between taking the element (again)
+				   and what follows it */
+				GrammarFirstSet take;
+				if (rule->optional)
+					add_first_of_element(rule, take);
+				if (rule->sequential)
+					add_first_of_repeat(rule, take);
+				GrammarCharSet chars;
+				unsigned long terminals = 0;
+				nr_choices++;
+				if (rule->line > 0 && overlap(take, rest_follow, chars, terminals))
+				{
+					nr_conflicts++;
+					fprintf(f, "%ld.%ld: conflict in %s of the %s element with what can follow it on",
+							rule->line, rule->column, nt->name.val(), rule->sequential ? "sequential" : "optional");
+					print_overlap(f, chars, terminals);
+				}
+			}
+
+			if (   (rule->kind == RK_OR_RULE || rule->kind == RK_COR_RULE)
+				&& rule->text.or_rules->prediction != 0)
+			{
+				GrammarFirstSet elem_follow;
+				add_follow_of_element(rule, end_follow, elem_follow);
+				nr_choices++;
+				nr_conflicts += print_conflicts(f, nt, rule->text.or_rules->prediction, elem_follow, false);
+				print_conflicts_in(f, nt, rule->text.or_rules->first, elem_follow, nr_choices, nr_conflicts);
+			}
+			if (rule->kind == RK_COR_RULE)
+				break;
+		}
+}
+
+int Grammar::print_conflicts(FILE* f, GrammarNonTerminal* nt, GrammarPrediction* prediction, const GrammarFirstSet& follow_set, bool can_stop)
+/*	Prints the conflicts of a choice, of which follow_set is what can
+	follow it. A nullable alternative is also taken on follow_set. With
+	can_stop, the choice also has an empty alternative.
+*/
+{
+	int nr_conflicts = 0;
+	for (int i = 0; i < prediction->nr_alternatives; i++)
+	{
+		GrammarOrRule* or_rule1 = prediction->alternatives[i];
+		GrammarRule* rule1 = positionedRule(or_rule1->rule);
+		if (or_rule1->first_set == 0 || rule1 == 0)
+			continue;
+		GrammarFirstSet predict1 = *or_rule1->first_set;
+		if (predict1.nullable)
+			predict1.add(follow_set);
+
+		GrammarCharSet chars;
+		unsigned long terminals = 0;
+		if (can_stop && overlap(predict1, follow_set, chars, terminals))
+		{
+			nr_conflicts++;
+			fprintf(f, "%ld.%ld: conflict in %s with what can follow it on",
+					rule1->line, rule1->column, nt->name.val());
+			print_overlap(f, chars, terminals);
+		}
+
+		for (int j = i + 1; j < prediction->nr_alternatives; j++)
+		{
+			GrammarOrRule* or_rule2 = prediction->alternatives[j];
+			GrammarRule* rule2 = positionedRule(or_rule2->rule);
+			if (or_rule2->first_set == 0 || rule2 == 0)
+				continue;
+			GrammarFirstSet predict2 = *or_rule2->first_set;
+			if (predict2.nullable)
+				predict2.add(follow_set);
+
+			GrammarCharSet chars;
+			unsigned long terminals = 0;
+			if (!overlap(predict1, predict2, chars, terminals))
+				continue;
+
+			nr_conflicts++;
+			fprintf(f, "%ld.%ld: conflict in %s with the alternative at %ld.%ld on",
+					rule2->line, rule2->column, nt->name.val(), rule1->line, rule1->column);
+			print_overlap(f, chars, terminals);
+		}
+	}
+	return nr_conflicts;
+}
 
 void Grammar::addLiteral(Ident literal)
 {
@@ -908,7 +1438,7 @@ public:
 		fprintf(_f, "#include \"ParserGrammar.h\"\n\n");
 
 		fprintf(_f, "#define NT_DEF(name) nt = grammar.addNonTerminal(Ident(name)); ref_or_rule = &nt->first; ref_rec_or_rule = &nt->recursive;\n");
-		fprintf(_f, "#define NEW_GR(K) rule = *ref_rule = new GrammarRule(); ref_rule = &rule->next; rule->kind = K;\n");
+		fprintf(_f, "#define NEW_GR(K) rule = *ref_rule = grammar.newRule(); ref_rule = &rule->next; rule->kind = K;\n");
 		fprintf(_f, "#define NT(name) NEW_GR(RK_NT) rule->text.non_terminal = grammar.addNonTerminal(Ident(name));\n");
 		fprintf(_f, "#define TERM(name) NEW_GR(RK_TERM) rule->text.terminal = new GrammarTerminal(Ident(name));\n");
 		fprintf(_f, "#define LLIT(sym) NEW_GR(RK_LIT) rule->str_value = sym;\n");
@@ -1128,7 +1658,7 @@ void GrammarLoader::nt_def(const char* name)
 
 void GrammarLoader::_new_elem()
 {
-	_c->rule = *_c->ref_rule = new GrammarRule();
+	_c->rule = *_c->ref_rule = _grammar->newRule();
 	_c->ref_rule = &_c->rule->next;
 }
 
@@ -1525,7 +2055,7 @@ void GrammarLoaderForAPT::make_rule(CombinedRule* rules)
 		if (!rule->rule.more() || !equivalent(rules->rule, rule->rule))
 			all_equivalent = false;
 
-    result = new GrammarRule;
+    result = _grammar->newRule();
 	if (all_equivalent)
 	{
 		AbstractParseTree elem = rules->rule;
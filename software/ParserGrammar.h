@@ -2,6 +2,8 @@
 #define _INCLUDED_PARSERGRAMMAR_H
 
 class GrammarRule;
+class GrammarFirstSet;
+class GrammarPrediction;
 
 #define RK_NT              0
 #define RK_LIT             1
@@ -27,13 +29,14 @@ class GrammarRule;
 class GrammarOrRule
 {   
 public:
-	GrammarOrRule() : next(0), rule(0), nr_active(0), single_element(0) {}
+	GrammarOrRule() : next(0), rule(0), nr_active(0), single_element(0), first_set(0) {}
 	void print(FILE* fout, bool first = true);
 	GrammarOrRule* next;
     GrammarRule* rule;
     Ident tree_name;
 	int nr_active;
 	GrammarRule* single_element;
+	GrammarFirstSet* first_set; // see Grammar::computeFirstSets()
 };
 
 class TreeTypeToGrammarRules;
@@ -41,8 +44,9 @@ class TreeTypeToGrammarRules;
 class GrammarOrRules
 {
 public:
-	GrammarOrRules() : first(0), emptyTreeRules(0), treeNameToRulesMap(0), listRules(0), terminalToRulesMap(0) {}
+	GrammarOrRules() : first(0), prediction(0), emptyTreeRules(0), treeNameToRulesMap(0), listRules(0), terminalToRulesMap(0) {}
 	GrammarOrRule* first;
+	GrammarPrediction* prediction; // of first, see Grammar::computePredictions()
 	TreeTypeToGrammarRules* emptyTreeRules;
 	TreeTypeToGrammarRules* treeNameToRulesMap;
 	TreeTypeToGrammarRules* listRules;
@@ -52,18 +56,30 @@ public:
 class GrammarNonTerminal : public GrammarOrRules
 {
 public:
-	GrammarNonTerminal(Ident n_name) : name(n_name), next(0), recursive(0) {}
+	GrammarNonTerminal(Ident n_name, int n_nr) : next(0), name(n_name), nr(n_nr), recursive(0), rec_prediction(0), first_set(0) {}
 	GrammarNonTerminal* next;
     Ident name;
+	int nr; // numbered densely from 0, see Grammar::nrNonTerminals()
     GrammarOrRule* recursive;
+	GrammarPrediction* rec_prediction; // of recursive
+	GrammarFirstSet* first_set;
 };
 
 class GrammarTerminal
 {	
 public:
-	GrammarTerminal(const Ident& new_name) : name(new_name), next(0) {}
+	GrammarTerminal(const Ident& new_name, int n_nr = -1) : name(new_name), next(0), nr(n_nr) {}
 	Ident name;
 	GrammarTerminal *next;
+	int nr; // numbered from 0 by Grammar::findTerminal(), otherwise -1
+};
+
+class GrammarLiteral
+{
+public:
+	GrammarLiteral(Ident n_value) : value(n_value), next(0) {}
+	Ident value;
+	GrammarLiteral* next;
 };
 
 class GrammarIdent
@@ -84,6 +100,8 @@ public:
 	void add_range(unsigned char from, unsigned char to);
 	inline void remove_char(unsigned char ch) { _range[ch >> 5] &= ~(1 << (ch & 0x01f)); }
 	inline bool contains_char(unsigned char ch) const { return (_range[ch >> 5] & (1 << (ch & 0x01f))) != 0; }
+	void add_set(const GrammarCharSet& char_set);
+	bool equal(const GrammarCharSet& char_set) const;
 	class RangeIterator
 	{
 	public:
@@ -103,6 +121,76 @@ private:
 	long _range[8];
 };
 
+/*	GrammarFirstSet describes with which characters the text can start
+	at which an alternative (or non-terminal) can be parsed. Terminals are
+	recorded by their number (GrammarTerminal::nr) in a bit mask, because
+	which characters they start with depends on the scanner. Terminals with
+	a number of FIRST_MAX_TERMINALS or more are not recorded, and make the
+	set 'any'. A nullable set also matches any character.
+*/
+
+#define FIRST_MAX_TERMINALS 32
+
+class GrammarFirstSet
+{
+public:
+	GrammarFirstSet() : terminals(0), any(false), nullable(false) {}
+	void add(const GrammarFirstSet& first_set)
+	{
+		chars.add_set(first_set.chars);
+		terminals |= first_set.terminals;
+		any = any || first_set.any;
+	}
+	bool equal(const GrammarFirstSet& first_set) const
+	{
+		return    chars.equal(first_set.chars) && terminals == first_set.terminals
+			   && any == first_set.any && nullable == first_set.nullable;
+	}
+	GrammarCharSet chars;
+	unsigned long terminals;
+	bool any;
+	bool nullable;
+};
+
+/*	GrammarPrediction is the LL(1) prediction table of a choice between
+	alternatives: the alternatives of a non-terminal, its left-recursive
+	alternatives, or the alternatives of a group. The lookahead token
+	classes are the characters, followed by the terminals, numbered as
+	in GrammarFirstSet. For each class the table holds which alternatives
+	are to be tried, in order: PREDICT_NONE when there is none, the index
+	of the alternative when it is the only one, or PREDICT_SEVERAL of the
+	index of the first. The nullable alternatives and those that can
+	start with any character, are tried at every class. Because the
+	characters with which a terminal can start depend on the scanner,
+	a parser combines the classes for each character (see
+	AbstractParser::init_predictions).
+*/
+
+#define PREDICT_CLASSES (256 + FIRST_MAX_TERMINALS)
+#define PREDICT_NONE -1
+#define PREDICT_SEVERAL(I) (-2 - (I))
+#define PREDICT_FIRST(E) ((E) >= 0 ? (E) : -2 - (E))
+
+class GrammarPrediction
+{
+public:
+	GrammarPrediction(int n_nr) : nr(n_nr), nr_alternatives(0), alternatives(0) {}
+	static short combine(short entry1, short entry2)
+	{
+		if (entry1 == PREDICT_NONE || entry1 == entry2)
+			return entry2;
+		if (entry2 == PREDICT_NONE)
+			return entry1;
+		short first1 = PREDICT_FIRST(entry1);
+		short first2 = PREDICT_FIRST(entry2);
+		return PREDICT_SEVERAL(first1 < first2 ? first1 : first2);
+	}
+	int nr; // numbered densely from 0, see Grammar::nrPredictions()
+	int nr_alternatives;
+	GrammarOrRule** alternatives;
+	short by_class[PREDICT_CLASSES];
+};
+
 class GrammarColourCoding
 {
 public:
@@ -119,7 +207,7 @@ private:
 class GrammarRule
 {
 public:
-	GrammarRule() : next(0), optional(false), sequential(false), avoid(false), nongreedy(false), last_fail_pos(-1) {}
+	GrammarRule(int n_nr) : next(0), optional(false), sequential(false), avoid(false), nongreedy(false), line(0), column(0), nr(n_nr) {}
 	void print(FILE* fout);
 	GrammarRule* next;
     bool optional;
@@ -140,7 +228,7 @@ public:
 	// position grammar text
 	long line;
 	long column;
-    long last_fail_pos; // Used by back-tracking parsers
+	int nr; // numbered densely from 0, see Grammar::nrRules()
 };
 
 class TreeTypeToGrammarRule
@@ -187,20 +275,31 @@ public:
 
 };
 
-class GrammarLiteral;
 class CodeGenerator;
 
 class Grammar
 {
 public:
-	Grammar() : _all_nt(0), _all_t(0), _all_l(0), _for_unparse(false) {}
+	Grammar() : _all_nt(0), _nr_nt(0), _nr_rules(0), _nr_t(0), _nr_predictions(0), _all_t(0), _all_l(0), _for_unparse(false) {}
 	void loadGrammar(const AbstractParseTree& root);
 	void loadGrammarForUnparse(const AbstractParseTree& root, AbstractUnparseErrorCollector *unparseErrorCollector);
 	GrammarNonTerminal* findNonTerminal(Ident name);
 	GrammarNonTerminal* addNonTerminal(Ident name);
+	int nrNonTerminals() { return _nr_nt; }
+	GrammarNonTerminal* allNonTerminals() { return _all_nt; }
+	GrammarRule* newRule() { return new GrammarRule(_nr_rules++); }
+	int nrRules() { return _nr_rules; }
+	void shareGrammar(const Grammar& grammar);
 	GrammarTerminal* findTerminal(Ident name);
+	GrammarTerminal* allTerminals() { return _all_t; }
+	void computeFirstSets();
+	void computePredictions();
+	int nrPredictions() { return _nr_predictions; }
+	int printConflicts(FILE* f);
+	static GrammarRule* positionedRule(GrammarRule* rule);
 	void addLiteral(Ident literal);
 	bool isLiteral(Ident literal);
+	GrammarLiteral* allLiterals() { return _all_l; }
 	void outputGrammarAsCode(FILE* fout, const char* name);
 
 private:
@@ -218,7 +317,26 @@ private:
 	bool equivalent(const AbstractParseTree& lhs, const AbstractParseTree& rhs);
 	GrammarOrRule* make_or_rule(AbstractParseTree::iterator or_rule);
 	void make_char_set(AbstractParseTree char_set_rule, GrammarCharSet *char_set);
+	bool add_first_of_rule(GrammarRule* rule, GrammarFirstSet& first_set);
+	bool add_first_of_element(GrammarRule* rule, GrammarFirstSet& first_set);
+	bool add_first_of_or_rules(GrammarOrRule* or_rule, GrammarFirstSet& first_set);
+	void add_first_of_terminal(GrammarTerminal* terminal, GrammarFirstSet& first_set);
+	void set_first_of_or_rules(GrammarOrRule* or_rule);
+	GrammarPrediction* make_prediction(GrammarOrRule* first);
+	void make_predictions_in(GrammarOrRule* or_rule);
+	void add_first_of_repeat(GrammarRule* rule, GrammarFirstSet& first_set);
+	void add_follow_of_element(GrammarRule* rule, const GrammarFirstSet& end_follow, GrammarFirstSet& follow_set);
+	void add_follow_of_rule(GrammarRule* rule, const GrammarFirstSet& end_follow, GrammarFirstSet* follow);
+	void end_follow_of(GrammarNonTerminal* nt, GrammarFirstSet* follow, GrammarFirstSet& end_follow);
+	void compute_follow_sets(GrammarFirstSet* follow);
+	int print_conflicts(FILE* f, GrammarNonTerminal* nt, GrammarPrediction* prediction, const GrammarFirstSet& follow_set, bool can_stop);
+	void print_conflicts_in(FILE* f, GrammarNonTerminal* nt, GrammarOrRule* or_rule, const GrammarFirstSet& end_follow, int& nr_choices, int& nr_conflicts);
+	void print_overlap(FILE* f, GrammarCharSet& chars, unsigned long terminals);
 	GrammarNonTerminal* _all_nt;
+	int _nr_nt;
+	int _nr_rules;
+	int _nr_t;
+	int _nr_predictions;
 	GrammarTerminal* _all_t;
 	GrammarLiteral* _all_l;
 	bool _for_unparse;
@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <string.h>
+#include <stdlib.h>
 #include <assert.h>
 #include <ctype.h>
 #include "Ident.h"
@@ -126,7 +127,7 @@ bool PascalScanner::acceptLiteral(TextFileBuffer& text, const char* sym)
     return true;
 }
 
-bool PascalScanner::acceptTerminal(TextFileBuffer& text, Ident name, AbstractParseTree& result)
+bool PascalScanner::scanTerminal(TextFileBuffer& text, Ident name, AbstractParseTree& result)
 {
 	static Ident id_ident = "ident";
 	static Ident id_string = "string";
@@ -379,7 +380,7 @@ bool PascalScanner::accept_double(TextFileBuffer& text, AbstractParseTree& resul
     while (isdigit(text[i]))
         i++;
 	double v;
-    sscanf(text, "%lf", &v);
+    v = strtod(text, 0);
 
     text.advance(i);
 	skipSpace(text);
@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <string.h>
+#include <stdlib.h>
 #include <assert.h>
 #include <ctype.h>
 #include "Ident.h"
@@ -86,7 +87,7 @@ bool ProtosScanner::acceptLiteral(TextFileBuffer& text, const char* sym)
     return true;
 }
 
-bool ProtosScanner::acceptTerminal(TextFileBuffer& text, Ident name, AbstractParseTree& result)
+bool ProtosScanner::scanTerminal(TextFileBuffer& text, Ident name, AbstractParseTree& result)
 {
 	if (name == id_ident)
 		return accept_ident(text, result);
@@ -257,7 +258,7 @@ bool ProtosScanner::accept_int(TextFileBuffer& text, AbstractParseTree& result)
             i++;
     }
 	long v;    
-    sscanf(text, "%ld", &v);
+    v = strtol(text, 0, 10);
 
     text.advance(i);
 	skipSpace(text);
@@ -293,7 +294,7 @@ bool ProtosScanner::accept_double(TextFileBuffer& text, AbstractParseTree& resul
 			i++;
 	}
 	double v;
-    sscanf(text, "%lf", &v);
+    v = strtod(text, 0);
 
     text.advance(i);
 	skipSpace(text);
@@ -10,7 +10,9 @@ public:
 	virtual void skipSpace(TextFileBuffer& text);
 	virtual bool acceptEOF(TextFileBuffer& text);
 	virtual bool acceptLiteral(TextFileBuffer& text, const char* sym);
-	virtual bool acceptTerminal(TextFileBuffer& text, Ident name, AbstractParseTree& result);
+
+protected:
+	virtual bool scanTerminal(TextFileBuffer& text, Ident name, AbstractParseTree& result);
 
 private:
 	bool accept_ident(TextFileBuffer& text, Ident& ident);
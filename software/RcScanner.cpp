@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <string.h>
+#include <stdlib.h>
 #include <assert.h>
 #include <ctype.h>
 #include "Ident.h"
@@ -122,7 +123,7 @@ bool ResourceScanner::acceptLiteral(TextFileBuffer& text, const char* sym)
     return true;
 }
 
-bool ResourceScanner::acceptTerminal(TextFileBuffer& text, Ident name, AbstractParseTree& result)
+bool ResourceScanner::scanTerminal(TextFileBuffer& text, Ident name, AbstractParseTree& result)
 {
 	static Ident id_comment = "comment";
 	static Ident id_ident = "ident";
@@ -427,7 +428,7 @@ bool ResourceScanner::accept_double(TextFileBuffer& text, AbstractParseTree& res
     while (isdigit(text[i]))
         i++;
 	double v;
-    sscanf(text, "%lf", &v);
+    v = strtod(text, 0);
 
     text.advance(i);
 	skipSpace(text);
@@ -10,9 +10,11 @@ public:
 	virtual void skipSpace(TextFileBuffer& text);
 	virtual bool acceptEOF(TextFileBuffer& text);
 	virtual bool acceptLiteral(TextFileBuffer& text, const char* sym);
-	virtual bool acceptTerminal(TextFileBuffer& text, Ident name, AbstractParseTree& result);
 	virtual bool acceptWhiteSpace(TextFileBuffer& text, Ident name);
 
+protected:
+	virtual bool scanTerminal(TextFileBuffer& text, Ident name, AbstractParseTree& result);
+
 private:
 	bool accept_comment(TextFileBuffer& text, AbstractParseTree& result);
 	bool accept_ident(TextFileBuffer& text, Ident& ident, bool& is_keyword, const char* keyword);
@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <string.h>
+#include <stdlib.h>
 #include <assert.h>
 #include <ctype.h>
 #include "Ident.h"
@@ -13,10 +14,167 @@
 #define IDENT_START_CHAR(X) (isalpha(X)||X=='_')
 #define IDENT_FOLLOW_CHAR(X) (isalpha(X)||isdigit(X)||X=='_')
 
+void TokenMemo::clear()
+{
+	for (int i = 0; i < TOKEN_MEMO_SIZE; i++)
+		if (_entries[i].pos != (unsigned long)-1)
+		{	_entries[i].pos = (unsigned long)-1;
+			_entries[i].value = AbstractParseTree();
+		}
+}
+
+void TokenMemo::printStats(FILE *f)
+{
+	fprintf(f, "tokens: %lu hits, %lu misses\n", _nr_hits, _nr_misses);
+}
+
+bool AbstractScanner::acceptTerminal(TextFileBuffer& text, Ident name, AbstractParseTree& result)
+{
+	unsigned long pos = text.position();
+	TokenMemo::Entry& entry = _tokens.entry(pos, name);
+	if (_tokens.found(entry, pos, name))
+	{
+		text = entry.end;
+		if (entry.furthest > text.furthest())
+			text.setFurthest(entry.furthest);
+		if (entry.accepted)
+			result = entry.value;
+		return entry.accepted;
+	}
+
+	/* the furthest position read by this scan is kept with the entry */
+	unsigned long surr_furthest = text.furthest();
+	text.setFurthest(pos);
+	entry.accepted = scanTerminal(text, name, result);
+	entry.pos = pos;
+	entry.name = name;
+	entry.end = text;
+	entry.furthest = text.furthest();
+	if (surr_furthest > entry.furthest)
+		text.setFurthest(surr_furthest);
+	entry.value = entry.accepted ? result : AbstractParseTree();
+	return entry.accepted;
+}
+
+void LiteralTrie::clear()
+{
+	_nr_nodes = 0;
+	_depth = 0;
+	for (int ch = 0; ch < 256; ch++)
+		_root[ch] = -1;
+	for (int i = 0; i < LITERAL_SYM_CACHE_SIZE; i++)
+		_sym_cache[i].sym = 0;
+	if (_path == 0)
+	{	_max_depth = 0;
+		_path = new int[1];
+		_path[0] = -1;
+	}
+}
+
+int LiteralTrie::child(int node, char ch) const
+{
+	if (node < 0)
+		return _root[(unsigned char)ch];
+	for (int c = _nodes[node].child; c >= 0; c = _nodes[c].sibling)
+		if (_nodes[c].ch == ch)
+			return c;
+	return -1;
+}
+
+void LiteralTrie::add(const char* literal)
+{
+	int node = -1;
+	int depth = 0;
+	for (const char* s = literal; *s != '\0'; s++)
+	{
+		depth++;
+		int next = child(node, *s);
+		if (next < 0)
+		{
+			if (_nr_nodes == _size)
+			{	_size = _size == 0 ? 256 : 2 * _size;
+				Node* new_nodes = new Node[_size];
+				for (int i = 0; i < _nr_nodes; i++)
+					new_nodes[i] = _nodes[i];
+				delete[] _nodes;
+				_nodes = new_nodes;
+			}
+			next = _nr_nodes++;
+			_nodes[next].ch = *s;
+			_nodes[next].is_literal = false;
+			_nodes[next].depth = depth;
+			_nodes[next].child = -1;
+			if (node < 0)
+			{	_nodes[next].sibling = -1;
+				_root[(unsigned char)*s] = next;
+			}
+			else
+			{	_nodes[next].sibling = _nodes[node].child;
+				_nodes[node].child = next;
+			}
+		}
+		node = next;
+	}
+	if (node < 0)
+		return;
+	_nodes[node].is_literal = true;
+
+	if (depth > _max_depth)
+	{	_max_depth = depth;
+		delete[] _path;
+		_path = new int[_max_depth + 1];
+		_path[0] = -1;
+		_depth = 0;
+	}
+}
+
+int LiteralTrie::find(const char* literal, int len) const
+{
+	int node = -1;
+	for (int i = 0; i < len; i++)
+		if ((node = child(node, literal[i])) < 0)
+			return -1;
+	return node >= 0 && _nodes[node].is_literal ? node : -1;
+}
+
+int LiteralTrie::find(const char* literal)
+{
+	int i = (int)(((size_t)literal >> 3) % LITERAL_SYM_CACHE_SIZE);
+	if (_sym_cache[i].sym != literal)
+	{	_sym_cache[i].sym = literal;
+		_sym_cache[i].node = find(literal, strlen(literal));
+	}
+	return _sym_cache[i].node;
+}
+
+int LiteralTrie::match(const char* text)
+/*	Determines the path through the trie along the given text as far as
+	possible. The text ends with a '\0', which is not in the trie.
+*/
+{
+	int node = -1;
+	_depth = 0;
+	while ((node = child(node, text[_depth])) >= 0)
+		_path[++_depth] = node;
+	return _depth;
+}
+
 void BasicScanner::initScanning(Grammar* grammar)
 {
 	AbstractScanner::initScanning(grammar);
 	_last_space_pos.clear();
+	_last_ident_pos.clear();
+	_last_literal_pos.clear();
+
+	/* The literals are kept until the end, hence a grammar that is
+	   loaded again gets a new list, while shared grammars share it */
+	if (grammar->allLiterals() != _literals_of)
+	{
+		_literals.clear();
+		for (GrammarLiteral* literal = grammar->allLiterals(); literal != 0; literal = literal->next)
+			_literals.add(literal->value.val());
+		_literals_of = grammar->allLiterals();
+	}
 }
 
 Ident BasicScanner::id_ident = "ident";
@@ -47,12 +205,11 @@ void BasicScanner::skipSpace(TextFileBuffer& text)
 	for(;;)
 	{   if (*text == ' ' || *text == '\t' || text[0] == '\n' || text[0] == '\r')
 		{
-			text.next();
+			text.skipWhiteSpace();
 		}
 		else if (cpp_comments && text[0] == '/' && text[1] == '/')
 		{
-			while (!text.eof() && text[0] != '\n')
-				text.next();
+			text.skipUntil('\n');
 		}
 		else if (text[0] == '/' && text[1] == '*')
 		{   int nesting_depth = 1;
@@ -60,8 +217,11 @@ void BasicScanner::skipSpace(TextFileBuffer& text)
  
  			text.next();
  			text.next();
-			while (!text.eof() && !(text[0] == '*' && text[1] == '/') && nesting_depth > 0)
+			for (;;)
 			{
+				text.skipUntilEither('*', '/');
+				if (text.eof() || (text[0] == '*' && text[1] == '/') || nesting_depth == 0)
+					break;
 				if (nested_comments)
 				{
 					if (text[0] == '/' && text[1] == '*')
@@ -101,33 +261,53 @@ bool BasicScanner::acceptLiteral(TextFileBuffer& text, const char* sym)
 	if (*sym == '\0')
 		return true;
 
+	int node = _literals.find(sym);
+
 	if (IDENT_START_CHAR(*sym))
 	{
 		TextFilePos start_pos = text;
 
 		Ident ident;
 		bool is_keyword;
-		if (accept_ident(text, ident, is_keyword, sym) && ident == sym)
+		if (   accept_ident(text, ident, is_keyword, sym) 
+			&& (node >= 0 ? _last_ident_node == node : ident == sym))
 			return true;
 
 		text = start_pos;
 		return false;
 	}
 	
-	int i;
-	const char *s;
-	for (i = 0, s = sym; *s != '\0' && text[i] == *s; i++, s++);
+	if (node >= 0)
+	{
+		/* All literals of the grammar that occur at this position
+		   lie on the path matched in the trie */
+		if (text != _last_literal_pos)
+		{	_literals.match(text);
+			_last_literal_pos = text;
+		}
+		text.examined(_literals.depth());
+		if (!_literals.matched(node))
+			return false;
 
-	if (*s != '\0')
-		return false;
+		text.advance(_literals.length(node));
+	}
+	else
+	{
+		int i;
+		const char *s;
+		for (i = 0, s = sym; *s != '\0' && text[i] == *s; i++, s++);
+
+		if (*s != '\0')
+			return false;
 		
-	text.advance(i);
+		text.advance(i);
+	}
 	skipSpace(text);
 
 	return true;
 }
 
-bool BasicScanner::acceptTerminal(TextFileBuffer& text, Ident name, AbstractParseTree& result)
+bool BasicScanner::scanTerminal(TextFileBuffer& text, Ident name, AbstractParseTree& result)
 {
 	if (name == id_ident)
 		return accept_ident(text, result);
@@ -145,6 +325,32 @@ bool BasicScanner::acceptTerminal(TextFileBuffer& text, Ident name, AbstractPars
 	return false;
 }
 
+bool BasicScanner::terminalFirstChars(Ident name, GrammarCharSet& chars)
+{
+	if (name == id_ident)
+	{
+		for (int ch = 1; ch < 256; ch++)
+			if (IDENT_START_CHAR((char)ch))
+				chars.add_char(ch);
+	}
+	else if (name == id_string || name == id_cstring)
+		chars.add_char('"');
+	else if (name == id_char)
+		chars.add_char('\'');
+	else if (name == id_int || name == id_double)
+	{
+		chars.add_range('0', '9');
+		chars.add_char('+');
+		chars.add_char('-');
+		if (name == id_double)
+			chars.add_char('.');
+	}
+	else
+		return false;
+
+	return true;
+}
+
 bool BasicScanner::acceptWhiteSpace(TextFileBuffer& text, Ident name)
 {
 	static Ident id_notamp = "notamp";
@@ -187,11 +393,12 @@ bool BasicScanner::accept_ident(TextFileBuffer& text, Ident& ident, bool& is_key
 		buf[j] = '\0';
 		ident = buf;
 	}
+	_last_ident_node = _literals.find(text, i);
 
 	text.advance(i);
 	skipSpace(text);
 
-	is_keyword = (keyword != 0 && ident == keyword) || _grammar->isLiteral(ident);
+	is_keyword = (keyword != 0 && ident == keyword) || _last_ident_node >= 0;
 	
 	_last_ident_end_pos = text;
 	_last_ident = ident;
@@ -377,7 +584,7 @@ bool BasicScanner::accept_int(TextFileBuffer& text, AbstractParseTree& result)
 			i++;
 	}
 	long v;	
-	sscanf(text, "%ld", &v);
+	v = strtol(text, 0, 10);
 
 	text.advance(i);
 	skipSpace(text);
@@ -405,7 +612,7 @@ bool BasicScanner::accept_double(TextFileBuffer& text, AbstractParseTree& result
 	while (isdigit(text[i]))
 		i++;
 	double v;
-	sscanf(text, "%lf", &v);
+	v = strtod(text, 0);
 
 	text.advance(i);
 	skipSpace(text);
@@ -421,12 +628,12 @@ void WhiteSpaceScanner::skipSpace(TextFileBuffer& text)
 {
 }
 
-bool WhiteSpaceScanner::acceptTerminal(TextFileBuffer& text, Ident name, AbstractParseTree& result)
+bool WhiteSpaceScanner::scanTerminal(TextFileBuffer& text, Ident name, AbstractParseTree& result)
 {
 	if (name == id_ws)
 		return accept_whitespace(text, result);
 	
-	return BasicScanner::acceptTerminal(text, name, result);
+	return BasicScanner::scanTerminal(text, name, result);
 }
 
 bool WhiteSpaceScanner::accept_whitespace(TextFileBuffer& text, AbstractParseTree& result)
@@ -512,12 +719,12 @@ bool WhiteSpaceScanner::accept_whitespace(TextFileBuffer& text, AbstractParseTre
 Ident ColourCodingScanner::id_colourcommand = "colourcommand";
 
 bool
-ColourCodingScanner::acceptTerminal(TextFileBuffer& text, Ident name, AbstractParseTree& result)
+ColourCodingScanner::scanTerminal(TextFileBuffer& text, Ident name, AbstractParseTree& result)
 {
 	if (name == id_colourcommand)
 		return accept_colourcommand(text, result);
 	
-	return BasicScanner::acceptTerminal(text, name, result);
+	return BasicScanner::scanTerminal(text, name, result);
 }
 
 bool ColourCodingScanner::accept_colourcommand(TextFileBuffer& text, AbstractParseTree& result)
@@ -546,6 +753,7 @@ bool ColourCodingScanner::accept_colourcommand(TextFileBuffer& text, AbstractPar
 	result.appendChild(AbstractParseTree(type));
 	result.appendChild(AbstractParseTree(fgcolour));
 	result.appendChild(AbstractParseTree(bgcolour));
+	skipSpace(text);
 
 	return true;
 }
@@ -567,7 +775,7 @@ void ColourCodingScanner::accept_colourcode(TextFileBuffer& text, long &code)
 		else if ('a' <= *text && *text <= 'f')
 			code = code * 16 + 10 + *text - 'a';
 		else if ('A' <= *text && *text <= 'F')
-			code = code * 16 + 10 + *text - 'F';
+			code = code * 16 + 10 + *text - 'A';
 		else
 		{
 			code = -1;
@@ -608,7 +816,7 @@ bool RawScanner::acceptLiteral(TextFileBuffer& text, const char* sym)
 	return true;
 }
 
-bool RawScanner::acceptTerminal(TextFileBuffer& text, Ident name, AbstractParseTree& result)
+bool RawScanner::scanTerminal(TextFileBuffer& text, Ident name, AbstractParseTree& result)
 {
 	return false;
 }
@@ -3,31 +3,156 @@
 
 class TextFileBuffer;
 class Grammar;
+class GrammarLiteral;
+class GrammarCharSet;
+
+/*	TokenMemo remembers the results of scanning terminals, such that a
+	back-tracking parser does not scan the same terminal at the same
+	position again. It is a direct mapped table indexed by the position
+	and the name of the terminal, hence it has a fixed size, and a new
+	result replaces the one with the same index. The values hold on to
+	parse trees, so the memo has to be cleared before the tree arena
+	they were allocated from is released.
+*/
+
+#define TOKEN_MEMO_SIZE 1024
+
+class TokenMemo
+{
+public:
+	struct Entry
+	{
+		Entry() : pos((unsigned long)-1), accepted(false), furthest(0) {}
+		unsigned long pos;
+		Ident name;
+		bool accepted;
+		TextFilePos end;
+		unsigned long furthest; // see TextFileBuffer::furthest
+		AbstractParseTree value;
+	};
+
+	TokenMemo() : _nr_hits(0), _nr_misses(0) {}
+
+	void init() { clear(); _nr_hits = 0; _nr_misses = 0; }
+	void clear();
+	inline Entry& entry(unsigned long pos, Ident name)
+	{
+		return _entries[(pos * 7 + ((size_t)name.val() >> 3)) % TOKEN_MEMO_SIZE];
+	}
+	inline bool found(Entry& entry, unsigned long pos, Ident name)
+	{
+		if (entry.pos == pos && entry.name == name)
+		{	_nr_hits++;
+			return true;
+		}
+		_nr_misses++;
+		return false;
+	}
+	void printStats(FILE *f);
+
+private:
+	Entry _entries[TOKEN_MEMO_SIZE];
+	unsigned long _nr_hits;
+	unsigned long _nr_misses;
+};
 
 class AbstractScanner
 {
 public:
 	AbstractScanner() : _grammar(0) {}
+	virtual ~AbstractScanner() {}
 
-	virtual void initScanning(Grammar* grammar) { _grammar = grammar; }
+	virtual void initScanning(Grammar* grammar) { _grammar = grammar; _tokens.init(); }
+	// To be called at the end of parsing, before the tree arena is released:
+	void doneScanning() { _tokens.clear(); }
 	virtual void skipSpace(TextFileBuffer& text) = 0;
 	virtual bool acceptEOF(TextFileBuffer& text) = 0;
 	virtual bool acceptLiteral(TextFileBuffer& text, const char*) = 0;
-	virtual bool acceptTerminal(TextFileBuffer& text, Ident name, AbstractParseTree& result) = 0;
+	bool acceptTerminal(TextFileBuffer& text, Ident name, AbstractParseTree& result);
 	virtual bool acceptWhiteSpace(TextFileBuffer& text, Ident name) { return true; }
+	// Whether literals, character sets and eof are matched against the
+	// current character, which allows parsers to use FIRST sets:
+	virtual bool matchesAtCurrentChar() { return false; }
+	// Adds the characters with which the terminal can start to the set, or
+	// returns false if the terminal could start with any character:
+	virtual bool terminalFirstChars(Ident, GrammarCharSet&) { return false; }
+	void printStats(FILE *f) { _tokens.printStats(f); }
 protected:
+	virtual bool scanTerminal(TextFileBuffer& text, Ident name, AbstractParseTree& result) = 0;
 	Grammar *_grammar;
+private:
+	TokenMemo _tokens;
+};
+
+/*	LiteralTrie contains the literals of a grammar. The children of the
+	root are indexed by their character, the other children are kept in
+	sibling lists. match() determines the path of the longest prefix of a
+	text that occurs in the trie, after which matched() tells in constant
+	time whether a literal is a prefix of that text. The literals of the
+	grammar are looked up by the address of their text, which does not
+	change while parsing.
+*/
+
+#define LITERAL_SYM_CACHE_SIZE 256
+
+class LiteralTrie
+{
+public:
+	LiteralTrie() : _nodes(0), _nr_nodes(0), _size(0), _path(0), _max_depth(0), _depth(0) { clear(); }
+	~LiteralTrie() { delete[] _nodes; delete[] _path; }
+
+	void clear();
+	void add(const char* literal);
+	// Returns the node of the literal, or -1 if it is not a literal
+	int find(const char* literal, int len) const;
+	int find(const char* literal);
+	int match(const char* text);
+	inline bool matched(int node) const
+	{	int depth = _nodes[node].depth;
+		return depth <= _depth && _path[depth] == node;
+	}
+	inline int length(int node) const { return _nodes[node].depth; }
+	// The number of characters matched by the last match
+	inline int depth() const { return _depth; }
+
+private:
+	struct Node
+	{
+		char ch;
+		bool is_literal;
+		short depth;
+		int child;
+		int sibling;
+	};
+	int child(int node, char ch) const;
+	Node* _nodes;
+	int _nr_nodes;
+	int _size;
+	int _root[256];
+	int* _path;
+	int _max_depth;
+	int _depth;
+	struct
+	{
+		const char* sym;
+		int node;
+	} _sym_cache[LITERAL_SYM_CACHE_SIZE];
 };
 
 class BasicScanner : public AbstractScanner
 {
 public:
+	BasicScanner() : _literals_of(0) {}
 	virtual void initScanning(Grammar* grammar);
 	virtual void skipSpace(TextFileBuffer& text);
 	virtual bool acceptEOF(TextFileBuffer& text);
 	virtual bool acceptLiteral(TextFileBuffer& text, const char* sym);
-	virtual bool acceptTerminal(TextFileBuffer& text, Ident name, AbstractParseTree& result);
 	virtual bool acceptWhiteSpace(TextFileBuffer& text, Ident name);
+	virtual bool matchesAtCurrentChar() { return true; }
+	virtual bool terminalFirstChars(Ident name, GrammarCharSet& chars);
+
+protected:
+	virtual bool scanTerminal(TextFileBuffer& text, Ident name, AbstractParseTree& result);
 
 private:
 	bool accept_ident(TextFileBuffer& text, Ident& ident, bool& is_keyword, const char* keyword);
@@ -44,7 +169,11 @@ private:
 	TextFilePos _last_ident_pos;
 	TextFilePos _last_ident_end_pos;
 	bool _last_ident_is_keyword;
+	int _last_ident_node;
 	Ident _last_ident;
+	TextFilePos _last_literal_pos;
+	LiteralTrie _literals;
+	GrammarLiteral* _literals_of; // the literals in the trie
 
 	static Ident id_ident;
 	static Ident id_string;
@@ -58,7 +187,9 @@ class WhiteSpaceScanner : public BasicScanner
 {
 public:
 	virtual void skipSpace(TextFileBuffer& text);
-	virtual bool acceptTerminal(TextFileBuffer& text, Ident name, AbstractParseTree& result);
+
+protected:
+	virtual bool scanTerminal(TextFileBuffer& text, Ident name, AbstractParseTree& result);
 
 private:
 	bool accept_whitespace(TextFileBuffer& text, AbstractParseTree& result);
@@ -68,8 +199,8 @@ private:
 
 class ColourCodingScanner : public BasicScanner
 {
-public:
-	virtual bool acceptTerminal(TextFileBuffer& text, Ident name, AbstractParseTree& result);
+protected:
+	virtual bool scanTerminal(TextFileBuffer& text, Ident name, AbstractParseTree& result);
 
 private:
 	bool accept_colourcommand(TextFileBuffer& text, AbstractParseTree& result);
@@ -83,8 +214,10 @@ public:
 	virtual void skipSpace(TextFileBuffer& text);
 	virtual bool acceptEOF(TextFileBuffer& text);
 	virtual bool acceptLiteral(TextFileBuffer& text, const char* sym);
-	virtual bool acceptTerminal(TextFileBuffer& text, Ident name, AbstractParseTree& result);
 	virtual bool acceptWhiteSpace(TextFileBuffer& text, Ident name);
+
+protected:
+	virtual bool scanTerminal(TextFileBuffer& text, Ident name, AbstractParseTree& result);
 };
 
 class BareScanner : public RawScanner
@@ -7,6 +7,30 @@
 
 #include "Streams.h"
 
+/*	The block versions of emit have a fast path for ASCII characters,
+	which uses SSE2 when available, to find a run of characters that
+	can be passed on unchanged.
+*/
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define STREAMS_USE_SSE2
+#endif
+
+#define STREAMS_BLOCK_SIZE 1024
+
+static unsigned long ascii_prefix(const char* data, unsigned long n)
+{
+	unsigned long i = 0;
+#ifdef STREAMS_USE_SSE2
+	for (; i + 16 <= n; i += 16)
+		if (_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)(data + i))) != 0)
+			break;
+#endif
+	while (i < n && (data[i] & 0x80) == 0)
+		i++;
+	return i;
+}
+
 void CharStreamToFile::emit(char symbol)
 {
 	if (_text && symbol == '\n')
@@ -40,6 +64,67 @@ void UnicodeToUTF8ConverterStream::emit(UnicodeChar symbol)
 	}
 }
 
+void UnicodeToUTF8ConverterStream::emit(const UnicodeChar* data, unsigned long n)
+{
+	char buffer[STREAMS_BLOCK_SIZE];
+	while (n > 0)
+	{
+		unsigned long k = 0;
+		while (k < n && k < STREAMS_BLOCK_SIZE && data[k] < 0x80)
+		{
+			buffer[k] = (char)data[k];
+			k++;
+		}
+		if (k > 0)
+			_out->emit(buffer, k);
+		else
+			emit(data[k++]);
+		data += k;
+		n -= k;
+	}
+}
+
+void UTF16ToUTF8ConverterStream::emit(const char* data, unsigned long n)
+{
+	char buffer[STREAMS_BLOCK_SIZE];
+	while (n > 0)
+	{
+		/* Only handle complete ASCII characters (after the BOM) in blocks */
+		if (_count < 2 || _count % 2 == 1 || n < 2)
+		{
+			emit(*data++);
+			n--;
+			continue;
+		}
+		unsigned long k = 0;
+		unsigned long max_k = n / 2 < STREAMS_BLOCK_SIZE ? n / 2 : STREAMS_BLOCK_SIZE;
+#ifdef STREAMS_USE_SSE2
+		const __m128i non_ascii = _mm_set1_epi16((short)0xFF80);
+		const __m128i zero = _mm_setzero_si128();
+		for (; k + 8 <= max_k; k += 8)
+		{
+			__m128i units = _mm_loadu_si128((const __m128i*)(data + 2 * k));
+			if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(units, non_ascii), zero)) != 0xFFFF)
+				break;
+			_mm_storel_epi64((__m128i*)(buffer + k), _mm_packus_epi16(units, units));
+		}
+#endif
+		for (; k < max_k && data[2 * k + 1] == 0 && (data[2 * k] & 0x80) == 0; k++)
+			buffer[k] = data[2 * k];
+		if (k == 0)
+		{
+			emit(*data++);
+			emit(*data++);
+			n -= 2;
+			continue;
+		}
+		_out->emit(buffer, k);
+		_count += 2 * k;
+		data += 2 * k;
+		n -= 2 * k;
+	}
+}
+
 void UTF16ToUTF8ConverterStream::emit(char symbol)
 {
 	_count++;
@@ -72,6 +157,49 @@ void CodePageToUnicodeConverterStream::emit(char symbol)
 		_out->emit(code_point);
 }
 
+void CodePageToUnicodeConverterStream::emit(const char* data, unsigned long n)
+{
+	UnicodeChar buffer[STREAMS_BLOCK_SIZE];
+	while (n > 0)
+	{
+		unsigned long k = 0;
+		for (unsigned long i = 0; i < n && i < STREAMS_BLOCK_SIZE; i++)
+			if (_codePage.from(data[i], buffer[k]))
+				k++;
+		unsigned long done = n < STREAMS_BLOCK_SIZE ? n : STREAMS_BLOCK_SIZE;
+		_out->emit(buffer, k);
+		data += done;
+		n -= done;
+	}
+}
+
+void CodePageToUF8ConverterStream::emit(const char* data, unsigned long n)
+{
+	if (_codePage.uniform() < 0x80)
+	{
+		_codePageToUnicodeConverterStream.emit(data, n);
+		return;
+	}
+	while (n > 0)
+	{
+		unsigned long k = ascii_prefix(data, n);
+		if (k > 0)
+		{
+			_out->emit(data, k);
+			data += k;
+			n -= k;
+		}
+		for (k = 0; k < n && (data[k] & 0x80) != 0; k++)
+			;
+		if (k > 0)
+		{
+			_codePageToUnicodeConverterStream.emit(data, k);
+			data += k;
+			n -= k;
+		}
+	}
+}
+
 void UTF8ToUnicodeConverterStream::emit(char symbol)
 {
 	unsigned char value = (unsigned char)symbol;
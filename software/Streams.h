@@ -8,6 +8,7 @@ class AbstractStream
 {
 public:
 	virtual void emit(const T symbol) = 0;
+	virtual void emit(const T* data, unsigned long n) { for (unsigned long i = 0; i < n; i++) emit(data[i]); }
 };
 
 template<class T>
@@ -38,6 +39,54 @@ private:
 	T* _str;
 };
 
+template<class T>
+class StreamToGrowingString : public AbstractStream<T>
+{
+public:
+	StreamToGrowingString(unsigned long size) : _str(new T[size > 0 ? size : 1]), _size(size > 0 ? size : 1), _len(0) {}
+	~StreamToGrowingString() { delete[] _str; }
+	virtual void emit(const T symbol)
+	{
+		if (symbol == '\r')
+			return;
+		if (_len == _size)
+			grow();
+		_str[_len++] = symbol;
+	}
+	virtual void emit(const T* data, unsigned long n)
+	{
+		while (_len + n > _size)
+			grow();
+		for (unsigned long i = 0; i < n; i++)
+			if (data[i] != '\r')
+				_str[_len++] = data[i];
+	}
+	unsigned long length() { return _len; }
+	// Returns the string (terminated with a zero), which should be deleted by the caller
+	T* release()
+	{
+		if (_len == _size)
+			grow();
+		_str[_len] = 0;
+		T* str = _str;
+		_str = 0;
+		return str;
+	}
+private:
+	void grow()
+	{
+		T* new_str = new T[_size * 2];
+		for (unsigned long i = 0; i < _len; i++)
+			new_str[i] = _str[i];
+		delete[] _str;
+		_str = new_str;
+		_size *= 2;
+	}
+	T* _str;
+	unsigned long _size;
+	unsigned long _len;
+};
+
 class CharStreamToFile : public AbstractStream<char>
 {
 public:
@@ -174,6 +223,7 @@ class CodePageToUnicodeConverterStream : public ConverterStream<char, UnicodeCha
 public:
 	CodePageToUnicodeConverterStream(AbstractCodePage &codePage) : _codePage(codePage) {}
 	virtual void emit(const char symbol);
+	virtual void emit(const char* data, unsigned long n);
 private:
 	AbstractCodePage &_codePage;
 };
@@ -182,6 +232,7 @@ class UnicodeToUTF8ConverterStream : public ConverterStream<UnicodeChar, char>
 {
 public:
 	virtual void emit(const UnicodeChar symbol);
+	virtual void emit(const UnicodeChar* data, unsigned long n);
 };
 
 class CharToCharConverterStream : public ConverterStream<char, char>
@@ -195,6 +246,7 @@ public:
 	virtual bool isUTF8Encoded() { return true; }
 	virtual void setOutputStream(AbstractStream<char> *out)
 	{ 
+		CharToCharConverterStream::setOutputStream(out);
 		_unicodeToUTF8ConverterStream.setOutputStream(out);
 	}
 protected:
@@ -205,12 +257,14 @@ class CodePageToUF8ConverterStream : public ToUTF8ConverterStream
 {
 public:
 	CodePageToUF8ConverterStream(AbstractCodePage &codePage)
-	 : _codePageToUnicodeConverterStream(codePage)
+	 : _codePage(codePage), _codePageToUnicodeConverterStream(codePage)
 	{
 		_codePageToUnicodeConverterStream.setOutputStream(&_unicodeToUTF8ConverterStream);
 	}
 	virtual void emit(const char symbol) { _codePageToUnicodeConverterStream.emit(symbol); }
+	virtual void emit(const char* data, unsigned long n);
 private:
+	AbstractCodePage &_codePage;
 	CodePageToUnicodeConverterStream _codePageToUnicodeConverterStream;
 };
 		
@@ -227,6 +281,7 @@ public:
 		_count = 0;
 	}
 	virtual void emit(const char symbol);
+	virtual void emit(const char* data, unsigned long n);
 private:
 	long _count;
 	char _prev;
@@ -13,6 +13,8 @@ public:
 	String(const char *str);
 	String(const char *str, const char *till);
 	String(string_t *str);
+	String(const String &str);
+	~String() { clear(); }
 	String &operator=(const char *rhs);
 	String &operator=(string_t *rhs);
 	String &operator=(const String &rhs);
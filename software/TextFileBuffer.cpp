@@ -1,17 +1,39 @@
 #include <string.h>
 #include <stdio.h>
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
 #include "TextFileBuffer.h"
 
 #define TAB_POS 4
 
+/*	The skip methods look for the end of a run of characters sixteen
+	characters at the time with SSE2, when available. Only complete
+	blocks before the end of the buffer are examined in this way.
+*/
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TEXT_USE_SSE2
+#ifdef _MSC_VER
+#include <intrin.h>
+#define POPCOUNT(X) __popcnt(X)
+#else
+#define POPCOUNT(X) __builtin_popcount(X)
+#endif
+#endif
+
 TextFileBuffer::TextFileBuffer()
 {
 	_buffer = 0;
 	_utf8encoded = false;
+	_mapped_len = 0;
+	_furthest = 0;
 }
 
 
-void TextFileBuffer::assign(const char* str, unsigned long len, bool utf8encoded /* = false */)
+void TextFileBuffer::assign(const char* str, unsigned long len, bool utf8encoded /* = false */, unsigned long mapped_len /* = 0 */)
 {
 	_buffer = str;
 	_len = len;
@@ -20,6 +42,24 @@ void TextFileBuffer::assign(const char* str, unsigned long len, bool utf8encoded
 	_column = 1;
 	_info = _buffer;
 	_utf8encoded = utf8encoded;
+	_mapped_len = mapped_len;
+	_furthest = 0;
+}
+
+void TextFileBuffer::release()
+{
+	if (_mapped_len > 0)
+	{
+#ifdef WIN32
+		UnmapViewOfFile(_buffer);
+#else
+		munmap((void*)_buffer, _mapped_len);
+#endif
+	}
+	else
+		delete[] (char*)_buffer;
+	_buffer = 0;
+	_mapped_len = 0;
 }
 
 void TextFileBuffer::next()
@@ -44,6 +84,119 @@ void TextFileBuffer::next()
     }
 }
 
+void TextFileBuffer::skip(unsigned long steps)
+/*	Has the same effect as calling next() steps times. For longer
+	runs, the lines are counted first, after which only the characters
+	after the last newline need to be examined for the column.
+*/
+{
+	if (steps > _len - _pos)
+		steps = _len - _pos;
+	unsigned long i = 0;
+#ifdef TEXT_USE_SSE2
+	if (steps >= 16)
+	{
+		const __m128i newline = _mm_set1_epi8('\n');
+		unsigned long line_start = 0;
+		unsigned long b = 0;
+		for (; b + 16 <= steps; b += 16)
+		{
+			unsigned int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(_info + b)), newline));
+			if (mask != 0)
+			{
+				_line += POPCOUNT(mask);
+				int last = 15;
+				while ((mask & (1 << last)) == 0)
+					last--;
+				line_start = b + last + 1;
+			}
+		}
+		if (line_start > 0)
+		{
+			_column = 1;
+			i = line_start;
+		}
+	}
+#endif
+	for (; i < steps; i++)
+	{
+		char ch = _info[i];
+		if (ch == '\n')
+		{
+			_line++;
+			_column = 1;
+		}
+		else if (ch == '\t')
+			_column = ((_column + TAB_POS) % TAB_POS) * TAB_POS;
+		else if (!_utf8encoded || (ch & 0xC0) != 0x80)
+			_column++;
+	}
+	_pos += steps;
+	_info += steps;
+}
+
+#define IS_WHITE_SPACE(C) ((C) == ' ' || (C) == '\t' || (C) == '\n' || (C) == '\r')
+
+void TextFileBuffer::skipWhiteSpace()
+/*	Skips spaces, tabs, newlines and carriage returns. Most runs
+	are short, and they are first scanned one character at a time.
+*/
+{
+	for (int n = 0; n < 16; n++)
+	{
+		if (_pos >= _len || !IS_WHITE_SPACE(*_info))
+			return;
+		next();
+	}
+	unsigned long rest = _len - _pos;
+	unsigned long i = 0;
+#ifdef TEXT_USE_SSE2
+	const __m128i space = _mm_set1_epi8(' ');
+	const __m128i tab = _mm_set1_epi8('\t');
+	const __m128i newline = _mm_set1_epi8('\n');
+	const __m128i cr = _mm_set1_epi8('\r');
+	for (; i + 16 <= rest; i += 16)
+	{
+		__m128i chars = _mm_loadu_si128((const __m128i*)(_info + i));
+		__m128i white = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chars, space), _mm_cmpeq_epi8(chars, tab)),
+									 _mm_or_si128(_mm_cmpeq_epi8(chars, newline), _mm_cmpeq_epi8(chars, cr)));
+		if (_mm_movemask_epi8(white) != 0xFFFF)
+			break;
+	}
+#endif
+	while (i < rest && IS_WHITE_SPACE(_info[i]))
+		i++;
+	skip(i);
+}
+
+void TextFileBuffer::skipUntil(char ch)
+/*	Skips to the first occurence of ch, or the end of the text */
+{
+	const char *s = (const char*)memchr(_info, ch, _len - _pos);
+	skip(s != 0 ? s - _info : _len - _pos);
+}
+
+void TextFileBuffer::skipUntilEither(char ch1, char ch2)
+/*	Skips to the first occurence of ch1 or ch2, or the end of the text */
+{
+	unsigned long rest = _len - _pos;
+	unsigned long i = 0;
+#ifdef TEXT_USE_SSE2
+	const __m128i c1 = _mm_set1_epi8(ch1);
+	const __m128i c2 = _mm_set1_epi8(ch2);
+	for (; i + 16 <= rest; i += 16)
+	{
+		__m128i chars = _mm_loadu_si128((const __m128i*)(_info + i));
+		if (_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chars, c1), _mm_cmpeq_epi8(chars, c2))) != 0)
+			break;
+	}
+#endif
+	for (; i < rest; i++)
+		if (_info[i] == ch1 || _info[i] == ch2)
+			break;
+	skip(i);
+}
+
 void TextFileBuffer::advance(unsigned int steps)
 {
     _pos += steps;
@@ -8,8 +8,8 @@ class TextFileBuffer : public TextFilePos
 public:
 	TextFileBuffer();
 
-	void assign(const char* str, unsigned long len, bool utf8encoded = false);
-	void release() { delete (char*)_buffer; _buffer = 0; }
+	void assign(const char* str, unsigned long len, bool utf8encoded = false, unsigned long mapped_len = 0);
+	void release();
 	unsigned long length() { return _len; }
 
 	TextFileBuffer& operator=(const TextFileBuffer& lhs)
@@ -19,6 +19,8 @@ public:
 	}
 	TextFileBuffer& operator=(const TextFilePos& lhs)
 	{	
+		if (_pos > _furthest)
+			_furthest = _pos;
 		*(TextFilePos*)this = lhs;
 		_info = _buffer + _pos;
 		return *this;
@@ -26,19 +28,34 @@ public:
 	
 	inline bool eof() { return _pos >= _len; }
 	inline char operator*() { return *_info; }
-	inline char operator[](int i) { return _info[i]; }
+	inline char operator[](int i) { examined(i); return _info[i]; }
 	inline operator const char*() { return _info; }
 	void next();
 	void advance(unsigned int steps);
+	void skip(unsigned long steps);
+	void skipWhiteSpace();
+	void skipUntil(char ch);
+	void skipUntilEither(char ch1, char ch2);
 
 	void print_state();
 	const char* start();
 
+	/* The furthest position at which the text was read since setFurthest,
+	   including the positions that were left again by going back to an
+	   earlier position, as a scanner does when it fails, and those that
+	   were looked at ahead with operator[] or examined. */
+	inline unsigned long furthest() { return _pos > _furthest ? _pos : _furthest; }
+	inline void setFurthest(unsigned long pos) { _furthest = pos; }
+	// Records that the character i positions ahead was read
+	inline void examined(int i) { if (_pos + i > _furthest) _furthest = _pos + i; }
+
 private:
 	const char *_buffer;
 	const char *_info;
 	unsigned long _len;
 	bool _utf8encoded;
+	unsigned long _mapped_len; // non-zero if _buffer is a memory mapped file
+	unsigned long _furthest;
 };
 
 #endif // _INCLUDED_TEXTFILEBUFFER_H
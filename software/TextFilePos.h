@@ -23,6 +23,13 @@ public:
 	inline unsigned long position() { return _pos; }
 	inline int line() { return _line; }
 	inline int column() { return _column; }
+	// Moves the position after an edit before it (see ParseSolutions::edit)
+	void shift(long pos_delta, int from_line, int line_delta, int column_delta)
+	{	_pos += pos_delta;
+		if (_line == from_line)
+			_column += column_delta;
+		_line += line_delta;
+	}
 
 protected:
 	unsigned long _pos;
@@ -1,8 +1,12 @@
 #include <stdio.h>
 #ifdef WIN32
 #include <io.h>
+#include <windows.h>
 #else
 #include <sys/io.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <unistd.h>
 #endif
 
 #include "TextReader.h"
@@ -18,30 +22,83 @@ void PlainFileReader::read(FILE *f, TextFileBuffer &textBuffer)
 	textBuffer.assign(str, len, /* utf8encoded */false);
 }
 
-void ConverterFileReader::read(FILE *f, TextFileBuffer &textBuffer)
+void MmapFileReader::read(FILE *f, TextFileBuffer &textBuffer)
 {
-	TextFileBuffer plainTextBuffer;
+	/*	The parser needs a '\0' after the last character. Where the
+		file does not end on a page boundary, the rest of the last
+		page is zero filled. Otherwise an extra (zero filled) page is
+		needed after the file.
+	*/
+	int fh = fileno(f);
+#ifdef WIN32
+	HANDLE file = (HANDLE)_get_osfhandle(fh);
+	LARGE_INTEGER size;
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	if (   GetFileSizeEx(file, &size) && size.QuadPart > 0 && size.HighPart == 0
+		&& size.LowPart % info.dwPageSize != 0)
+	{
+		HANDLE mapping = CreateFileMapping(file, 0, PAGE_READONLY, 0, 0, 0);
+		if (mapping != 0)
+		{
+			const char *str = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+			CloseHandle(mapping);
+			if (str != 0)
+			{
+				textBuffer.assign(str, size.LowPart, /* utf8encoded */false, size.LowPart);
+				return;
+			}
+		}
+	}
+#else
+	struct stat st;
+	if (fstat(fh, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+	{
+		unsigned long len = st.st_size;
+		unsigned long page_size = sysconf(_SC_PAGESIZE);
+		unsigned long mapped_len = (len / page_size + 1) * page_size;
+		void *area = mmap(0, mapped_len, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (area != MAP_FAILED)
+		{
+			if (mmap(area, len, PROT_READ, MAP_PRIVATE | MAP_FIXED, fh, 0) != MAP_FAILED)
+			{
+				madvise(area, len, MADV_SEQUENTIAL);
+				textBuffer.assign((const char*)area, len, /* utf8encoded */false, mapped_len);
+				return;
+			}
+			munmap(area, mapped_len);
+		}
+	}
+#endif
 	PlainFileReader plainFileReader;
-	plainFileReader.read(f, plainTextBuffer);
+	plainFileReader.read(f, textBuffer);
+}
 
-	StreamCounter<char> streamCounter;
-	_converter.setOutputStream(&streamCounter);
-	TextFilePos startPos = plainTextBuffer;
-	for (; !plainTextBuffer.eof(); plainTextBuffer.next())
-		_converter.emit(*plainTextBuffer);
-	unsigned long len = streamCounter.count();
+#define CONVERTER_CHUNK_SIZE 65536
 
-	char *str = new char[len+1];
+void ConverterFileReader::read(FILE *f, TextFileBuffer &textBuffer)
+/*	The file is read in chunks, which are converted in a single
+	pass into a buffer that grows when needed. The initial size
+	of the buffer is a guess based on the length of the file.
+*/
+{
+	int fh = fileno(f);
+	unsigned long file_len = lseek(fh, 0L, SEEK_END);
+	lseek(fh, 0L, SEEK_SET);
 
-	StreamToString<char> streamToString(str);
+	StreamToGrowingString<char> streamToString(file_len + file_len / 4 + 1);
 	_converter.setOutputStream(&streamToString);
-	plainTextBuffer = startPos;
-	for (; !plainTextBuffer.eof(); plainTextBuffer.next())
-		_converter.emit(*plainTextBuffer);
-	streamToString.emit('\0');
-
-	textBuffer.assign(str, len, _converter.isUTF8Encoded());
+	char *chunk = new char[CONVERTER_CHUNK_SIZE];
+	for (;;)
+	{
+		long len = ::read(fh, chunk, CONVERTER_CHUNK_SIZE);
+		if (len <= 0)
+			break;
+		_converter.emit(chunk, len);
+	}
+	delete[] chunk;
 
-	plainTextBuffer.release();
+	unsigned long len = streamToString.length();
+	textBuffer.assign(streamToString.release(), len, _converter.isUTF8Encoded());
 }
 
@@ -16,6 +16,18 @@ public:
 	virtual void read(FILE *f, TextFileBuffer &textBuffer);
 };
 
+/*	MmapFileReader maps the file in memory instead of reading it, such
+	that parsing can start without copying the file. The buffer is only
+	valid until TextFileBuffer::release is called. When the file cannot
+	be mapped, it is read like PlainFileReader does.
+*/
+
+class MmapFileReader : public AbstractFileReader
+{
+public:
+	virtual void read(FILE *f, TextFileBuffer &textBuffer);
+};
+
 class ConverterFileReader : public AbstractFileReader
 {
 public:
@@ -0,0 +1,246 @@
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#endif
+#include "Threads.h"
+
+struct Thread::impl_t
+{
+	void (*function)(void *data);
+	void *data;
+#ifdef WIN32
+	HANDLE handle;
+#else
+	pthread_t thread;
+#endif
+};
+
+#ifdef WIN32
+static DWORD WINAPI thread_start(LPVOID arg)
+{
+	Thread::impl_t *impl = (Thread::impl_t*)arg;
+	impl->function(impl->data);
+	return 0;
+}
+#else
+static void *thread_start(void *arg)
+{
+	Thread::impl_t *impl = (Thread::impl_t*)arg;
+	impl->function(impl->data);
+	return 0;
+}
+#endif
+
+bool Thread::start(void (*function)(void *data), void *data)
+{
+	join();
+	_impl = new impl_t;
+	_impl->function = function;
+	_impl->data = data;
+#ifdef WIN32
+	_impl->handle = CreateThread(0, 0, thread_start, _impl, 0, 0);
+	if (_impl->handle != 0)
+		return true;
+#else
+	if (pthread_create(&_impl->thread, 0, thread_start, _impl) == 0)
+		return true;
+#endif
+	delete _impl;
+	_impl = 0;
+	return false;
+}
+
+void Thread::join()
+{
+	if (_impl == 0)
+		return;
+#ifdef WIN32
+	WaitForSingleObject(_impl->handle, INFINITE);
+	CloseHandle(_impl->handle);
+#else
+	pthread_join(_impl->thread, 0);
+#endif
+	delete _impl;
+	_impl = 0;
+}
+
+struct Mutex::impl_t
+{
+#ifdef WIN32
+	CRITICAL_SECTION critical_section;
+#else
+	pthread_mutex_t mutex;
+#endif
+};
+
+Mutex::Mutex()
+{
+	_impl = new impl_t;
+#ifdef WIN32
+	InitializeCriticalSection(&_impl->critical_section);
+#else
+	pthread_mutex_init(&_impl->mutex, 0);
+#endif
+}
+
+Mutex::~Mutex()
+{
+#ifdef WIN32
+	DeleteCriticalSection(&_impl->critical_section);
+#else
+	pthread_mutex_destroy(&_impl->mutex);
+#endif
+	delete _impl;
+}
+
+void Mutex::lock()
+{
+#ifdef WIN32
+	EnterCriticalSection(&_impl->critical_section);
+#else
+	pthread_mutex_lock(&_impl->mutex);
+#endif
+}
+
+void Mutex::unlock()
+{
+#ifdef WIN32
+	LeaveCriticalSection(&_impl->critical_section);
+#else
+	pthread_mutex_unlock(&_impl->mutex);
+#endif
+}
+
+struct Condition::impl_t
+{
+#ifdef WIN32
+	CONDITION_VARIABLE condition;
+#else
+	pthread_cond_t condition;
+#endif
+};
+
+Condition::Condition()
+{
+	_impl = new impl_t;
+#ifdef WIN32
+	InitializeConditionVariable(&_impl->condition);
+#else
+	pthread_cond_init(&_impl->condition, 0);
+#endif
+}
+
+Condition::~Condition()
+{
+#ifndef WIN32
+	pthread_cond_destroy(&_impl->condition);
+#endif
+	delete _impl;
+}
+
+void Condition::wait(Mutex& mutex)
+{
+#ifdef WIN32
+	SleepConditionVariableCS(&_impl->condition, &mutex._impl->critical_section, INFINITE);
+#else
+	pthread_cond_wait(&_impl->condition, &mutex._impl->mutex);
+#endif
+}
+
+void Condition::signal()
+{
+#ifdef WIN32
+	WakeConditionVariable(&_impl->condition);
+#else
+	pthread_cond_signal(&_impl->condition);
+#endif
+}
+
+void Condition::signalAll()
+{
+#ifdef WIN32
+	WakeAllConditionVariable(&_impl->condition);
+#else
+	pthread_cond_broadcast(&_impl->condition);
+#endif
+}
+
+long atomicIncrement(volatile long &value)
+{
+#ifdef WIN32
+	return InterlockedIncrement(&value);
+#else
+	return __sync_add_and_fetch(&value, 1);
+#endif
+}
+
+int atomicIncrement(volatile int &value)
+{
+#ifdef WIN32
+	return InterlockedIncrement((volatile LONG*)&value);
+#else
+	return __sync_add_and_fetch(&value, 1);
+#endif
+}
+
+long atomicDecrement(volatile long &value)
+{
+#ifdef WIN32
+	return InterlockedDecrement(&value);
+#else
+	return __sync_sub_and_fetch(&value, 1);
+#endif
+}
+
+int atomicDecrement(volatile int &value)
+{
+#ifdef WIN32
+	return InterlockedDecrement((volatile LONG*)&value);
+#else
+	return __sync_sub_and_fetch(&value, 1);
+#endif
+}
+
+long atomicValue(volatile long &value)
+{
+#ifdef WIN32
+	return InterlockedCompareExchange(&value, 0, 0);
+#else
+	return __sync_fetch_and_add(&value, 0);
+#endif
+}
+
+int atomicValue(volatile int &value)
+{
+#ifdef WIN32
+	return InterlockedCompareExchange((volatile LONG*)&value, 0, 0);
+#else
+	return __sync_fetch_and_add(&value, 0);
+#endif
+}
+
+void yieldThread()
+{
+#ifdef WIN32
+	SwitchToThread();
+#else
+	sched_yield();
+#endif
+}
+
+double wallClockTime()
+{
+#ifdef WIN32
+	LARGE_INTEGER frequency, counter;
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&counter);
+	return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+#endif
+}
@@ -0,0 +1,73 @@
+#ifndef _INCLUDED_THREADS_H
+#define _INCLUDED_THREADS_H
+
+/*	A minimal portable layer for running functions in parallel threads,
+	for mutual exclusion, for letting threads wait for each other, and
+	for distributing work between them with atomic counters.
+*/
+
+#ifdef WIN32
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+class Thread
+{
+public:
+	Thread() : _impl(0) {}
+	~Thread() { join(); }
+	bool start(void (*function)(void *data), void *data);
+	void join();
+
+	struct impl_t;
+private:
+	impl_t *_impl;
+};
+
+class Mutex
+{
+	friend class Condition;
+public:
+	Mutex();
+	~Mutex();
+	void lock();
+	void unlock();
+
+	struct impl_t;
+private:
+	impl_t *_impl;
+};
+
+class Condition
+{
+public:
+	Condition();
+	~Condition();
+	// Waits until signalled, with the mutex unlocked in the meantime
+	void wait(Mutex& mutex);
+	// Wakes up one of the threads that wait
+	void signal();
+	// Wakes up all threads that wait
+	void signalAll();
+
+	struct impl_t;
+private:
+	impl_t *_impl;
+};
+
+// Increments the value and returns the result
+long atomicIncrement(volatile long &value);
+int atomicIncrement(volatile int &value);
+// Decrements the value and returns the result
+long atomicDecrement(volatile long &value);
+int atomicDecrement(volatile int &value);
+// Returns the value, as left by the atomic operations of other threads
+long atomicValue(volatile long &value);
+int atomicValue(volatile int &value);
+// Lets other threads run, for a thread that waits for work
+void yieldThread();
+// Returns the elapsed (wall clock) time in seconds since some fixed moment
+double wallClockTime();
+
+#endif // _INCLUDED_THREADS_H
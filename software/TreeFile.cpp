@@ -0,0 +1,636 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "Ident.h"
+#include "String.h"
+#include "AbstractParseTree.h"
+#include "TextFileBuffer.h"
+#include "TextReader.h"
+#include "TreeFile.h"
+
+#define TREE_FILE_MAGIC "IParseTr"
+#define TREE_FILE_VERSION 1
+#define TREE_FILE_BYTE_ORDER 0x01020304
+#define TREE_FILE_HEADER_LEN 32
+
+#define TF_EMPTY         0
+#define TF_IDENT         1
+#define TF_STRING        2
+#define TF_NULL_STRING   3
+#define TF_INT           4
+#define TF_DOUBLE        5
+#define TF_CHAR          6
+#define TF_LIST          7
+#define TF_TREE          8
+#define TF_OPENCONTEXT   9
+#define TF_CLOSECONTEXT 10
+
+static unsigned long tree_file_zigzag(long value)
+{
+	return value < 0 ? ((unsigned long)~value << 1) | 1 : (unsigned long)value << 1;
+}
+
+static long tree_file_unzigzag(unsigned long value)
+{
+	return (value & 1) != 0 ? ~(long)(value >> 1) : (long)(value >> 1);
+}
+
+static unsigned long tree_file_hash(const char* str)
+{
+	unsigned long hash = 2166136261UL;
+	for (; *str != '\0'; str++)
+		hash = (hash ^ (unsigned char)*str) * 16777619UL;
+	return hash;
+}
+
+
+TreeFileWriter::TreeFileWriter()
+  : _part_sizes(0), _nr_part_sizes(0), _size_part_sizes(0), _next_part_sizes(0),
+    _strings(0), _nr_strings(0), _size_strings(0), _string_hash(0), _size_string_hash(0),
+    _nodes(0), _len(0), _lines(0), _columns(0), _nr_nodes(0)
+{
+}
+
+TreeFileWriter::~TreeFileWriter()
+{
+	delete[] _part_sizes;
+	delete[] _strings;
+	delete[] _string_hash;
+	delete[] _nodes;
+	delete[] _lines;
+	delete[] _columns;
+}
+
+bool TreeFileWriter::write(FILE* f, const AbstractParseTree& tree)
+/*	Writes the tree in two passes. The first pass collects the strings
+	and the sizes of the parts of all lists and trees, such that the
+	second pass can put these sizes in front of the parts.
+*/
+{
+	Sizes sizes;
+	measure(tree, sizes);
+
+	_nodes = new unsigned char[sizes.nr_bytes];
+	_lines = new unsigned int[sizes.nr_nodes];
+	_columns = new unsigned int[sizes.nr_nodes];
+	put_node(tree);
+
+	unsigned long strings_len = 0;
+	for (unsigned long i = 0; i < _nr_strings; i++)
+		strings_len += strlen(_strings[i]) + 1;
+	/* The numbers in the header and the tables have 32 bits */
+	if (   _nr_strings > 0xffffffffUL || _nr_nodes > 0xffffffffUL
+		|| _len > 0xffffffffUL || strings_len > 0xffffffffUL)
+		return false;
+	unsigned int* offsets = new unsigned int[_nr_strings];
+	unsigned long offset = 0;
+	for (unsigned long i = 0; i < _nr_strings; i++)
+	{
+		offsets[i] = (unsigned int)offset;
+		offset += strlen(_strings[i]) + 1;
+	}
+
+	char header[TREE_FILE_HEADER_LEN];
+	unsigned int fields[6] = { TREE_FILE_VERSION, TREE_FILE_BYTE_ORDER, (unsigned int)_nr_strings, (unsigned int)_nr_nodes,
+							   (unsigned int)_len, (unsigned int)strings_len };
+	memcpy(header, TREE_FILE_MAGIC, 8);
+	memcpy(header + 8, fields, 24);
+
+	bool written =    fwrite(header, 1, TREE_FILE_HEADER_LEN, f) == TREE_FILE_HEADER_LEN
+				   && fwrite(offsets, sizeof(unsigned int), _nr_strings, f) == _nr_strings
+				   && fwrite(_lines, sizeof(unsigned int), _nr_nodes, f) == _nr_nodes
+				   && fwrite(_columns, sizeof(unsigned int), _nr_nodes, f) == _nr_nodes
+				   && fwrite(_nodes, 1, _len, f) == _len;
+	for (unsigned long i = 0; i < _nr_strings && written; i++)
+		written = fwrite(_strings[i], 1, strlen(_strings[i]) + 1, f) == strlen(_strings[i]) + 1;
+	delete[] offsets;
+	return written;
+}
+
+void TreeFileWriter::measure(const AbstractParseTree& tree, Sizes& sizes)
+/*	Returns the number of nodes and the number of bytes of the tree */
+{
+	sizes.nr_nodes = 1;
+	sizes.nr_parts = 0;
+	if (tree.isEmpty())
+		sizes.nr_bytes = 1;
+	else if (tree.isIdent())
+		sizes.nr_bytes = 1 + varint_len(string_nr(tree.identName().val()));
+	else if (tree.isString())
+	{
+		String str = tree.string();
+		sizes.nr_bytes = str.empty() ? 1 : 1 + varint_len(string_nr(str.val()));
+	}
+	else if (tree.isInt())
+		sizes.nr_bytes = 1 + varint_len(tree_file_zigzag(tree.intValue()));
+	else if (tree.isDouble())
+		sizes.nr_bytes = 1 + sizeof(double);
+	else if (tree.isChar())
+		sizes.nr_bytes = 2;
+	else if (tree.isList() || tree.isTree())
+	{
+		if (_nr_part_sizes == _size_part_sizes)
+		{
+			_size_part_sizes = 2 * _size_part_sizes + 1000;
+			Sizes* new_part_sizes = new Sizes[_size_part_sizes];
+			for (unsigned long i = 0; i < _nr_part_sizes; i++)
+				new_part_sizes[i] = _part_sizes[i];
+			delete[] _part_sizes;
+			_part_sizes = new_part_sizes;
+		}
+		unsigned long part_sizes_nr = _nr_part_sizes++;
+
+		Sizes parts;
+		parts.nr_nodes = 0;
+		parts.nr_bytes = 0;
+		parts.nr_parts = 0;
+		for (AbstractParseTree::iterator it(tree); it.more(); it.next())
+		{
+			Sizes part;
+			measure(it, part);
+			parts.nr_nodes += part.nr_nodes;
+			parts.nr_bytes += part.nr_bytes;
+			parts.nr_parts++;
+		}
+		_part_sizes[part_sizes_nr] = parts;
+
+		sizes.nr_nodes += parts.nr_nodes;
+		sizes.nr_bytes =   1 + (tree.isList() ? 0 : varint_len(string_nr(tree.type())))
+						 + varint_len(parts.nr_parts) + varint_len(parts.nr_nodes)
+						 + varint_len(parts.nr_bytes) + parts.nr_bytes;
+	}
+	else
+		sizes.nr_bytes = 1;
+}
+
+void TreeFileWriter::put_node(const AbstractParseTree& tree)
+{
+	unsigned long nr = _nr_nodes++;
+	_lines[nr] = tree.isEmpty() ? 0 : tree.line();
+	_columns[nr] = tree.isEmpty() ? 0 : tree.column();
+
+	unsigned char kind;
+	if (tree.isEmpty())
+		kind = TF_EMPTY;
+	else if (tree.isIdent())
+	{
+		kind = TF_IDENT;
+		put_bytes(&kind, 1);
+		put_varint(string_nr(tree.identName().val()));
+		return;
+	}
+	else if (tree.isString())
+	{
+		String str = tree.string();
+		kind = str.empty() ? TF_NULL_STRING : TF_STRING;
+		put_bytes(&kind, 1);
+		if (!str.empty())
+			put_varint(string_nr(str.val()));
+		return;
+	}
+	else if (tree.isInt())
+	{
+		kind = TF_INT;
+		put_bytes(&kind, 1);
+		put_varint(tree_file_zigzag(tree.intValue()));
+		return;
+	}
+	else if (tree.isDouble())
+	{
+		kind = TF_DOUBLE;
+		put_bytes(&kind, 1);
+		double value = tree.doubleValue();
+		put_bytes(&value, sizeof(double));
+		return;
+	}
+	else if (tree.isChar())
+	{
+		kind = TF_CHAR;
+		put_bytes(&kind, 1);
+		char value = tree.charValue();
+		put_bytes(&value, 1);
+		return;
+	}
+	else if (tree.isList() || tree.isTree())
+	{
+		Sizes parts = _part_sizes[_next_part_sizes++];
+		kind = tree.isList() ? TF_LIST : TF_TREE;
+		put_bytes(&kind, 1);
+		if (kind == TF_TREE)
+			put_varint(string_nr(tree.type()));
+		put_varint(parts.nr_parts);
+		put_varint(parts.nr_nodes);
+		put_varint(parts.nr_bytes);
+		for (AbstractParseTree::iterator it(tree); it.more(); it.next())
+			put_node(it);
+		return;
+	}
+	else
+		kind = strcmp(tree.type(), "<opencontext>") == 0 ? TF_OPENCONTEXT : TF_CLOSECONTEXT;
+	put_bytes(&kind, 1);
+}
+
+unsigned long TreeFileWriter::string_nr(const char* str)
+/*	Returns the number of the string, adding it when it is new */
+{
+	if (2 * (_nr_strings + 1) > _size_string_hash)
+	{
+		delete[] _string_hash;
+		_size_string_hash = _size_string_hash == 0 ? 1024 : 2 * _size_string_hash;
+		_string_hash = new unsigned long[_size_string_hash];
+		for (unsigned long i = 0; i < _size_string_hash; i++)
+			_string_hash[i] = 0;
+		for (unsigned long nr = 0; nr < _nr_strings; nr++)
+		{
+			unsigned long i = tree_file_hash(_strings[nr]) & (_size_string_hash - 1);
+			while (_string_hash[i] != 0)
+				i = (i + 1) & (_size_string_hash - 1);
+			_string_hash[i] = nr + 1;
+		}
+	}
+
+	unsigned long i = tree_file_hash(str) & (_size_string_hash - 1);
+	for (; _string_hash[i] != 0; i = (i + 1) & (_size_string_hash - 1))
+		if (strcmp(_strings[_string_hash[i] - 1], str) == 0)
+			return _string_hash[i] - 1;
+
+	if (_nr_strings == _size_strings)
+	{
+		_size_strings = 2 * _size_strings + 1000;
+		const char** new_strings = new const char*[_size_strings];
+		for (unsigned long nr = 0; nr < _nr_strings; nr++)
+			new_strings[nr] = _strings[nr];
+		delete[] _strings;
+		_strings = new_strings;
+	}
+	_strings[_nr_strings] = str;
+	_string_hash[i] = ++_nr_strings;
+	return _nr_strings - 1;
+}
+
+void TreeFileWriter::put_varint(unsigned long value)
+{
+	unsigned char bytes[10];
+	int len = 0;
+	while (value >= 0x80)
+	{
+		bytes[len++] = (unsigned char)(value | 0x80);
+		value >>= 7;
+	}
+	bytes[len++] = (unsigned char)value;
+	put_bytes(bytes, len);
+}
+
+void TreeFileWriter::put_bytes(const void* bytes, unsigned long len)
+{
+	memcpy(_nodes + _len, bytes, len);
+	_len += len;
+}
+
+unsigned long TreeFileWriter::varint_len(unsigned long value)
+{
+	unsigned long len = 1;
+	for (; value >= 0x80; value >>= 7)
+		len++;
+	return len;
+}
+
+
+bool TreeFile::open(FILE* f)
+{
+	MmapFileReader mmapFileReader;
+	mmapFileReader.read(f, _buffer);
+	return read(_buffer, _buffer.length());
+}
+
+bool TreeFile::read(const char* data, unsigned long len)
+/*	Checks the header and the tables. The nodes themselves are not
+	checked, but only read when the tree is navigated, where the
+	numbers are checked against the header (see get_varint and
+	string). */
+{
+	unsigned int fields[6];
+	if (len < TREE_FILE_HEADER_LEN || memcmp(data, TREE_FILE_MAGIC, 8) != 0)
+		return false;
+	memcpy(fields, data + 8, 24);
+	if (fields[0] != TREE_FILE_VERSION || fields[1] != TREE_FILE_BYTE_ORDER)
+		return false;
+	unsigned long nr_strings = fields[2];
+	unsigned long nr_nodes = fields[3];
+	unsigned long nodes_len = fields[4];
+	unsigned long strings_len = fields[5];
+	unsigned long rest = len - TREE_FILE_HEADER_LEN;
+	if (nr_nodes == 0 || nodes_len == 0 || nr_strings > rest / sizeof(unsigned int))
+		return false;
+	rest -= sizeof(unsigned int) * nr_strings;
+	if (nr_nodes > rest / (2 * sizeof(unsigned int)))
+		return false;
+	rest -= 2 * sizeof(unsigned int) * nr_nodes;
+	if (nodes_len > rest || rest - nodes_len != strings_len)
+		return false;
+
+	_string_offsets = (const unsigned int*)(data + TREE_FILE_HEADER_LEN);
+	_lines = _string_offsets + nr_strings;
+	_columns = _lines + nr_nodes;
+	_nodes = (const unsigned char*)(_columns + nr_nodes);
+	_nodes_end = _nodes + nodes_len;
+	_strings = (const char*)_nodes_end;
+	if (strings_len > 0 && _strings[strings_len - 1] != '\0')
+		return false;
+	for (unsigned long i = 0; i < nr_strings; i++)
+		if (_string_offsets[i] >= strings_len)
+			return false;
+
+	_nr_strings = nr_strings;
+	_nr_nodes = nr_nodes;
+	return true;
+}
+
+unsigned long TreeFile::get_varint(const unsigned char*& data) const
+/*	Stops at the end of the nodes, and ignores the bits that do not fit */
+{
+	unsigned long value = 0;
+	int shift = 0;
+	while (data < _nodes_end && (*data & 0x80) != 0)
+	{
+		if (shift < (int)sizeof(unsigned long) * 8)
+			value |= (unsigned long)(*data & 0x7f) << shift;
+		data++;
+		shift += 7;
+	}
+	if (data < _nodes_end)
+	{
+		if (shift < (int)sizeof(unsigned long) * 8)
+			value |= (unsigned long)(*data) << shift;
+		data++;
+	}
+	return value;
+}
+
+const char* TreeFile::string(unsigned long nr) const
+{
+	return nr < _nr_strings ? _strings + _string_offsets[nr] : "";
+}
+
+TreeFile::Node::Node(const iterator& it)
+  : _file(it._file), _data(it._data < it._file->_nodes_end ? it._data : 0), _nr(it._nr)
+{
+}
+
+bool TreeFile::Node::isEmpty() const
+{
+	return _data == 0 || *_data == TF_EMPTY;
+}
+
+bool TreeFile::Node::isIdent() const
+{
+	return _data != 0 && *_data == TF_IDENT;
+}
+
+bool TreeFile::Node::isIdent(const char* name) const
+{
+	return isIdent() && strcmp(identName(), name) == 0;
+}
+
+const char* TreeFile::Node::identName() const
+{
+	const unsigned char* data = _data + 1;
+	return _file->string(_file->get_varint(data));
+}
+
+bool TreeFile::Node::isString() const
+{
+	return _data != 0 && (*_data == TF_STRING || *_data == TF_NULL_STRING);
+}
+
+const char* TreeFile::Node::stringValue() const
+{
+	if (*_data == TF_NULL_STRING)
+		return "";
+	const unsigned char* data = _data + 1;
+	return _file->string(_file->get_varint(data));
+}
+
+bool TreeFile::Node::isInt() const
+{
+	return _data != 0 && *_data == TF_INT;
+}
+
+long TreeFile::Node::intValue() const
+{
+	const unsigned char* data = _data + 1;
+	return tree_file_unzigzag(_file->get_varint(data));
+}
+
+bool TreeFile::Node::isDouble() const
+{
+	return _data != 0 && *_data == TF_DOUBLE;
+}
+
+double TreeFile::Node::doubleValue() const
+{
+	double value = 0.0;
+	if (_data + 1 + sizeof(double) <= _file->_nodes_end)
+		memcpy(&value, _data + 1, sizeof(double));
+	return value;
+}
+
+bool TreeFile::Node::isChar() const
+{
+	return _data != 0 && *_data == TF_CHAR;
+}
+
+char TreeFile::Node::charValue() const
+{
+	return _data + 1 < _file->_nodes_end ? (char)_data[1] : '\0';
+}
+
+bool TreeFile::Node::isList() const
+{
+	return _data != 0 && *_data == TF_LIST;
+}
+
+bool TreeFile::Node::isTree() const
+{
+	return _data != 0 && *_data == TF_TREE;
+}
+
+bool TreeFile::Node::isTree(const char* name) const
+{
+	return isTree() && strcmp(type(), name) == 0;
+}
+
+const char* TreeFile::Node::type() const
+{
+	switch (*_data)
+	{
+		case TF_IDENT: return "identifier";
+		case TF_STRING:
+		case TF_NULL_STRING: return "string value";
+		case TF_INT: return "integer value";
+		case TF_DOUBLE: return "double value";
+		case TF_CHAR: return "char value";
+		case TF_LIST: return "list";
+		case TF_OPENCONTEXT: return "<opencontext>";
+		case TF_CLOSECONTEXT: return "<closecontext>";
+	}
+	const unsigned char* data = _data + 1;
+	return _file->string(_file->get_varint(data));
+}
+
+int TreeFile::Node::nrParts() const
+{
+	if (!isList() && !isTree())
+		return 0;
+	const unsigned char* data = _data + 1;
+	if (*_data == TF_TREE)
+		_file->get_varint(data);
+	return _file->get_varint(data);
+}
+
+int TreeFile::Node::line() const
+{
+	return _data != 0 && _nr < _file->_nr_nodes ? _file->_lines[_nr] : 0;
+}
+
+int TreeFile::Node::column() const
+{
+	return _data != 0 && _nr < _file->_nr_nodes ? _file->_columns[_nr] : 0;
+}
+
+TreeFile::Node TreeFile::Node::part(int n) const
+/*	Returns the n-th part (counting from 1), or an empty node */
+{
+	iterator it(*this);
+	for (; it.more() && n > 1; n--)
+		it.next();
+	return it.more() ? Node(it) : Node();
+}
+
+void TreeFile::Node::print(FILE* f, bool compact) const
+/*	Prints the tree like AbstractParseTree::print does */
+{
+	print_rec(f, compact, 0);
+	if (!compact)
+		fprintf(f, "\n");
+}
+
+void TreeFile::Node::print_rec(FILE* f, bool compact, int depth) const
+{
+	if (isEmpty())
+	{
+		fprintf(f, "[EMPTY]");
+		return;
+	}
+	if (line() != 0)
+		fprintf(f, "<%d:%d>", line(), column());
+	switch (*_data)
+	{
+		case TF_IDENT:
+			fprintf(f, "%s", identName());
+			break;
+		case TF_STRING:
+		case TF_NULL_STRING:
+			fprintf(f, "\"");
+			for (const char *s = stringValue(); *s != '\0'; s++)
+			{
+				if (*s == '\n')
+					fprintf(f, "\\n");
+				else if (*s == '\t')
+					fprintf(f, "\\t");
+				else
+					fprintf(f, "%c", *s);
+			}
+			fprintf(f, "\"");
+			break;
+		case TF_INT:
+			fprintf(f, "%ld", intValue());
+			break;
+		case TF_DOUBLE:
+			fprintf(f, "%f", doubleValue());
+			break;
+		case TF_CHAR:
+			fprintf(f, "'%c'", charValue());
+			break;
+		case TF_OPENCONTEXT:
+			fprintf(f, "{");
+			break;
+		case TF_CLOSECONTEXT:
+			fprintf(f, "}");
+			break;
+		default:
+		{
+			const char* tree_type = type();
+			fprintf(f, "%s(", tree_type);
+			depth += strlen(tree_type) + 1;
+			bool first = true;
+			for (iterator it(*this); it.more(); it.next())
+			{
+				if (!first)
+				{   if (compact)
+						fprintf(f, ",");
+					else
+						fprintf(f, ",\n%*s", depth, "");
+				}
+				first = false;
+				Node(it).print_rec(f, compact, depth);
+			}
+			fprintf(f, ")");
+		}
+	}
+}
+
+TreeFile::iterator::iterator(const Node& node)
+  : _file(node._file), _data(0), _nr(node._nr + 1), _nr_parts(0)
+{
+	if (node.isList() || node.isTree())
+	{
+		const unsigned char* data = node._data + 1;
+		if (*node._data == TF_TREE)
+			_file->get_varint(data);
+		_nr_parts = _file->get_varint(data);
+		_file->get_varint(data); // number of nodes of the parts
+		_file->get_varint(data); // number of bytes of the parts
+		_data = data;
+	}
+}
+
+void TreeFile::iterator::next()
+/*	Skips the current part. A list or a tree is skipped as a whole
+	with its number of nodes and bytes. */
+{
+	if (_data >= _file->_nodes_end)
+	{
+		_nr_parts = 0;
+		return;
+	}
+	unsigned char kind = *_data++;
+	_nr++;
+	switch (kind)
+	{
+		case TF_IDENT:
+		case TF_STRING:
+		case TF_INT:
+			_file->get_varint(_data);
+			break;
+		case TF_DOUBLE:
+			_data += sizeof(double);
+			break;
+		case TF_CHAR:
+			_data++;
+			break;
+		case TF_TREE:
+			_file->get_varint(_data);
+			// fall through
+		case TF_LIST:
+		{
+			_file->get_varint(_data); // number of parts
+			unsigned long nr_nodes = _file->get_varint(_data);
+			unsigned long nr_bytes = _file->get_varint(_data);
+			_nr += nr_nodes;
+			_data = nr_bytes < (unsigned long)(_file->_nodes_end - _data) ? _data + nr_bytes : _file->_nodes_end;
+			break;
+		}
+	}
+	_nr_parts--;
+}
@@ -0,0 +1,152 @@
+#ifndef _INCLUDED_TREEFILE_H
+#define _INCLUDED_TREEFILE_H
+
+#include "AbstractParseTree.h"
+#include "TextFileBuffer.h"
+
+/*	A tree file is a compact binary form of an abstract parse tree
+	(option -bin). It consists of:
+	- a header with the magic, the version, the byte order, the number
+	  of strings, the number of nodes and the length of the nodes,
+	- a table with the offsets of the strings,
+	- the lines and the columns of all the nodes, by pre-order number,
+	- the nodes in pre-order, each starting with a byte for its kind,
+	  followed by variable length numbers (varints): the index of the
+	  string of an identifier, a string or a tree type, the value of an
+	  integer (zig-zag encoded), and the number of parts, the number of
+	  nodes and the number of bytes of the parts of a list or a tree,
+	- the strings, each terminated with a '\0'.
+	Each identifier and string occurs only once in the file. Numbers in
+	the header and in the tables are stored in the byte order of the
+	machine. TreeFile reads the tree directly from the (mapped) file,
+	without building tree nodes: a TreeFile::Node refers to the position
+	of the node in the file, and skips the parts before the one asked
+	for with the number of bytes of their parts.
+*/
+
+class TreeFileWriter
+{
+public:
+	TreeFileWriter();
+	~TreeFileWriter();
+
+	bool write(FILE* f, const AbstractParseTree& tree);
+
+private:
+	struct Sizes
+	{
+		unsigned long nr_parts;
+		unsigned long nr_nodes;
+		unsigned long nr_bytes;
+	};
+	void measure(const AbstractParseTree& tree, Sizes& sizes);
+	void put_node(const AbstractParseTree& tree);
+	unsigned long string_nr(const char* str);
+	void put_varint(unsigned long value);
+	void put_bytes(const void* bytes, unsigned long len);
+	static unsigned long varint_len(unsigned long value);
+
+	// the sizes of the parts of the lists and trees, in pre-order
+	Sizes* _part_sizes;
+	unsigned long _nr_part_sizes;
+	unsigned long _size_part_sizes;
+	unsigned long _next_part_sizes;
+
+	// the strings, with a hash table on their contents
+	const char** _strings;
+	unsigned long _nr_strings;
+	unsigned long _size_strings;
+	unsigned long* _string_hash;
+	unsigned long _size_string_hash;
+
+	unsigned char* _nodes;
+	unsigned long _len;
+	unsigned int* _lines;
+	unsigned int* _columns;
+	unsigned long _nr_nodes;
+};
+
+class TreeFile
+{
+public:
+	TreeFile() : _nr_strings(0), _nr_nodes(0), _nodes_end(0) {}
+	~TreeFile() { _buffer.release(); }
+
+	bool open(FILE* f);
+	bool read(const char* data, unsigned long len);
+
+	class iterator;
+
+	class Node
+	{
+		friend class TreeFile;
+		friend class iterator;
+	public:
+		Node() : _file(0), _data(0), _nr(0) {}
+		Node(const iterator& it);
+
+		bool isEmpty() const;
+		bool isIdent() const;
+		bool isIdent(const char* name) const;
+		const char* identName() const;
+		bool isString() const;
+		const char* stringValue() const;
+		bool isInt() const;
+		long intValue() const;
+		bool isDouble() const;
+		double doubleValue() const;
+		bool isChar() const;
+		char charValue() const;
+		bool isList() const;
+		bool isTree() const;
+		bool isTree(const char* name) const;
+		const char* type() const;
+		int nrParts() const;
+		int line() const;
+		int column() const;
+		Node part(int n) const;
+
+		void print(FILE* f, bool compact) const;
+
+	private:
+		Node(const TreeFile* file, const unsigned char* data, unsigned long nr) : _file(file), _data(data), _nr(nr) {}
+		void print_rec(FILE* f, bool compact, int depth) const;
+		const TreeFile* _file;
+		const unsigned char* _data;
+		unsigned long _nr;
+	};
+
+	class iterator
+	{
+		friend class Node;
+	public:
+		iterator(const Node& node);
+		bool more() const { return _nr_parts > 0; }
+		void next();
+
+	private:
+		const TreeFile* _file;
+		const unsigned char* _data;
+		unsigned long _nr;
+		unsigned long _nr_parts;
+	};
+
+	Node root() const { return Node(this, _nodes, 0); }
+	unsigned long nrNodes() const { return _nr_nodes; }
+
+private:
+	unsigned long get_varint(const unsigned char*& data) const;
+	const char* string(unsigned long nr) const;
+
+	TextFileBuffer _buffer;
+	unsigned long _nr_strings;
+	unsigned long _nr_nodes;
+	const unsigned int* _string_offsets;
+	const unsigned char* _nodes;
+	const unsigned char* _nodes_end;
+	const unsigned int* _lines;
+	const unsigned int* _columns;
+	const char* _strings;
+};
+
+#endif // _INCLUDED_TREEFILE_H
@@ -0,0 +1,122 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "Ident.h"
+#include "String.h"
+#include "AbstractParseTree.h"
+#include "TreeStream.h"
+
+void AbstractTreeStream::stream(const AbstractParseTree& tree)
+{
+	if (   tree.isEmpty() || tree.isIdent() || tree.isString()
+		|| tree.isInt() || tree.isDouble() || tree.isChar())
+		atom(tree);
+	else
+	{
+		if (tree.isList())
+			openList();
+		else
+			openTree(tree.type());
+		for (AbstractParseTree::iterator child_it(tree); child_it.more(); child_it.next())
+			stream(child_it);
+		close();
+	}
+}
+
+void XMLTreeStream::openList()
+{
+	open_node(0);
+	fprintf(_f, "<LIST");
+}
+
+void XMLTreeStream::openTree(const char* type)
+{
+	open_node(type);
+	fprintf(_f, "<TREE TYPE=\"%s\"", type);
+}
+
+void XMLTreeStream::open_node(const char* type)
+{
+	end_pending();
+	fprintf(_f, "\n%*.*s", _depth, _depth, "");
+	if (_depth == _size_open)
+	{
+		int new_size = _size_open == 0 ? 20 : 2 * _size_open;
+		const char** new_open = new const char*[new_size];
+		for (int i = 0; i < _size_open; i++)
+			new_open[i] = _open[i];
+		delete[] _open;
+		_open = new_open;
+		_size_open = new_size;
+	}
+	_open[_depth++] = type;
+	_pending = true;
+}
+
+void XMLTreeStream::close()
+{
+	if (_depth == 0)
+		return;
+	const char* type = _open[--_depth];
+	if (_pending)
+	{
+		/* a list or a tree without parts */
+		fprintf(_f, "/>");
+		_pending = false;
+	}
+	else
+		fprintf(_f, type == 0 ? "</LIST>" : "</TREE>");
+}
+
+void XMLTreeStream::atom(const AbstractParseTree& atom)
+{
+	end_pending();
+	fprintf(_f, "\n%*.*s", _depth, _depth, "");
+	if (atom.isEmpty())
+		fprintf(_f, "<EMPTY/>");
+	else if (atom.isIdent())
+	{   fprintf(_f, "<ID>");
+		print_string(atom.identName().val());
+		fprintf(_f, "</ID>");
+	}
+	else if (atom.isString())
+	{   fprintf(_f, "<STRING>");
+		print_string(atom.identName().val());
+		fprintf(_f, "</STRING>");
+	}
+	else if (atom.isInt())
+		fprintf(_f, "<INT>%ld</INT>", atom.intValue());
+	else if (atom.isDouble())
+		fprintf(_f, "<DOUBLE>%f</DOUBLE>", atom.doubleValue());
+	else if (atom.isChar())
+	{
+		fprintf(_f, "<CHAR>");
+		char str[2];
+		str[0] = atom.charValue();
+		str[1] = '\0';
+		print_string(str);
+		fprintf(_f, "</CHAR>");
+	}
+}
+
+void XMLTreeStream::end_pending()
+{
+	if (_pending)
+	{
+		fprintf(_f, ">");
+		_pending = false;
+	}
+}
+
+void XMLTreeStream::print_string(const char *s)
+{
+	for (; *s != '\0'; s++)
+		if (*s == '<')
+			fprintf(_f, "&lt;");
+		else if (*s == '>')
+			fprintf(_f, "&gt;");
+		else if (*s == '&')
+			fprintf(_f, "&amp;");
+		else
+			fprintf(_f, "%c", *s);
+}
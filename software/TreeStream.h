@@ -0,0 +1,55 @@
+#ifndef _INCLUDED_TREESTREAM_H
+#define _INCLUDED_TREESTREAM_H
+
+#include "AbstractParseTree.h"
+
+/*	AbstractTreeStream receives an abstract parse tree as a series of
+	events: the opening of a list or a tree, an atom (any node that is
+	not a list or a tree), and the closing of the last opened list or
+	tree. The events are given in pre-order, such that an output format
+	can be written without the tree being present as a whole. BTParser
+	and BTVMParser, when given a stream (see AbstractParser::setTreeStream),
+	send each element of the top-level list of the input as soon as it has
+	been parsed, and drop it from the parse tree (see init_stream).
+*/
+
+class AbstractTreeStream
+{
+public:
+	virtual ~AbstractTreeStream() {}
+
+	virtual void openList() = 0;
+	virtual void openTree(const char* type) = 0;
+	virtual void atom(const AbstractParseTree& atom) = 0;
+	virtual void close() = 0;
+
+	void stream(const AbstractParseTree& tree);
+};
+
+/*	XMLTreeStream writes the events in the XML format of option -xml.
+*/
+
+class XMLTreeStream : public AbstractTreeStream
+{
+public:
+	XMLTreeStream(FILE* f) : _f(f), _depth(0), _open(0), _size_open(0), _pending(false) {}
+	~XMLTreeStream() { delete[] _open; }
+
+	void openList();
+	void openTree(const char* type);
+	void atom(const AbstractParseTree& atom);
+	void close();
+
+private:
+	void open_node(const char* type);
+	void end_pending();
+	void print_string(const char *s);
+
+	FILE* _f;
+	int _depth;
+	const char** _open; // types of the open nodes, 0 for a list
+	int _size_open;
+	bool _pending; // the start tag of the last opened node is not closed
+};
+
+#endif // _INCLUDED_TREESTREAM_H
@@ -1,5 +1,6 @@
 #include "Ident.cpp"
 #include "String.cpp"
+#include "Threads.cpp"
 #include "AbstractParseTree.cpp"
 #include "TextFileBuffer.cpp"
 #include "Scanner.cpp"
@@ -9,11 +10,19 @@
 #include <unistd.h>
 #include "ParserGrammar.cpp"
 #include "AbstractParser.cpp"
+#include "LookaheadDFA.cpp"
 #include "BTParser.cpp"
+#include "BTVMParser.cpp"
 #include "BTHeapParser.cpp"
 #include "LL1Parser.cpp"
 #include "LL1HeapParser.cpp"
+#include "LL1HeapColourParser.cpp"
 #include "ParParser.cpp"
+#include "GeneratedParser.cpp"
+#include "ParserGenerator.cpp"
+#include "GrammarFile.cpp"
+#include "TreeFile.cpp"
+#include "TreeStream.cpp"
 #include "CodePages.cpp"
 #include "Streams.cpp"
 #include "TextReader.cpp"